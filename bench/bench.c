@@ -0,0 +1,791 @@
+/*
+ * ZIGMA, Copyright (C) 2024 Chase Zehl O'Byrne
+ *   <mail: zehl@live.com> http://zehlchen.com/
+ *
+ * This file is part of ZIGMA.
+ *
+ * ZIGMA is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ZIGMA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ZIGMA; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/* zigma_bench: micro and end-to-end benchmarks with JSON results.
+ *
+ *   zigma_bench [filter=TEXT] [time=SECONDS] [out=FILE] [compare=BASELINE] [threshold=PERCENT] [cli=PATH]
+ *
+ * Every case runs on generated corpora of fixed sizes and entropy, so results from different runs and machines
+ * are comparable. With compare=, the results are matched against a saved run and any case slower by more than
+ * `threshold` percent is reported as a regression (and the exit status is non-zero).
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define ZQ_BENCH_TSC 1
+#include <x86intrin.h>
+#endif
+
+#include "common.h"
+
+#include "base16.h"
+#include "base64.h"
+#include "registry.h"
+#include "zigma.h"
+
+/* Number of timed rounds per case; the fastest round is reported. */
+#define ZQ_BENCH_ROUNDS 5
+
+/* Corpus sizes used by the kernel cases, and by the end-to-end runs. */
+static const uint64 BenchSizes[] = {4 * 1024, 1024 * 1024};
+
+#define ZQ_BENCH_CLI_SIZE (16 * 1024 * 1024) /* 16MB */
+
+#define ZQ_BENCH_BATCH_LANES 32 /* messages the corpus is cut into for the batch cases */
+
+static const char* Base64Kernels[] = {"scalar", "ssse3", "avx2", "avx512", NULL};
+static const char* Base16Kernels[] = {"scalar", "ssse3", "avx2", NULL};
+
+/* Generated input data. */
+typedef struct BenchCorpus {
+  /* "random" (incompressible), "text" (skewed English-like letters) or "zero". */
+  const char* entropy;
+
+  uint8* data;
+  uint64 length;
+
+  /* The corpus in base64 (raw and wrapped at 76 columns) and base16, for the decoders. */
+  char*  base64;
+  uint64 base64Length;
+  char*  wrapped;
+  uint64 wrappedLength;
+  char*  base16;
+} BenchCorpus;
+
+/* One measurement. */
+typedef struct BenchCase {
+  const char*        name;
+  const char*        kernel;
+  const BenchCorpus* corpus;
+
+  /* Bytes counted per call of `run`. */
+  uint64 bytes;
+
+  void (*run)(struct BenchCase* bench);
+
+  /* Scratch state for `run`. */
+  ZigmaContext context;
+  void*        output;
+} BenchCase;
+
+/* A finished measurement. */
+typedef struct BenchResult {
+  char   key[160];
+  double bytesPerSecond;
+  double cyclesPerByte;
+  double nanosecondsPerCall;
+} BenchResult;
+
+typedef struct BenchRun {
+  const char* filter;
+  double      seconds;
+  FILE*       output;
+
+  BenchResult* results;
+  uint64       count;
+  uint64       capacity;
+} BenchRun;
+
+static double BenchNow(void)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return (double) now.tv_sec + (double) now.tv_nsec * 1e-9;
+}
+
+static uint64 BenchCycles(void)
+{
+#ifdef ZQ_BENCH_TSC
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+/* Deterministic generator so every run sees the same corpora. */
+static uint64 BenchRandom(uint64* state)
+{
+  *state ^= *state << 13;
+  *state ^= *state >> 7;
+  *state ^= *state << 17;
+
+  return *state;
+}
+
+static BenchCorpus* BenchCorpusCreate(const char* entropy, uint64 length)
+{
+  static const char letters[] = "eeeeeeeeettttttaaaaaoooooiiiiinnnnnsssshhhhrrrrddlllcuumwfgypbvk      \n";
+
+  BenchCorpus* corpus = (BenchCorpus*) malloc(sizeof(BenchCorpus));
+  uint64       state  = 0x9E3779B97F4A7C15ull ^ length;
+
+  corpus->entropy = entropy;
+  corpus->length  = length;
+  corpus->data    = (uint8*) malloc(length);
+
+  for (uint64 i = 0; i < length; i++) {
+    if (strcmp(entropy, "random") == 0)
+      corpus->data[i] = (uint8) BenchRandom(&state);
+    else if (strcmp(entropy, "text") == 0)
+      corpus->data[i] = (uint8) letters[BenchRandom(&state) % (sizeof(letters) - 1)];
+    else
+      corpus->data[i] = 0;
+  }
+
+  corpus->base64       = (char*) malloc(4 * ((length + 2) / 3) + 1);
+  corpus->base64Length = base64_encode(corpus->base64, (const char*) corpus->data, length);
+
+  corpus->wrapped       = (char*) malloc(corpus->base64Length + corpus->base64Length / 76 + 2);
+  corpus->wrappedLength = 0;
+
+  for (uint64 i = 0; i < corpus->base64Length; i += 76) {
+    uint64 span = corpus->base64Length - i < 76 ? corpus->base64Length - i : 76;
+
+    memcpy(corpus->wrapped + corpus->wrappedLength, corpus->base64 + i, span);
+    corpus->wrappedLength += span;
+    corpus->wrapped[corpus->wrappedLength++] = '\n';
+  }
+
+  corpus->base16 = (char*) malloc(2 * length);
+  base16_encode(corpus->base16, corpus->data, length);
+
+  return corpus;
+}
+
+static void BenchCorpusDestroy(BenchCorpus* corpus)
+{
+  free(corpus->data);
+  free(corpus->base64);
+  free(corpus->wrapped);
+  free(corpus->base16);
+  free(corpus);
+}
+
+static void BenchEncodeByte(BenchCase* bench)
+{
+  uint8* output = (uint8*) bench->output;
+
+  for (uint64 i = 0; i < bench->corpus->length; i++)
+    output[i] = ZigmaEncodeByte(&bench->context, bench->corpus->data[i]);
+}
+
+static void BenchDecodeByte(BenchCase* bench)
+{
+  uint8* output = (uint8*) bench->output;
+
+  for (uint64 i = 0; i < bench->corpus->length; i++)
+    output[i] = ZigmaDecodeByte(&bench->context, bench->corpus->data[i]);
+}
+
+static void BenchEncodeBlock(BenchCase* bench)
+{
+  ZigmaEncodeBlock(&bench->context, (uint8*) bench->output, bench->corpus->data, bench->corpus->length);
+}
+
+static void BenchDecodeBlock(BenchCase* bench)
+{
+  ZigmaDecodeBlock(&bench->context, (uint8*) bench->output, bench->corpus->data, bench->corpus->length);
+}
+
+/* The corpus as ZQ_BENCH_BATCH_LANES messages, each starting from the keyed context, as the server ciphers them. */
+static void BenchBatch(BenchCase* bench, int decode)
+{
+  ZigmaContext contexts[ZQ_BENCH_BATCH_LANES];
+  ZigmaLane    lanes[ZQ_BENCH_BATCH_LANES];
+  uint64       size = bench->corpus->length / ZQ_BENCH_BATCH_LANES;
+
+  for (uint32 i = 0; i < ZQ_BENCH_BATCH_LANES; i++) {
+    contexts[i] = bench->context;
+
+    lanes[i].context = &contexts[i];
+    lanes[i].output  = (uint8*) bench->output + i * size;
+    lanes[i].input   = bench->corpus->data + i * size;
+    lanes[i].length  = i + 1 < ZQ_BENCH_BATCH_LANES ? size : bench->corpus->length - i * size;
+  }
+
+  if (decode)
+    ZigmaDecodeBatch(lanes, ZQ_BENCH_BATCH_LANES);
+  else
+    ZigmaEncodeBatch(lanes, ZQ_BENCH_BATCH_LANES);
+}
+
+static void BenchEncodeBatch(BenchCase* bench)
+{
+  BenchBatch(bench, 0);
+}
+
+static void BenchDecodeBatch(BenchCase* bench)
+{
+  BenchBatch(bench, 1);
+}
+
+static void BenchHashUpdate(BenchCase* bench)
+{
+  ZigmaHashUpdate(&bench->context, bench->corpus->data, bench->corpus->length);
+}
+
+static void BenchKeySchedule(BenchCase* bench)
+{
+  ZigmaCreate(&bench->context, (const char*) bench->corpus->data, ZQ_MAX_KEY_SIZE);
+}
+
+static void BenchHashFinal(BenchCase* bench)
+{
+  ZigmaCreate(&bench->context, NULL, 0);
+  ZigmaHashFinal(&bench->context, (uint8*) bench->output, ZIGMA_CHECKSUM_SIZE);
+}
+
+static void BenchBase64Encode(BenchCase* bench)
+{
+  base64_encode((char*) bench->output, (const char*) bench->corpus->data, bench->corpus->length);
+}
+
+static void BenchBase64Decode(BenchCase* bench)
+{
+  base64_decode((char*) bench->output, bench->corpus->base64, bench->corpus->base64Length);
+}
+
+static void BenchBase64Sanitize(BenchCase* bench)
+{
+  base64_sanitize((char*) bench->output, bench->corpus->wrapped, bench->corpus->wrappedLength);
+}
+
+static void BenchBase64Stream(BenchCase* bench)
+{
+  base64_decoder decoder;
+
+  base64_decoder_init(&decoder);
+  base64_decoder_update(&decoder, (uint8*) bench->output, bench->corpus->wrapped, bench->corpus->wrappedLength);
+}
+
+static void BenchBase16Encode(BenchCase* bench)
+{
+  base16_encode((char*) bench->output, bench->corpus->data, bench->corpus->length);
+}
+
+static void BenchBase16Decode(BenchCase* bench)
+{
+  int nibble = -1;
+
+  base16_decode((uint8*) bench->output, bench->corpus->base16, 2 * bench->corpus->length, &nibble);
+}
+
+static void BenchRecord(BenchRun* run, const char* key, const BenchCase* bench, double seconds, uint64 cycles,
+                        uint64 calls)
+{
+  if (run->count == run->capacity) {
+    run->capacity = run->capacity == 0 ? 64 : 2 * run->capacity;
+    run->results  = (BenchResult*) realloc(run->results, run->capacity * sizeof(BenchResult));
+  }
+
+  BenchResult* result = &run->results[run->count++];
+  double       bytes  = (double) bench->bytes * (double) calls;
+
+  snprintf(result->key, sizeof(result->key), "%s", key);
+
+  result->bytesPerSecond     = bytes / seconds;
+  result->cyclesPerByte      = (double) cycles / bytes;
+  result->nanosecondsPerCall = seconds * 1e9 / (double) calls;
+
+  fprintf(run->output,
+          "%s    {\"name\": \"%s\", \"kernel\": \"%s\", \"corpus\": \"%s\", \"size\": %" PRIu64
+          ", \"bytes_per_sec\": %.1f, \"cycles_per_byte\": %.3f, \"ns_per_call\": %.1f}",
+          run->count > 1 ? ",\n" : "", bench->name, bench->kernel, bench->corpus->entropy, bench->corpus->length,
+          result->bytesPerSecond, result->cyclesPerByte, result->nanosecondsPerCall);
+  fflush(run->output);
+
+  fprintf(stderr, "  %-44s %10.1f MB/s %9.3f cycles/byte\n", key, result->bytesPerSecond / 1e6,
+          result->cyclesPerByte);
+}
+
+/* Time a case: calibrate a call count that fills one round, then keep the fastest of ZQ_BENCH_ROUNDS rounds. */
+static void BenchMeasure(BenchRun* run, BenchCase* bench)
+{
+  char key[160];
+
+  snprintf(key, sizeof(key), "%s/%s/%s/%" PRIu64, bench->name, bench->kernel, bench->corpus->entropy,
+           bench->corpus->length);
+
+  if (run->filter != NULL && strstr(key, run->filter) == NULL)
+    return;
+
+  double budget = run->seconds / ZQ_BENCH_ROUNDS;
+  uint64 calls  = 1;
+
+  bench->run(bench);
+
+  for (;;) {
+    double start = BenchNow();
+
+    for (uint64 i = 0; i < calls; i++)
+      bench->run(bench);
+
+    double elapsed = BenchNow() - start;
+
+    if (elapsed >= budget / 2 || calls >= (1ull << 40))
+      break;
+
+    calls *= 2;
+  }
+
+  double best       = 0;
+  uint64 bestCycles = 0;
+
+  for (int round = 0; round < ZQ_BENCH_ROUNDS; round++) {
+    uint64 cycles = BenchCycles();
+    double start  = BenchNow();
+
+    for (uint64 i = 0; i < calls; i++)
+      bench->run(bench);
+
+    double elapsed = BenchNow() - start;
+
+    cycles = BenchCycles() - cycles;
+
+    if (round == 0 || elapsed < best) {
+      best       = elapsed;
+      bestCycles = cycles;
+    }
+  }
+
+  BenchRecord(run, key, bench, best, bestCycles, calls);
+}
+
+static void BenchCipher(BenchRun* run, const BenchCorpus* corpus, const BenchCorpus* key)
+{
+  static const struct {
+    const char* name;
+    void (*run)(BenchCase* bench);
+  } cases[] = {
+    {"zigma_encode_byte",  BenchEncodeByte },
+    {"zigma_decode_byte",  BenchDecodeByte },
+    {"zigma_encode_block", BenchEncodeBlock},
+    {"zigma_decode_block", BenchDecodeBlock},
+    {"zigma_encode_batch", BenchEncodeBatch},
+    {"zigma_decode_batch", BenchDecodeBatch},
+    {"zigma_hash_update",  BenchHashUpdate },
+  };
+
+  BenchCase bench;
+
+  bench.corpus = corpus;
+  bench.kernel = "scalar";
+  bench.bytes  = corpus->length;
+  bench.output = malloc(corpus->length);
+
+  for (uint64 i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+    ZigmaCreate(&bench.context, (const char*) key->data, ZQ_MAX_KEY_SIZE);
+
+    bench.name = cases[i].name;
+    bench.run  = cases[i].run;
+
+    BenchMeasure(run, &bench);
+  }
+
+  free(bench.output);
+}
+
+static void BenchContext(BenchRun* run, const BenchCorpus* key)
+{
+  BenchCase bench;
+
+  bench.corpus = key;
+  bench.kernel = "scalar";
+  bench.output = malloc(ZIGMA_CHECKSUM_SIZE);
+
+  /* Key scheduling is counted per key byte; hashing (a fresh hash context, then finalization) per digest byte. */
+  bench.name  = "zigma_create";
+  bench.bytes = ZQ_MAX_KEY_SIZE;
+  bench.run   = BenchKeySchedule;
+
+  BenchMeasure(run, &bench);
+
+  bench.name  = "zigma_hash_final";
+  bench.bytes = ZIGMA_CHECKSUM_SIZE;
+  bench.run   = BenchHashFinal;
+
+  BenchMeasure(run, &bench);
+
+  free(bench.output);
+}
+
+static void BenchCodecs(BenchRun* run, const BenchCorpus* corpus)
+{
+  BenchCase   bench;
+  const char* base64Default = base64_kernel();
+  const char* base16Default = base16_kernel();
+
+  bench.corpus = corpus;
+  bench.output = malloc(2 * corpus->wrappedLength + 64);
+
+  for (int k = 0; Base64Kernels[k] != NULL; k++) {
+    if (!base64_select_kernel(Base64Kernels[k]))
+      continue;
+
+    bench.kernel = Base64Kernels[k];
+
+    bench.name  = "base64_encode";
+    bench.bytes = corpus->length;
+    bench.run   = BenchBase64Encode;
+    BenchMeasure(run, &bench);
+
+    bench.name  = "base64_decode";
+    bench.bytes = corpus->base64Length;
+    bench.run   = BenchBase64Decode;
+    BenchMeasure(run, &bench);
+
+    bench.name  = "base64_sanitize";
+    bench.bytes = corpus->wrappedLength;
+    bench.run   = BenchBase64Sanitize;
+    BenchMeasure(run, &bench);
+
+    bench.name  = "base64_decoder";
+    bench.bytes = corpus->wrappedLength;
+    bench.run   = BenchBase64Stream;
+    BenchMeasure(run, &bench);
+  }
+
+  for (int k = 0; Base16Kernels[k] != NULL; k++) {
+    if (!base16_select_kernel(Base16Kernels[k]))
+      continue;
+
+    bench.kernel = Base16Kernels[k];
+
+    bench.name  = "base16_encode";
+    bench.bytes = corpus->length;
+    bench.run   = BenchBase16Encode;
+    BenchMeasure(run, &bench);
+
+    bench.name  = "base16_decode";
+    bench.bytes = 2 * corpus->length;
+    bench.run   = BenchBase16Decode;
+    BenchMeasure(run, &bench);
+  }
+
+  base64_select_kernel(base64Default);
+  base16_select_kernel(base16Default);
+
+  free(bench.output);
+}
+
+/* Run the command line tool with the given operands, discarding its output; returns the elapsed seconds. */
+static double BenchSpawn(const char* cli, char* const* argv, uint64* cycles)
+{
+  double start = BenchNow();
+
+  *cycles = BenchCycles();
+  pid_t  child = fork();
+
+  if (child == 0) {
+    int null = open("/dev/null", O_WRONLY);
+
+    dup2(null, STDOUT_FILENO);
+    dup2(null, STDERR_FILENO);
+    execv(cli, argv);
+    _exit(127);
+  }
+
+  int status = 0;
+
+  if (child < 0 || waitpid(child, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    fprintf(stderr, "ERROR: '%s %s' failed!\n", cli, argv[1]);
+    exit(EXIT_FAILURE);
+  }
+
+  *cycles = BenchCycles() - *cycles;
+
+  return BenchNow() - start;
+}
+
+/* Wall-clock runs of the command line tool, including process start-up and file I/O. */
+static void BenchCommandLine(BenchRun* run, const char* cli, const BenchCorpus* corpus, const BenchCorpus* key)
+{
+  if (access(cli, X_OK) != 0) {
+    fprintf(stderr, "WARNING: '%s' is not executable; skipping end-to-end runs!\n", cli);
+    return;
+  }
+
+  char plainPath[]  = "/tmp/zigma_bench_plain_XXXXXX";
+  char cipherPath[] = "/tmp/zigma_bench_cipher_XXXXXX";
+  char keyPath[]    = "/tmp/zigma_bench_key_XXXXXX";
+  int  plainFile    = mkstemp(plainPath);
+  int  cipherFile   = mkstemp(cipherPath);
+  int  keyFile      = mkstemp(keyPath);
+
+  if (plainFile < 0 || cipherFile < 0 || keyFile < 0 || write(plainFile, corpus->data, corpus->length) < 0 ||
+      write(keyFile, key->data, 64) < 0) {
+    fprintf(stderr, "ERROR: Unable to write the end-to-end corpus: %s!\n", strerror(errno));
+    exit(EXIT_FAILURE);
+  }
+
+  close(plainFile);
+  close(cipherFile);
+  close(keyFile);
+
+  char in[64], out[64], keyOperand[64];
+
+  snprintf(keyOperand, sizeof(keyOperand), "key=%s", keyPath);
+
+  static const struct {
+    const char* name;
+    const char* operation;
+    const char* format;
+  } cases[] = {
+    {"cli_encode_base64", "encode", "64" },
+    {"cli_decode_base64", "decode", "64" },
+    {"cli_encode_base16", "encode", "16" },
+    {"cli_decode_base16", "decode", "16" },
+    {"cli_check",         "check",  "256"},
+  };
+
+  for (uint64 i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+    BenchCase bench;
+    char      format[32];
+    char      label[160];
+
+    bench.name   = cases[i].name;
+    bench.kernel = "cli";
+    bench.corpus = corpus;
+    bench.bytes  = corpus->length;
+
+    snprintf(label, sizeof(label), "%s/%s/%s/%" PRIu64, bench.name, bench.kernel, corpus->entropy, corpus->length);
+
+    if (run->filter != NULL && strstr(label, run->filter) == NULL)
+      continue;
+
+    int decoding = strcmp(cases[i].operation, "decode") == 0;
+
+    /* Encodes write the ciphertext that the following decode reads back. */
+    snprintf(in, sizeof(in), "in=%s", decoding ? cipherPath : plainPath);
+    snprintf(out, sizeof(out), "out=%s", decoding ? "/dev/null" : cipherPath);
+    snprintf(format, sizeof(format), "%s=%s", decoding ? "in.fmt" : "out.fmt", cases[i].format);
+
+    char* argv[] = {(char*) cli, (char*) cases[i].operation, in, out, format, keyOperand, NULL};
+
+    /* check takes neither an output nor a key. */
+    if (strcmp(cases[i].operation, "check") == 0)
+      argv[3] = NULL;
+
+    double best       = 0;
+    uint64 bestCycles = 0;
+
+    for (int round = 0; round < ZQ_BENCH_ROUNDS; round++) {
+      uint64 cycles;
+      double elapsed = BenchSpawn(cli, argv, &cycles);
+
+      if (round == 0 || elapsed < best) {
+        best       = elapsed;
+        bestCycles = cycles;
+      }
+    }
+
+    BenchRecord(run, label, &bench, best, bestCycles, 1);
+  }
+
+  unlink(plainPath);
+  unlink(cipherPath);
+  unlink(keyPath);
+}
+
+/* Extract the string value of `field` from one result line of a JSON report. */
+static int BenchField(const char* line, const char* field, char* value, uint64 size)
+{
+  char        pattern[64];
+  const char* start;
+
+  snprintf(pattern, sizeof(pattern), "\"%s\": ", field);
+
+  if ((start = strstr(line, pattern)) == NULL)
+    return 0;
+
+  start += strlen(pattern);
+
+  uint64 length = strcspn(start[0] == '"' ? start + 1 : start, "\",}");
+
+  if (length >= size)
+    return 0;
+
+  memcpy(value, start[0] == '"' ? start + 1 : start, length);
+  value[length] = '\0';
+
+  return 1;
+}
+
+/* Compare this run with a saved report. Returns the number of regressions. */
+static uint64 BenchCompare(BenchRun* run, const char* path, double threshold)
+{
+  FILE* baseline = fopen(path, "r");
+
+  if (baseline == NULL) {
+    fprintf(stderr, "ERROR: fopen(): unable to open file '%s': %s!\n", path, strerror(errno));
+    exit(EXIT_FAILURE);
+  }
+
+  char*   line        = NULL;
+  size_t  capacity    = 0;
+  uint64  regressions = 0;
+  uint64  matched     = 0;
+  ssize_t length;
+
+  fprintf(stdout, "%-44s %12s %12s %9s\n", "case", "baseline", "current", "change");
+
+  while ((length = getline(&line, &capacity, baseline)) >= 0) {
+    char name[64], kernel[32], corpus[32], size[32], speed[64], key[160];
+
+    if (!BenchField(line, "name", name, sizeof(name)) || !BenchField(line, "kernel", kernel, sizeof(kernel)) ||
+        !BenchField(line, "corpus", corpus, sizeof(corpus)) || !BenchField(line, "size", size, sizeof(size)) ||
+        !BenchField(line, "bytes_per_sec", speed, sizeof(speed)))
+      continue;
+
+    snprintf(key, sizeof(key), "%s/%s/%s/%s", name, kernel, corpus, size);
+
+    for (uint64 i = 0; i < run->count; i++) {
+      if (strcmp(run->results[i].key, key) != 0)
+        continue;
+
+      double before = strtod(speed, NULL);
+      double after  = run->results[i].bytesPerSecond;
+      double change = before > 0 ? (after - before) / before * 100.0 : 0;
+      int    slower = change < -threshold;
+
+      fprintf(stdout, "%-44s %9.1f MB/s %7.1f MB/s %+8.1f%%%s\n", key, before / 1e6, after / 1e6, change,
+              slower ? "  REGRESSION" : "");
+
+      regressions += slower;
+      matched++;
+    }
+  }
+
+  fprintf(stdout, "\n%" PRIu64 " cases compared, %" PRIu64 " regressed by more than %.1f%%\n", matched, regressions,
+          threshold);
+
+  free(line);
+  fclose(baseline);
+
+  return regressions;
+}
+
+int main(int argc, char* argv[])
+{
+  RegistryNode* registry = NULL;
+
+  RegistryUpdate(&registry, "filter", "");     /* NULL = every case */
+  RegistryUpdate(&registry, "time", "0.5");    /* seconds per case */
+  RegistryUpdate(&registry, "out", "");        /* NULL = stdout */
+  RegistryUpdate(&registry, "compare", "");    /* NULL = no comparison */
+  RegistryUpdate(&registry, "threshold", "5"); /* percent */
+  RegistryUpdate(&registry, "cli", ZIGMA_BENCH_CLI);
+
+  for (int i = 1; i < argc; i++) {
+    char* dupl    = strndup(argv[i], ZQ_REGISTRY_KEY_MAX);
+    char* delimit = strchr(dupl, '=');
+
+    if (delimit != NULL) {
+      *delimit = '\0';
+      RegistryUpdate(&registry, dupl, delimit + 1);
+    }
+
+    free(dupl);
+  }
+
+  BenchRun run = {0};
+
+  run.filter  = *RegistrySearch(&registry, "filter")->value != 0 ? RegistrySearch(&registry, "filter")->value : NULL;
+  run.seconds = strtod(RegistrySearch(&registry, "time")->value, NULL);
+  run.output  = *RegistrySearch(&registry, "out")->value != 0 ? OpenFile(RegistrySearch(&registry, "out")->value, "w")
+                                                             : stdout;
+
+  if (run.seconds <= 0) {
+    fprintf(stderr, "ERROR: Invalid time '%s'!\n", RegistrySearch(&registry, "time")->value);
+    exit(EXIT_FAILURE);
+  }
+
+  const char* compare = RegistrySearch(&registry, "compare")->value;
+
+  /* In compare mode the report on stdout is the comparison; JSON only goes to an explicit out= file. */
+  if (*compare != 0 && run.output == stdout)
+    run.output = fopen("/dev/null", "w");
+
+#ifdef __OPTIMIZE__
+  const int optimized = 1;
+#else
+  const int optimized = 0;
+
+  fprintf(stderr, "WARNING: zigma_bench was built without optimization; configure with "
+                  "-DCMAKE_BUILD_TYPE=Release for meaningful numbers!\n");
+#endif
+
+  fprintf(run.output, "{\n  \"version\": \"%s\",\n  \"commit\": \"%s\",\n  \"optimized\": %s,\n",
+          ZIGMATIQ_VERSION_STRING, ZIGMATIQ_GIT_COMMIT, optimized ? "true" : "false");
+  fprintf(run.output, "  \"processors\": %ld,\n  \"base64_kernel\": \"%s\",\n  \"base16_kernel\": \"%s\",\n",
+          sysconf(_SC_NPROCESSORS_ONLN), base64_kernel(), base16_kernel());
+  fprintf(run.output, "  \"results\": [\n");
+
+  static const char* entropies[] = {"random", "text", "zero"};
+
+  BenchCorpus* key = BenchCorpusCreate("random", ZQ_MAX_KEY_SIZE);
+
+  BenchContext(&run, key);
+
+  for (int e = 0; e < 3; e++) {
+    for (uint64 s = 0; s < sizeof(BenchSizes) / sizeof(BenchSizes[0]); s++) {
+      BenchCorpus* corpus = BenchCorpusCreate(entropies[e], BenchSizes[s]);
+
+      BenchCipher(&run, corpus, key);
+      BenchCodecs(&run, corpus);
+
+      BenchCorpusDestroy(corpus);
+    }
+  }
+
+  BenchCorpus* corpus = BenchCorpusCreate("random", ZQ_BENCH_CLI_SIZE);
+
+  BenchCommandLine(&run, RegistrySearch(&registry, "cli")->value, corpus, key);
+
+  BenchCorpusDestroy(corpus);
+  BenchCorpusDestroy(key);
+
+  fprintf(run.output, "\n  ]\n}\n");
+
+  if (run.output != stdout)
+    fclose(run.output);
+
+  uint64 regressions = 0;
+
+  if (*compare != 0)
+    regressions = BenchCompare(&run, compare, strtod(RegistrySearch(&registry, "threshold")->value, NULL));
+
+  free(run.results);
+
+  return regressions > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,755 @@
+#!/bin/sh
+#
+# ZIGMA, Copyright (C) 2024 Chase Zehl O'Byrne
+#   <mail: zehl@live.com> http://zehlchen.com/
+#
+# This file is part of ZIGMA.
+#
+# ZIGMA is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#
+# ZIGMA is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with ZIGMA; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+#
+
+# Command line tests: `cli.sh ZIGMA DATA_DIRECTORY NAME`.
+#
+# tests/data holds a plaintext (plain.bin), a key (key.bin), and files encoded from them. Each file was written when
+# its format was introduced; encoding again must reproduce it byte for byte, and decoding it must give plain.bin back.
+
+ZIGMA=$1
+DATA=$2
+NAME=$3
+
+WORK=$(mktemp -d) || exit 1
+STATUS=0
+
+trap 'rm -rf "$WORK"' EXIT
+
+fail()
+{
+  echo "FAIL: $NAME: $*" >&2
+  STATUS=1
+}
+
+# Run zigma with its progress output kept out of the way.
+z()
+{
+  "$ZIGMA" "$@" 2>>"$WORK/log"
+}
+
+# The command must exit with an error.
+refuse()
+{
+  if "$ZIGMA" "$@" >/dev/null 2>>"$WORK/log"; then
+    fail "accepted: $*"
+  fi
+}
+
+same()
+{
+  cmp -s "$1" "$2" || fail "$1 differs from $2"
+}
+
+# Print COUNT bytes of FILE from OFFSET as hex pairs, with no spaces.
+peek()
+{
+  od -An -tx1 -j "$2" -N "$3" "$1" | tr -d ' \n'
+}
+
+# Print the little-endian 32-bit integer at OFFSET of FILE.
+le32()
+{
+  set -- $(od -An -tu1 -j "$2" -N 4 "$1")
+  echo $(($1 | $2 << 8 | $3 << 16 | $4 << 24))
+}
+
+# Overwrite the bytes of FILE at OFFSET with the hex pairs given.
+poke()
+{
+  printf "$(echo "$3" | sed 's/../\\x&/g')" | dd of="$1" bs=1 seek="$2" conv=notrunc 2>/dev/null
+}
+
+# Copy COUNT bytes of FILE from OFFSET to standard output.
+slice()
+{
+  dd if="$1" bs=1 skip="$2" count="$3" 2>/dev/null
+}
+
+# The simd= kernels this processor supports.
+kernels()
+{
+  for kernel in auto scalar ssse3 avx2 avx512; do
+    "$ZIGMA" encode in=/dev/null key="$DATA/key.bin" simd=$kernel >/dev/null 2>&1 && echo $kernel
+  done
+}
+
+PLAIN=$DATA/plain.bin
+KEY=$DATA/key.bin
+WRONG=$WORK/wrong.key
+
+# The same key with its last byte changed.
+cp "$KEY" "$WRONG"
+poke "$WRONG" 39 00
+
+case $NAME in
+base64)
+  # stream.64 is the baseline release's base64 output for plain.bin; every kernel must reproduce it.
+  for kernel in $(kernels); do
+    z encode in="$PLAIN" key="$KEY" out="$WORK/out.64" out.fmt=64 simd=$kernel
+    same "$WORK/out.64" "$DATA/stream.64"
+
+    z decode in="$DATA/stream.64" in.fmt=64 key="$KEY" out="$WORK/back" simd=$kernel
+    same "$WORK/back" "$PLAIN"
+  done
+
+  # out.wrap and out.eol only change the line breaks.
+  for layout in 0:lf 1:lf 64:crlf 76:crlf 100:lf; do
+    z encode in="$PLAIN" key="$KEY" out="$WORK/out.64" out.wrap=${layout%:*} out.eol=${layout#*:}
+    [ "$(tr -d '\r\n' <"$WORK/out.64")" = "$(tr -d '\n' <"$DATA/stream.64")" ] || fail "out.wrap=${layout%:*} text"
+
+    width=$(tr -d '\r' <"$WORK/out.64" | awk '{ if (length($0) > w) w = length($0) } END { print w }')
+    [ "${layout%:*}" = 0 ] || [ "$width" = "${layout%:*}" ] || fail "out.wrap=${layout%:*} is $width wide"
+    [ "${layout#*:}" = crlf ] && ! grep -q "$(printf '\r')\$" "$WORK/out.64" && fail "out.eol=crlf"
+
+    z decode in="$WORK/out.64" key="$KEY" out="$WORK/back"
+    same "$WORK/back" "$PLAIN"
+  done
+
+  refuse encode in="$PLAIN" key="$KEY" out.eol=cr
+
+  # Line breaks, blanks and comment lines are not part of the data.
+  { echo "# a comment"; sed 's/$/\r/' "$DATA/stream.64"; } >"$WORK/crlf.64"
+  tr -d '\n' <"$DATA/stream.64" | fold -w 7 | sed 's/^/  /' >"$WORK/folded.64"
+
+  for text in crlf folded; do
+    z decode in="$WORK/$text.64" in.fmt=64 key="$KEY" out="$WORK/back"
+    same "$WORK/back" "$PLAIN"
+  done
+
+  # A character outside the alphabet, padding in the middle, and a partial quantum are errors.
+  for damage in 100:2a 5000:2d 76:3d; do
+    cp "$DATA/stream.64" "$WORK/bad.64"
+    poke "$WORK/bad.64" "${damage%:*}" "${damage#*:}"
+    refuse decode in="$WORK/bad.64" in.fmt=64 key="$KEY"
+  done
+
+  tr -d '\n' <"$DATA/stream.64" | head -c 10001 >"$WORK/short.64"
+  refuse decode in="$WORK/short.64" in.fmt=64 key="$KEY"
+
+  # From a pipe the text is decoded as it arrives, in pieces of whatever size the pipe delivers.
+  cat "$WORK/crlf.64" | z decode key="$KEY" >"$WORK/back"
+  same "$WORK/back" "$PLAIN"
+
+  if head -c 10003 "$DATA/stream.64" | "$ZIGMA" decode key="$KEY" >/dev/null 2>>"$WORK/log"; then
+    fail "accepted a truncated pipe"
+  fi
+  ;;
+
+base16)
+  # stream.16 is the baseline release's base16 output for plain.bin; every kernel must reproduce it.
+  for kernel in $(kernels); do
+    z encode in="$PLAIN" key="$KEY" out="$WORK/out.16" out.fmt=16 simd=$kernel
+    same "$WORK/out.16" "$DATA/stream.16"
+
+    z decode in="$DATA/stream.16" in.fmt=16 key="$KEY" out="$WORK/back" simd=$kernel
+    same "$WORK/back" "$PLAIN"
+  done
+
+  # Upper case digits, and whitespace anywhere, even inside a pair.
+  tr 'a-f' 'A-F' <"$DATA/stream.16" | fold -w 33 >"$WORK/upper.16"
+  z decode in="$WORK/upper.16" in.fmt=16 key="$KEY" out="$WORK/back"
+  same "$WORK/back" "$PLAIN"
+
+  # A character that is not a digit is an error.
+  cp "$DATA/stream.16" "$WORK/bad.16"
+  poke "$WORK/bad.16" 1001 67
+  refuse decode in="$WORK/bad.16" in.fmt=16 key="$KEY"
+
+  cat "$WORK/upper.16" | z decode in.fmt=16 key="$KEY" >"$WORK/back"
+  same "$WORK/back" "$PLAIN"
+
+  refuse encode in="$PLAIN" key="$KEY" simd=none
+  ;;
+
+chunked)
+  # chunked.zq: plain.bin (7897 bytes) in 1024 byte chunks, so seven full chunks and one of 729 bytes. Chunk N's
+  # length field is at 12 + 1028 * N, the end marker at 7941, and the index (count, eight offsets, index offset,
+  # "ZQIX") at 7945.
+  for jobs in 1 3; do
+    z encode in="$PLAIN" key="$KEY" out="$WORK/out.zq" out.fmt=256 mode=chunked chunk.size=1024 jobs=$jobs
+    same "$WORK/out.zq" "$DATA/chunked.zq"
+  done
+
+  z decode in="$DATA/chunked.zq" in.fmt=256 key="$KEY" mode=chunked jobs=3 out="$WORK/back"
+  same "$WORK/back" "$PLAIN"
+
+  [ "$(peek "$DATA/chunked.zq" 0 12)" = 5a51434b0100000000040000 ] || fail "header"
+  [ "$(peek "$DATA/chunked.zq" 7941 12)" = 000000000800000000000000 ] || fail "end marker and chunk count"
+  [ "$(peek "$DATA/chunked.zq" 7953 16)" = 0c000000000000001004000000000000 ] || fail "chunk offsets"
+  [ "$(peek "$DATA/chunked.zq" 8017 12)" = 091f0000000000005a514958 ] || fail "index offset and trailer"
+
+  # Chunk sizes at and around the input length, and an empty input, which is a container with no chunks.
+  for size in 1 7896 7897 7898; do
+    z encode in="$PLAIN" key="$KEY" mode=chunked chunk.size=$size | z decode key="$KEY" mode=chunked >"$WORK/back"
+    same "$WORK/back" "$PLAIN"
+  done
+
+  : >"$WORK/empty"
+  z encode in="$WORK/empty" key="$KEY" out="$WORK/empty.zq" out.fmt=256 mode=chunked
+  [ "$(wc -c <"$WORK/empty.zq")" = 36 ] || fail "empty container size"
+  z decode in="$WORK/empty.zq" in.fmt=256 key="$KEY" mode=chunked out="$WORK/back"
+  [ -s "$WORK/back" ] && fail "empty container decoded to data"
+
+  refuse encode in="$PLAIN" key="$KEY" mode=chunked chunk.size=0
+
+  # Each chunk has its own context: swapping the first two chunks garbles both, and leaves the others intact.
+  cp "$DATA/chunked.zq" "$WORK/swapped.zq"
+  slice "$DATA/chunked.zq" 1040 1028 | dd of="$WORK/swapped.zq" bs=1 seek=12 conv=notrunc 2>/dev/null
+  slice "$DATA/chunked.zq" 12 1028 | dd of="$WORK/swapped.zq" bs=1 seek=1040 conv=notrunc 2>/dev/null
+  z decode in="$WORK/swapped.zq" in.fmt=256 key="$KEY" mode=chunked out="$WORK/back"
+  slice "$WORK/back" 0 1024 | cmp -s - "$PLAIN" && fail "a chunk decoded in another position"
+  slice "$PLAIN" 1024 1024 | cmp -s - "$WORK/back" && fail "a chunk decoded in another position"
+  [ "$(slice "$WORK/back" 2048 6000 | cksum)" = "$(slice "$PLAIN" 2048 6000 | cksum)" ] || fail "unswapped chunks"
+
+  # The same goes for the key: a wrong one is not detected, but no chunk comes back.
+  z decode in="$DATA/chunked.zq" in.fmt=256 key="$WRONG" mode=chunked out="$WORK/back"
+  for chunk in 0 1 2 3 4 5 6 7; do
+    [ "$(slice "$WORK/back" $((chunk * 1024)) 1024 | cksum)" = "$(slice "$PLAIN" $((chunk * 1024)) 1024 | cksum)" ] &&
+      fail "chunk $chunk decoded with the wrong key"
+  done
+
+  # The framing and the index are checked: a bad magic, version or chunk size, a chunk longer than the chunk size,
+  # a count or offset that disagrees with the chunks, a missing trailer, and a container cut short.
+  for damage in 0:58 4:02 8:00000000 12:01040000 7945:07 7961:11 8025:5a51495a; do
+    cp "$DATA/chunked.zq" "$WORK/bad.zq"
+    poke "$WORK/bad.zq" "${damage%:*}" "${damage#*:}"
+    refuse decode in="$WORK/bad.zq" in.fmt=256 key="$KEY" mode=chunked
+  done
+
+  for length in 11 5000 7941 8028; do
+    head -c $length "$DATA/chunked.zq" >"$WORK/short.zq"
+    refuse decode in="$WORK/short.zq" in.fmt=256 key="$KEY" mode=chunked
+  done
+  ;;
+
+check)
+  # check.16 is the baseline release's digest line for plain.bin. The line names the file as given, so check it from
+  # the data directory.
+  for jobs in 1 4; do
+    (cd "$DATA" && z check in=plain.bin jobs=$jobs) >"$WORK/check.16"
+    same "$WORK/check.16" "$DATA/check.16"
+  done
+
+  # Directories are walked in name order, operands are kept in command line order (repeats included), and a file
+  # named like an option is still a file.
+  mkdir -p "$WORK/tree/b" "$WORK/tree/a"
+  cp "$PLAIN" "$WORK/tree/b/plain.bin"
+  echo one >"$WORK/tree/a/one"
+  echo two >"$WORK/tree/jobs"
+  (cd "$WORK/tree" && z check b jobs a jobs jobs=2) >"$WORK/manifest"
+  [ "$(sed 's/^[0-9a-f]*  //' "$WORK/manifest" | tr '\n' ,)" = "b/plain.bin (7897),jobs (4),a/one (4),jobs (4)," ] ||
+    fail "operand order"
+  grep -q "^$(cut -d' ' -f1 "$DATA/check.16")  b/plain.bin" "$WORK/manifest" || fail "digest of a walked file"
+
+  printf 'a/one\n\nb/plain.bin\n' >"$WORK/tree/list"
+  (cd "$WORK/tree" && z check list=list) >"$WORK/listed"
+  [ "$(grep -c . "$WORK/listed")" = 2 ] || fail "list="
+
+  # verify= re-hashes every file in a manifest, in either output format, and fails if any one no longer matches.
+  (cd "$WORK/tree" && z check verify="$WORK/manifest") >"$WORK/report" || fail "verify= of an unchanged tree"
+  [ "$(grep -c ': OK$' "$WORK/report")" = 4 ] || fail "verify= report"
+
+  (cd "$WORK/tree" && z check out.fmt=64 b/plain.bin) >"$WORK/manifest.64"
+  (cd "$WORK/tree" && z check verify="$WORK/manifest.64") >/dev/null || fail "verify= of a base64 manifest"
+
+  echo three >>"$WORK/tree/a/one"
+  (cd "$WORK/tree" && z check verify="$WORK/manifest") >"$WORK/report" && fail "verify= missed a changed file"
+  [ "$(grep -c ': FAILED$' "$WORK/report")" = 1 ] || fail "verify= report of a changed file"
+
+  refuse check "$WORK/missing"
+  refuse check in="$PLAIN" out.fmt=256
+  ;;
+
+schedule)
+  # key.ctx is key.bin as a scheduled key file: "ZQKS", version 1, the 261-byte snapshot, and an 8-byte checksum.
+  z schedule key="$KEY" out="$WORK/key.ctx"
+  same "$WORK/key.ctx" "$DATA/key.ctx"
+  [ "$(stat -c %a "$WORK/key.ctx")" = 600 ] || fail "scheduled key is readable by others"
+  [ "$(peek "$DATA/key.ctx" 0 8)" = 5a514b5301000000 ] || fail "header"
+
+  # A scheduled key ciphers exactly as the key it was made from, in every mode.
+  z encode in="$PLAIN" key="$DATA/key.ctx" key.fmt=ctx out="$WORK/out.256" out.fmt=256
+  same "$WORK/out.256" "$DATA/stream.256"
+
+  z decode in="$DATA/stream.64" key="$DATA/key.ctx" key.fmt=ctx out="$WORK/back"
+  same "$WORK/back" "$PLAIN"
+
+  z decode in="$DATA/chunked.zq" in.fmt=256 key="$DATA/key.ctx" key.fmt=ctx mode=chunked out="$WORK/back"
+  same "$WORK/back" "$PLAIN"
+
+  # A damaged or cut short file, a raw key read as a scheduled one, and a scheduled key that is not in a file.
+  for damage in 3:54 4:02 8:00 100:00 276:00; do
+    cp "$DATA/key.ctx" "$WORK/bad.ctx"
+    poke "$WORK/bad.ctx" "${damage%:*}" "${damage#*:}"
+    refuse encode in="$PLAIN" key="$WORK/bad.ctx" key.fmt=ctx
+  done
+
+  head -c 276 "$DATA/key.ctx" >"$WORK/short.ctx"
+  refuse encode in="$PLAIN" key="$WORK/short.ctx" key.fmt=ctx
+  refuse encode in="$PLAIN" key="$KEY" key.fmt=ctx
+  refuse encode in="$PLAIN" key.fmt=ctx </dev/null
+  ;;
+
+stream)
+  # Input around the 16KB tile and 64KB block sizes, from a file (mapped) and from a pipe. The base16 and base64
+  # output must be exactly the binary output in that encoding, as coreutils writes it (without a final line break).
+  for i in $(seq 25); do cat "$PLAIN"; done >"$WORK/long"
+
+  for size in 16383 16384 16385 49151 65535 65536 65537 196608; do
+    head -c $size "$WORK/long" >"$WORK/in"
+
+    z encode in="$WORK/in" key="$KEY" out="$WORK/out.256" out.fmt=256
+    [ "$(wc -c <"$WORK/out.256")" = $size ] || fail "$size: binary output length"
+
+    base64 -w 0 "$WORK/out.256" >"$WORK/expect.64"
+    printf '%s' "$(base64 -w 76 "$WORK/out.256")" >"$WORK/expect.wrapped.64"
+    od -An -v -tx1 "$WORK/out.256" | tr -d ' \n' >"$WORK/expect.16"
+
+    z encode in="$WORK/in" key="$KEY" out="$WORK/out.64" out.wrap=0
+    same "$WORK/out.64" "$WORK/expect.64"
+
+    cat "$WORK/in" | z encode key="$KEY" >"$WORK/out.64"
+    same "$WORK/out.64" "$WORK/expect.wrapped.64"
+
+    cat "$WORK/in" | z encode key="$KEY" out.fmt=16 | tr -d '\n' >"$WORK/out.16"
+    same "$WORK/out.16" "$WORK/expect.16"
+
+    z decode in="$WORK/expect.wrapped.64" key="$KEY" out="$WORK/back"
+    same "$WORK/back" "$WORK/in"
+  done
+
+  # Without a tag there is no error to report, but the plaintext must not come back.
+  z decode in="$DATA/stream.64" key="$WRONG" out="$WORK/back"
+  cmp -s "$WORK/back" "$PLAIN" && fail "decoded with the wrong key"
+  ;;
+
+pipeline)
+  # mode=pipeline writes exactly what mode=stream writes, for every format, from files and pipes, for an empty
+  # input, one block, and more blocks (about 950KB) than the rings hold.
+  : >"$WORK/empty"
+  cp "$PLAIN" "$WORK/plain"
+  for i in $(seq 120); do cat "$PLAIN"; done >"$WORK/long"
+
+  for input in empty plain long; do
+    for format in 16 64 256; do
+      z encode in="$WORK/$input" key="$KEY" out="$WORK/stream.out" out.fmt=$format
+      z encode in="$WORK/$input" key="$KEY" out="$WORK/pipeline.out" out.fmt=$format mode=pipeline
+      same "$WORK/pipeline.out" "$WORK/stream.out"
+
+      cat "$WORK/$input" | z encode key="$KEY" out.fmt=$format mode=pipeline >"$WORK/pipeline.out"
+      same "$WORK/pipeline.out" "$WORK/stream.out"
+
+      cat "$WORK/stream.out" | z decode key="$KEY" in.fmt=$format mode=pipeline >"$WORK/back"
+      same "$WORK/back" "$WORK/$input"
+    done
+  done
+  ;;
+
+uring)
+  # io=uring writes exactly what io=sync writes, for every format, mode=stream and mode=pipeline, from files and
+  # pipes, for an empty input, one block, and enough 64KB blocks (about 950KB) to keep several reads in flight.
+  # Where io_uring is unavailable zigma falls back to blocking I/O, which must give the same output.
+  : >"$WORK/empty"
+  cp "$PLAIN" "$WORK/plain"
+  for i in $(seq 120); do cat "$PLAIN"; done >"$WORK/long"
+
+  for input in empty plain long; do
+    for format in 16 64 256; do
+      z encode in="$WORK/$input" key="$KEY" out="$WORK/sync.out" out.fmt=$format
+      for mode in stream pipeline; do
+        z encode in="$WORK/$input" key="$KEY" out="$WORK/uring.out" out.fmt=$format mode=$mode io=uring
+        same "$WORK/uring.out" "$WORK/sync.out"
+
+        cat "$WORK/$input" | z encode key="$KEY" out.fmt=$format mode=$mode io=uring >"$WORK/uring.out"
+        same "$WORK/uring.out" "$WORK/sync.out"
+
+        z decode in="$WORK/sync.out" key="$KEY" in.fmt=$format mode=$mode io=uring out="$WORK/back"
+        same "$WORK/back" "$WORK/$input"
+
+        cat "$WORK/sync.out" | z decode key="$KEY" in.fmt=$format mode=$mode io=uring >"$WORK/back"
+        same "$WORK/back" "$WORK/$input"
+      done
+    done
+  done
+
+  z decode in="$DATA/stream.64" key="$KEY" io=uring out="$WORK/back"
+  same "$WORK/back" "$PLAIN"
+
+  refuse encode in="$PLAIN" key="$KEY" io=bogus
+  refuse decode in="$DATA/stream.64" key="$KEY" io=bogus
+  ;;
+
+pipe)
+  # io=pipe writes exactly what io=sync writes, whether the output is a pipe (spliced) or a file (copied). About
+  # 3MB of input cycles the splice ring several times; a reader taking 1000 bytes at a time leaves pages partly
+  # read in the pipe while later blocks are staged.
+  for i in $(seq 400); do cat "$PLAIN"; done >"$WORK/long"
+
+  for format in 16 64 256; do
+    z encode in="$WORK/long" key="$KEY" out="$WORK/sync.out" out.fmt=$format
+
+    cat "$WORK/long" | z encode key="$KEY" out.fmt=$format io=pipe | cat >"$WORK/pipe.out"
+    same "$WORK/pipe.out" "$WORK/sync.out"
+
+    z encode in="$WORK/long" key="$KEY" out.fmt=$format io=pipe | dd bs=1000 2>/dev/null >"$WORK/pipe.out"
+    same "$WORK/pipe.out" "$WORK/sync.out"
+
+    z encode in="$WORK/long" key="$KEY" out="$WORK/pipe.out" out.fmt=$format io=pipe
+    same "$WORK/pipe.out" "$WORK/sync.out"
+
+    cat "$WORK/sync.out" | z decode key="$KEY" in.fmt=$format io=pipe | cat >"$WORK/back"
+    same "$WORK/back" "$WORK/long"
+  done
+  ;;
+
+stats)
+  # The report goes to stderr and leaves the output alone. Times vary from run to run; the byte counts of each
+  # stage do not.
+  text()
+  {
+    awk -v stage="$1" '$1 == stage { print $3 }' "$WORK/stats"
+  }
+
+  json()
+  {
+    grep -o "\"$1\":[0-9]*" "$WORK/stats" | sed 's/.*://'
+  }
+
+  stage()
+  {
+    grep -o "\"$1\":{\"seconds\":[0-9.]*,\"bytes\":[0-9]*" "$WORK/stats" | sed 's/.*://'
+  }
+
+  expect()
+  {
+    [ "$($1 "$2")" = "$3" ] || fail "$4: $2 is '$($1 "$2")', not $3"
+  }
+
+  "$ZIGMA" encode in="$PLAIN" key="$KEY" out="$WORK/out.64" stats=text 2>"$WORK/stats"
+  same "$WORK/out.64" "$DATA/stream.64"
+  expect text read 7897 "encode text"
+  expect text decode 0 "encode text"
+  expect text schedule 40 "encode text"
+  expect text cipher 7897 "encode text"
+  expect text encode 7897 "encode text"
+  expect text write 10670 "encode text"
+  grep -q '^ *10670 (out)$' "$WORK/stats" || fail "encode text: no output total"
+
+  "$ZIGMA" decode in="$DATA/stream.64" key="$KEY" out="$WORK/back" stats=json 2>"$WORK/stats"
+  same "$WORK/back" "$PLAIN"
+  [ "$(grep -c '^{"operation":"decode",.*}}}$' "$WORK/stats")" = 1 ] || fail "decode json: not one line"
+  expect json bytes_in 10670 "decode json"
+  expect json bytes_out 7897 "decode json"
+  expect stage read 10670 "decode json"
+  expect stage decode 10670 "decode json"
+  expect stage cipher 7897 "decode json"
+  expect stage write 7897 "decode json"
+
+  # Every mode and backend counts the same bytes; the chunked container adds its headers and index. io=pipe
+  # needs blocks of 64KB or more before it splices.
+  for i in $(seq 100); do cat "$PLAIN"; done >"$WORK/long"
+
+  for options in mode=pipeline io=uring io=pipe mode=chunked; do
+    "$ZIGMA" encode in="$WORK/long" key="$KEY" out.fmt=256 stats=json $options 2>"$WORK/stats" | cat >"$WORK/out"
+    expect json bytes_in 789700 "$options"
+    expect json bytes_out $(wc -c <"$WORK/out") "$options"
+    expect stage cipher 789700 "$options"
+    expect stage write $(wc -c <"$WORK/out") "$options"
+  done
+
+  refuse encode in="$PLAIN" key="$KEY" stats=xml
+  ;;
+
+seekable)
+  # seekable.zq is plain.bin under mode=seekable chunk.size=1024 and must be reproduced. Every checkpoint interval
+  # gives a file whose full decode is plain.bin.
+  z encode in="$PLAIN" key="$KEY" out="$WORK/out.zq" out.fmt=256 mode=seekable chunk.size=1024
+  same "$WORK/out.zq" "$DATA/seekable.zq"
+
+  for interval in 1 1000 7897 1048576; do
+    z encode in="$PLAIN" key="$KEY" out="$WORK/out.zq" out.fmt=256 mode=seekable chunk.size=$interval
+    z decode in="$WORK/out.zq" in.fmt=256 key="$KEY" mode=seekable out="$WORK/back"
+    same "$WORK/back" "$PLAIN"
+  done
+
+  # Ranges inside a frame, across frames, on a checkpoint, up to the end, and empty at the end.
+  for range in 0:1 1000:3000 1024:1024 7000:897 7897:0; do
+    z decode in="$DATA/seekable.zq" in.fmt=256 key="$KEY" range=$range out="$WORK/part"
+    slice "$PLAIN" ${range%:*} ${range#*:} >"$WORK/expected"
+    same "$WORK/part" "$WORK/expected"
+  done
+
+  refuse decode in="$DATA/seekable.zq" in.fmt=256 key="$KEY" range=7000:898
+  refuse decode in="$DATA/seekable.zq" in.fmt=256 key="$KEY" range=7898:0
+  refuse decode in="$DATA/seekable.zq" in.fmt=256 key="$KEY" range=10
+  refuse decode in="$DATA/stream.256" in.fmt=256 key="$KEY" range=0:10
+  refuse decode in="$DATA/seekable.zq" in.fmt=256 key="$WRONG" range=0:10
+  refuse decode in="$DATA/seekable.zq" in.fmt=256 key="$WRONG" mode=seekable
+  if cat "$DATA/seekable.zq" | "$ZIGMA" decode in.fmt=256 key="$KEY" range=0:10 >/dev/null 2>>"$WORK/log"; then
+    fail "range accepted from a pipe"
+  fi
+
+  # A damaged byte in the third frame: the full decode notices at the next checkpoint, but a range that starts
+  # after the frame is still exact.
+  cp "$DATA/seekable.zq" "$WORK/bad.zq"
+  poke "$WORK/bad.zq" $((12 + 3 * 4 + 2 * 1024 + 10)) 00
+  refuse decode in="$WORK/bad.zq" in.fmt=256 key="$KEY" mode=seekable
+
+  z decode in="$WORK/bad.zq" in.fmt=256 key="$KEY" range=4096:2000 out="$WORK/part"
+  slice "$PLAIN" 4096 2000 >"$WORK/expected"
+  same "$WORK/part" "$WORK/expected"
+  ;;
+
+tag)
+  # tagged.zq is plain.bin encoded with tag=on. In binary, tagged output is the ZQTG header, exactly the untagged
+  # ciphertext, and the 32-byte tag.
+  for mode in stream pipeline; do
+    z encode in="$PLAIN" key="$KEY" out="$WORK/out.zq" tag=on mode=$mode
+    same "$WORK/out.zq" "$DATA/tagged.zq"
+
+    z decode in="$DATA/tagged.zq" key="$KEY" tag=on mode=$mode out="$WORK/back"
+    same "$WORK/back" "$PLAIN"
+  done
+
+  z encode in="$PLAIN" key="$KEY" out="$WORK/tagged.256" out.fmt=256 tag=on
+  [ "$(peek "$WORK/tagged.256" 0 8)" = 5a51544701000000 ] || fail "header"
+  [ $(wc -c <"$WORK/tagged.256") = $((8 + 7897 + 32)) ] || fail "tagged length"
+  slice "$WORK/tagged.256" 8 7897 >"$WORK/cipher"
+  same "$WORK/cipher" "$DATA/stream.256"
+
+  : >"$WORK/empty"
+  z encode in="$WORK/empty" key="$KEY" out="$WORK/empty.zq" out.fmt=256 tag=on
+  z decode in="$WORK/empty.zq" in.fmt=256 key="$KEY" tag=on out="$WORK/back"
+  same "$WORK/back" "$WORK/empty"
+
+  # Damage to the header, the ciphertext or the tag, a missing or extra byte, and a wrong key are all refused.
+  for damage in 4:02 100:00 7904:00 7936:00; do
+    cp "$WORK/tagged.256" "$WORK/bad.256"
+    poke "$WORK/bad.256" ${damage%:*} ${damage#*:}
+    refuse decode in="$WORK/bad.256" in.fmt=256 key="$KEY" tag=on
+  done
+
+  slice "$WORK/tagged.256" 0 7936 >"$WORK/bad.256"
+  refuse decode in="$WORK/bad.256" in.fmt=256 key="$KEY" tag=on
+  cp "$WORK/tagged.256" "$WORK/bad.256"
+  printf x >>"$WORK/bad.256"
+  refuse decode in="$WORK/bad.256" in.fmt=256 key="$KEY" tag=on
+
+  # On a mismatch an output file is truncated back to what it held before, whichever way it was opened.
+  for mode in stream pipeline; do
+    for io in sync uring; do
+      printf stale >"$WORK/back"
+      refuse decode in="$DATA/tagged.zq" key="$WRONG" tag=on mode=$mode io=$io out="$WORK/back"
+      [ -s "$WORK/back" ] && fail "mode=$mode io=$io: unverified output kept"
+    done
+  done
+
+  printf kept >"$WORK/back"
+  if "$ZIGMA" decode in="$DATA/tagged.zq" key="$WRONG" tag=on >>"$WORK/back" 2>>"$WORK/log"; then
+    fail "accepted a wrong key"
+  fi
+  [ "$(cat "$WORK/back")" = kept ] || fail "appended output not taken back"
+
+  # Through a pipe the plaintext cannot be recalled, but the exit status still reports the mismatch.
+  { "$ZIGMA" decode in="$DATA/tagged.zq" key="$WRONG" tag=on 2>>"$WORK/log"; echo $? >"$WORK/status"; } | cat >/dev/null
+  [ "$(cat "$WORK/status")" != 0 ] || fail "wrong key accepted through a pipe"
+
+  # Tagged and untagged streams are not mistaken for each other.
+  refuse decode in="$DATA/tagged.zq" key="$KEY"
+  refuse decode in="$DATA/tagged.zq" key="$KEY" mode=pipeline
+  refuse decode in="$DATA/stream.64" key="$KEY" tag=on
+
+  refuse encode in="$PLAIN" key="$KEY" tag=on mode=chunked
+  refuse encode in="$PLAIN" key="$KEY" tag=on mode=seekable
+  refuse encode in="$PLAIN" key="$KEY" tag=yes
+  ;;
+
+compress)
+  z encode in="$PLAIN" key="$KEY" out="$WORK/out.zq" compress=on
+  same "$WORK/out.zq" "$DATA/compressed.zq"
+
+  z decode in="$DATA/compressed.zq" key="$KEY" compress=on out="$WORK/back"
+  same "$WORK/back" "$PLAIN"
+
+  # Blocks of text, then random bytes, then text again. Decoding without compress=on gives the frames: a 4-byte
+  # little-endian header (payload length, top bit set for a stored block), the payload, and a 0 header at the end.
+  for i in $(seq 20); do cat "$PLAIN"; done >"$WORK/text"
+  { slice "$WORK/text" 0 65536; head -c 262144 /dev/urandom; slice "$WORK/text" 0 131072; } >"$WORK/mixed"
+
+  z encode in="$WORK/mixed" key="$KEY" out="$WORK/mixed.zq" out.fmt=256 compress=on
+  z decode in="$WORK/mixed.zq" in.fmt=256 key="$KEY" compress=on out="$WORK/back"
+  same "$WORK/back" "$WORK/mixed"
+  z decode in="$WORK/mixed.zq" in.fmt=256 key="$KEY" out="$WORK/frames"
+
+  offset=0
+  layout=
+  while [ $(le32 "$WORK/frames" $offset) != 0 ]; do
+    header=$(le32 "$WORK/frames" $offset)
+    if [ $header -ge 2147483648 ]; then
+      layout="$layout S"
+      header=$((header - 2147483648))
+    else
+      layout="$layout C"
+    fi
+    offset=$((offset + 4 + header))
+  done
+  [ $((offset + 4)) = $(wc -c <"$WORK/frames") ] || fail "the frames do not end at the end marker"
+
+  # Text compresses. After a block that does not, the next one is stored without trying, then the next two, so the
+  # first text block after the random ones is stored too.
+  [ "$layout" = " C S S S S S C" ] || fail "frame layout:$layout"
+
+  # A stored block is the plaintext as is.
+  slice "$WORK/frames" $((4 + $(le32 "$WORK/frames" 0) + 4)) 65536 >"$WORK/stored"
+  slice "$WORK/mixed" 65536 65536 >"$WORK/random"
+  same "$WORK/stored" "$WORK/random"
+
+  # An empty input is just the end marker.
+  : >"$WORK/empty"
+  z encode in="$WORK/empty" key="$KEY" out="$WORK/empty.zq" out.fmt=256 compress=on
+  [ $(wc -c <"$WORK/empty.zq") = 4 ] || fail "empty input"
+  z decode in="$WORK/empty.zq" in.fmt=256 key="$KEY" compress=on out="$WORK/back"
+  same "$WORK/back" "$WORK/empty"
+
+  # A wrong key, a damaged header, a missing end marker, data after it, or input that is not compressed are refused,
+  # and the output written so far (more than a sink block of it) is taken back.
+  cat "$WORK/text" "$WORK/text" "$WORK/text" >"$WORK/big"
+  z encode in="$WORK/big" key="$KEY" out="$WORK/text.zq" out.fmt=256 compress=on
+  size=$(wc -c <"$WORK/text.zq")
+
+  cp "$WORK/text.zq" "$WORK/header.zq"
+  poke "$WORK/header.zq" 3 7f
+  slice "$WORK/text.zq" 0 $((size - 4)) >"$WORK/short.zq"
+  cp "$WORK/text.zq" "$WORK/long.zq"
+  printf x >>"$WORK/long.zq"
+
+  for bad in "$WORK/header.zq" "$WORK/short.zq" "$WORK/long.zq" "$DATA/stream.256"; do
+    printf stale >"$WORK/back"
+    refuse decode in="$bad" in.fmt=256 key="$KEY" compress=on out="$WORK/back"
+    [ -s "$WORK/back" ] && fail "$bad: output kept"
+  done
+  refuse decode in="$WORK/text.zq" in.fmt=256 key="$WRONG" compress=on
+
+  # With a tag the plaintext is hashed before compression and checked after decompression.
+  z encode in="$PLAIN" key="$KEY" tag=on compress=on | z decode key="$KEY" tag=on compress=on >"$WORK/back"
+  same "$WORK/back" "$PLAIN"
+
+  refuse encode in="$PLAIN" key="$KEY" compress=on mode=pipeline
+  refuse encode in="$PLAIN" key="$KEY" compress=on mode=chunked
+  refuse encode in="$PLAIN" key="$KEY" compress=on mode=seekable
+  refuse encode in="$PLAIN" key="$KEY" compress=yes
+  ;;
+
+archive)
+  # archive.zqa packs this tree, with both files last modified at 1700000000: the header, data/noise.bin (2896 bytes)
+  # and notes.txt (5001 bytes) back to back, then the index and the trailer.
+  mkdir -p "$WORK/tree/data"
+  head -c 5001 "$PLAIN" >"$WORK/tree/notes.txt"
+  tail -c +5002 "$PLAIN" >"$WORK/tree/data/noise.bin"
+  chmod 644 "$WORK/tree/notes.txt"
+  chmod 600 "$WORK/tree/data/noise.bin"
+  touch -d @1700000000 "$WORK/tree/notes.txt" "$WORK/tree/data/noise.bin"
+
+  for jobs in 1 4; do
+    z archive in="$WORK/tree" out="$WORK/new.zqa" key="$KEY" jobs=$jobs
+    same "$WORK/new.zqa" "$DATA/archive.zqa"
+  done
+
+  ARCHIVE=$DATA/archive.zqa
+  size=$(wc -c <"$ARCHIVE")
+
+  [ "$(peek "$ARCHIVE" 0 8)" = 5a51415201000000 ] || fail "header"
+  [ "$(slice "$ARCHIVE" $((size - 4)) 4)" = ZQAX ] || fail "trailer magic"
+  [ $(le32 "$ARCHIVE" $((size - 20))) = $((8 + 2896 + 5001)) ] || fail "index offset"
+  [ $(le32 "$ARCHIVE" $((size - 12))) = $((size - 20 - 8 - 2896 - 5001)) ] || fail "index length"
+
+  printf '2896  data/noise.bin\n5001  notes.txt\n' >"$WORK/listing"
+  z archive action=list in="$ARCHIVE" key="$KEY" >"$WORK/list"
+  same "$WORK/list" "$WORK/listing"
+
+  z archive action=extract in="$ARCHIVE" key="$KEY" member=notes.txt out="$WORK/notes"
+  same "$WORK/notes" "$WORK/tree/notes.txt"
+
+  z archive action=extract in="$ARCHIVE" key="$KEY" out="$WORK/restored"
+  same "$WORK/restored/notes.txt" "$WORK/tree/notes.txt"
+  same "$WORK/restored/data/noise.bin" "$WORK/tree/data/noise.bin"
+  [ "$(stat -c '%a %Y' "$WORK/restored/data/noise.bin")" = "600 1700000000" ] || fail "mode and mtime not restored"
+  [ "$(stat -c '%a %Y' "$WORK/restored/notes.txt")" = "644 1700000000" ] || fail "mode and mtime not restored"
+
+  # Each member has its own context, so identical files have different ciphertexts.
+  mkdir -p "$WORK/twins"
+  cp "$WORK/tree/notes.txt" "$WORK/twins/a"
+  cp "$WORK/tree/notes.txt" "$WORK/twins/b"
+  z archive in="$WORK/twins" out="$WORK/twins.zqa" key="$KEY"
+  slice "$WORK/twins.zqa" 8 5001 >"$WORK/a"
+  slice "$WORK/twins.zqa" 5009 5001 >"$WORK/b"
+  cmp -s "$WORK/a" "$WORK/b" && fail "identical members share a cipher context"
+
+  # Setuid, setgid and sticky bits are stored but not restored.
+  mkdir -p "$WORK/special"
+  cp "$WORK/tree/notes.txt" "$WORK/special/tool"
+  chmod 7755 "$WORK/special/tool"
+  z archive in="$WORK/special" out="$WORK/special.zqa" key="$KEY"
+  z archive action=extract in="$WORK/special.zqa" key="$KEY" out="$WORK/unpacked"
+  [ "$(stat -c %a "$WORK/unpacked/tool")" = 755 ] || fail "special mode bits restored"
+
+  # A damaged member is refused on its own, leaves nothing behind, and does not stop the others being read.
+  cp "$ARCHIVE" "$WORK/bad.zqa"
+  poke "$WORK/bad.zqa" 100 00
+  refuse archive action=extract in="$WORK/bad.zqa" key="$KEY" member=data/noise.bin out="$WORK/noise"
+  [ -s "$WORK/noise" ] && fail "a damaged member was extracted"
+  z archive action=extract in="$WORK/bad.zqa" key="$KEY" member=notes.txt out="$WORK/notes"
+  same "$WORK/notes" "$WORK/tree/notes.txt"
+  refuse archive action=extract in="$WORK/bad.zqa" key="$KEY" out="$WORK/partial"
+  [ -n "$(ls -A "$WORK/partial/data" 2>/dev/null)" ] && fail "a damaged member left files behind"
+
+  # A damaged index or trailer, a wrong key, a short archive or a missing member are refused.
+  cp "$ARCHIVE" "$WORK/index.zqa"
+  poke "$WORK/index.zqa" $((8 + 2896 + 5001 + 10)) 00
+  refuse archive action=list in="$WORK/index.zqa" key="$KEY"
+  cp "$ARCHIVE" "$WORK/trailer.zqa"
+  poke "$WORK/trailer.zqa" $((size - 20)) 00
+  refuse archive action=list in="$WORK/trailer.zqa" key="$KEY"
+  slice "$ARCHIVE" 0 $((size - 1)) >"$WORK/short.zqa"
+  refuse archive action=list in="$WORK/short.zqa" key="$KEY"
+  refuse archive action=list in="$ARCHIVE" key="$WRONG"
+  refuse archive action=extract in="$ARCHIVE" key="$KEY" member=missing.txt out="$WORK/missing"
+
+  # A link planted in the destination is not written through, and links are not archived.
+  mkdir -p "$WORK/planted" "$WORK/outside"
+  ln -s "$WORK/outside" "$WORK/planted/data"
+  refuse archive action=extract in="$ARCHIVE" key="$KEY" out="$WORK/planted"
+  [ -e "$WORK/outside/noise.bin" ] && fail "extracted through a link"
+
+  ln -s notes.txt "$WORK/tree/link"
+  refuse archive in="$WORK/tree" out="$WORK/link.zqa" key="$KEY"
+  ;;
+
+*)
+  echo "ERROR: No test named '$NAME'!" >&2
+  exit 1
+  ;;
+esac
+
+[ $STATUS = 0 ] || cat "$WORK/log" >&2
+
+exit $STATUS
@@ -0,0 +1,141 @@
+/*
+ * ZIGMA, Copyright (C) 2024 Chase Zehl O'Byrne
+ *   <mail: zehl@live.com> http://zehlchen.com/
+ *
+ * This file is part of ZIGMA.
+ *
+ * ZIGMA is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ZIGMA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ZIGMA; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#pragma once
+#ifndef _ZIGMATIQ_TEST_H_
+#define _ZIGMATIQ_TEST_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+
+/* The harness shared by the library tests. Each test program is `zigma_test_NAME DATA_DIRECTORY [CASE]`: it runs
+ * every case in its table, or only CASE, and exits non-zero if any check failed. DATA_DIRECTORY is tests/data.
+ */
+
+typedef struct TestCase {
+  const char* name;
+  void (*run)(void);
+} TestCase;
+
+static const char* TestDirectory = NULL;
+static uint64      TestFailures  = 0;
+
+/* Record a failure, with where it happened, and carry on. */
+#define TEST_CHECK(condition)                                                                                          \
+  do {                                                                                                                 \
+    if (!(condition)) {                                                                                                \
+      fprintf(stderr, "FAIL: %s:%d: %s\n", __FILE__, __LINE__, #condition);                                            \
+      TestFailures++;                                                                                                  \
+    }                                                                                                                  \
+  } while (0)
+
+/* Read a whole file from the data directory; exits if it is missing.
+ *   @param name The file name within the data directory.
+ *   @param length Receives the length of the file.
+ *   @return The contents, which the caller frees.
+ */
+static inline uint8* TestLoad(const char* name, uint64* length)
+{
+  char path[4096];
+
+  snprintf(path, sizeof(path), "%s/%s", TestDirectory, name);
+
+  FILE* file = fopen(path, "rb");
+
+  if (file == NULL) {
+    fprintf(stderr, "ERROR: Unable to open '%s'!\n", path);
+    exit(EXIT_FAILURE);
+  }
+
+  fseek(file, 0, SEEK_END);
+
+  *length = (uint64) ftell(file);
+
+  uint8* data = (uint8*) malloc(*length + 1);
+
+  rewind(file);
+
+  if (fread(data, 1, *length, file) != *length) {
+    fprintf(stderr, "ERROR: Unable to read '%s'!\n", path);
+    exit(EXIT_FAILURE);
+  }
+
+  fclose(file);
+
+  return data;
+}
+
+/* Fill `data` with a reproducible byte sequence.
+ *   @param data The destination.
+ *   @param length The number of bytes.
+ *   @param seed Selects the sequence.
+ */
+static inline void TestFill(uint8* data, uint64 length, uint64 seed)
+{
+  for (uint64 i = 0; i < length; i++) {
+    seed    = seed * 6364136223846793005ull + 1442695040888963407ull;
+    data[i] = (uint8) (seed >> 56);
+  }
+}
+
+/* Run the cases named on the command line.
+ *   @param argc The argument count from main().
+ *   @param argv The arguments from main().
+ *   @param cases The test cases.
+ *   @param count The number of cases.
+ *   @return The exit status for main().
+ */
+static int TestMain(int argc, char* argv[], const TestCase* cases, uint64 count)
+{
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s DATA_DIRECTORY [CASE]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  TestDirectory = argv[1];
+
+  uint64 ran = 0;
+
+  for (uint64 i = 0; i < count; i++) {
+    if (argc > 2 && strcmp(argv[2], cases[i].name) != 0)
+      continue;
+
+    uint64 before = TestFailures;
+
+    cases[i].run();
+    ran++;
+
+    fprintf(stderr, "%s: %s\n", TestFailures == before ? "PASS" : "FAIL", cases[i].name);
+  }
+
+  if (ran == 0) {
+    fprintf(stderr, "ERROR: No test case named '%s'!\n", argv[2]);
+    return EXIT_FAILURE;
+  }
+
+  return TestFailures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+#endif /* _ZIGMATIQ_TEST_H_ */
@@ -0,0 +1,343 @@
+/*
+ * ZIGMA, Copyright (C) 2024 Chase Zehl O'Byrne
+ *   <mail: zehl@live.com> http://zehlchen.com/
+ *
+ * This file is part of ZIGMA.
+ *
+ * ZIGMA is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ZIGMA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ZIGMA; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/* Cipher tests: `zigma_test_cipher DATA_DIRECTORY [CASE]`.
+ *
+ * stream.256 is the baseline release's output for plain.bin under key.bin, so every kernel must reproduce it.
+ * key.ctx is key.bin as a scheduled key file.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+
+#include "test.h"
+#include "zigma.h"
+
+/* The block and byte functions against the baseline release. */
+static void TestCipher(void)
+{
+  uint64 plainLength, keyLength, cipherLength;
+  uint8* plain  = TestLoad("plain.bin", &plainLength);
+  uint8* key    = TestLoad("key.bin", &keyLength);
+  uint8* cipher = TestLoad("stream.256", &cipherLength);
+  uint8* output = (uint8*) malloc(plainLength);
+
+  ZigmaContext context;
+
+  TEST_CHECK(cipherLength == plainLength);
+
+  ZigmaCreate(&context, (const char*) key, keyLength);
+  ZigmaEncodeBlock(&context, output, plain, plainLength);
+
+  TEST_CHECK(memcmp(output, cipher, plainLength) == 0);
+
+  /* A byte at a time, then in uneven pieces, the stream is the same. */
+  ZigmaCreate(&context, (const char*) key, keyLength);
+
+  for (uint64 i = 0; i < 100; i++)
+    output[i] = ZigmaEncodeByte(&context, plain[i]);
+
+  for (uint64 i = 100, step = 1; i < plainLength; i += step, step = step * 3 % 1001 + 1)
+    ZigmaEncodeBlock(&context, output + i, plain + i, i + step < plainLength ? step : plainLength - i);
+
+  TEST_CHECK(memcmp(output, cipher, plainLength) == 0);
+
+  ZigmaCreate(&context, (const char*) key, keyLength);
+  ZigmaDecodeBlock(&context, output, cipher, plainLength);
+
+  TEST_CHECK(memcmp(output, plain, plainLength) == 0);
+
+  free(output);
+  free(cipher);
+  free(key);
+  free(plain);
+}
+
+/* The batch functions give every lane exactly what the block functions give it alone: the same output, and the
+ * context left in the same state.
+ */
+static void TestBatch(void)
+{
+  enum { LANES = 3 * ZQ_ZIGMA_BATCH_WIDTH + 5 };
+
+  uint64 plainLength, keyLength, cipherLength;
+  uint8* plain  = TestLoad("plain.bin", &plainLength);
+  uint8* key    = TestLoad("key.bin", &keyLength);
+  uint8* cipher = TestLoad("stream.256", &cipherLength);
+  uint8* output = (uint8*) malloc(LANES * plainLength);
+  uint8* expect = (uint8*) malloc(plainLength);
+
+  ZigmaContext keyed, contexts[LANES], single;
+  ZigmaLane    lanes[LANES];
+
+  ZigmaCreate(&keyed, (const char*) key, keyLength);
+
+  /* Uneven lengths, some empty, so lanes finish and are refilled at different times, and a lane count that is not a
+   * multiple of the width. Every lane starts from the keyed context, so each output is a prefix of stream.256.
+   */
+  for (uint64 i = 0; i < LANES; i++) {
+    contexts[i] = keyed;
+
+    lanes[i].context = &contexts[i];
+    lanes[i].output  = output + i * plainLength;
+    lanes[i].input   = plain;
+    lanes[i].length  = i % 7 == 3 ? 0 : i == 0 ? plainLength : (i * 997) % plainLength;
+  }
+
+  ZigmaEncodeBatch(lanes, LANES);
+
+  for (uint64 i = 0; i < LANES; i++) {
+    single = keyed;
+
+    ZigmaEncodeBlock(&single, expect, plain, lanes[i].length);
+
+    TEST_CHECK(memcmp(output + i * plainLength, cipher, lanes[i].length) == 0);
+    TEST_CHECK(memcmp(&contexts[i], &single, sizeof(ZigmaContext)) == 0);
+  }
+
+  /* In place, the lanes decode back to the plaintext. */
+  for (uint64 i = 0; i < LANES; i++) {
+    contexts[i] = keyed;
+
+    lanes[i].input = lanes[i].output;
+  }
+
+  ZigmaDecodeBatch(lanes, LANES);
+
+  for (uint64 i = 0; i < LANES; i++)
+    TEST_CHECK(memcmp(output + i * plainLength, plain, lanes[i].length) == 0);
+
+  /* Lanes are independent: each one with its own derived context and its own slice of the plaintext, as the
+   * chunked container ciphers its chunks, matches that chunk ciphered on its own.
+   */
+  for (uint64 i = 0; i < LANES; i++) {
+    ZigmaDerive(&contexts[i], &keyed, i);
+
+    lanes[i].output = output + i * plainLength;
+    lanes[i].input  = plain + i * 251;
+    lanes[i].length = plainLength - i * 251;
+  }
+
+  ZigmaEncodeBatch(lanes, LANES);
+
+  for (uint64 i = 0; i < LANES; i++) {
+    ZigmaDerive(&single, &keyed, i);
+    ZigmaEncodeBlock(&single, expect, plain + i * 251, plainLength - i * 251);
+
+    TEST_CHECK(memcmp(output + i * plainLength, expect, plainLength - i * 251) == 0);
+  }
+
+  free(expect);
+  free(output);
+  free(cipher);
+  free(key);
+  free(plain);
+}
+
+/* Scheduled key files: the export of key.bin is key.ctx, importing it gives the keyed context back, and anything
+ * that is not exactly such a file is refused.
+ */
+static void TestSchedule(void)
+{
+  uint64 keyLength, scheduleLength, plainLength, cipherLength;
+  uint8* key      = TestLoad("key.bin", &keyLength);
+  uint8* schedule = TestLoad("key.ctx", &scheduleLength);
+  uint8* plain    = TestLoad("plain.bin", &plainLength);
+  uint8* cipher   = TestLoad("stream.256", &cipherLength);
+  uint8* output   = (uint8*) malloc(plainLength);
+  uint8  data[ZQ_SCHEDULE_SIZE + 1];
+
+  ZigmaContext keyed, imported;
+
+  ZigmaCreate(&keyed, (const char*) key, keyLength);
+
+  TEST_CHECK(scheduleLength == ZQ_SCHEDULE_SIZE);
+  TEST_CHECK(ZigmaExport(&keyed, data) == ZQ_SCHEDULE_SIZE);
+  TEST_CHECK(memcmp(data, schedule, ZQ_SCHEDULE_SIZE) == 0);
+
+  TEST_CHECK(ZigmaImport(&imported, schedule, scheduleLength) == &imported);
+  TEST_CHECK(memcmp(&imported, &keyed, sizeof(ZigmaContext)) == 0);
+
+  ZigmaEncodeBlock(&imported, output, plain, plainLength);
+  TEST_CHECK(memcmp(output, cipher, plainLength) == 0);
+
+  ZigmaContext* allocated = ZigmaImport(NULL, schedule, scheduleLength);
+
+  TEST_CHECK(allocated != NULL && memcmp(allocated, &keyed, sizeof(ZigmaContext)) == 0);
+
+  free(allocated);
+
+  /* A changed bit anywhere (header, snapshot or checksum), or a length that is off by one. */
+  for (uint64 i = 0; i < ZQ_SCHEDULE_SIZE; i++) {
+    memcpy(data, schedule, ZQ_SCHEDULE_SIZE);
+
+    data[i] ^= 1 << (i % 8);
+
+    TEST_CHECK(ZigmaImport(&imported, data, ZQ_SCHEDULE_SIZE) == NULL);
+  }
+
+  memcpy(data, schedule, ZQ_SCHEDULE_SIZE);
+
+  TEST_CHECK(ZigmaImport(&imported, data, ZQ_SCHEDULE_SIZE - 1) == NULL);
+  TEST_CHECK(ZigmaImport(&imported, data, ZQ_SCHEDULE_SIZE + 1) == NULL);
+
+  /* A correctly checksummed state that is not a permutation. */
+  ZigmaContext broken = keyed;
+
+  broken.state[1] = broken.state[0];
+
+  ZigmaExport(&broken, data);
+  TEST_CHECK(ZigmaImport(&imported, data, ZQ_SCHEDULE_SIZE) == NULL);
+
+  free(output);
+  free(cipher);
+  free(plain);
+  free(schedule);
+  free(key);
+}
+
+/* ZigmaHashUpdate advances a context exactly as ZigmaEncodeBlock does, in pieces of any size, and its digest of
+ * plain.bin is the one in check.16.
+ */
+static void TestHash(void)
+{
+  uint64 plainLength, keyLength, checkLength;
+  uint8* plain  = TestLoad("plain.bin", &plainLength);
+  uint8* key    = TestLoad("key.bin", &keyLength);
+  uint8* check  = TestLoad("check.16", &checkLength);
+  uint8* output = (uint8*) malloc(plainLength);
+  uint8  digest[ZIGMA_CHECKSUM_SIZE];
+  char   text[2 * ZIGMA_CHECKSUM_SIZE + 1];
+
+  ZigmaContext hashed, encoded;
+
+  ZigmaHashInit(&hashed);
+  ZigmaCreate(&encoded, NULL, 0);
+
+  TEST_CHECK(memcmp(&hashed, &encoded, sizeof(ZigmaContext)) == 0);
+
+  for (uint64 i = 0, step = 0; i < plainLength; i += step, step = step * 3 % 1021 + 1)
+    ZigmaHashUpdate(&hashed, plain + i, i + step < plainLength ? step : plainLength - i);
+
+  ZigmaEncodeBlock(&encoded, output, plain, plainLength);
+
+  TEST_CHECK(memcmp(&hashed, &encoded, sizeof(ZigmaContext)) == 0);
+
+  ZigmaHashFinal(&hashed, digest, sizeof(digest));
+
+  for (uint64 i = 0; i < sizeof(digest); i++)
+    snprintf(text + 2 * i, 3, "%02x", digest[i]);
+
+  TEST_CHECK(checkLength > sizeof(text) && memcmp(check, text, sizeof(text) - 1) == 0);
+
+  /* The same from a keyed context, which is what a keyed digest would start from. */
+  ZigmaCreate(&hashed, (const char*) key, keyLength);
+  ZigmaCreate(&encoded, (const char*) key, keyLength);
+
+  ZigmaHashUpdate(&hashed, plain, plainLength);
+  ZigmaEncodeBlock(&encoded, output, plain, plainLength);
+
+  TEST_CHECK(memcmp(&hashed, &encoded, sizeof(ZigmaContext)) == 0);
+
+  free(output);
+  free(check);
+  free(key);
+  free(plain);
+}
+
+/* Every block length around the unroll factor, from every offset within one unrolled step: the unrolled loop and
+ * the tail must hand the indices over exactly, in both directions, in place, and when only hashing.
+ */
+static void TestKernel(void)
+{
+  enum { LONGEST = 4 * ZQ_ZIGMA_UNROLL + 1 };
+
+  uint64 plainLength, keyLength, cipherLength;
+  uint8* plain  = TestLoad("plain.bin", &plainLength);
+  uint8* key    = TestLoad("key.bin", &keyLength);
+  uint8* cipher = TestLoad("stream.256", &cipherLength);
+  uint8  output[LONGEST];
+
+  ZigmaContext keyed, start, context, reference;
+
+  ZigmaCreate(&keyed, (const char*) key, keyLength);
+
+  for (uint64 offset = 0; offset <= ZQ_ZIGMA_UNROLL; offset++) {
+    start = keyed;
+
+    for (uint64 i = 0; i < offset; i++)
+      ZigmaEncodeByte(&start, plain[i]);
+
+    for (uint64 length = 0; length <= LONGEST; length++) {
+      const uint8* in  = plain + offset;
+      const uint8* out = cipher + offset;
+
+      reference = start;
+
+      for (uint64 i = 0; i < length; i++)
+        ZigmaEncodeByte(&reference, in[i]);
+
+      context = start;
+      ZigmaEncodeBlock(&context, output, in, length);
+
+      TEST_CHECK(memcmp(output, out, length) == 0);
+      TEST_CHECK(memcmp(&context, &reference, sizeof(ZigmaContext)) == 0);
+
+      context = start;
+      ZigmaDecodeBlock(&context, output, out, length);
+
+      TEST_CHECK(memcmp(output, in, length) == 0);
+      TEST_CHECK(memcmp(&context, &reference, sizeof(ZigmaContext)) == 0);
+
+      memcpy(output, in, length);
+      context = start;
+      ZigmaEncodeBlock(&context, output, output, length);
+
+      TEST_CHECK(memcmp(output, out, length) == 0);
+
+      context = start;
+      ZigmaHashUpdate(&context, in, length);
+
+      TEST_CHECK(memcmp(&context, &reference, sizeof(ZigmaContext)) == 0);
+    }
+  }
+
+  free(cipher);
+  free(key);
+  free(plain);
+}
+
+static const TestCase TestCases[] = {
+  {"cipher",   TestCipher  },
+  {"batch",    TestBatch   },
+  {"schedule", TestSchedule},
+  {"hash",     TestHash    },
+  {"kernel",   TestKernel  },
+};
+
+int main(int argc, char* argv[])
+{
+  return TestMain(argc, argv, TestCases, sizeof(TestCases) / sizeof(TestCases[0]));
+}
@@ -0,0 +1,365 @@
+/*
+ * ZIGMA, Copyright (C) 2024 Chase Zehl O'Byrne
+ *   <mail: zehl@live.com> http://zehlchen.com/
+ *
+ * This file is part of ZIGMA.
+ *
+ * ZIGMA is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ZIGMA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ZIGMA; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/* Codec tests: `zigma_test_codecs DATA_DIRECTORY [CASE]`.
+ *
+ * Every kernel the processor supports is checked against the RFC 4648 vectors and against the scalar kernel. The
+ * incremental decoders are checked on stream.64 and stream.16, which decode to stream.256.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+
+#include "base16.h"
+#include "base64.h"
+#include "test.h"
+
+static const char* TestKernels[] = {"scalar", "ssse3", "avx2", "avx512", NULL};
+
+/* RFC 4648, section 10. */
+static const struct {
+  const char* plain;
+  const char* base64;
+  const char* base16;
+} TestVectors[] = {
+  {"",       "",         ""            },
+  {"f",      "Zg==",     "66"          },
+  {"fo",     "Zm8=",     "666f"        },
+  {"foo",    "Zm9v",     "666f6f"      },
+  {"foob",   "Zm9vYg==", "666f6f62"    },
+  {"fooba",  "Zm9vYmE=", "666f6f6261"  },
+  {"foobar", "Zm9vYmFy", "666f6f626172"},
+};
+
+#define TEST_VECTOR_COUNT (sizeof(TestVectors) / sizeof(TestVectors[0]))
+
+enum { TEST_SIZE = 4096 };
+
+/* Lengths 0-200 one by one, so every vector block and tail size is hit, then a few long runs. */
+static uint64 TestNextLength(uint64 length)
+{
+  return length < 200 ? length + 1 : length * 2 + 7;
+}
+
+static void TestBase64(void)
+{
+  uint8* data      = (uint8*) malloc(TEST_SIZE);
+  char*  reference = (char*) malloc(2 * TEST_SIZE);
+  char*  text      = (char*) malloc(2 * TEST_SIZE);
+  char*  wrapped   = (char*) malloc(4 * TEST_SIZE);
+  uint8* decoded   = (uint8*) malloc(TEST_SIZE);
+  char*  initial   = strdup(base64_kernel());
+
+  TestFill(data, TEST_SIZE, 64);
+
+  for (int k = 0; TestKernels[k] != NULL; k++) {
+    if (!base64_select_kernel(TestKernels[k]))
+      continue;
+
+    for (uint64 v = 0; v < TEST_VECTOR_COUNT; v++) {
+      uint64 length = strlen(TestVectors[v].plain);
+      uint64 size   = strlen(TestVectors[v].base64);
+
+      TEST_CHECK(base64_encode(text, TestVectors[v].plain, length) == size);
+      TEST_CHECK(memcmp(text, TestVectors[v].base64, size) == 0);
+      TEST_CHECK(base64_decode((char*) decoded, TestVectors[v].base64, size) == length);
+      TEST_CHECK(memcmp(decoded, TestVectors[v].plain, length) == 0);
+    }
+
+    for (uint64 length = 0; length <= TEST_SIZE; length = TestNextLength(length)) {
+      base64_select_kernel("scalar");
+
+      uint64 size = base64_encode(reference, (const char*) data, length);
+
+      base64_select_kernel(TestKernels[k]);
+
+      TEST_CHECK(base64_encode(text, (const char*) data, length) == size);
+      TEST_CHECK(memcmp(text, reference, size) == 0);
+      TEST_CHECK(base64_decode((char*) decoded, text, size) == length);
+      TEST_CHECK(memcmp(decoded, data, length) == 0);
+    }
+
+    /* A character outside the alphabet is found wherever it falls, inside a vector block or in the tail. */
+    base64_encode(reference, (const char*) data, 150);
+
+    for (uint64 at = 0; at < 200; at++) {
+      memcpy(text, reference, 200);
+
+      text[at] = "*-_.\x80"[at % 5];
+
+      TEST_CHECK(base64_decode((char*) decoded, text, 200) == BASE64_INVALID);
+    }
+
+    /* Padding only at the end, and never more than two; whole quanta only. */
+    static const char* malformed[] = {"Zg=", "Z===", "Zg=a", "Zg==Zm8=", "=Zm9", "Zm9vY", "Zm9v===="};
+
+    for (uint64 m = 0; m < sizeof(malformed) / sizeof(malformed[0]); m++)
+      TEST_CHECK(base64_decode((char*) decoded, malformed[m], strlen(malformed[m])) == BASE64_INVALID);
+
+    /* Sanitizing drops line breaks (LF or CRLF), blanks and comment lines, and agrees with the scalar kernel. */
+    for (uint64 length = 0; length <= TEST_SIZE; length = TestNextLength(length)) {
+      uint64 size = base64_encode(reference, (const char*) data, length);
+      uint64 used = (uint64) sprintf(wrapped, "# comment %u\n", (unsigned int) length);
+
+      for (uint64 i = 0; i < size; i++) {
+        if (i > 0 && i % 76 == 0)
+          used += (uint64) sprintf(wrapped + used, "%s", i % 3 == 0 ? "\r\n" : i % 5 == 0 ? " \n\t" : "\n");
+
+        wrapped[used++] = reference[i];
+      }
+
+      TEST_CHECK(base64_sanitize(text, wrapped, used) == size);
+      TEST_CHECK(memcmp(text, reference, size) == 0);
+
+      /* In place. */
+      TEST_CHECK(base64_sanitize(wrapped, wrapped, used) == size);
+      TEST_CHECK(memcmp(wrapped, reference, size) == 0);
+    }
+  }
+
+  base64_select_kernel(initial);
+
+  free(initial);
+  free(decoded);
+  free(wrapped);
+  free(text);
+  free(reference);
+  free(data);
+}
+
+static void TestBase16(void)
+{
+  uint8* data      = (uint8*) malloc(TEST_SIZE);
+  char*  reference = (char*) malloc(2 * TEST_SIZE);
+  char*  text      = (char*) malloc(4 * TEST_SIZE);
+  uint8* decoded   = (uint8*) malloc(2 * TEST_SIZE);
+  char*  initial   = strdup(base16_kernel());
+
+  TestFill(data, TEST_SIZE, 16);
+
+  for (int k = 0; TestKernels[k] != NULL; k++) {
+    if (!base16_select_kernel(TestKernels[k]))
+      continue;
+
+    for (uint64 v = 0; v < TEST_VECTOR_COUNT; v++) {
+      uint64 length = strlen(TestVectors[v].plain);
+      int    nibble = -1;
+
+      TEST_CHECK(base16_encode(text, (const uint8*) TestVectors[v].plain, length) == 2 * length);
+      TEST_CHECK(memcmp(text, TestVectors[v].base16, 2 * length) == 0);
+      TEST_CHECK(base16_decode(decoded, TestVectors[v].base16, 2 * length, &nibble) == length && nibble < 0);
+      TEST_CHECK(memcmp(decoded, TestVectors[v].plain, length) == 0);
+    }
+
+    for (uint64 length = 0; length <= TEST_SIZE; length = TestNextLength(length)) {
+      int nibble = -1;
+
+      base16_select_kernel("scalar");
+      base16_encode(reference, data, length);
+      base16_select_kernel(TestKernels[k]);
+
+      TEST_CHECK(base16_encode(text, data, length) == 2 * length);
+      TEST_CHECK(memcmp(text, reference, 2 * length) == 0);
+      TEST_CHECK(base16_decode(decoded, text, 2 * length, &nibble) == length && nibble < 0);
+      TEST_CHECK(memcmp(decoded, data, length) == 0);
+    }
+
+    /* Upper case digits and whitespace between and inside pairs decode the same. */
+    uint64 used = 0;
+
+    base16_encode(reference, data, 300);
+
+    for (uint64 i = 0; i < 600; i++) {
+      text[used++] = (char) (i % 3 == 0 && reference[i] >= 'a' ? reference[i] - 'a' + 'A' : reference[i]);
+
+      if (i % 37 == 0)
+        text[used++] = "\n \t\r"[i % 4];
+    }
+
+    int nibble = -1;
+
+    TEST_CHECK(base16_decode(decoded, text, used, &nibble) == 300 && nibble < 0);
+    TEST_CHECK(memcmp(decoded, data, 300) == 0);
+
+    /* Split anywhere, a pair cut in two is carried over in the nibble. */
+    for (uint64 cut = 0; cut <= 200; cut++) {
+      uint64 first;
+
+      nibble = -1;
+      first  = base16_decode(decoded, reference, cut, &nibble);
+
+      TEST_CHECK(first == cut / 2 && (nibble >= 0) == (cut % 2 == 1));
+      TEST_CHECK(base16_decode(decoded + first, reference + cut, 200 - cut, &nibble) == 100 - first && nibble < 0);
+      TEST_CHECK(memcmp(decoded, data, 100) == 0);
+    }
+
+    /* A character that is neither a digit nor whitespace is found wherever it falls. */
+    for (uint64 at = 0; at < 200; at++) {
+      memcpy(text, reference, 200);
+
+      text[at] = "gG/:@`"[at % 6];
+      nibble   = -1;
+
+      TEST_CHECK(base16_decode(decoded, text, 200, &nibble) == BASE16_INVALID);
+    }
+  }
+
+  base16_select_kernel(initial);
+
+  free(initial);
+  free(decoded);
+  free(text);
+  free(reference);
+  free(data);
+}
+
+/* Annotate `text` the way people edit encoded files: a leading comment, CRLF on every third line, and a comment
+ * line every tenth.
+ *   @return The length of the annotated text in `output`.
+ */
+static uint64 TestAnnotate(char* output, const uint8* text, uint64 length)
+{
+  uint64 used = (uint64) sprintf(output, "# annotated\n");
+
+  for (uint64 i = 0, line = 0; i < length; i++) {
+    if (text[i] != '\n') {
+      output[used++] = (char) text[i];
+      continue;
+    }
+
+    used += (uint64) sprintf(output + used, "%s", ++line % 3 == 0 ? "\r\n" : "\n");
+
+    if (line % 10 == 0)
+      used += (uint64) sprintf(output + used, "#%llu: = # 0123456789abcdef\n", (unsigned long long) line);
+  }
+
+  return used;
+}
+
+/* Decode `text` through a decoder, `piece` bytes at a time.
+ *   @return The number of bytes decoded, or the codec's invalid value; `complete` receives the final check.
+ */
+static uint64 TestDecodeBase64(uint8* output, const char* text, uint64 length, uint64 piece, int* complete)
+{
+  base64_decoder decoder;
+  uint64         used = 0;
+
+  base64_decoder_init(&decoder);
+
+  for (uint64 i = 0; i < length; i += piece) {
+    uint64        size  = i + piece < length ? piece : length - i;
+    unsigned long count = base64_decoder_update(&decoder, output + used, text + i, size);
+
+    if (count == BASE64_INVALID)
+      return BASE64_INVALID;
+
+    used += count;
+  }
+
+  *complete = base64_decoder_final(&decoder);
+
+  return used;
+}
+
+static uint64 TestDecodeBase16(uint8* output, const char* text, uint64 length, uint64 piece, int* complete)
+{
+  base16_decoder decoder;
+  uint64         used = 0;
+
+  base16_decoder_init(&decoder);
+
+  for (uint64 i = 0; i < length; i += piece) {
+    uint64        size  = i + piece < length ? piece : length - i;
+    unsigned long count = base16_decoder_update(&decoder, output + used, text + i, size);
+
+    if (count == BASE16_INVALID)
+      return BASE16_INVALID;
+
+    used += count;
+  }
+
+  *complete = base16_decoder_final(&decoder);
+
+  return used;
+}
+
+/* The incremental decoders give the same bytes however the text is cut into pieces: quanta, pairs, CRLF and comment
+ * lines may all be split across a piece boundary.
+ */
+static void TestDecoder(void)
+{
+  uint64 text64Length, text16Length, cipherLength;
+  uint8* text64  = TestLoad("stream.64", &text64Length);
+  uint8* text16  = TestLoad("stream.16", &text16Length);
+  uint8* cipher  = TestLoad("stream.256", &cipherLength);
+  char*  text    = (char*) malloc(2 * text16Length);
+  uint8* decoded = (uint8*) malloc(cipherLength + 64);
+  int    complete;
+
+  uint64 length = TestAnnotate(text, text64, text64Length);
+
+  for (uint64 piece = 1; piece <= 4096; piece = piece < 100 ? piece + 1 : piece * 4) {
+    complete = 0;
+
+    TEST_CHECK(TestDecodeBase64(decoded, text, length, piece, &complete) == cipherLength && complete);
+    TEST_CHECK(memcmp(decoded, cipher, cipherLength) == 0);
+  }
+
+  length = TestAnnotate(text, text16, text16Length);
+
+  for (uint64 piece = 1; piece <= 4096; piece = piece < 100 ? piece + 1 : piece * 4) {
+    complete = 0;
+
+    TEST_CHECK(TestDecodeBase16(decoded, text, length, piece, &complete) == cipherLength && complete);
+    TEST_CHECK(memcmp(decoded, cipher, cipherLength) == 0);
+  }
+
+  /* A stream cut inside a quantum or a pair decodes what it can, but is not complete. */
+  TEST_CHECK(TestDecodeBase64(decoded, "Zm9vY", 5, 2, &complete) == 3 && !complete);
+  TEST_CHECK(TestDecodeBase16(decoded, "666f6", 5, 2, &complete) == 2 && !complete);
+
+  /* Padding split from its quantum is still the end: data after it is an error, in the same piece or a later one. */
+  TEST_CHECK(TestDecodeBase64(decoded, "Zg==", 4, 3, &complete) == 1 && complete && decoded[0] == 'f');
+  TEST_CHECK(TestDecodeBase64(decoded, "Zg==Zm8=", 8, 4, &complete) == BASE64_INVALID);
+  TEST_CHECK(TestDecodeBase64(decoded, "Zg==Zm8=", 8, 8, &complete) == BASE64_INVALID);
+  TEST_CHECK(TestDecodeBase64(decoded, "Zg==\n# end\n", 11, 1, &complete) == 1 && complete);
+
+  free(decoded);
+  free(text);
+  free(cipher);
+  free(text16);
+  free(text64);
+}
+
+static const TestCase TestCases[] = {
+  {"base64",  TestBase64 },
+  {"base16",  TestBase16 },
+  {"decoder", TestDecoder},
+};
+
+int main(int argc, char* argv[])
+{
+  return TestMain(argc, argv, TestCases, sizeof(TestCases) / sizeof(TestCases[0]));
+}
@@ -0,0 +1,249 @@
+/* tests/test_lz.c
+ *
+ * ZIGMA, Copyright (C) 2024 Chase Zehl O'Byrne
+ *   <mail: zehl@live.com> http://zehlchen.com/
+ *
+ * This file is part of ZIGMA.
+ *
+ * ZIGMA is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ZIGMA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ZIGMA; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/* LZ block codec tests: `zigma_test_lz DATA_DIRECTORY [CASE]`. */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "common.h"
+
+#include "lz.h"
+#include "test.h"
+
+/* Decompress `length` bytes of `block` into a buffer of `capacity` and compare the result with `expected`. */
+static int TestExpand(const uint8* block, uint64 length, uint64 capacity, const uint8* expected, uint64 expectedLength)
+{
+  uint8* output   = (uint8*) malloc(capacity + 1);
+  uint64 produced = 0;
+  int    same     = LzDecompress(output, capacity, block, length, &produced) && produced == expectedLength &&
+               memcmp(output, expected, expectedLength) == 0;
+
+  free(output);
+
+  return same;
+}
+
+/* Hand-built blocks decode as the format describes, including extended counts and overlapping matches. */
+static void TestFormat(void)
+{
+  /* Literals only. */
+  const uint8 literals[] = {0x50, 'h', 'e', 'l', 'l', 'o'};
+
+  TEST_CHECK(TestExpand(literals, sizeof(literals), 5, (const uint8*) "hello", 5));
+
+  /* "ab", a match of 6 at offset 2, then "c". */
+  const uint8 match[] = {0x22, 'a', 'b', 0x02, 0x00, 0x10, 'c'};
+
+  TEST_CHECK(TestExpand(match, sizeof(match), 9, (const uint8*) "ababababc", 9));
+
+  /* A one-byte offset repeats a single byte; 15 + 255 + 10 + 4 = 284 bytes of match after the literal. */
+  uint8 run[1 + 284 + 1];
+
+  memset(run, 'x', sizeof(run));
+  run[285] = 'y';
+
+  const uint8 extended[] = {0x1F, 'x', 0x01, 0x00, 0xFF, 0x0A, 0x10, 'y'};
+
+  TEST_CHECK(TestExpand(extended, sizeof(extended), sizeof(run), run, sizeof(run)));
+
+  /* 15 + 0 literals: a count of exactly 15 still takes its continuation byte. */
+  uint8 fifteen[1 + 1 + 15];
+
+  fifteen[0] = 0xF0;
+  fifteen[1] = 0x00;
+  memset(fifteen + 2, 'z', 15);
+
+  TEST_CHECK(TestExpand(fifteen, sizeof(fifteen), 15, fifteen + 2, 15));
+
+  /* An empty block is a valid empty input. */
+  TEST_CHECK(TestExpand(literals, 0, 0, literals, 0));
+}
+
+/* Blocks of every shape survive a round trip, and repetitive ones shrink. */
+static void TestRoundTrip(void)
+{
+  uint64 plainLength;
+  uint8* plain      = TestLoad("plain.bin", &plainLength);
+  uint8* input      = (uint8*) malloc(ZQ_LZ_BLOCK_MAX);
+  uint8* compressed = (uint8*) malloc(2 * ZQ_LZ_BLOCK_MAX);
+  uint8* output     = (uint8*) malloc(ZQ_LZ_BLOCK_MAX);
+
+  /* Text, a single byte value (one long match), random bytes, and text repeated just inside the 16-bit window. */
+  for (uint32 shape = 0; shape < 4; shape++) {
+    uint64 length = ZQ_LZ_BLOCK_MAX;
+
+    if (shape == 0) {
+      length = plainLength;
+      memcpy(input, plain, length);
+    }
+    else if (shape == 1) {
+      memset(input, 0, length);
+    }
+    else if (shape == 2) {
+      TestFill(input, length, 1);
+    }
+    else {
+      TestFill(input, length, 2);
+      memcpy(input, plain, 4096);
+      memcpy(input + length - 4096, plain, 4096);
+    }
+
+    /* Every length short of the whole block too, around where matches are and are not allowed to start. */
+    uint64 cuts[] = {0, 1, 4, 12, 13, 17, 255, 4096 + 12, length};
+
+    for (uint32 i = 0; i < sizeof(cuts) / sizeof(cuts[0]); i++) {
+      uint64 cut     = cuts[i] < length ? cuts[i] : length;
+      uint64 packed  = LzCompress(compressed, 2 * ZQ_LZ_BLOCK_MAX, input, cut);
+      uint64 decoded = 0;
+
+      TEST_CHECK(packed > 0);
+      TEST_CHECK(LzDecompress(output, ZQ_LZ_BLOCK_MAX, compressed, packed, &decoded));
+      TEST_CHECK(decoded == cut && memcmp(output, input, cut) == 0);
+    }
+
+    uint64 packed = LzCompress(compressed, 2 * ZQ_LZ_BLOCK_MAX, input, length);
+
+    if (shape == 0)
+      TEST_CHECK(packed < length * 3 / 4);
+    else if (shape == 1)
+      TEST_CHECK(packed < 300);
+    else if (shape == 3)
+      TEST_CHECK(packed < length - 3000);
+  }
+
+  free(output);
+  free(compressed);
+  free(input);
+  free(plain);
+}
+
+/* The capacity bounds the output: a block that would not fit gives 0 rather than a partial result. */
+static void TestCapacity(void)
+{
+  uint64 plainLength;
+  uint8* plain      = TestLoad("plain.bin", &plainLength);
+  uint8* random     = (uint8*) malloc(ZQ_LZ_BLOCK_MAX);
+  uint8* compressed = (uint8*) malloc(2 * ZQ_LZ_BLOCK_MAX + 1);
+
+  TestFill(random, ZQ_LZ_BLOCK_MAX, 3);
+
+  TEST_CHECK(LzCompress(compressed, ZQ_LZ_BLOCK_MAX - 1, random, ZQ_LZ_BLOCK_MAX) == 0);
+
+  uint64 packed = LzCompress(compressed, 2 * ZQ_LZ_BLOCK_MAX, plain, plainLength);
+
+  /* Short of the compressed size it gives up. Room is checked for the worst case of each sequence, so a little over
+   * it may give up too, but a result is always complete and nothing is written past the capacity.
+   */
+  TEST_CHECK(LzCompress(compressed, packed - 1, plain, plainLength) == 0);
+
+  for (uint64 capacity = packed - 16; capacity <= packed + 64; capacity++) {
+    memset(compressed, 0xA5, 2 * ZQ_LZ_BLOCK_MAX + 1);
+
+    uint64 length = LzCompress(compressed, capacity, plain, plainLength);
+
+    TEST_CHECK(length == 0 || (length == packed && capacity >= packed));
+    TEST_CHECK(compressed[capacity] == 0xA5);
+  }
+
+  TEST_CHECK(LzCompress(compressed, packed + 64, plain, plainLength) == packed);
+
+  /* Decompressing needs room for all of it, too. */
+  uint64 produced;
+  uint8* output = (uint8*) malloc(plainLength);
+
+  TEST_CHECK(!LzDecompress(output, plainLength - 1, compressed, packed, &produced));
+  TEST_CHECK(LzDecompress(output, plainLength, compressed, packed, &produced) && produced == plainLength);
+
+  free(output);
+  free(compressed);
+  free(random);
+  free(plain);
+}
+
+/* Malformed blocks are refused rather than reading or writing out of bounds. */
+static void TestMalformed(void)
+{
+  uint8  output[64];
+  uint64 produced;
+
+  /* A match before anything has been written, an offset of 0, and an offset past the start of the output. */
+  const uint8 early[]  = {0x00, 0x01, 0x00, 0x10, 'a'};
+  const uint8 zero[]   = {0x10, 'a', 0x00, 0x00, 0x10, 'a'};
+  const uint8 behind[] = {0x10, 'a', 0x02, 0x00, 0x10, 'a'};
+
+  TEST_CHECK(!LzDecompress(output, sizeof(output), early, sizeof(early), &produced));
+  TEST_CHECK(!LzDecompress(output, sizeof(output), zero, sizeof(zero), &produced));
+  TEST_CHECK(!LzDecompress(output, sizeof(output), behind, sizeof(behind), &produced));
+
+  /* More literals than the block holds, a count cut off mid-way, and an offset cut off after the literals. */
+  const uint8 literals[] = {0x40, 'a', 'b', 'c'};
+  const uint8 count[]    = {0xF0, 0xFF};
+  const uint8 offset[]   = {0x10, 'a', 0x01};
+
+  TEST_CHECK(!LzDecompress(output, sizeof(output), literals, sizeof(literals), &produced));
+  TEST_CHECK(!LzDecompress(output, sizeof(output), count, sizeof(count), &produced));
+  TEST_CHECK(!LzDecompress(output, sizeof(output), offset, sizeof(offset), &produced));
+
+  /* A match longer than the room left. */
+  const uint8 overrun[] = {0x1F, 'a', 0x01, 0x00, 0x40, 0x10, 'b'};
+
+  TEST_CHECK(!LzDecompress(output, sizeof(output), overrun, sizeof(overrun), &produced));
+
+  /* Every byte of a real block, damaged in turn, either decodes within the capacity or is refused. */
+  uint64 plainLength;
+  uint8* plain      = TestLoad("plain.bin", &plainLength);
+  uint8* compressed = (uint8*) malloc(2 * ZQ_LZ_BLOCK_MAX);
+  uint8* expanded   = (uint8*) malloc(plainLength);
+  uint64 packed     = LzCompress(compressed, 2 * ZQ_LZ_BLOCK_MAX, plain, plainLength);
+
+  for (uint64 i = 0; i < packed; i++) {
+    compressed[i] ^= 0x5A;
+
+    if (LzDecompress(expanded, plainLength, compressed, packed, &produced))
+      TEST_CHECK(produced <= plainLength);
+
+    compressed[i] ^= 0x5A;
+  }
+
+  for (uint64 cut = 0; cut < packed; cut += 97) {
+    if (LzDecompress(expanded, plainLength, compressed, cut, &produced))
+      TEST_CHECK(produced < plainLength);
+  }
+
+  free(expanded);
+  free(compressed);
+  free(plain);
+}
+
+static const TestCase TestCases[] = {
+  {"format",    TestFormat   },
+  {"roundtrip", TestRoundTrip},
+  {"capacity",  TestCapacity },
+  {"malformed", TestMalformed},
+};
+
+int main(int argc, char* argv[])
+{
+  return TestMain(argc, argv, TestCases, sizeof(TestCases) / sizeof(TestCases[0]));
+}
@@ -0,0 +1,128 @@
+/*
+ * ZIGMA, Copyright (C) 2024 Chase Zehl O'Byrne
+ *   <mail: zehl@live.com> http://zehlchen.com/
+ *
+ * This file is part of ZIGMA.
+ *
+ * ZIGMA is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ZIGMA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ZIGMA; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/* Ring tests: `zigma_test_ring DATA_DIRECTORY [CASE]`.
+ */
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "common.h"
+
+#include "ring.h"
+#include "test.h"
+
+enum { TEST_ITEMS = 1000000 };
+
+static Ring* TestQueue = NULL;
+
+/* Push 1..TEST_ITEMS, pausing now and then so the consumer empties the ring and has to sleep. */
+static void* TestProducer(void* argument)
+{
+  struct timespec pause = {.tv_nsec = 100 * 1000};
+
+  for (uintptr_t i = 1; i <= TEST_ITEMS; i++) {
+    RingPush(TestQueue, (void*) i);
+
+    if (i % 100000 == 0)
+      nanosleep(&pause, NULL);
+  }
+
+  return NULL;
+}
+
+/* Items come out once each and in order, across wrap-arounds and with both sides sleeping at times. */
+static void TestOrder(void)
+{
+  pthread_t producer;
+  uint64    misplaced = 0;
+
+  TestQueue = RingCreate(NULL);
+  pthread_create(&producer, NULL, TestProducer, NULL);
+
+  struct timespec pause = {.tv_nsec = 100 * 1000};
+
+  for (uintptr_t i = 1; i <= TEST_ITEMS; i++) {
+    misplaced += RingPop(TestQueue) != (void*) i;
+
+    /* A slow consumer fills the ring, and the producer has to sleep instead. */
+    if (i % 100000 == 50000)
+      nanosleep(&pause, NULL);
+  }
+
+  pthread_join(producer, NULL);
+
+  TEST_CHECK(misplaced == 0);
+  TEST_CHECK(atomic_load(&TestQueue->head) == TEST_ITEMS && atomic_load(&TestQueue->tail) == TEST_ITEMS);
+
+  RingDestroy(TestQueue);
+}
+
+static _Atomic int TestPushed;
+
+static void* TestPushOne(void* argument)
+{
+  RingPush(TestQueue, argument);
+  atomic_store(&TestPushed, 1);
+
+  return NULL;
+}
+
+/* A full ring holds exactly ZQ_RING_CAPACITY items, and a push into it waits for a pop. */
+static void TestFull(void)
+{
+  pthread_t       producer;
+  struct timespec pause = {.tv_nsec = 50 * 1000 * 1000};
+
+  TestQueue = RingCreate(NULL);
+
+  for (uintptr_t i = 1; i <= ZQ_RING_CAPACITY; i++)
+    RingPush(TestQueue, (void*) i);
+
+  atomic_store(&TestPushed, 0);
+  pthread_create(&producer, NULL, TestPushOne, (void*) (uintptr_t) (ZQ_RING_CAPACITY + 1));
+
+  nanosleep(&pause, NULL);
+  TEST_CHECK(atomic_load(&TestPushed) == 0);
+
+  TEST_CHECK(RingPop(TestQueue) == (void*) 1);
+
+  pthread_join(producer, NULL);
+  TEST_CHECK(atomic_load(&TestPushed) == 1);
+
+  for (uintptr_t i = 2; i <= ZQ_RING_CAPACITY + 1; i++)
+    TEST_CHECK(RingPop(TestQueue) == (void*) i);
+
+  RingDestroy(TestQueue);
+}
+
+static const TestCase TestCases[] = {
+  {"order", TestOrder},
+  {"full",  TestFull },
+};
+
+int main(int argc, char* argv[])
+{
+  return TestMain(argc, argv, TestCases, sizeof(TestCases) / sizeof(TestCases[0]));
+}
@@ -0,0 +1,224 @@
+/*
+ * ZIGMA, Copyright (C) 2024 Chase Zehl O'Byrne
+ *   <mail: zehl@live.com> http://zehlchen.com/
+ *
+ * This file is part of ZIGMA.
+ *
+ * ZIGMA is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ZIGMA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ZIGMA; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/* Seekable file tests: `zigma_test_seekable DATA_DIRECTORY [CASE]`.
+ *
+ * seekable.zq is plain.bin encoded under key.bin with mode=seekable chunk.size=1024: eight frames, the last one
+ * short, and eight checkpoints.
+ */
+
+#include <stdint.h>
+
+#include "common.h"
+
+#include "libzigma.h"
+#include "seekable.h"
+#include "test.h"
+
+enum { TEST_INTERVAL = 1024 };
+
+/* Write `data` to a temporary file that goes away when it is closed. */
+static FILE* TestCopy(const uint8* data, uint64 length)
+{
+  FILE* copy = tmpfile();
+
+  fwrite(data, 1, length, copy);
+  fflush(copy);
+
+  return copy;
+}
+
+/* The frames hold exactly the stream ciphertext, cut at every interval, and the index and trailer describe them. */
+static void TestLayout(void)
+{
+  uint64 fileLength, cipherLength;
+  uint8* file   = TestLoad("seekable.zq", &fileLength);
+  uint8* cipher = TestLoad("stream.256", &cipherLength);
+  uint8* joined = (uint8*) malloc(fileLength);
+  uint64 offset = ZQ_SEEKABLE_HEADER_SIZE;
+  uint64 total  = 0;
+  uint64 frames = 0;
+
+  TEST_CHECK(memcmp(file, ZQ_SEEKABLE_MAGIC, 4) == 0);
+  TEST_CHECK(file[4] == ZQ_SEEKABLE_VERSION);
+  TEST_CHECK(UnpackUint32(file + 8) == TEST_INTERVAL);
+
+  for (uint32 length; offset + 4 <= fileLength && (length = UnpackUint32(file + offset)) != 0; frames++) {
+    /* Every frame but the last is a full interval. */
+    TEST_CHECK(length == TEST_INTERVAL || total + length == cipherLength);
+
+    memcpy(joined + total, file + offset + 4, length);
+
+    total += length;
+    offset += 4 + length;
+  }
+
+  offset += 4;
+
+  TEST_CHECK(frames == (cipherLength + TEST_INTERVAL - 1) / TEST_INTERVAL);
+  TEST_CHECK(total == cipherLength && memcmp(joined, cipher, cipherLength) == 0);
+
+  /* The index follows the terminating frame: one checkpoint per frame, then the trailer. */
+  const uint8* trailer = file + fileLength - ZQ_SEEKABLE_TRAILER_SIZE;
+
+  TEST_CHECK(UnpackUint64(file + offset) == frames);
+  TEST_CHECK(offset + 8 + frames * ZQ_SCHEDULE_SIZE + ZQ_SEEKABLE_TRAILER_SIZE == fileLength);
+  TEST_CHECK(UnpackUint64(trailer) == cipherLength);
+  TEST_CHECK(UnpackUint64(trailer + 8) == offset);
+  TEST_CHECK(memcmp(trailer + 16, ZQ_SEEKABLE_INDEX_MAGIC, 4) == 0);
+
+  /* The checkpoints are encrypted: no two are alike, and none is the plain export of a context. */
+  for (uint64 i = 1; i < frames; i++)
+    TEST_CHECK(memcmp(file + offset + 8, file + offset + 8 + i * ZQ_SCHEDULE_SIZE, ZQ_SCHEDULE_SIZE) != 0);
+
+  TEST_CHECK(memcmp(file + offset + 8, ZQ_SCHEDULE_MAGIC, 4) != 0);
+
+  free(joined);
+  free(cipher);
+  free(file);
+}
+
+/* Reads from anywhere, in any order, through the library. */
+static void TestRead(void)
+{
+  static const uint64 offsets[] = {0, 1, 1023, 1024, 1025, 5000, 3000, 3100, 7000, 0, 7896, 7897, 9000};
+
+  uint64 plainLength, keyLength, fileLength;
+  uint8* plain  = TestLoad("plain.bin", &plainLength);
+  uint8* key    = TestLoad("key.bin", &keyLength);
+  uint8* file   = TestLoad("seekable.zq", &fileLength);
+  uint8* output = (uint8*) malloc(plainLength + 1);
+  FILE*  copy   = TestCopy(file, fileLength);
+
+  ZigmaSeekable* seekable = ZigmaSeekableOpen(fileno(copy), key, keyLength);
+
+  TEST_CHECK(seekable != NULL);
+
+  if (seekable != NULL) {
+    TEST_CHECK(ZigmaSeekableLength(seekable) == plainLength);
+
+    /* Forward within a frame, across checkpoints, backward, and up to and past the end. */
+    for (uint64 i = 0; i < sizeof(offsets) / sizeof(offsets[0]); i++) {
+      uint64  offset   = offsets[i];
+      uint64  expected = offset < plainLength ? (plainLength - offset < 1500 ? plainLength - offset : 1500) : 0;
+      int64_t count    = ZigmaSeekableRead(seekable, offset, output, 1500);
+
+      TEST_CHECK(count == (int64_t) expected);
+      TEST_CHECK(memcmp(output, plain + (offset < plainLength ? offset : 0), expected) == 0);
+    }
+
+    /* Byte by byte, each read carrying on from the last. */
+    for (uint64 offset = 1000; offset < 1100; offset++)
+      TEST_CHECK(ZigmaSeekableRead(seekable, offset, output, 1) == 1 && output[0] == plain[offset]);
+
+    TEST_CHECK(ZigmaSeekableRead(seekable, 0, output, plainLength + 1) == (int64_t) plainLength);
+    TEST_CHECK(memcmp(output, plain, plainLength) == 0);
+
+    ZigmaSeekableClose(seekable);
+  }
+
+  fclose(copy);
+  free(output);
+  free(file);
+  free(key);
+  free(plain);
+}
+
+/* Opening checks the header, the trailer and the first checkpoint. A damaged frame only spoils reads that run
+ * through it: a read that starts from a later checkpoint is exact.
+ */
+static void TestDamage(void)
+{
+  uint64 plainLength, keyLength, fileLength, cipherLength;
+  uint8* plain  = TestLoad("plain.bin", &plainLength);
+  uint8* key    = TestLoad("key.bin", &keyLength);
+  uint8* file   = TestLoad("seekable.zq", &fileLength);
+  uint8* cipher = TestLoad("stream.256", &cipherLength);
+  uint8  output[TEST_INTERVAL];
+  uint64 index  = UnpackUint64(file + fileLength - ZQ_SEEKABLE_TRAILER_SIZE + 8);
+  FILE*  copy;
+
+  key[3] ^= 0x10;
+  copy = TestCopy(file, fileLength);
+  TEST_CHECK(ZigmaSeekableOpen(fileno(copy), key, keyLength) == NULL);
+  fclose(copy);
+  key[3] ^= 0x10;
+
+  copy = TestCopy(file, fileLength - 1);
+  TEST_CHECK(ZigmaSeekableOpen(fileno(copy), key, keyLength) == NULL);
+  fclose(copy);
+
+  copy = TestCopy(cipher, cipherLength);
+  TEST_CHECK(ZigmaSeekableOpen(fileno(copy), key, keyLength) == NULL);
+  fclose(copy);
+
+  /* The first checkpoint, which is decrypted on open. */
+  file[index + 8 + 5] ^= 1;
+  copy = TestCopy(file, fileLength);
+  TEST_CHECK(ZigmaSeekableOpen(fileno(copy), key, keyLength) == NULL);
+  fclose(copy);
+  file[index + 8 + 5] ^= 1;
+
+  /* A byte in the third frame. */
+  uint64 damaged = 2 * TEST_INTERVAL + 10;
+
+  file[ZQ_SEEKABLE_HEADER_SIZE + 3 * 4 + damaged] ^= 1;
+  copy = TestCopy(file, fileLength);
+
+  ZigmaSeekable* seekable = ZigmaSeekableOpen(fileno(copy), key, keyLength);
+
+  TEST_CHECK(seekable != NULL);
+
+  if (seekable != NULL) {
+    TEST_CHECK(ZigmaSeekableRead(seekable, 2 * TEST_INTERVAL, output, TEST_INTERVAL) == TEST_INTERVAL);
+    TEST_CHECK(memcmp(output, plain + 2 * TEST_INTERVAL, damaged - 2 * TEST_INTERVAL) == 0);
+    TEST_CHECK(memcmp(output, plain + 2 * TEST_INTERVAL, TEST_INTERVAL) != 0);
+
+    /* Last frame first, so no read carries on from the damaged one. */
+    for (uint64 frame = (plainLength - 1) / TEST_INTERVAL; frame >= 3; frame--) {
+      uint64 start  = frame * TEST_INTERVAL;
+      uint64 length = plainLength - start < TEST_INTERVAL ? plainLength - start : TEST_INTERVAL;
+
+      TEST_CHECK(ZigmaSeekableRead(seekable, start, output, length) == (int64_t) length);
+      TEST_CHECK(memcmp(output, plain + start, length) == 0);
+    }
+
+    ZigmaSeekableClose(seekable);
+  }
+
+  fclose(copy);
+  free(cipher);
+  free(file);
+  free(key);
+  free(plain);
+}
+
+static const TestCase TestCases[] = {
+  {"layout", TestLayout},
+  {"read",   TestRead  },
+  {"damage", TestDamage},
+};
+
+int main(int argc, char* argv[])
+{
+  return TestMain(argc, argv, TestCases, sizeof(TestCases) / sizeof(TestCases[0]));
+}
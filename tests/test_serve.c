@@ -0,0 +1,384 @@
+/*
+ * ZIGMA, Copyright (C) 2024 Chase Zehl O'Byrne
+ *   <mail: zehl@live.com> http://zehlchen.com/
+ *
+ * This file is part of ZIGMA.
+ *
+ * ZIGMA is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ZIGMA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ZIGMA; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/* `zigma serve` tests: `zigma_test_serve DATA_DIRECTORY [CASE]`.
+ *
+ * Each case starts the zigma binary (ZIGMA_TEST_CLI) as a server with key.bin as key 0, talks to it as a client
+ * would, and stops it with SIGTERM.
+ */
+
+#define _GNU_SOURCE /* memmem() */
+
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "common.h"
+
+#include "serve.h"
+#include "test.h"
+
+extern char** environ;
+
+typedef struct TestServer {
+  char  directory[64];
+  char  path[128];
+  pid_t process;
+} TestServer;
+
+static int TestConnect(const TestServer* server)
+{
+  struct sockaddr_un address = {.sun_family = AF_UNIX};
+
+  strcpy(address.sun_path, server->path);
+
+  int descriptor = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+  if (connect(descriptor, (struct sockaddr*) &address, sizeof(address)) < 0) {
+    close(descriptor);
+    return -1;
+  }
+
+  return descriptor;
+}
+
+/* Start a server and wait until it accepts connections. */
+static void TestServerStart(TestServer* server)
+{
+  char key[4096], socketOperand[160];
+
+  strcpy(server->directory, "/tmp/zigma_test_serve.XXXXXX");
+
+  if (mkdtemp(server->directory) == NULL) {
+    perror("mkdtemp");
+    exit(EXIT_FAILURE);
+  }
+
+  snprintf(server->path, sizeof(server->path), "%s/zigma.sock", server->directory);
+  snprintf(socketOperand, sizeof(socketOperand), "socket=%s", server->path);
+  snprintf(key, sizeof(key), "key=%s/key.bin", TestDirectory);
+
+  char* argv[] = {ZIGMA_TEST_CLI, "serve", socketOperand, key, "jobs=2", NULL};
+
+  posix_spawn_file_actions_t actions;
+
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_addopen(&actions, 2, "/dev/null", O_WRONLY, 0);
+
+  if (posix_spawn(&server->process, argv[0], &actions, NULL, argv, environ) != 0) {
+    perror("posix_spawn");
+    exit(EXIT_FAILURE);
+  }
+
+  posix_spawn_file_actions_destroy(&actions);
+
+  struct timespec pause = {.tv_nsec = 10 * 1000 * 1000};
+
+  for (int i = 0; i < 500; i++) {
+    int descriptor = TestConnect(server);
+
+    if (descriptor >= 0) {
+      close(descriptor);
+      return;
+    }
+
+    nanosleep(&pause, NULL);
+  }
+
+  fprintf(stderr, "ERROR: The server did not start!\n");
+  exit(EXIT_FAILURE);
+}
+
+/* Stop the server; it must exit cleanly and remove its socket. */
+static void TestServerStop(TestServer* server)
+{
+  int status = 0;
+
+  kill(server->process, SIGTERM);
+  waitpid(server->process, &status, 0);
+
+  TEST_CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  TEST_CHECK(access(server->path, F_OK) < 0);
+
+  rmdir(server->directory);
+}
+
+static void TestWrite(int descriptor, const void* data, uint64 length)
+{
+  for (uint64 done = 0; done < length;) {
+    ssize_t count = write(descriptor, (const uint8*) data + done, length - done);
+
+    if (count <= 0) {
+      perror("write");
+      exit(EXIT_FAILURE);
+    }
+
+    done += count;
+  }
+}
+
+/* Read exactly `length` bytes; returns 0 at end of stream. */
+static int TestRead(int descriptor, void* data, uint64 length)
+{
+  for (uint64 done = 0; done < length;) {
+    ssize_t count = read(descriptor, (uint8*) data + done, length - done);
+
+    if (count <= 0)
+      return 0;
+
+    done += count;
+  }
+
+  return 1;
+}
+
+static void TestRequest(int descriptor, uint8 operation, uint32 keyId, const void* payload, uint32 length)
+{
+  uint8 header[ZQ_SERVE_HEADER_SIZE] = {operation};
+
+  PackUint32(header + 4, keyId);
+  PackUint32(header + 8, length);
+
+  TestWrite(descriptor, header, sizeof(header));
+  TestWrite(descriptor, payload, length);
+}
+
+/* Read a response.
+ *   @return The payload, which the caller frees, or NULL if the server hung up.
+ */
+static uint8* TestResponse(int descriptor, uint8* status, uint64* length)
+{
+  uint8 header[ZQ_SERVE_RESPONSE_SIZE];
+
+  if (!TestRead(descriptor, header, sizeof(header)))
+    return NULL;
+
+  *status = header[0];
+  *length = UnpackUint32(header + 4);
+
+  uint8* payload = (uint8*) malloc(*length + 1);
+
+  if (!TestRead(descriptor, payload, *length)) {
+    free(payload);
+    return NULL;
+  }
+
+  return payload;
+}
+
+/* Expect a response with `status`, and if `expect` is not NULL, that payload. */
+static void TestExpect(int descriptor, uint8 status, const void* expect, uint64 expectLength)
+{
+  uint8  actualStatus = 0xff;
+  uint64 length       = 0;
+  uint8* payload      = TestResponse(descriptor, &actualStatus, &length);
+
+  TEST_CHECK(payload != NULL);
+  TEST_CHECK(actualStatus == status);
+
+  if (payload != NULL && expect != NULL)
+    TEST_CHECK(length == expectLength && memcmp(payload, expect, length) == 0);
+
+  free(payload);
+}
+
+/* Every operation against the baseline release's files, the error statuses, and pipelined requests answered in
+ * order.
+ */
+static void TestServe(void)
+{
+  uint64 plainLength, keyLength, cipherLength, checkLength;
+  uint8* plain  = TestLoad("plain.bin", &plainLength);
+  uint8* key    = TestLoad("key.bin", &keyLength);
+  uint8* cipher = TestLoad("stream.256", &cipherLength);
+  uint8* check  = TestLoad("check.16", &checkLength);
+  uint8  digest[ZIGMA_CHECKSUM_SIZE];
+
+  for (int i = 0; i < ZIGMA_CHECKSUM_SIZE; i++)
+    sscanf((const char*) check + 2 * i, "%2hhx", &digest[i]);
+
+  TestServer server;
+
+  TestServerStart(&server);
+
+  int descriptor = TestConnect(&server);
+
+  TestRequest(descriptor, 'E', 0, plain, plainLength);
+  TestExpect(descriptor, SERVE_OK, cipher, cipherLength);
+
+  TestRequest(descriptor, 'D', 0, cipher, cipherLength);
+  TestExpect(descriptor, SERVE_OK, plain, plainLength);
+
+  TestRequest(descriptor, 'H', 12345, plain, plainLength);
+  TestExpect(descriptor, SERVE_OK, digest, sizeof(digest));
+
+  /* A key loaded at run time gets the next id and ciphers as key 0 does; an empty message is still answered. */
+  uint8 id[4] = {1, 0, 0, 0};
+
+  TestRequest(descriptor, 'K', 0, key, keyLength);
+  TestExpect(descriptor, SERVE_OK, id, sizeof(id));
+
+  TestRequest(descriptor, 'E', 1, plain, plainLength);
+  TestExpect(descriptor, SERVE_OK, cipher, cipherLength);
+
+  TestRequest(descriptor, 'E', 1, NULL, 0);
+  TestExpect(descriptor, SERVE_OK, NULL, 0);
+
+  uint8 longKey[ZQ_MAX_KEY_SIZE + 1] = {0};
+
+  TestRequest(descriptor, 'X', 0, plain, 10);
+  TestExpect(descriptor, SERVE_ERROR_OPERATION, NULL, 0);
+  TestRequest(descriptor, 'D', 2, plain, 10);
+  TestExpect(descriptor, SERVE_ERROR_KEY, NULL, 0);
+  TestRequest(descriptor, 'K', 0, NULL, 0);
+  TestExpect(descriptor, SERVE_ERROR_LENGTH, NULL, 0);
+  TestRequest(descriptor, 'K', 0, longKey, sizeof(longKey));
+  TestExpect(descriptor, SERVE_ERROR_LENGTH, NULL, 0);
+
+  /* Requests sent back to back on one connection (each message from the keyed context) come back in order, while
+   * a second connection is served alongside.
+   */
+  int other = TestConnect(&server);
+
+  for (uint64 i = 0; i < 40; i++)
+    TestRequest(descriptor, i % 2 ? 'D' : 'E', 0, i % 2 ? cipher : plain, plainLength - i * 100);
+
+  TestRequest(other, 'H', 0, plain, plainLength);
+  TestExpect(other, SERVE_OK, digest, sizeof(digest));
+
+  for (uint64 i = 0; i < 40; i++)
+    TestExpect(descriptor, SERVE_OK, i % 2 ? plain : cipher, plainLength - i * 100);
+
+  TestRequest(other, 'S', 0, NULL, 0);
+
+  uint8  status;
+  uint64 length;
+  uint8* text = TestResponse(other, &status, &length);
+
+  TEST_CHECK(text != NULL && status == SERVE_OK);
+  TEST_CHECK(text != NULL && length > 0 && memmem(text, length, "keys=2 connections=2", 20) != NULL);
+
+  free(text);
+  close(other);
+
+  /* A frame longer than ZQ_SERVE_MAX_MESSAGE cannot be skipped: it is refused and the connection is closed. */
+  uint8 header[ZQ_SERVE_HEADER_SIZE] = {'E'};
+
+  PackUint32(header + 8, ZQ_SERVE_MAX_MESSAGE + 1);
+  TestWrite(descriptor, header, sizeof(header));
+  TestExpect(descriptor, SERVE_ERROR_LENGTH, NULL, 0);
+
+  TEST_CHECK(read(descriptor, header, 1) == 0);
+
+  close(descriptor);
+
+  TestServerStop(&server);
+
+  free(check);
+  free(cipher);
+  free(key);
+  free(plain);
+}
+
+/* A client that pipelines far more than it reads back does not make the server buffer it: the server only reads
+ * while it has no request running on the connection, so its peak memory stays near one message in flight.
+ */
+static void TestPipeline(void)
+{
+  enum { MESSAGE = 2 * 1024 * 1024, COUNT = 24 };
+
+  uint8* message = (uint8*) malloc(MESSAGE);
+
+  TestFill(message, MESSAGE, 7);
+
+  TestServer server;
+
+  TestServerStart(&server);
+
+  int descriptor = TestConnect(&server);
+
+  /* Send everything from a child process, so this one can keep reading the responses. */
+  pid_t writer = fork();
+
+  if (writer == 0) {
+    for (int i = 0; i < COUNT; i++)
+      TestRequest(descriptor, 'E', 0, message, MESSAGE);
+
+    _exit(EXIT_SUCCESS);
+  }
+
+  uint64 answered = 0;
+
+  for (int i = 0; i < COUNT; i++) {
+    uint8  status = 0xff;
+    uint64 length = 0;
+    uint8* cipher = TestResponse(descriptor, &status, &length);
+
+    answered += cipher != NULL && status == SERVE_OK && length == MESSAGE;
+
+    free(cipher);
+  }
+
+  waitpid(writer, NULL, 0);
+
+  TEST_CHECK(answered == COUNT);
+
+  /* The server's peak resident memory, from /proc, against the COUNT * MESSAGE (48MB) the client sent. */
+  char  path[64], line[256];
+  long  peak   = -1;
+  FILE* status = NULL;
+
+  snprintf(path, sizeof(path), "/proc/%d/status", (int) server.process);
+
+  if ((status = fopen(path, "r")) != NULL) {
+    while (fgets(line, sizeof(line), status) != NULL)
+      sscanf(line, "VmHWM: %ld kB", &peak);
+
+    fclose(status);
+  }
+
+  TEST_CHECK(peak > 0 && peak < 24 * 1024);
+
+  close(descriptor);
+
+  TestServerStop(&server);
+
+  free(message);
+}
+
+static const TestCase TestCases[] = {
+  {"serve",    TestServe   },
+  {"pipeline", TestPipeline},
+};
+
+int main(int argc, char* argv[])
+{
+  return TestMain(argc, argv, TestCases, sizeof(TestCases) / sizeof(TestCases[0]));
+}
@@ -0,0 +1,138 @@
+/*
+ * ZIGMA, Copyright (C) 2024 Chase Zehl O'Byrne
+ *   <mail: zehl@live.com> http://zehlchen.com/
+ *
+ * This file is part of ZIGMA.
+ *
+ * ZIGMA is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ZIGMA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ZIGMA; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/* libzigma session tests: `zigma_test_session DATA_DIRECTORY [CASE]`.
+ *
+ * Only libzigma.h is used, as a program linking -lzigma would; the expected results are the baseline release's
+ * files in tests/data.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libzigma.h"
+
+#include "test.h"
+
+/* Encode and decode against stream.256, in pieces and in place, and Clone/Reset as a per-record template. */
+static void TestSession(void)
+{
+  uint64 plainLength, keyLength, cipherLength;
+  uint8* plain  = TestLoad("plain.bin", &plainLength);
+  uint8* key    = TestLoad("key.bin", &keyLength);
+  uint8* cipher = TestLoad("stream.256", &cipherLength);
+  uint8* output = (uint8*) malloc(plainLength);
+
+  ZigmaSession* keyed  = ZigmaSessionCreate(ZIGMA_SESSION_ENCODE, key, keyLength);
+  ZigmaSession* record = ZigmaSessionClone(keyed);
+
+  for (uint64 i = 0, step = 1; i < plainLength; i += step, step = step * 5 % 977 + 1)
+    ZigmaSessionUpdate(record, output + i, plain + i, i + step < plainLength ? step : plainLength - i);
+
+  TEST_CHECK(memcmp(output, cipher, plainLength) == 0);
+
+  /* A clone taken mid-stream carries on from the same position. */
+  ZigmaSessionReset(record, keyed);
+  ZigmaSessionUpdate(record, output, plain, 1000);
+
+  ZigmaSession* clone = ZigmaSessionClone(record);
+
+  ZigmaSessionUpdate(record, output + 1000, plain + 1000, plainLength - 1000);
+  TEST_CHECK(memcmp(output, cipher, plainLength) == 0);
+
+  memset(output + 1000, 0, plainLength - 1000);
+  ZigmaSessionUpdate(clone, output + 1000, plain + 1000, plainLength - 1000);
+  TEST_CHECK(memcmp(output, cipher, plainLength) == 0);
+
+  ZigmaSessionDestroy(clone);
+
+  /* Decoding in place. */
+  ZigmaSession* decode = ZigmaSessionCreate(ZIGMA_SESSION_DECODE, key, keyLength);
+
+  memcpy(output, cipher, plainLength);
+  ZigmaSessionUpdate(decode, output, output, plainLength);
+  TEST_CHECK(memcmp(output, plain, plainLength) == 0);
+
+  /* The cipher modes need a key. */
+  TEST_CHECK(ZigmaSessionCreate(ZIGMA_SESSION_ENCODE, key, 0) == NULL);
+  TEST_CHECK(ZigmaSessionCreate(ZIGMA_SESSION_DECODE, NULL, 0) == NULL);
+
+  ZigmaSessionDestroy(decode);
+  ZigmaSessionDestroy(record);
+  ZigmaSessionDestroy(keyed);
+  ZigmaSessionDestroy(NULL);
+
+  free(output);
+  free(cipher);
+  free(key);
+  free(plain);
+}
+
+/* The digest of plain.bin, fed in pieces with no output, is the one in check.16. */
+static void TestHash(void)
+{
+  uint64 plainLength, checkLength;
+  uint8* plain = TestLoad("plain.bin", &plainLength);
+  uint8* check = TestLoad("check.16", &checkLength);
+  uint8  digest[ZIGMA_SESSION_DIGEST_SIZE];
+  char   text[2 * ZIGMA_SESSION_DIGEST_SIZE + 1];
+
+  ZigmaSession* session = ZigmaSessionCreate(ZIGMA_SESSION_HASH, NULL, 0);
+
+  for (uint64 i = 0, step = 1; i < plainLength; i += step, step = step * 7 % 1013 + 1)
+    ZigmaSessionUpdate(session, NULL, plain + i, i + step < plainLength ? step : plainLength - i);
+
+  TEST_CHECK(ZigmaSessionFinal(session, digest, sizeof(digest)) == 0);
+
+  for (uint64 i = 0; i < sizeof(digest); i++)
+    snprintf(text + 2 * i, 3, "%02x", digest[i]);
+
+  TEST_CHECK(checkLength > sizeof(text) && memcmp(check, text, sizeof(text) - 1) == 0);
+
+  /* Finished sessions and oversized digests are refused. */
+  TEST_CHECK(ZigmaSessionFinal(session, digest, sizeof(digest)) == -1);
+
+  ZigmaSession* fresh = ZigmaSessionCreate(ZIGMA_SESSION_HASH, NULL, 0);
+
+  ZigmaSessionReset(session, fresh);
+  TEST_CHECK(ZigmaSessionFinal(session, digest, ZIGMA_SESSION_DIGEST_SIZE + 1) == -1);
+  TEST_CHECK(ZigmaSessionFinal(session, digest, 4) == 0);
+
+  TEST_CHECK(strlen(ZigmaLibraryVersion()) > 0);
+
+  ZigmaSessionDestroy(fresh);
+  ZigmaSessionDestroy(session);
+
+  free(check);
+  free(plain);
+}
+
+static const TestCase TestCases[] = {
+  {"session", TestSession},
+  {"hash",    TestHash   },
+};
+
+int main(int argc, char* argv[])
+{
+  return TestMain(argc, argv, TestCases, sizeof(TestCases) / sizeof(TestCases[0]));
+}
@@ -0,0 +1,339 @@
+/*
+ * ZIGMA, Copyright (C) 2024 Chase Zehl O'Byrne
+ *   <mail: zehl@live.com> http://zehlchen.com/
+ *
+ * This file is part of ZIGMA.
+ *
+ * ZIGMA is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ZIGMA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ZIGMA; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef __linux__
+#define _GNU_SOURCE /* mremap() */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "common.h"
+
+#include "allocator.h"
+
+/* Alignment of arena allocations. */
+#define ZQ_ARENA_ALIGNMENT 64
+
+static void* HeapAllocate(Allocator* allocator, uint64 size)
+{
+  return malloc(size);
+}
+
+static void* HeapReallocate(Allocator* allocator, void* data, uint64 size, uint64 newSize)
+{
+  return realloc(data, newSize);
+}
+
+static void HeapRelease(Allocator* allocator, void* data, uint64 size)
+{
+  free(data);
+}
+
+Allocator AllocatorHeap = {HeapAllocate, HeapReallocate, HeapRelease, NULL};
+
+static void* SecureAllocate(Allocator* allocator, uint64 size)
+{
+  /* Zeroed, so nothing is locked or handed out uninitialized. */
+  void* data = calloc(1, size);
+
+  /* Best effort: RLIMIT_MEMLOCK may be too small, in which case the memory is merely wiped. */
+  if (data != NULL)
+    mlock(data, size);
+
+  return data;
+}
+
+static void SecureRelease(Allocator* allocator, void* data, uint64 size)
+{
+  if (data == NULL)
+    return;
+
+  Nullify(data, size);
+  munlock(data, size);
+  free(data);
+}
+
+static void* SecureReallocate(Allocator* allocator, void* data, uint64 size, uint64 newSize)
+{
+  /* Never let realloc() move the contents and leave an unwiped copy behind. */
+  void* moved = SecureAllocate(allocator, newSize);
+
+  if (moved == NULL)
+    return NULL;
+
+  memcpy(moved, data, size < newSize ? size : newSize);
+  SecureRelease(allocator, data, size);
+
+  return moved;
+}
+
+Allocator AllocatorSecure = {SecureAllocate, SecureReallocate, SecureRelease, NULL};
+
+#ifdef __linux__
+static uint64 HugePageRound(uint64 size)
+{
+  if (size == 0)
+    size = 1;
+
+  return (size + ZQ_HUGE_PAGE_SIZE - 1) & ~((uint64) ZQ_HUGE_PAGE_SIZE - 1);
+}
+
+static void* HugePageAllocate(Allocator* allocator, uint64 size)
+{
+  uint64 length = HugePageRound(size);
+  void*  data   = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+  if (data == MAP_FAILED)
+    return NULL;
+
+#ifdef MADV_HUGEPAGE
+  madvise(data, length, MADV_HUGEPAGE);
+#endif
+
+  return data;
+}
+
+static void* HugePageReallocate(Allocator* allocator, void* data, uint64 size, uint64 newSize)
+{
+  uint64 length    = HugePageRound(size);
+  uint64 newLength = HugePageRound(newSize);
+
+  if (length == newLength)
+    return data;
+
+  /* The kernel moves page table entries, not the data itself. */
+  void* moved = mremap(data, length, newLength, MREMAP_MAYMOVE);
+
+  if (moved == MAP_FAILED)
+    return NULL;
+
+#ifdef MADV_HUGEPAGE
+  madvise(moved, newLength, MADV_HUGEPAGE);
+#endif
+
+  return moved;
+}
+
+static void HugePageRelease(Allocator* allocator, void* data, uint64 size)
+{
+  if (data != NULL)
+    munmap(data, HugePageRound(size));
+}
+
+Allocator AllocatorHugePage = {HugePageAllocate, HugePageReallocate, HugePageRelease, NULL};
+#else
+Allocator AllocatorHugePage = {HeapAllocate, HeapReallocate, HeapRelease, NULL};
+#endif /* __linux__ */
+
+static void* MappingAllocate(Allocator* allocator, uint64 size)
+{
+  return NULL;
+}
+
+static void* MappingReallocate(Allocator* allocator, void* data, uint64 size, uint64 newSize)
+{
+  return NULL;
+}
+
+static void MappingRelease(Allocator* allocator, void* data, uint64 size)
+{
+  if (data == NULL)
+    return;
+
+  /* The mapping starts on the page boundary at or below `data`. */
+  uint64 page  = (uint64) sysconf(_SC_PAGESIZE);
+  uint64 delta = (uint64) (uintptr_t) data % page;
+
+  munmap((uint8*) data - delta, size + delta);
+}
+
+Allocator AllocatorMapping = {MappingAllocate, MappingReallocate, MappingRelease, NULL};
+
+/* A region that arena allocations are carved from. */
+typedef struct ArenaBlock {
+  struct ArenaBlock* next;
+
+  uint64 capacity;
+  uint64 used;
+
+  uint8* data;
+} ArenaBlock;
+
+typedef struct Arena {
+  /* The block currently being carved; older blocks follow. */
+  ArenaBlock* head;
+
+  /* Default size of a new block. */
+  uint64 blockSize;
+
+  /* The most recent allocation, which may grow or shrink in place. */
+  uint8* last;
+} Arena;
+
+static ArenaBlock* ArenaBlockCreate(uint64 capacity)
+{
+  ArenaBlock* block = (ArenaBlock*) malloc(sizeof(ArenaBlock));
+
+  DEBUG_ASSERT(block != NULL);
+
+  block->next     = NULL;
+  block->capacity = capacity;
+  block->used     = 0;
+  block->data     = (uint8*) AllocatorHugePage.allocate(&AllocatorHugePage, capacity);
+
+  if (block->data == NULL) {
+    free(block);
+    return NULL;
+  }
+
+  return block;
+}
+
+static void ArenaBlockDestroy(ArenaBlock* block)
+{
+  Nullify(block->data, block->used);
+  AllocatorHugePage.release(&AllocatorHugePage, block->data, block->capacity);
+  free(block);
+}
+
+static void* ArenaAllocate(Allocator* allocator, uint64 size)
+{
+  Arena* arena  = (Arena*) allocator->state;
+  uint64 offset = 0;
+
+  if (arena->head != NULL)
+    offset = (arena->head->used + ZQ_ARENA_ALIGNMENT - 1) & ~((uint64) ZQ_ARENA_ALIGNMENT - 1);
+
+  if (arena->head == NULL || offset + size > arena->head->capacity) {
+    ArenaBlock* block = ArenaBlockCreate(size > arena->blockSize ? size : arena->blockSize);
+
+    if (block == NULL)
+      return NULL;
+
+    block->next = arena->head;
+    arena->head = block;
+    offset      = 0;
+  }
+
+  arena->head->used = offset + size;
+  arena->last       = arena->head->data + offset;
+
+  return arena->last;
+}
+
+static void* ArenaReallocate(Allocator* allocator, void* data, uint64 size, uint64 newSize)
+{
+  Arena* arena = (Arena*) allocator->state;
+
+  /* The latest allocation can simply be extended. */
+  if (data != NULL && data == arena->last) {
+    uint64 offset = arena->last - arena->head->data;
+
+    if (offset + newSize <= arena->head->capacity) {
+      arena->head->used = offset + newSize;
+      return data;
+    }
+  }
+
+  void* moved = ArenaAllocate(allocator, newSize);
+
+  if (moved != NULL && data != NULL)
+    memcpy(moved, data, size < newSize ? size : newSize);
+
+  return moved;
+}
+
+static void ArenaRelease(Allocator* allocator, void* data, uint64 size)
+{
+  Arena* arena = (Arena*) allocator->state;
+
+  /* Only the latest allocation can be given back; everything else waits for a reset. */
+  if (data != NULL && data == arena->last) {
+    arena->head->used = arena->last - arena->head->data;
+    arena->last       = NULL;
+  }
+}
+
+Allocator* AllocatorArenaCreate(uint64 blockSize)
+{
+  Allocator* allocator = (Allocator*) malloc(sizeof(Allocator));
+  Arena*     arena     = (Arena*) malloc(sizeof(Arena));
+
+  DEBUG_ASSERT(allocator != NULL);
+  DEBUG_ASSERT(arena != NULL);
+
+  arena->head      = NULL;
+  arena->blockSize = blockSize != 0 ? blockSize : ZQ_ARENA_BLOCK_SIZE;
+  arena->last      = NULL;
+
+  allocator->allocate   = ArenaAllocate;
+  allocator->reallocate = ArenaReallocate;
+  allocator->release    = ArenaRelease;
+  allocator->state      = arena;
+
+  return allocator;
+}
+
+void AllocatorArenaReset(Allocator* allocator)
+{
+  DEBUG_ASSERT(allocator != NULL);
+
+  Arena* arena = (Arena*) allocator->state;
+
+  if (arena->head == NULL)
+    return;
+
+  /* New blocks are pushed at the head, so the first block is the one at the end of the list. */
+  while (arena->head->next != NULL) {
+    ArenaBlock* block = arena->head;
+
+    arena->head = block->next;
+    ArenaBlockDestroy(block);
+  }
+
+  Nullify(arena->head->data, arena->head->used);
+
+  arena->head->used = 0;
+  arena->last       = NULL;
+}
+
+void AllocatorArenaDestroy(Allocator* allocator)
+{
+  if (allocator == NULL)
+    return;
+
+  Arena* arena = (Arena*) allocator->state;
+
+  while (arena->head != NULL) {
+    ArenaBlock* block = arena->head;
+
+    arena->head = block->next;
+    ArenaBlockDestroy(block);
+  }
+
+  free(arena);
+  free(allocator);
+}
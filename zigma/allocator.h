@@ -0,0 +1,89 @@
+/*
+ * ZIGMA, Copyright (C) 2024 Chase Zehl O'Byrne
+ *   <mail: zehl@live.com> http://zehlchen.com/
+ *
+ * This file is part of ZIGMA.
+ *
+ * ZIGMA is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ZIGMA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ZIGMA; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#pragma once
+#ifndef _ZIGMATIQ_ALLOCATOR_H_
+#define _ZIGMATIQ_ALLOCATOR_H_
+
+#include "common.h"
+
+/* Size of the region reserved by a new arena block. */
+#ifndef ZQ_ARENA_BLOCK_SIZE
+#define ZQ_ARENA_BLOCK_SIZE (16 * 1024 * 1024) /* 16MB */
+#endif
+
+/* Huge page size used to round mappings. */
+#define ZQ_HUGE_PAGE_SIZE (2 * 1024 * 1024) /* 2MB */
+
+/* Memory source for buffers. Every callback receives the size the memory was obtained with, so allocators do not
+ * need to track it themselves.
+ */
+typedef struct Allocator {
+  /* Return at least `size` bytes, or NULL. */
+  void* (*allocate)(struct Allocator* allocator, uint64 size);
+
+  /* Grow or shrink `data` from `size` to `newSize` bytes, preserving the contents, or return NULL. */
+  void* (*reallocate)(struct Allocator* allocator, void* data, uint64 size, uint64 newSize);
+
+  /* Return `data` (obtained with `size` bytes) to the allocator. */
+  void (*release)(struct Allocator* allocator, void* data, uint64 size);
+
+  /* Allocator-specific state. */
+  void* state;
+} Allocator;
+
+/* Plain malloc()/realloc()/free(). */
+extern Allocator AllocatorHeap;
+
+/* Locks memory out of swap where permitted and wipes every block before it is released or moved. Intended for
+ * key material.
+ */
+extern Allocator AllocatorSecure;
+
+/* Anonymous mappings rounded to huge pages. Growth remaps the pages instead of copying them, so large buffers
+ * can double repeatedly at no copy cost. Falls back to the heap on platforms without mremap().
+ */
+extern Allocator AllocatorHugePage;
+
+/* Read-only file mappings made by `BufferMap()`. Mappings cannot be allocated or grown here; releasing one
+ * unmaps it.
+ */
+extern Allocator AllocatorMapping;
+
+/* Create a bump allocator. Allocations are carved out of large blocks and only returned all at once by
+ * `AllocatorArenaReset()` or `AllocatorArenaDestroy()`. The most recent allocation can grow in place.
+ *   @param blockSize The size of each block, or 0 for ZQ_ARENA_BLOCK_SIZE.
+ *   @return The arena allocator.
+ */
+Allocator* AllocatorArenaCreate(uint64 blockSize);
+
+/* Discard every allocation made from an arena, keeping its first block for reuse.
+ *   @param allocator The arena allocator.
+ */
+void AllocatorArenaReset(Allocator* allocator);
+
+/* Wipe and release an arena and all of its blocks.
+ *   @param allocator The arena allocator.
+ */
+void AllocatorArenaDestroy(Allocator* allocator);
+
+#endif /* _ZIGMATIQ_ALLOCATOR_H_ */
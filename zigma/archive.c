@@ -0,0 +1,659 @@
+/*
+ * ZIGMA, Copyright (C) 2024 Chase Zehl O'Byrne
+ *   <mail: zehl@live.com> http://zehlchen.com/
+ *
+ * This file is part of ZIGMA.
+ *
+ * ZIGMA is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ZIGMA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ZIGMA; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "common.h"
+
+#include "archive.h"
+#include "buffer.h"
+#include "check.h"
+#include "stream.h"
+#include "zigma.h"
+
+/* A member whose size differs from what stat() reported when the archive was laid out. */
+#define ARCHIVE_CHANGED -1
+
+/* A unit of work for the pool: one member to encode. */
+typedef struct ArchiveTask {
+  const ZigmaContext* master;
+
+  /* The archive being written. */
+  int descriptor;
+
+  /* The file to read, and its entry in the index. */
+  const char*    path;
+  ArchiveMember* member;
+  uint64         number;
+
+  /* errno, or ARCHIVE_CHANGED, if the member could not be archived; otherwise 0. */
+  int error;
+} ArchiveTask;
+
+static void ArchiveCorrupt(const char* reason)
+{
+  fprintf(stderr, "ERROR: Corrupt archive: %s!\n", reason);
+  exit(EXIT_FAILURE);
+}
+
+/* Write all of `length` bytes at `offset`.
+ *   @return 0, or errno on failure.
+ */
+static int ArchivePwrite(int descriptor, const uint8* data, uint64 length, uint64 offset)
+{
+  while (length > 0) {
+    ssize_t count = pwrite(descriptor, data, length, (off_t) offset);
+
+    if (count < 0 && errno == EINTR)
+      continue;
+
+    if (count < 0)
+      return errno;
+
+    data += count;
+    length -= count;
+    offset += count;
+  }
+
+  return 0;
+}
+
+/* Read exactly `length` bytes at `offset` of the archive. */
+static void ArchivePread(Archive* archive, uint8* data, uint64 length, uint64 offset)
+{
+  while (length > 0) {
+    ssize_t count = pread(archive->descriptor, data, length, (off_t) offset);
+
+    if (count < 0 && errno == EINTR)
+      continue;
+
+    if (count < 0) {
+      fprintf(stderr, "ERROR: pread(): %s!\n", strerror(errno));
+      exit(EXIT_FAILURE);
+    }
+
+    if (count == 0)
+      ArchiveCorrupt("truncated file");
+
+    data += count;
+    length -= count;
+    offset += count;
+  }
+}
+
+/* Encode one member into its place in the archive; runs on a pool worker. */
+static void ArchiveEncodeMember(void* argument)
+{
+  ArchiveTask*   task   = (ArchiveTask*) argument;
+  ArchiveMember* member = task->member;
+  int            file   = open(task->path, O_RDONLY | O_NOFOLLOW);
+
+  if (file < 0) {
+    task->error = errno;
+    return;
+  }
+
+  ZigmaContext context, hash;
+  uint8*       block = (uint8*) malloc(ZQ_ARCHIVE_BLOCK_SIZE);
+  uint64       done  = 0;
+
+  DEBUG_ASSERT(block != NULL);
+
+  ZigmaDerive(&context, task->master, ZQ_ARCHIVE_DOMAIN | (task->number + 1));
+  ZigmaHashInit(&hash);
+
+  while (done < member->length && task->error == 0) {
+    uint64  wanted = member->length - done < ZQ_ARCHIVE_BLOCK_SIZE ? member->length - done : ZQ_ARCHIVE_BLOCK_SIZE;
+    ssize_t count  = read(file, block, wanted);
+
+    if (count < 0 && errno == EINTR)
+      continue;
+
+    if (count <= 0) {
+      task->error = count < 0 ? errno : ARCHIVE_CHANGED;
+      break;
+    }
+
+    ZigmaHashUpdate(&hash, block, count);
+    ZigmaEncodeBlock(&context, block, block, count);
+
+    task->error = ArchivePwrite(task->descriptor, block, count, member->offset + done);
+    done += count;
+  }
+
+  /* A file that grew would not fit its place. */
+  if (task->error == 0 && read(file, block, 1) > 0)
+    task->error = ARCHIVE_CHANGED;
+
+  ZigmaHashFinal(&hash, member->digest, ZIGMA_CHECKSUM_SIZE);
+
+  Nullify(block, ZQ_ARCHIVE_BLOCK_SIZE);
+  free(block);
+
+  Nullify(&context, sizeof(ZigmaContext));
+
+  close(file);
+}
+
+uint64 ArchiveCreate(const ZigmaContext* master, const char* root, FILE* stream, Pool* pool, uint64* count)
+{
+  DEBUG_ASSERT(master != NULL);
+  DEBUG_ASSERT(root != NULL);
+  DEBUG_ASSERT(stream != NULL);
+  DEBUG_ASSERT(pool != NULL);
+
+  struct stat info, self;
+  int         descriptor = fileno(stream);
+
+  if (fstat(descriptor, &self) != 0 || !S_ISREG(self.st_mode)) {
+    fprintf(stderr, "ERROR: An archive must be written to a regular file!\n");
+    exit(EXIT_FAILURE);
+  }
+
+  /* The directory walk is the one `check` uses, so both see the same files in the same order. */
+  CheckList* list = CheckListCreate(NULL, 256);
+
+  CheckListAdd(list, root);
+
+  /* Names are taken relative to the directory, or are the file's own name when a single file is archived. */
+  uint64 prefix = 0;
+
+  if (stat(root, &info) == 0 && S_ISDIR(info.st_mode)) {
+    prefix = strlen(root);
+
+    while (prefix > 1 && root[prefix - 1] == '/')
+      prefix--;
+
+    prefix++;
+  }
+  else if (strrchr(root, '/') != NULL) {
+    prefix = strrchr(root, '/') - root + 1;
+  }
+
+  ArchiveMember* members = (ArchiveMember*) calloc(list->count + 1, sizeof(ArchiveMember));
+  ArchiveTask*   tasks   = (ArchiveTask*) calloc(list->count + 1, sizeof(ArchiveTask));
+  uint64         number  = 0;
+  uint64         offset  = ZQ_ARCHIVE_HEADER_SIZE;
+  uint64         total   = 0;
+
+  DEBUG_ASSERT(members != NULL && tasks != NULL);
+
+  /* Every member's place is fixed from its size up front, so the workers can write in any order. */
+  for (uint64 i = 0; i < list->count; i++) {
+    const char* path = list->entries[i].path;
+
+    int error = list->entries[i].error != 0 ? list->entries[i].error : lstat(path, &info) != 0 ? errno : 0;
+
+    /* The walk follows links to files, but an archive records none: extracting one would write to its target. */
+    if (error != 0 || !S_ISREG(info.st_mode)) {
+      fprintf(stderr, "ERROR: Unable to archive '%s': %s!\n", path,
+              error != 0              ? strerror(error)
+              : S_ISLNK(info.st_mode) ? "symbolic links are not archived"
+                                      : "not a regular file");
+      exit(EXIT_FAILURE);
+    }
+
+    /* The archive itself, when it is written inside the directory. */
+    if (info.st_dev == self.st_dev && info.st_ino == self.st_ino)
+      continue;
+
+    ArchiveMember* member = &members[number];
+    ArchiveTask*   task   = &tasks[number];
+
+    member->name   = strdup(path + prefix);
+    member->offset = offset;
+    member->length = (uint64) info.st_size;
+    member->mode   = (uint32) (info.st_mode & 07777);
+    member->mtime  = (int64) info.st_mtime;
+
+    if (strlen(member->name) > ZQ_ARCHIVE_MAX_NAME) {
+      fprintf(stderr, "ERROR: Unable to archive '%s': name too long!\n", path);
+      exit(EXIT_FAILURE);
+    }
+
+    task->master     = master;
+    task->descriptor = descriptor;
+    task->path       = path;
+    task->member     = member;
+    task->number     = number++;
+
+    offset += member->length;
+    total += member->length;
+  }
+
+  uint8 header[ZQ_ARCHIVE_HEADER_SIZE] = {0};
+  int   error;
+
+  memcpy(header, ZQ_ARCHIVE_MAGIC, 4);
+  header[4] = ZQ_ARCHIVE_VERSION;
+
+  if ((error = ArchivePwrite(descriptor, header, sizeof(header), 0)) != 0) {
+    fprintf(stderr, "ERROR: pwrite(): %s!\n", strerror(error));
+    exit(EXIT_FAILURE);
+  }
+
+  for (uint64 i = 0; i < number; i++)
+    PoolSubmit(pool, ArchiveEncodeMember, &tasks[i]);
+
+  PoolWait(pool);
+
+  for (uint64 i = 0; i < number; i++) {
+    if (tasks[i].error != 0) {
+      fprintf(stderr, "ERROR: Unable to archive '%s': %s!\n", tasks[i].path,
+              tasks[i].error == ARCHIVE_CHANGED ? "file changed while being archived" : strerror(tasks[i].error));
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  /* The index, with a digest of its own so a wrong key shows when it is opened. */
+  Buffer*      index = BufferCreate(NULL, 0);
+  ZigmaContext context;
+
+  BufferResize(index, 8);
+  PackUint64(index->data, number);
+
+  for (uint64 i = 0; i < number; i++) {
+    uint32 length = (uint32) strlen(members[i].name);
+    uint64 at     = index->length;
+
+    BufferResize(index, at + ZQ_ARCHIVE_ENTRY_SIZE + length);
+
+    uint8* entry = index->data + at;
+
+    PackUint64(entry, members[i].offset);
+    PackUint64(entry + 8, members[i].length);
+    PackUint32(entry + 16, members[i].mode);
+    PackUint64(entry + 20, (uint64) members[i].mtime);
+    memcpy(entry + 28, members[i].digest, ZIGMA_CHECKSUM_SIZE);
+    PackUint32(entry + 28 + ZIGMA_CHECKSUM_SIZE, length);
+    memcpy(entry + ZQ_ARCHIVE_ENTRY_SIZE, members[i].name, length);
+  }
+
+  uint64 entries = index->length;
+
+  BufferResize(index, entries + ZIGMA_CHECKSUM_SIZE);
+
+  ZigmaHashInit(&context);
+  ZigmaHashUpdate(&context, index->data, entries);
+  ZigmaHashFinal(&context, index->data + entries, ZIGMA_CHECKSUM_SIZE);
+
+  ZigmaDerive(&context, master, ZQ_ARCHIVE_DOMAIN);
+  ZigmaEncodeBlock(&context, index->data, index->data, index->length);
+
+  uint8 trailer[ZQ_ARCHIVE_TRAILER_SIZE];
+
+  PackUint64(trailer, offset);
+  PackUint64(trailer + 8, index->length);
+  memcpy(trailer + 16, ZQ_ARCHIVE_INDEX_MAGIC, 4);
+
+  if ((error = ArchivePwrite(descriptor, index->data, index->length, offset)) != 0 ||
+      (error = ArchivePwrite(descriptor, trailer, sizeof(trailer), offset + index->length)) != 0) {
+    fprintf(stderr, "ERROR: pwrite(): %s!\n", strerror(error));
+    exit(EXIT_FAILURE);
+  }
+
+  *count = number;
+
+  for (uint64 i = 0; i < number; i++)
+    free(members[i].name);
+
+  free(members);
+  free(tasks);
+
+  BufferDestroy(index);
+  CheckListDestroy(list);
+
+  Nullify(&context, sizeof(ZigmaContext));
+
+  return total;
+}
+
+Archive* ArchiveOpen(Archive* archive, FILE* stream, const ZigmaContext* master)
+{
+  DEBUG_ASSERT(stream != NULL);
+  DEBUG_ASSERT(master != NULL);
+
+  if (archive == NULL)
+    archive = (Archive*) malloc(sizeof(Archive));
+
+  DEBUG_ASSERT(archive != NULL);
+
+  struct stat info;
+  uint8       header[ZQ_ARCHIVE_HEADER_SIZE];
+  uint8       trailer[ZQ_ARCHIVE_TRAILER_SIZE];
+  uint8       digest[ZIGMA_CHECKSUM_SIZE];
+
+  archive->descriptor = fileno(stream);
+  archive->master     = master;
+  archive->members    = NULL;
+  archive->count      = 0;
+
+  if (fstat(archive->descriptor, &info) != 0 || !S_ISREG(info.st_mode)) {
+    fprintf(stderr, "ERROR: An archive must be read from a regular file!\n");
+    exit(EXIT_FAILURE);
+  }
+
+  uint64 size = (uint64) info.st_size;
+
+  if (size < ZQ_ARCHIVE_HEADER_SIZE + 8 + ZIGMA_CHECKSUM_SIZE + ZQ_ARCHIVE_TRAILER_SIZE)
+    ArchiveCorrupt("too short");
+
+  ArchivePread(archive, header, sizeof(header), 0);
+  ArchivePread(archive, trailer, sizeof(trailer), size - ZQ_ARCHIVE_TRAILER_SIZE);
+
+  if (memcmp(header, ZQ_ARCHIVE_MAGIC, 4) != 0 || memcmp(trailer + 16, ZQ_ARCHIVE_INDEX_MAGIC, 4) != 0)
+    ArchiveCorrupt("not an archive");
+
+  if (header[4] != ZQ_ARCHIVE_VERSION)
+    ArchiveCorrupt("unsupported version");
+
+  uint64 indexOffset = UnpackUint64(trailer);
+  uint64 indexLength = UnpackUint64(trailer + 8);
+
+  if (indexLength < 8 + ZIGMA_CHECKSUM_SIZE || indexLength > ZQ_ARCHIVE_MAX_INDEX ||
+      indexOffset < ZQ_ARCHIVE_HEADER_SIZE || indexOffset + indexLength != size - ZQ_ARCHIVE_TRAILER_SIZE)
+    ArchiveCorrupt("index out of bounds");
+
+  Buffer*      index = BufferCreate(NULL, indexLength);
+  ZigmaContext context;
+
+  index->length = indexLength;
+
+  ArchivePread(archive, index->data, indexLength, indexOffset);
+
+  ZigmaDerive(&context, master, ZQ_ARCHIVE_DOMAIN);
+  ZigmaDecodeBlock(&context, index->data, index->data, indexLength);
+
+  uint64 entries = indexLength - ZIGMA_CHECKSUM_SIZE;
+
+  ZigmaHashInit(&context);
+  ZigmaHashUpdate(&context, index->data, entries);
+  ZigmaHashFinal(&context, digest, ZIGMA_CHECKSUM_SIZE);
+
+  if (memcmp(digest, index->data + entries, ZIGMA_CHECKSUM_SIZE) != 0) {
+    fprintf(stderr, "ERROR: Unable to decrypt the archive index (wrong key or corrupt file)!\n");
+    exit(EXIT_FAILURE);
+  }
+
+  uint64 count = UnpackUint64(index->data);
+  uint64 at    = 8;
+
+  /* Every entry takes at least ZQ_ARCHIVE_ENTRY_SIZE bytes, which bounds the count before it is allocated. */
+  if (count > (entries - 8) / ZQ_ARCHIVE_ENTRY_SIZE)
+    ArchiveCorrupt("member count does not match the index");
+
+  archive->members = (ArchiveMember*) calloc(count + 1, sizeof(ArchiveMember));
+
+  DEBUG_ASSERT(archive->members != NULL);
+
+  for (uint64 i = 0; i < count; i++) {
+    ArchiveMember* member = &archive->members[i];
+    const uint8*   entry  = index->data + at;
+
+    if (entries - at < ZQ_ARCHIVE_ENTRY_SIZE)
+      ArchiveCorrupt("truncated index");
+
+    uint32 length = UnpackUint32(entry + 28 + ZIGMA_CHECKSUM_SIZE);
+
+    if (length == 0 || length > ZQ_ARCHIVE_MAX_NAME || entries - at - ZQ_ARCHIVE_ENTRY_SIZE < length)
+      ArchiveCorrupt("invalid member name");
+
+    member->offset = UnpackUint64(entry);
+    member->length = UnpackUint64(entry + 8);
+    member->mode   = UnpackUint32(entry + 16);
+    member->mtime  = (int64) UnpackUint64(entry + 20);
+    member->name   = strndup((const char*) entry + ZQ_ARCHIVE_ENTRY_SIZE, length);
+
+    memcpy(member->digest, entry + 28, ZIGMA_CHECKSUM_SIZE);
+
+    if (member->offset < ZQ_ARCHIVE_HEADER_SIZE || member->offset > indexOffset ||
+        member->length > indexOffset - member->offset)
+      ArchiveCorrupt("member out of bounds");
+
+    archive->count++;
+    at += ZQ_ARCHIVE_ENTRY_SIZE + length;
+  }
+
+  if (at != entries)
+    ArchiveCorrupt("member count does not match the index");
+
+  BufferDestroy(index);
+
+  Nullify(&context, sizeof(ZigmaContext));
+
+  return archive;
+}
+
+ArchiveMember* ArchiveFind(Archive* archive, const char* name)
+{
+  DEBUG_ASSERT(archive != NULL);
+  DEBUG_ASSERT(name != NULL);
+
+  for (uint64 i = 0; i < archive->count; i++) {
+    if (strcmp(archive->members[i].name, name) == 0)
+      return &archive->members[i];
+  }
+
+  return NULL;
+}
+
+void ArchiveList(Archive* archive, const ArchiveMember* member, FILE* stream)
+{
+  DEBUG_ASSERT(archive != NULL);
+  DEBUG_ASSERT(stream != NULL);
+
+  for (uint64 i = 0; i < archive->count; i++) {
+    if (member == NULL || member == &archive->members[i])
+      fprintf(stream, "%" PRIu64 "  %s\n", archive->members[i].length, archive->members[i].name);
+  }
+}
+
+/* Decode one member to a writer.
+ *   @return 1 if the plaintext matches the digest in the index, otherwise 0.
+ */
+static int ArchiveDecodeMember(Archive* archive, const ArchiveMember* member, StreamWriter* writer)
+{
+  ZigmaContext context, hash;
+  uint8        digest[ZIGMA_CHECKSUM_SIZE];
+  Buffer*      block = BufferCreate(NULL, ZQ_ARCHIVE_BLOCK_SIZE);
+
+  ZigmaDerive(&context, archive->master, ZQ_ARCHIVE_DOMAIN | ((uint64) (member - archive->members) + 1));
+  ZigmaHashInit(&hash);
+
+  for (uint64 done = 0; done < member->length; done += block->length) {
+    block->length = member->length - done < ZQ_ARCHIVE_BLOCK_SIZE ? member->length - done : ZQ_ARCHIVE_BLOCK_SIZE;
+
+    ArchivePread(archive, block->data, block->length, member->offset + done);
+
+    uint64 start = StatsStart(writer->stats);
+
+    ZigmaDecodeBlock(&context, block->data, block->data, block->length);
+
+    StatsAdd(writer->stats, STATS_CIPHER, start, block->length);
+
+    ZigmaHashUpdate(&hash, block->data, block->length);
+    StreamWriterWrite(writer, block->data, block->length);
+  }
+
+  ZigmaHashFinal(&hash, digest, ZIGMA_CHECKSUM_SIZE);
+
+  /* BufferDestroy() only wipes `length` bytes; the block held plaintext. */
+  block->length = block->capacity;
+  BufferDestroy(block);
+
+  Nullify(&context, sizeof(ZigmaContext));
+
+  return memcmp(digest, member->digest, ZIGMA_CHECKSUM_SIZE) == 0;
+}
+
+static void ArchiveMismatch(const ArchiveMember* member)
+{
+  fprintf(stderr, "ERROR: Member '%s' does not match its digest (corrupt archive)!\n", member->name);
+  exit(EXIT_FAILURE);
+}
+
+uint64 ArchiveExtract(Archive* archive, const ArchiveMember* member, StreamWriter* writer)
+{
+  DEBUG_ASSERT(archive != NULL);
+  DEBUG_ASSERT(member != NULL);
+  DEBUG_ASSERT(writer != NULL);
+
+  if (!ArchiveDecodeMember(archive, member, writer)) {
+    SinkDiscard(writer->sink);
+    ArchiveMismatch(member);
+  }
+
+  return member->length;
+}
+
+/* Whether a member name stays below the directory it is extracted to. */
+static int ArchiveSafeName(const char* name)
+{
+  if (*name == '/')
+    return 0;
+
+  for (const char* part = name; part != NULL; part = strchr(part, '/') != NULL ? strchr(part, '/') + 1 : NULL) {
+    uint64 length = strchr(part, '/') != NULL ? (uint64) (strchr(part, '/') - part) : strlen(part);
+
+    if (length == 0 || (length == 1 && part[0] == '.') || (length == 2 && part[0] == '.' && part[1] == '.'))
+      return 0;
+  }
+
+  return 1;
+}
+
+uint64 ArchiveExtractAll(Archive* archive, const char* directory)
+{
+  DEBUG_ASSERT(archive != NULL);
+  DEBUG_ASSERT(directory != NULL);
+
+  uint64 total = 0;
+
+  if (mkdir(directory, 0777) != 0 && errno != EEXIST) {
+    fprintf(stderr, "ERROR: mkdir(): unable to create '%s': %s!\n", directory, strerror(errno));
+    exit(EXIT_FAILURE);
+  }
+
+  for (uint64 i = 0; i < archive->count; i++) {
+    ArchiveMember* member = &archive->members[i];
+
+    if (!ArchiveSafeName(member->name)) {
+      fprintf(stderr, "ERROR: Refusing to extract '%s' outside of '%s'!\n", member->name, directory);
+      exit(EXIT_FAILURE);
+    }
+
+    char* path      = (char*) malloc(strlen(directory) + strlen(member->name) + 2);
+    char* temporary = (char*) malloc(strlen(directory) + strlen(member->name) + 32);
+
+    DEBUG_ASSERT(path != NULL && temporary != NULL);
+
+    sprintf(path, "%s/%s", directory, member->name);
+    sprintf(temporary, "%s.%ld.zqpart", path, (long) getpid());
+
+    /* Create the member's parent directories, one level at a time. A symbolic link already standing in for one
+     * would carry the plaintext outside of the directory.
+     */
+    for (char* slash = path + strlen(directory) + 1; (slash = strchr(slash, '/')) != NULL; slash++) {
+      struct stat info;
+
+      *slash = '\0';
+
+      if (mkdir(path, 0777) != 0 && errno != EEXIST) {
+        fprintf(stderr, "ERROR: mkdir(): unable to create '%s': %s!\n", path, strerror(errno));
+        exit(EXIT_FAILURE);
+      }
+
+      if (lstat(path, &info) != 0 || !S_ISDIR(info.st_mode)) {
+        fprintf(stderr, "ERROR: Refusing to extract '%s': '%s' is not a directory!\n", member->name, path);
+        exit(EXIT_FAILURE);
+      }
+
+      *slash = '/';
+    }
+
+    /* The plaintext goes to a new file that no link can redirect, and takes the member's name only once it has
+     * matched its digest. rename() replaces whatever had that name instead of writing through it.
+     */
+    int descriptor = open(temporary, O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW, 0600);
+
+    if (descriptor < 0) {
+      fprintf(stderr, "ERROR: open(): unable to create '%s': %s!\n", temporary, strerror(errno));
+      exit(EXIT_FAILURE);
+    }
+
+    FILE* file = fdopen(descriptor, "wb");
+
+    DEBUG_ASSERT(file != NULL);
+
+    StreamWriter* writer = StreamWriterCreate(NULL, file, 256, 0, SINK_NEWLINE_LF);
+    int           match  = ArchiveDecodeMember(archive, member, writer);
+
+    StreamWriterDestroy(writer);
+
+    struct timespec times[2] = {{0, UTIME_OMIT}, {(time_t) member->mtime, 0}};
+
+    /* Only the permission bits are restored: setuid, setgid and sticky bits from an archive are not trusted. */
+    if (match) {
+      fchmod(descriptor, member->mode & 0777);
+      futimens(descriptor, times);
+    }
+
+    fclose(file);
+
+    if (!match) {
+      unlink(temporary);
+      ArchiveMismatch(member);
+    }
+
+    if (rename(temporary, path) != 0) {
+      fprintf(stderr, "ERROR: rename(): unable to create '%s': %s!\n", path, strerror(errno));
+      unlink(temporary);
+      exit(EXIT_FAILURE);
+    }
+
+    total += member->length;
+
+    free(temporary);
+    free(path);
+  }
+
+  return total;
+}
+
+void ArchiveDestroy(Archive* archive)
+{
+  if (archive == NULL)
+    return;
+
+  for (uint64 i = 0; i < archive->count; i++)
+    free(archive->members[i].name);
+
+  free(archive->members);
+  free(archive);
+}
@@ -0,0 +1,156 @@
+/*
+ * ZIGMA, Copyright (C) 2024 Chase Zehl O'Byrne
+ *   <mail: zehl@live.com> http://zehlchen.com/
+ *
+ * This file is part of ZIGMA.
+ *
+ * ZIGMA is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ZIGMA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ZIGMA; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#pragma once
+#ifndef _ZIGMATIQ_ARCHIVE_H_
+#define _ZIGMATIQ_ARCHIVE_H_
+
+#include <stdio.h>
+
+#include "common.h"
+
+#include "pool.h"
+#include "stream.h"
+#include "zigma.h"
+
+/* An archive holds the regular files below a directory, each ciphered on its own, followed by an encrypted index of
+ * their names and places (all integers little-endian):
+ *
+ *   header   "ZQAR" | version (1) | reserved (3)
+ *   members  ciphertext of each file, back to back
+ *   index    ciphertext of: count (8) | entries | digest of the entries (ZIGMA_CHECKSUM_SIZE)
+ *   trailer  index offset (8) | index length (8) | "ZQAX"
+ *
+ * An index entry is offset (8) | length (8) | mode (4) | mtime (8) | digest (ZIGMA_CHECKSUM_SIZE) | name length (4)
+ * | name, where the digest is the hash of the member's plaintext. Member `i` (from 0) is ciphered with a context
+ * derived from the master key with ZQ_ARCHIVE_DOMAIN | (i + 1), and the index with ZQ_ARCHIVE_DOMAIN, so any one
+ * member can be read given only the index.
+ */
+#define ZQ_ARCHIVE_MAGIC         "ZQAR"
+#define ZQ_ARCHIVE_INDEX_MAGIC   "ZQAX"
+#define ZQ_ARCHIVE_VERSION       1
+#define ZQ_ARCHIVE_HEADER_SIZE   8
+#define ZQ_ARCHIVE_TRAILER_SIZE  20
+#define ZQ_ARCHIVE_ENTRY_SIZE    (32 + ZIGMA_CHECKSUM_SIZE)
+
+/* Members are read, ciphered and written in blocks of this size, one block per worker. */
+#ifndef ZQ_ARCHIVE_BLOCK_SIZE
+#define ZQ_ARCHIVE_BLOCK_SIZE (1024 * 1024) /* 1MB */
+#endif
+
+/* Limits that keep a corrupt index from asking for absurd allocations. */
+#define ZQ_ARCHIVE_MAX_INDEX (256 * 1024 * 1024) /* 256MB */
+#define ZQ_ARCHIVE_MAX_NAME  4096
+
+/* Archive contexts are derived with indices in their own range, apart from chunks, checkpoints and tags. */
+#define ZQ_ARCHIVE_DOMAIN (1ULL << 61)
+
+/* A file within an archive. */
+typedef struct ArchiveMember {
+  /* The path below the archived directory, with '/' separators. */
+  char* name;
+
+  /* Where the ciphertext starts in the archive, and its length (the same as the plaintext's). */
+  uint64 offset;
+  uint64 length;
+
+  /* Permission bits and modification time of the original file. */
+  uint32 mode;
+  int64  mtime;
+
+  /* Hash of the plaintext. */
+  uint8 digest[ZIGMA_CHECKSUM_SIZE];
+} ArchiveMember;
+
+/* An archive opened for listing and extraction. Only the index is read when it is opened.
+ */
+typedef struct Archive {
+  /* The file, read with pread(). */
+  int descriptor;
+
+  /* The master key the members are encrypted under. */
+  const ZigmaContext* master;
+
+  /* The members, in archive order. */
+  ArchiveMember* members;
+  uint64         count;
+} Archive;
+
+/* Archive a file or every regular file below a directory (in name order, as `check` walks it). Members are ciphered
+ * on the pool in parallel, each written at its own offset. A symbolic link among the files is an error rather than
+ * being archived as its target.
+ *   @param master The keyed context; it is not modified.
+ *   @param root The file or directory to archive.
+ *   @param stream The destination, a regular file.
+ *   @param pool The workers to encode on.
+ *   @param count Receives the number of members.
+ *   @return The number of plaintext bytes archived.
+ */
+uint64 ArchiveCreate(const ZigmaContext* master, const char* root, FILE* stream, Pool* pool, uint64* count);
+
+/* Open an archive and decrypt its index. A wrong key is reported here.
+ *   @param archive The object to initialize, or NULL to allocate one.
+ *   @param stream A binary, regular file.
+ *   @param master The keyed context; it must outlive the object.
+ *   @return The object.
+ */
+Archive* ArchiveOpen(Archive* archive, FILE* stream, const ZigmaContext* master);
+
+/* Look up a member by name.
+ *   @param archive The archive.
+ *   @param name The member's path within the archive.
+ *   @return The member, or NULL if there is none by that name.
+ */
+ArchiveMember* ArchiveFind(Archive* archive, const char* name);
+
+/* Write one line per member, "SIZE  NAME", in archive order.
+ *   @param archive The archive.
+ *   @param member The only member to list, or NULL for all of them.
+ *   @param stream The destination of the listing.
+ */
+void ArchiveList(Archive* archive, const ArchiveMember* member, FILE* stream);
+
+/* Decode one member to a writer, reading nothing else from the archive. Exits with an error if the plaintext does
+ * not match the digest in the index; by then the plaintext has been written, and only an output file can be
+ * truncated back (SinkDiscard()).
+ *   @param archive The archive.
+ *   @param member The member.
+ *   @param writer The destination of the plaintext.
+ *   @return The number of bytes written.
+ */
+uint64 ArchiveExtract(Archive* archive, const ArchiveMember* member, StreamWriter* writer);
+
+/* Extract every member below a directory, creating subdirectories as needed and restoring permissions and
+ * modification times. Names that would leave the directory, directly or through a symbolic link, are refused. Each
+ * member is written to a new temporary file and renamed into place only after it matches its digest.
+ *   @param archive The archive.
+ *   @param directory The destination directory.
+ *   @return The number of bytes written.
+ */
+uint64 ArchiveExtractAll(Archive* archive, const char* directory);
+
+/* Release an archive. The stream itself is not closed.
+ *   @param archive The archive.
+ */
+void ArchiveDestroy(Archive* archive);
+
+#endif /* _ZIGMATIQ_ARCHIVE_H_ */
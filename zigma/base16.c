@@ -0,0 +1,383 @@
+/*
+ * ZIGMA, Copyright (C) 2024 Chase Zehl O'Byrne
+ *   <mail: zehl@live.com> http://zehlchen.com/
+ *
+ * This file is part of ZIGMA.
+ *
+ * ZIGMA is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ZIGMA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ZIGMA; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define ZQ_BASE16_X86 1
+#include <immintrin.h>
+#endif
+
+#include "base16.h"
+#include "common.h"
+
+static const char base16_chars[] = "0123456789abcdef";
+
+#define BASE16_SKIP  0xFE
+#define BASE16_ERROR 0xFF
+
+/* Nibble value of every byte, BASE16_SKIP for whitespace, or BASE16_ERROR. */
+static const unsigned char base16_values[256] = {
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xfe, 0xfe, 0xff, 0xff, 0xfe, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xfe, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+};
+
+/* Characters handed to the scalar decoder each time the vector decoder stops. */
+#define BASE16_SCALAR_RUN 32
+
+/* A set of bulk routines; each handles whole vector blocks and leaves the rest to the caller.
+ */
+typedef struct Base16Kernel {
+  const char* name;
+
+  /* Encode; returns the number of input bytes consumed. */
+  unsigned long (*encode)(char* output, const unsigned char* input, unsigned long length);
+
+  /* Decode blocks made only of hex digits, starting on a pair boundary. Stops at the first block holding anything
+   * else. Returns the number of bytes written and stores the number of characters consumed in `*consumed`.
+   */
+  unsigned long (*decode)(unsigned char* output, const char* input, unsigned long length, unsigned long* consumed);
+} Base16Kernel;
+
+static unsigned long base16_encode_scalar(char* output, const unsigned char* input, unsigned long length)
+{
+  for (unsigned long i = 0; i < length; i++) {
+    *output++ = base16_chars[input[i] >> 4];
+    *output++ = base16_chars[input[i] & 0x0F];
+  }
+
+  return length;
+}
+
+/* The block is one pair of digits, looked up in `base16_values`. */
+static unsigned long base16_decode_scalar(unsigned char* output, const char* input, unsigned long length,
+                                          unsigned long* consumed)
+{
+  unsigned long i = 0;
+
+  for (; i + 2 <= length; i += 2) {
+    unsigned char high = base16_values[(unsigned char) input[i]];
+    unsigned char low  = base16_values[(unsigned char) input[i + 1]];
+
+    if ((high | low) > 0x0F)
+      break;
+
+    *output++ = (unsigned char) ((high << 4) | low);
+  }
+
+  *consumed = i;
+
+  return i / 2;
+}
+
+static const Base16Kernel base16_kernel_scalar = {"scalar", base16_encode_scalar, base16_decode_scalar};
+
+#ifdef ZQ_BASE16_X86
+
+__attribute__((target("ssse3"))) static unsigned long base16_encode_ssse3(char* output, const unsigned char* input,
+                                                                          unsigned long length)
+{
+  const __m128i lut = _mm_loadu_si128((const __m128i*) base16_chars);
+  unsigned long i   = 0;
+
+  for (; i + 16 <= length; i += 16, output += 32) {
+    __m128i block = _mm_loadu_si128((const __m128i*) (input + i));
+    __m128i high  = _mm_shuffle_epi8(lut, _mm_and_si128(_mm_srli_epi16(block, 4), _mm_set1_epi8(0x0F)));
+    __m128i low   = _mm_shuffle_epi8(lut, _mm_and_si128(block, _mm_set1_epi8(0x0F)));
+
+    _mm_storeu_si128((__m128i*) output, _mm_unpacklo_epi8(high, low));
+    _mm_storeu_si128((__m128i*) (output + 16), _mm_unpackhi_epi8(high, low));
+  }
+
+  return i + base16_encode_scalar(output, input + i, length - i);
+}
+
+/* Convert 16 characters to nibbles; `valid` is all-ones in lanes holding a hex digit. */
+__attribute__((target("ssse3"))) static inline __m128i base16_translate_ssse3(__m128i block, __m128i* valid)
+{
+  __m128i folded = _mm_or_si128(block, _mm_set1_epi8(0x20));
+  __m128i digit  = _mm_and_si128(_mm_cmpgt_epi8(block, _mm_set1_epi8('0' - 1)),
+                                 _mm_cmpgt_epi8(_mm_set1_epi8('9' + 1), block));
+  __m128i alpha  = _mm_and_si128(_mm_cmpgt_epi8(folded, _mm_set1_epi8('a' - 1)),
+                                 _mm_cmpgt_epi8(_mm_set1_epi8('f' + 1), folded));
+
+  *valid = _mm_or_si128(digit, alpha);
+
+  return _mm_or_si128(_mm_and_si128(digit, _mm_sub_epi8(block, _mm_set1_epi8('0'))),
+                      _mm_and_si128(alpha, _mm_sub_epi8(folded, _mm_set1_epi8('a' - 10))));
+}
+
+__attribute__((target("ssse3"))) static unsigned long base16_decode_ssse3(unsigned char* output, const char* input,
+                                                                          unsigned long length,
+                                                                          unsigned long* consumed)
+{
+  unsigned long i = 0;
+
+  for (; i + 16 <= length; i += 16, output += 8) {
+    __m128i valid;
+    __m128i nibbles = base16_translate_ssse3(_mm_loadu_si128((const __m128i*) (input + i)), &valid);
+
+    if (_mm_movemask_epi8(valid) != 0xFFFF)
+      break;
+
+    /* high * 16 + low for each pair, then narrow to bytes. */
+    __m128i pairs = _mm_maddubs_epi16(nibbles, _mm_set1_epi16(0x0110));
+
+    _mm_storel_epi64((__m128i*) output, _mm_packus_epi16(pairs, pairs));
+  }
+
+  unsigned long rest;
+  unsigned long written = base16_decode_scalar(output, input + i, length - i, &rest);
+
+  *consumed = i + rest;
+
+  return i / 2 + written;
+}
+
+static const Base16Kernel base16_kernel_ssse3 = {"ssse3", base16_encode_ssse3, base16_decode_ssse3};
+
+__attribute__((target("avx2"))) static unsigned long base16_encode_avx2(char* output, const unsigned char* input,
+                                                                        unsigned long length)
+{
+  const __m256i lut = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*) base16_chars));
+  unsigned long i   = 0;
+
+  for (; i + 32 <= length; i += 32, output += 64) {
+    __m256i block = _mm256_loadu_si256((const __m256i*) (input + i));
+    __m256i high  = _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi16(block, 4), _mm256_set1_epi8(0x0F)));
+    __m256i low   = _mm256_shuffle_epi8(lut, _mm256_and_si256(block, _mm256_set1_epi8(0x0F)));
+    __m256i first = _mm256_unpacklo_epi8(high, low);
+    __m256i last  = _mm256_unpackhi_epi8(high, low);
+
+    /* unpack works within 128-bit lanes; put the four 16-character runs back in order. */
+    _mm256_storeu_si256((__m256i*) output, _mm256_permute2x128_si256(first, last, 0x20));
+    _mm256_storeu_si256((__m256i*) (output + 32), _mm256_permute2x128_si256(first, last, 0x31));
+  }
+
+  return i + base16_encode_ssse3(output, input + i, length - i);
+}
+
+__attribute__((target("avx2"))) static unsigned long base16_decode_avx2(unsigned char* output, const char* input,
+                                                                        unsigned long length, unsigned long* consumed)
+{
+  unsigned long i = 0;
+
+  for (; i + 32 <= length; i += 32, output += 16) {
+    __m256i block  = _mm256_loadu_si256((const __m256i*) (input + i));
+    __m256i folded = _mm256_or_si256(block, _mm256_set1_epi8(0x20));
+    __m256i digit  = _mm256_and_si256(_mm256_cmpgt_epi8(block, _mm256_set1_epi8('0' - 1)),
+                                      _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), block));
+    __m256i alpha  = _mm256_and_si256(_mm256_cmpgt_epi8(folded, _mm256_set1_epi8('a' - 1)),
+                                      _mm256_cmpgt_epi8(_mm256_set1_epi8('f' + 1), folded));
+
+    if ((uint32) _mm256_movemask_epi8(_mm256_or_si256(digit, alpha)) != 0xFFFFFFFFu)
+      break;
+
+    __m256i nibbles = _mm256_or_si256(_mm256_and_si256(digit, _mm256_sub_epi8(block, _mm256_set1_epi8('0'))),
+                                      _mm256_and_si256(alpha, _mm256_sub_epi8(folded, _mm256_set1_epi8('a' - 10))));
+    __m256i pairs   = _mm256_maddubs_epi16(nibbles, _mm256_set1_epi16(0x0110));
+    __m256i packed  = _mm256_permute4x64_epi64(_mm256_packus_epi16(pairs, pairs), _MM_SHUFFLE(3, 1, 2, 0));
+
+    _mm_storeu_si128((__m128i*) output, _mm256_castsi256_si128(packed));
+  }
+
+  unsigned long rest;
+  unsigned long written = base16_decode_ssse3(output, input + i, length - i, &rest);
+
+  *consumed = i + rest;
+
+  return i / 2 + written;
+}
+
+static const Base16Kernel base16_kernel_avx2 = {"avx2", base16_encode_avx2, base16_decode_avx2};
+
+#endif /* ZQ_BASE16_X86 */
+
+static const Base16Kernel* base16_active = &base16_kernel_scalar;
+
+#ifdef ZQ_BASE16_X86
+/* Pick the widest kernel the processor supports before main() runs. */
+__attribute__((constructor)) static void base16_dispatch(void)
+{
+  __builtin_cpu_init();
+
+  if (__builtin_cpu_supports("avx2"))
+    base16_active = &base16_kernel_avx2;
+  else if (__builtin_cpu_supports("ssse3"))
+    base16_active = &base16_kernel_ssse3;
+}
+#endif /* ZQ_BASE16_X86 */
+
+const char* base16_kernel(void)
+{
+  return base16_active->name;
+}
+
+int base16_select_kernel(const char* name)
+{
+  const Base16Kernel* kernel = NULL;
+
+  if (strcmp(name, "scalar") == 0)
+    kernel = &base16_kernel_scalar;
+#ifdef ZQ_BASE16_X86
+  else if (strcmp(name, "ssse3") == 0 && __builtin_cpu_supports("ssse3"))
+    kernel = &base16_kernel_ssse3;
+  else if (strcmp(name, "avx2") == 0 && __builtin_cpu_supports("avx2"))
+    kernel = &base16_kernel_avx2;
+#endif /* ZQ_BASE16_X86 */
+
+  if (kernel == NULL)
+    return 0;
+
+  base16_active = kernel;
+
+  return 1;
+}
+
+unsigned long base16_encode(char* output, const unsigned char* input, unsigned long length)
+{
+  DEBUG_ASSERT(output != NULL || length == 0);
+
+  base16_active->encode(output, input, length);
+
+  return 2 * length;
+}
+
+unsigned long base16_decode(unsigned char* output, const char* input, unsigned long length, int* nibble)
+{
+  DEBUG_ASSERT(nibble != NULL);
+
+  unsigned long written = 0;
+  unsigned long i       = 0;
+
+  while (i < length) {
+    /* Runs of digits on a pair boundary go to the vector decoder. */
+    if (*nibble < 0) {
+      unsigned long consumed;
+
+      written += base16_active->decode(output + written, input + i, length - i, &consumed);
+      i += consumed;
+    }
+
+    /* Whatever stopped it (whitespace, a split pair, or a short tail) is handled a few characters at a time. */
+    unsigned long end = i + BASE16_SCALAR_RUN < length ? i + BASE16_SCALAR_RUN : length;
+
+    for (; i < end; i++) {
+      unsigned char value = base16_values[(unsigned char) input[i]];
+
+      if (value == BASE16_SKIP)
+        continue;
+
+      if (value == BASE16_ERROR)
+        return BASE16_INVALID;
+
+      if (*nibble < 0) {
+        *nibble = value;
+      }
+      else {
+        output[written++] = (unsigned char) ((*nibble << 4) | value);
+        *nibble           = -1;
+      }
+    }
+  }
+
+  return written;
+}
+
+void base16_decoder_init(base16_decoder* decoder)
+{
+  DEBUG_ASSERT(decoder != NULL);
+
+  decoder->nibble     = -1;
+  decoder->in_comment = 0;
+  decoder->line_start = 1;
+}
+
+unsigned long base16_decoder_update(base16_decoder* decoder, unsigned char* output, const char* input,
+                                    unsigned long length)
+{
+  DEBUG_ASSERT(decoder != NULL);
+  DEBUG_ASSERT(input != NULL || length == 0);
+
+  unsigned long written = 0;
+  unsigned long i       = 0;
+
+  while (i < length) {
+    /* A comment runs to the end of its line, which may be in a later piece. */
+    if (decoder->in_comment) {
+      while (i < length && input[i] != '\n' && input[i] != '\r')
+        i++;
+
+      if (i < length) {
+        decoder->in_comment = 0;
+        decoder->line_start = 1;
+      }
+
+      continue;
+    }
+
+    if (input[i] == '#') {
+      if (!decoder->line_start)
+        return BASE16_INVALID;
+
+      decoder->in_comment = 1;
+      continue;
+    }
+
+    const char*   hash    = memchr(input + i, '#', length - i);
+    unsigned long end     = hash != NULL ? (unsigned long) (hash - input) : length;
+    unsigned long decoded = base16_decode(output + written, input + i, end - i, &decoder->nibble);
+
+    if (decoded == BASE16_INVALID)
+      return BASE16_INVALID;
+
+    decoder->line_start = input[end - 1] == '\n' || input[end - 1] == '\r';
+
+    written += decoded;
+    i = end;
+  }
+
+  return written;
+}
+
+int base16_decoder_final(const base16_decoder* decoder)
+{
+  DEBUG_ASSERT(decoder != NULL);
+
+  return decoder->nibble < 0;
+}
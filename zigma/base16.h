@@ -0,0 +1,92 @@
+/*
+ * ZIGMA, Copyright (C) 2024 Chase Zehl O'Byrne
+ *   <mail: zehl@live.com> http://zehlchen.com/
+ *
+ * This file is part of ZIGMA.
+ *
+ * ZIGMA is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ZIGMA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ZIGMA; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef _ZIGMATIQ_BASE16_H_
+#define _ZIGMATIQ_BASE16_H_
+
+/* Returned by `base16_decode()` when the input contains a character that is neither a hexadecimal digit nor
+ * whitespace.
+ */
+#define BASE16_INVALID ((unsigned long) -1)
+
+/* Encode a buffer to lowercase base16.
+ *  @param output The output buffer, at least `2 * length` bytes. No terminator is written.
+ *  @param input The input buffer.
+ *  @param length The length of the input buffer.
+ *  @return The length of the output (`2 * length`).
+ */
+unsigned long base16_encode(char* output, const unsigned char* input, unsigned long length);
+
+/* Decode base16 text, skipping whitespace. May be called repeatedly on consecutive pieces of a stream: a digit
+ * left over at the end of one piece is carried in `*nibble` and paired with the first digit of the next.
+ *  @param output The output buffer, at least `(length + 1) / 2` bytes.
+ *  @param input The input buffer (upper or lower case).
+ *  @param length The length of the input buffer.
+ *  @param nibble The pending high nibble, or -1 if none; initialize to -1 before the first call.
+ *  @return The number of bytes decoded, or BASE16_INVALID.
+ */
+unsigned long base16_decode(unsigned char* output, const char* input, unsigned long length, int* nibble);
+
+/* Incremental decoder state; see `base16_decoder_update()`. */
+typedef struct base16_decoder {
+  /* The pending high nibble of a pair split across pieces, or -1. */
+  int nibble;
+
+  /* Whether the previous piece ended inside a comment, or at the start of a line. */
+  int in_comment;
+  int line_start;
+} base16_decoder;
+
+/* Prepare a decoder for a new stream.
+ *  @param decoder The decoder state.
+ */
+void base16_decoder_init(base16_decoder* decoder);
+
+/* Decode the next piece of a base16 stream. Like base64 input, a line starting with '#' is a comment; pairs,
+ * comments and whitespace may be split across pieces anywhere.
+ *  @param decoder The decoder state.
+ *  @param output The output buffer, at least `(length + 1) / 2` bytes.
+ *  @param input The next piece of text.
+ *  @param length The length of the piece.
+ *  @return The number of bytes decoded, or BASE16_INVALID.
+ */
+unsigned long base16_decoder_update(base16_decoder* decoder, unsigned char* output, const char* input,
+                                    unsigned long length);
+
+/* Check that the stream did not end in the middle of a pair.
+ *  @param decoder The decoder state.
+ *  @return 1 if the stream was complete, 0 if a half-byte was left over.
+ */
+int base16_decoder_final(const base16_decoder* decoder);
+
+/* The name of the kernel in use ("scalar", "ssse3", "avx2"), selected at startup from the processor features.
+ *  @return The kernel name.
+ */
+const char* base16_kernel(void);
+
+/* Force a specific kernel, e.g. to compare implementations.
+ *  @param name The kernel name, as returned by `base16_kernel()`.
+ *  @return 1 if the kernel was selected, 0 if it is unknown or not supported by this processor.
+ */
+int base16_select_kernel(const char* name);
+
+#endif /* _ZIGMATIQ_BASE16_H_ */
@@ -25,92 +25,588 @@
 #include <stdlib.h>
 #include <string.h>
 
+#if defined(__x86_64__) && defined(__GNUC__)
+#define ZQ_BASE64_X86 1
+#include <immintrin.h>
+#endif
+
 #include "base64.h"
 #include "common.h"
 
 static const char base64_chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
 
-unsigned int base64_encode(char* data, char const* buffer, unsigned long length)
-{
-  unsigned long output_length = 4 * ((length + 2) / 3);
+/* Sextet value of every byte, or 0xFF if the byte is not in the base64 alphabet. */
+static const unsigned char base64_values[256] = {
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x3e, 0xff, 0xff, 0xff, 0x3f,
+  0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x3b, 0x3c, 0x3d, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e,
+  0x0f, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f, 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28,
+  0x29, 0x2a, 0x2b, 0x2c, 0x2d, 0x2e, 0x2f, 0x30, 0x31, 0x32, 0x33, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+};
+
+/* A set of bulk routines. Each one handles as much of its input as it can in whole vector blocks and returns how
+ * far it got; the scalar code finishes the remainder.
+ */
+typedef struct Base64Kernel {
+  const char* name;
 
-  DEBUG_ASSERT(data != NULL);
+  /* Encode whole triples; returns the number of input bytes consumed (a multiple of 3). */
+  unsigned long (*encode)(char* output, const unsigned char* input, unsigned long length);
+
+  /* Decode whole quanta without padding; returns the number of characters consumed (a multiple of 4), or
+   * BASE64_INVALID_LENGTH if an invalid character was found.
+   */
+  unsigned long (*decode)(unsigned char* output, const char* input, unsigned long length);
 
-  for (int i = 0, j = 0; i < length;) {
-    unsigned long octet_a = i < length ? (unsigned char) buffer[i++] : 0;
-    unsigned long octet_b = i < length ? (unsigned char) buffer[i++] : 0;
-    unsigned long octet_c = i < length ? (unsigned char) buffer[i++] : 0;
+  /* Strip whitespace and comments; returns the number of characters written. */
+  unsigned long (*sanitize)(char* output, const char* input, unsigned long length);
+} Base64Kernel;
 
-    unsigned long triple = (octet_a << 16) + (octet_b << 8) + octet_c;
+#define BASE64_INVALID_LENGTH ((unsigned long) -1)
+
+static unsigned long base64_encode_scalar(char* output, const unsigned char* input, unsigned long length)
+{
+  unsigned long i = 0;
 
-    data[j++] = base64_chars[(triple >> 18) & 0x3F];
-    data[j++] = base64_chars[(triple >> 12) & 0x3F];
-    data[j++] = base64_chars[(triple >> 6) & 0x3F];
-    data[j++] = base64_chars[(triple >> 0) & 0x3F];
+  for (; i + 3 <= length; i += 3) {
+    unsigned long triple = ((unsigned long) input[i] << 16) | ((unsigned long) input[i + 1] << 8) | input[i + 2];
+
+    *output++ = base64_chars[(triple >> 18) & 0x3F];
+    *output++ = base64_chars[(triple >> 12) & 0x3F];
+    *output++ = base64_chars[(triple >> 6) & 0x3F];
+    *output++ = base64_chars[(triple >> 0) & 0x3F];
   }
 
-  static const int mod_table[] = {0, 2, 1};
+  return i;
+}
 
-  for (int i = 0; i < mod_table[length % 3]; i++)
-    data[output_length - 1 - i] = '=';
+static unsigned long base64_decode_scalar(unsigned char* output, const char* input, unsigned long length)
+{
+  unsigned long i = 0;
 
-  data[output_length] = '\0';
+  for (; i + 4 <= length; i += 4) {
+    unsigned char a = base64_values[(unsigned char) input[i]];
+    unsigned char b = base64_values[(unsigned char) input[i + 1]];
+    unsigned char c = base64_values[(unsigned char) input[i + 2]];
+    unsigned char d = base64_values[(unsigned char) input[i + 3]];
 
-  return output_length;
+    if ((a | b | c | d) & 0x80)
+      return BASE64_INVALID_LENGTH;
+
+    unsigned long triple = ((unsigned long) a << 18) | ((unsigned long) b << 12) | ((unsigned long) c << 6) | d;
+
+    *output++ = (triple >> 16) & 0xFF;
+    *output++ = (triple >> 8) & 0xFF;
+    *output++ = triple & 0xFF;
+  }
+
+  return i;
 }
 
-/* Convert a base64 character to its integer value.
- *  @param c The base64 character to convert.
- *  @return The integer value.
+/* Scalar sanitizer over input[begin, end), continuing from `*in_comment`. Looks back at input[begin - 1] to
+ * decide whether a '#' starts a line. Returns the number of characters written.
  */
-unsigned char base64_char_value(char c)
+static unsigned long base64_sanitize_range(char* output, const char* input, unsigned long begin, unsigned long end,
+                                           bool* in_comment)
 {
-  if (c >= 'A' && c <= 'Z')
-    return c - 'A';
-  if (c >= 'a' && c <= 'z')
-    return c - 'a' + 26;
-  if (c >= '0' && c <= '9')
-    return c - '0' + 52;
-  if (c == '+')
-    return 62;
-  if (c == '/')
-    return 63;
+  unsigned long written = 0;
+
+  for (unsigned long i = begin; i < end; i++) {
+    char ch = input[i];
+
+    if (ch == '#' && (i == 0 || input[i - 1] == '\n' || input[i - 1] == '\r'))
+      *in_comment = true;
+
+    if (ch == '\n' || ch == '\r') {
+      *in_comment = false;
+      continue;
+    }
 
-  return -1;
+    if (!*in_comment && ch != ' ' && ch != '\t')
+      output[written++] = ch;
+  }
+
+  return written;
 }
 
-unsigned int base64_sanitize(char* output, char const* input, unsigned long length)
+static unsigned long base64_sanitize_scalar(char* output, const char* input, unsigned long length)
 {
-  DEBUG_ASSERT(input != NULL);
+  bool in_comment = false;
 
-  if (length == 0)
-    return 0;
+  return base64_sanitize_range(output, input, 0, length, &in_comment);
+}
 
-  if (output == NULL)
-    output = malloc(length);
+static const Base64Kernel base64_kernel_scalar = {"scalar", base64_encode_scalar, base64_decode_scalar,
+                                                  base64_sanitize_scalar};
 
-  DEBUG_ASSERT(output != NULL);
+#ifdef ZQ_BASE64_X86
 
-  unsigned int output_length = 0;
-  bool         in_comment    = false;
+/* pshufb patterns that move the bytes selected by an 8-bit mask to the front (remaining lanes zeroed). */
+static unsigned char base64_compact[256][8];
 
-  for (unsigned long i = 0; i < length; i++) {
-    char ch = input[i];
+static void base64_compact_init(void)
+{
+  for (int mask = 0; mask < 256; mask++) {
+    int count = 0;
 
-    if (ch == '#' && (i == 0 || input[i - 1] == '\n' || input[i - 1] == '\r')) {
-      in_comment = true;
+    for (int bit = 0; bit < 8; bit++) {
+      if (mask & (1 << bit))
+        base64_compact[mask][count++] = bit;
     }
 
-    if (ch == '\n' || ch == '\r') {
-      in_comment = false;
+    while (count < 8)
+      base64_compact[mask][count++] = 0x80;
+  }
+}
+
+/* Store the 12 significant bytes of a packed decode block. */
+__attribute__((target("ssse3"))) static inline void base64_store12(unsigned char* output, __m128i packed)
+{
+  uint32 tail = (uint32) _mm_cvtsi128_si32(_mm_srli_si128(packed, 8));
+
+  _mm_storel_epi64((__m128i*) output, packed);
+  memcpy(output + 8, &tail, 4);
+}
+
+/* Map 16 sextets (0..63) to their base64 characters. */
+__attribute__((target("ssse3"))) static inline __m128i base64_lookup_ssse3(__m128i indices)
+{
+  const __m128i shift = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                      '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+
+  __m128i result = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+  __m128i less   = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+
+  result = _mm_or_si128(result, _mm_and_si128(less, _mm_set1_epi8(13)));
+
+  return _mm_add_epi8(_mm_shuffle_epi8(shift, result), indices);
+}
+
+/* Split each group of three bytes into four sextets, one per byte. */
+__attribute__((target("ssse3"))) static inline __m128i base64_split_ssse3(__m128i input)
+{
+  input = _mm_shuffle_epi8(input, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+
+  __m128i t0 = _mm_mulhi_epu16(_mm_and_si128(input, _mm_set1_epi32(0x0fc0fc00)), _mm_set1_epi32(0x04000040));
+  __m128i t1 = _mm_mullo_epi16(_mm_and_si128(input, _mm_set1_epi32(0x003f03f0)), _mm_set1_epi32(0x01000010));
+
+  return _mm_or_si128(t0, t1);
+}
+
+/* Translate 16 characters to sextets; `valid` is set to all-ones lanes for characters in the alphabet. */
+__attribute__((target("ssse3"))) static inline __m128i base64_translate_ssse3(__m128i input, __m128i* valid)
+{
+  __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(input, _mm_set1_epi8('A' - 1)),
+                                _mm_cmpgt_epi8(_mm_set1_epi8('Z' + 1), input));
+  __m128i lower = _mm_and_si128(_mm_cmpgt_epi8(input, _mm_set1_epi8('a' - 1)),
+                                _mm_cmpgt_epi8(_mm_set1_epi8('z' + 1), input));
+  __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(input, _mm_set1_epi8('0' - 1)),
+                                _mm_cmpgt_epi8(_mm_set1_epi8('9' + 1), input));
+  __m128i plus  = _mm_cmpeq_epi8(input, _mm_set1_epi8('+'));
+  __m128i slash = _mm_cmpeq_epi8(input, _mm_set1_epi8('/'));
+
+  __m128i shift = _mm_and_si128(upper, _mm_set1_epi8(-'A'));
+
+  shift = _mm_or_si128(shift, _mm_and_si128(lower, _mm_set1_epi8(26 - 'a')));
+  shift = _mm_or_si128(shift, _mm_and_si128(digit, _mm_set1_epi8(52 - '0')));
+  shift = _mm_or_si128(shift, _mm_and_si128(plus, _mm_set1_epi8(62 - '+')));
+  shift = _mm_or_si128(shift, _mm_and_si128(slash, _mm_set1_epi8(63 - '/')));
+
+  *valid = _mm_or_si128(_mm_or_si128(upper, lower), _mm_or_si128(digit, _mm_or_si128(plus, slash)));
+
+  return _mm_add_epi8(input, shift);
+}
+
+/* Pack 16 sextets into 12 bytes (in the low 12 lanes). */
+__attribute__((target("ssse3"))) static inline __m128i base64_pack_ssse3(__m128i sextets)
+{
+  __m128i pairs  = _mm_maddubs_epi16(sextets, _mm_set1_epi32(0x01400140));
+  __m128i triple = _mm_madd_epi16(pairs, _mm_set1_epi32(0x00011000));
+
+  return _mm_shuffle_epi8(triple, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+}
+
+__attribute__((target("ssse3"))) static unsigned long base64_encode_ssse3(char* output, const unsigned char* input,
+                                                                          unsigned long length)
+{
+  unsigned long i = 0;
+
+  /* 16 bytes are loaded but only 12 are used. */
+  for (; i + 16 <= length; i += 12, output += 16) {
+    __m128i block = _mm_loadu_si128((const __m128i*) (input + i));
+
+    _mm_storeu_si128((__m128i*) output, base64_lookup_ssse3(base64_split_ssse3(block)));
+  }
+
+  return i + base64_encode_scalar(output, input + i, length - i);
+}
+
+__attribute__((target("ssse3"))) static unsigned long base64_decode_ssse3(unsigned char* output, const char* input,
+                                                                          unsigned long length)
+{
+  unsigned long i = 0;
+
+  for (; i + 16 <= length; i += 16, output += 12) {
+    __m128i valid;
+    __m128i sextets = base64_translate_ssse3(_mm_loadu_si128((const __m128i*) (input + i)), &valid);
+
+    if (_mm_movemask_epi8(valid) != 0xFFFF)
+      return BASE64_INVALID_LENGTH;
+
+    base64_store12(output, base64_pack_ssse3(sextets));
+  }
+
+  unsigned long rest = base64_decode_scalar(output, input + i, length - i);
+
+  return rest == BASE64_INVALID_LENGTH ? rest : i + rest;
+}
+
+/* Compact one 8-byte half (`half` holds it in its low lanes) by `keep` and store it; returns the bytes stored. */
+__attribute__((target("ssse3"))) static inline unsigned long base64_compact8(char* output, __m128i half, int keep)
+{
+  __m128i pattern = _mm_loadl_epi64((const __m128i*) base64_compact[keep]);
+
+  _mm_storel_epi64((__m128i*) output, _mm_shuffle_epi8(half, pattern));
+
+  return __builtin_popcount(keep);
+}
+
+/* Mask of whitespace lanes and of '#' lanes in a 16-byte block. */
+__attribute__((target("ssse3"))) static inline void base64_classify_ssse3(__m128i block, int* space, int* hash)
+{
+  __m128i ws = _mm_or_si128(_mm_cmpeq_epi8(block, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(block, _mm_set1_epi8('\t')));
+
+  ws = _mm_or_si128(ws, _mm_or_si128(_mm_cmpeq_epi8(block, _mm_set1_epi8('\n')),
+                                     _mm_cmpeq_epi8(block, _mm_set1_epi8('\r'))));
+
+  *space = _mm_movemask_epi8(ws);
+  *hash  = _mm_movemask_epi8(_mm_cmpeq_epi8(block, _mm_set1_epi8('#')));
+}
+
+__attribute__((target("ssse3"))) static unsigned long base64_sanitize_ssse3(char* output, const char* input,
+                                                                            unsigned long length)
+{
+  unsigned long written    = 0;
+  unsigned long i          = 0;
+  bool          in_comment = false;
+
+  for (; i + 16 <= length; i += 16) {
+    __m128i block = _mm_loadu_si128((const __m128i*) (input + i));
+    int     space, hash;
+
+    base64_classify_ssse3(block, &space, &hash);
+
+    /* Comments are rare; let the scalar code track them. */
+    if (in_comment || hash != 0) {
+      written += base64_sanitize_range(output + written, input, i, i + 16, &in_comment);
       continue;
     }
 
-    if (!in_comment && ch != ' ' && ch != '\t' && ch != '\n' && ch != '\r') {
-      output[output_length++] = ch;
+    if (space == 0) {
+      _mm_storeu_si128((__m128i*) (output + written), block);
+      written += 16;
+      continue;
     }
+
+    int keep = ~space & 0xFFFF;
+
+    written += base64_compact8(output + written, block, keep & 0xFF);
+    written += base64_compact8(output + written, _mm_srli_si128(block, 8), keep >> 8);
+  }
+
+  return written + base64_sanitize_range(output + written, input, i, length, &in_comment);
+}
+
+static const Base64Kernel base64_kernel_ssse3 = {"ssse3", base64_encode_ssse3, base64_decode_ssse3,
+                                                 base64_sanitize_ssse3};
+
+__attribute__((target("avx2"))) static unsigned long base64_encode_avx2(char* output, const unsigned char* input,
+                                                                        unsigned long length)
+{
+  const __m256i split = _mm256_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1, 10, 11, 9, 10, 7, 8, 6, 7,
+                                        4, 5, 3, 4, 1, 2, 0, 1);
+  const __m256i shift = _mm256_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                         '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0,
+                                         'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                         '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+  unsigned long i = 0;
+
+  /* Two 12-byte groups per iteration, one in each 128-bit lane. */
+  for (; i + 28 <= length; i += 24, output += 32) {
+    __m256i block = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*) (input + i))),
+                                            _mm_loadu_si128((const __m128i*) (input + i + 12)), 1);
+
+    block = _mm256_shuffle_epi8(block, split);
+
+    __m256i t0 = _mm256_mulhi_epu16(_mm256_and_si256(block, _mm256_set1_epi32(0x0fc0fc00)),
+                                    _mm256_set1_epi32(0x04000040));
+    __m256i t1 = _mm256_mullo_epi16(_mm256_and_si256(block, _mm256_set1_epi32(0x003f03f0)),
+                                    _mm256_set1_epi32(0x01000010));
+    __m256i indices = _mm256_or_si256(t0, t1);
+
+    __m256i result = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+    __m256i less   = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices);
+
+    result = _mm256_or_si256(result, _mm256_and_si256(less, _mm256_set1_epi8(13)));
+    result = _mm256_add_epi8(_mm256_shuffle_epi8(shift, result), indices);
+
+    _mm256_storeu_si256((__m256i*) output, result);
+  }
+
+  return i + base64_encode_ssse3(output, input + i, length - i);
+}
+
+__attribute__((target("avx2"))) static unsigned long base64_decode_avx2(unsigned char* output, const char* input,
+                                                                        unsigned long length)
+{
+  unsigned long i = 0;
+
+  for (; i + 32 <= length; i += 32, output += 24) {
+    __m256i block = _mm256_loadu_si256((const __m256i*) (input + i));
+
+    __m256i upper = _mm256_and_si256(_mm256_cmpgt_epi8(block, _mm256_set1_epi8('A' - 1)),
+                                     _mm256_cmpgt_epi8(_mm256_set1_epi8('Z' + 1), block));
+    __m256i lower = _mm256_and_si256(_mm256_cmpgt_epi8(block, _mm256_set1_epi8('a' - 1)),
+                                     _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), block));
+    __m256i digit = _mm256_and_si256(_mm256_cmpgt_epi8(block, _mm256_set1_epi8('0' - 1)),
+                                     _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), block));
+    __m256i plus  = _mm256_cmpeq_epi8(block, _mm256_set1_epi8('+'));
+    __m256i slash = _mm256_cmpeq_epi8(block, _mm256_set1_epi8('/'));
+
+    __m256i valid = _mm256_or_si256(_mm256_or_si256(upper, lower), _mm256_or_si256(digit, _mm256_or_si256(plus, slash)));
+
+    if ((uint32) _mm256_movemask_epi8(valid) != 0xFFFFFFFFu)
+      return BASE64_INVALID_LENGTH;
+
+    __m256i shift = _mm256_and_si256(upper, _mm256_set1_epi8(-'A'));
+
+    shift = _mm256_or_si256(shift, _mm256_and_si256(lower, _mm256_set1_epi8(26 - 'a')));
+    shift = _mm256_or_si256(shift, _mm256_and_si256(digit, _mm256_set1_epi8(52 - '0')));
+    shift = _mm256_or_si256(shift, _mm256_and_si256(plus, _mm256_set1_epi8(62 - '+')));
+    shift = _mm256_or_si256(shift, _mm256_and_si256(slash, _mm256_set1_epi8(63 - '/')));
+
+    __m256i pairs  = _mm256_maddubs_epi16(_mm256_add_epi8(block, shift), _mm256_set1_epi32(0x01400140));
+    __m256i triple = _mm256_madd_epi16(pairs, _mm256_set1_epi32(0x00011000));
+    __m256i packed = _mm256_shuffle_epi8(triple, _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1,
+                                                                  -1, 2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1,
+                                                                  -1, -1));
+
+    base64_store12(output, _mm256_castsi256_si128(packed));
+    base64_store12(output + 12, _mm256_extracti128_si256(packed, 1));
   }
 
+  unsigned long rest = base64_decode_ssse3(output, input + i, length - i);
+
+  return rest == BASE64_INVALID_LENGTH ? rest : i + rest;
+}
+
+__attribute__((target("avx2"))) static unsigned long base64_sanitize_avx2(char* output, const char* input,
+                                                                          unsigned long length)
+{
+  unsigned long written    = 0;
+  unsigned long i          = 0;
+  bool          in_comment = false;
+
+  for (; i + 32 <= length; i += 32) {
+    __m256i block = _mm256_loadu_si256((const __m256i*) (input + i));
+
+    __m256i ws = _mm256_or_si256(_mm256_cmpeq_epi8(block, _mm256_set1_epi8(' ')),
+                                 _mm256_cmpeq_epi8(block, _mm256_set1_epi8('\t')));
+
+    ws = _mm256_or_si256(ws, _mm256_or_si256(_mm256_cmpeq_epi8(block, _mm256_set1_epi8('\n')),
+                                             _mm256_cmpeq_epi8(block, _mm256_set1_epi8('\r'))));
+
+    uint32 space = (uint32) _mm256_movemask_epi8(ws);
+    uint32 hash  = (uint32) _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, _mm256_set1_epi8('#')));
+
+    if (in_comment || hash != 0) {
+      written += base64_sanitize_range(output + written, input, i, i + 32, &in_comment);
+      continue;
+    }
+
+    if (space == 0) {
+      _mm256_storeu_si256((__m256i*) (output + written), block);
+      written += 32;
+      continue;
+    }
+
+    uint32  keep = ~space;
+    __m128i low  = _mm256_castsi256_si128(block);
+    __m128i high = _mm256_extracti128_si256(block, 1);
+
+    written += base64_compact8(output + written, low, keep & 0xFF);
+    written += base64_compact8(output + written, _mm_srli_si128(low, 8), (keep >> 8) & 0xFF);
+    written += base64_compact8(output + written, high, (keep >> 16) & 0xFF);
+    written += base64_compact8(output + written, _mm_srli_si128(high, 8), keep >> 24);
+  }
+
+  return written + base64_sanitize_range(output + written, input, i, length, &in_comment);
+}
+
+static const Base64Kernel base64_kernel_avx2 = {"avx2", base64_encode_avx2, base64_decode_avx2, base64_sanitize_avx2};
+
+#define ZQ_BASE64_AVX512 "avx512f,avx512bw,avx512vbmi"
+
+__attribute__((target(ZQ_BASE64_AVX512))) static unsigned long
+    base64_encode_avx512(char* output, const unsigned char* input, unsigned long length)
+{
+  const __m512i split = _mm512_setr_epi32(0x01020001, 0x04050304, 0x07080607, 0x0a0b090a, 0x0d0e0c0d, 0x10110f10,
+                                          0x13141213, 0x16171516, 0x191a1819, 0x1c1d1b1c, 0x1f201e1f, 0x22232122,
+                                          0x25262425, 0x28292728, 0x2b2c2a2b, 0x2e2f2d2e);
+  const __m512i lookup     = _mm512_loadu_si512((const void*) base64_chars);
+  const __m512i multishift = _mm512_set1_epi64(0x3036242a1016040a);
+  unsigned long i          = 0;
+
+  /* 64 bytes are loaded, 48 are used. */
+  for (; i + 64 <= length; i += 48, output += 64) {
+    __m512i block   = _mm512_permutexvar_epi8(split, _mm512_loadu_si512((const void*) (input + i)));
+    __m512i indices = _mm512_multishift_epi64_epi8(multishift, block);
+
+    _mm512_storeu_si512((void*) output, _mm512_permutexvar_epi8(indices, lookup));
+  }
+
+  return i + base64_encode_avx2(output, input + i, length - i);
+}
+
+__attribute__((target(ZQ_BASE64_AVX512))) static unsigned long
+    base64_decode_avx512(unsigned char* output, const char* input, unsigned long length)
+{
+  const __m512i lookup_lo = _mm512_loadu_si512((const void*) base64_values);
+  const __m512i lookup_hi = _mm512_loadu_si512((const void*) (base64_values + 64));
+  unsigned long i         = 0;
+
+  /* Byte k of the 48-byte result comes from byte (2 - k % 3) of dword k / 3. */
+  unsigned char order[64];
+
+  for (int k = 0; k < 64; k++)
+    order[k] = k < 48 ? 4 * (k / 3) + 2 - k % 3 : 0;
+
+  const __m512i pack = _mm512_loadu_si512((const void*) order);
+
+  for (; i + 64 <= length; i += 64, output += 48) {
+    __m512i block   = _mm512_loadu_si512((const void*) (input + i));
+    __m512i sextets = _mm512_permutex2var_epi8(lookup_lo, block, lookup_hi);
+
+    /* Invalid characters translate to 0xFF; non-ASCII input has its own high bit set. */
+    if (_mm512_test_epi8_mask(_mm512_or_si512(sextets, block), _mm512_set1_epi8((char) 0x80)) != 0)
+      return BASE64_INVALID_LENGTH;
+
+    __m512i pairs  = _mm512_maddubs_epi16(sextets, _mm512_set1_epi32(0x01400140));
+    __m512i triple = _mm512_madd_epi16(pairs, _mm512_set1_epi32(0x00011000));
+
+    _mm512_mask_storeu_epi8(output, 0x0000FFFFFFFFFFFFull, _mm512_permutexvar_epi8(pack, triple));
+  }
+
+  unsigned long rest = base64_decode_avx2(output, input + i, length - i);
+
+  return rest == BASE64_INVALID_LENGTH ? rest : i + rest;
+}
+
+static const Base64Kernel base64_kernel_avx512 = {"avx512", base64_encode_avx512, base64_decode_avx512,
+                                                  base64_sanitize_avx2};
+
+#endif /* ZQ_BASE64_X86 */
+
+static const Base64Kernel* base64_active = &base64_kernel_scalar;
+
+#ifdef ZQ_BASE64_X86
+/* Pick the widest kernel the processor supports before main() runs. */
+__attribute__((constructor)) static void base64_dispatch(void)
+{
+  base64_compact_init();
+
+  __builtin_cpu_init();
+
+  if (__builtin_cpu_supports("avx512vbmi") && __builtin_cpu_supports("avx512bw"))
+    base64_active = &base64_kernel_avx512;
+  else if (__builtin_cpu_supports("avx2"))
+    base64_active = &base64_kernel_avx2;
+  else if (__builtin_cpu_supports("ssse3"))
+    base64_active = &base64_kernel_ssse3;
+}
+#endif /* ZQ_BASE64_X86 */
+
+const char* base64_kernel(void)
+{
+  return base64_active->name;
+}
+
+int base64_select_kernel(const char* name)
+{
+  const Base64Kernel* kernel = NULL;
+
+  if (strcmp(name, "scalar") == 0)
+    kernel = &base64_kernel_scalar;
+#ifdef ZQ_BASE64_X86
+  else if (strcmp(name, "ssse3") == 0 && __builtin_cpu_supports("ssse3"))
+    kernel = &base64_kernel_ssse3;
+  else if (strcmp(name, "avx2") == 0 && __builtin_cpu_supports("avx2"))
+    kernel = &base64_kernel_avx2;
+  else if (strcmp(name, "avx512") == 0 && __builtin_cpu_supports("avx512vbmi") && __builtin_cpu_supports("avx512bw"))
+    kernel = &base64_kernel_avx512;
+#endif /* ZQ_BASE64_X86 */
+
+  if (kernel == NULL)
+    return 0;
+
+  base64_active = kernel;
+
+  return 1;
+}
+
+unsigned int base64_encode(char* data, char const* buffer, unsigned long length)
+{
+  unsigned long output_length = 4 * ((length + 2) / 3);
+
+  DEBUG_ASSERT(data != NULL);
+
+  const unsigned char* input = (const unsigned char*) buffer;
+
+  unsigned long i = base64_active->encode(data, input, length);
+
+  /* Final partial triple, padded with '='. */
+  if (i < length) {
+    unsigned long octet_a = input[i];
+    unsigned long octet_b = i + 1 < length ? input[i + 1] : 0;
+    unsigned long triple  = (octet_a << 16) + (octet_b << 8);
+    char*         tail    = data + output_length - 4;
+
+    tail[0] = base64_chars[(triple >> 18) & 0x3F];
+    tail[1] = base64_chars[(triple >> 12) & 0x3F];
+    tail[2] = i + 1 < length ? base64_chars[(triple >> 6) & 0x3F] : '=';
+    tail[3] = '=';
+  }
+
+  data[output_length] = '\0';
+
+  return output_length;
+}
+
+unsigned int base64_sanitize(char* output, char const* input, unsigned long length)
+{
+  DEBUG_ASSERT(input != NULL);
+
+  if (length == 0)
+    return 0;
+
+  if (output == NULL)
+    output = malloc(length + 1);
+
+  DEBUG_ASSERT(output != NULL);
+
+  unsigned int output_length = base64_active->sanitize(output, input, length);
+
   output[output_length] = '\0';
 
   return output_length;
@@ -118,36 +614,165 @@ unsigned int base64_sanitize(char* output, char const* input, unsigned long leng
 
 unsigned int base64_decode(char* data, char const* buffer, unsigned long length)
 {
-  if (length % 4 != 0)
+  if (length == 0)
     return 0;
 
-  unsigned int output_length = length / 4 * 3;
+  if (length % 4 != 0)
+    return BASE64_INVALID;
 
-  if (buffer[length - 1] == '=')
-    output_length--;
-  if (buffer[length - 2] == '=')
-    output_length--;
+  /* Padding may only appear in the final quantum: "xx==" or "xxx=". */
+  unsigned long padding = buffer[length - 1] == '=' ? (buffer[length - 2] == '=' ? 2 : 1) : 0;
 
   if (data == NULL)
-    data = malloc(output_length);
+    data = malloc(length / 4 * 3);
 
   DEBUG_ASSERT(data != NULL);
 
-  for (unsigned long i = 0, j = 0; i < length;) {
-    unsigned long sextet_a = buffer[i] == '=' ? 0 & i++ : base64_char_value(buffer[i++]);
-    unsigned long sextet_b = buffer[i] == '=' ? 0 & i++ : base64_char_value(buffer[i++]);
-    unsigned long sextet_c = buffer[i] == '=' ? 0 & i++ : base64_char_value(buffer[i++]);
-    unsigned long sextet_d = buffer[i] == '=' ? 0 & i++ : base64_char_value(buffer[i++]);
+  unsigned char* output = (unsigned char*) data;
+
+  /* The vector kernels never see the final quantum, which is the only one allowed to hold padding. */
+  unsigned long i = base64_active->decode(output, buffer, length - 4);
+
+  if (i == BASE64_INVALID_LENGTH)
+    return BASE64_INVALID;
+
+  output += i / 4 * 3;
+
+  unsigned char quantum[4] = {'A', 'A', 'A', 'A'};
+
+  memcpy(quantum, buffer + length - 4, 4 - padding);
+
+  unsigned char last[3];
+
+  if (base64_decode_scalar(last, (const char*) quantum, 4) != 4)
+    return BASE64_INVALID;
+
+  memcpy(output, last, 3 - padding);
+
+  return length / 4 * 3 - padding;
+}
+
+/* Sanitized text is decoded a slice at a time through a buffer of this size. */
+#define BASE64_DECODER_SLICE 4096
+
+void base64_decoder_init(base64_decoder* decoder)
+{
+  DEBUG_ASSERT(decoder != NULL);
+
+  memset(decoder, 0, sizeof(base64_decoder));
+
+  decoder->line_start = 1;
+}
+
+/* Decode sanitized characters, completing the carried quantum first. */
+static unsigned long base64_decoder_feed(base64_decoder* decoder, unsigned char* output, const char* input,
+                                         unsigned long length)
+{
+  unsigned long written = 0;
+  unsigned long i       = 0;
+
+  while (i < length) {
+    if (decoder->finished)
+      return BASE64_INVALID_LENGTH;
+
+    /* Whole quanta on a boundary, up to any padding, go to the vector decoder. */
+    if (decoder->length == 0) {
+      const char*   padding = memchr(input + i, '=', length - i);
+      unsigned long run     = ((padding != NULL ? (unsigned long) (padding - input) : length) - i) & ~3UL;
+
+      if (run > 0) {
+        if (base64_active->decode(output + written, input + i, run) == BASE64_INVALID_LENGTH)
+          return BASE64_INVALID_LENGTH;
+
+        written += run / 4 * 3;
+        i += run;
+        continue;
+      }
+    }
+
+    decoder->quantum[decoder->length++] = input[i++];
+
+    if (decoder->length == 4) {
+      unsigned long padding    = decoder->quantum[3] == '=' ? (decoder->quantum[2] == '=' ? 2 : 1) : 0;
+      unsigned char quantum[4] = {'A', 'A', 'A', 'A'};
+      unsigned char last[3];
+
+      memcpy(quantum, decoder->quantum, 4 - padding);
+
+      if (base64_decode_scalar(last, (const char*) quantum, 4) != 4)
+        return BASE64_INVALID_LENGTH;
 
-    unsigned long triple = (sextet_a << 3 * 6) + (sextet_b << 2 * 6) + (sextet_c << 1 * 6) + (sextet_d << 0 * 6);
+      memcpy(output + written, last, 3 - padding);
 
-    if (j < output_length)
-      data[j++] = (triple >> 2 * 8) & 0xFF;
-    if (j < output_length)
-      data[j++] = (triple >> 1 * 8) & 0xFF;
-    if (j < output_length)
-      data[j++] = (triple >> 0 * 8) & 0xFF;
+      written += 3 - padding;
+
+      decoder->length   = 0;
+      decoder->finished = padding > 0;
+    }
   }
 
-  return output_length;
+  return written;
+}
+
+unsigned long base64_decoder_update(base64_decoder* decoder, unsigned char* output, char const* input,
+                                    unsigned long length)
+{
+  DEBUG_ASSERT(decoder != NULL);
+  DEBUG_ASSERT(input != NULL || length == 0);
+
+  /* The vector sanitizers may store a little past the characters they keep. */
+  char          slice[BASE64_DECODER_SLICE + 64];
+  unsigned long written = 0;
+  unsigned long i       = 0;
+
+  while (i < length) {
+    /* A comment runs to the end of its line, which may be in a later piece. */
+    if (decoder->in_comment) {
+      while (i < length && input[i] != '\n' && input[i] != '\r')
+        i++;
+
+      if (i < length) {
+        decoder->in_comment = 0;
+        decoder->line_start = 1;
+      }
+
+      continue;
+    }
+
+    /* '#' starts a comment at the beginning of a line; anywhere else it is not base64. */
+    if (input[i] == '#') {
+      if (!decoder->line_start)
+        return BASE64_INVALID;
+
+      decoder->in_comment = 1;
+      continue;
+    }
+
+    /* Up to the next '#' the text only needs whitespace removed. */
+    unsigned long end  = length - i > BASE64_DECODER_SLICE ? i + BASE64_DECODER_SLICE : length;
+    const char*   hash = memchr(input + i, '#', end - i);
+
+    if (hash != NULL)
+      end = (unsigned long) (hash - input);
+
+    unsigned long count   = base64_active->sanitize(slice, input + i, end - i);
+    unsigned long decoded = base64_decoder_feed(decoder, output + written, slice, count);
+
+    if (decoded == BASE64_INVALID_LENGTH)
+      return BASE64_INVALID;
+
+    decoder->line_start = input[end - 1] == '\n' || input[end - 1] == '\r';
+
+    written += decoded;
+    i = end;
+  }
+
+  return written;
+}
+
+int base64_decoder_final(const base64_decoder* decoder)
+{
+  DEBUG_ASSERT(decoder != NULL);
+
+  return decoder->length == 0;
 }
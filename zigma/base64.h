@@ -23,6 +23,9 @@
 #ifndef _ZIGMATIQ_BASE64_H_
 #define _ZIGMATIQ_BASE64_H_
 
+/* Returned by `base64_decode()` when the input is not valid base64. */
+#define BASE64_INVALID ((unsigned int) -1)
+
 /* Encode a buffer to base64.
  *  @param data The output buffer, or NULL to allocate one.
  *  @param buffer The input buffer.
@@ -31,20 +34,69 @@
  */
 unsigned int base64_encode(char* data, char const* buffer, unsigned long length);
 
-/* Decode a base64 buffer.
+/* Decode a base64 buffer. The input must be sanitized (no whitespace) and a multiple of four characters long.
  *  @param data The output buffer, or NULL to allocate one.
  *  @param buffer The input buffer.
  *  @param length The length of the input buffer.
- *  @return The length of the output buffer.
+ *  @return The length of the output buffer, or BASE64_INVALID if the input contains a character outside the
+ *          alphabet, misplaced padding, or has a length that is not a multiple of four.
  */
 unsigned int base64_decode(char* data, char const* buffer, unsigned long length);
 
-/* Sanitize a buffer by removing comments and whitespace.
- *  @param output The output buffer, or NULL to allocate one.
+/* Sanitize a buffer by removing comments and whitespace. A comment is a line starting with '#'.
+ *  @param output The output buffer (at least `length + 1` bytes, may equal `input`), or NULL to allocate one.
  *  @param input The input buffer.
  *  @param length The length of the input buffer.
  *  @return The length of the output buffer.
  */
 unsigned int base64_sanitize(char* output, char const* input, unsigned long length);
 
+/* Incremental decoder state; see `base64_decoder_update()`. */
+typedef struct base64_decoder {
+  /* Characters of a quantum split across pieces. */
+  char         quantum[4];
+  unsigned int length;
+
+  /* Whether the previous piece ended inside a comment, or at the start of a line. */
+  int in_comment;
+  int line_start;
+
+  /* Set once a padded quantum has been decoded; nothing but whitespace and comments may follow it. */
+  int finished;
+} base64_decoder;
+
+/* Prepare a decoder for a new stream.
+ *  @param decoder The decoder state.
+ */
+void base64_decoder_init(base64_decoder* decoder);
+
+/* Decode the next piece of a base64 stream. Pieces may be split anywhere: partial quanta, comments and whitespace
+ * are carried in the decoder, and the text is never gathered in memory.
+ *  @param decoder The decoder state.
+ *  @param output The output buffer, at least `length / 4 * 3 + 3` bytes.
+ *  @param input The next piece of text.
+ *  @param length The length of the piece.
+ *  @return The number of bytes decoded, or BASE64_INVALID.
+ */
+unsigned long base64_decoder_update(base64_decoder* decoder, unsigned char* output, char const* input,
+                                    unsigned long length);
+
+/* Check that the stream ended on a quantum boundary.
+ *  @param decoder The decoder state.
+ *  @return 1 if the stream was complete, 0 if it was truncated.
+ */
+int base64_decoder_final(const base64_decoder* decoder);
+
+/* The name of the kernel in use ("scalar", "ssse3", "avx2", "avx512"). The widest kernel supported by the
+ * processor is selected at startup.
+ *  @return The kernel name.
+ */
+const char* base64_kernel(void);
+
+/* Force a specific kernel, e.g. to compare implementations.
+ *  @param name The kernel name, as returned by `base64_kernel()`.
+ *  @return 1 if the kernel was selected, 0 if it is unknown or not supported by this processor.
+ */
+int base64_select_kernel(const char* name);
+
 #endif /* _ZIGMATIQ_BASE64_H_ */
\ No newline at end of file
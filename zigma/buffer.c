@@ -23,36 +23,69 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "common.h"
 
+#include "allocator.h"
+#include "base16.h"
 #include "base64.h"
 #include "buffer.h"
+#include "sink.h"
 
-Buffer* BufferCreate(Buffer* buffer, uint64 length)
+/* Abort when an allocation cannot be satisfied. */
+static void BufferOutOfMemory(uint64 size)
 {
-  if (buffer == NULL)
-    buffer = (Buffer*) malloc(sizeof(Buffer));
+  fprintf(stderr, "ERROR: Unable to allocate %lu bytes!\n", size);
+  exit(EXIT_FAILURE);
+}
 
-  uint64 toAllocate = length < ZQ_BUFFER_DEFAULT_CAPACITY ? ZQ_BUFFER_DEFAULT_CAPACITY : length;
+/* Pick the next capacity for a buffer that must hold `length` bytes: double until it fits. */
+static uint64 BufferGrowth(uint64 capacity, uint64 length)
+{
+  uint64 next = capacity < ZQ_BUFFER_DEFAULT_CAPACITY ? ZQ_BUFFER_DEFAULT_CAPACITY : capacity;
 
-  buffer->data     = (uint8*) malloc(toAllocate);
-  buffer->length   = length;
-  buffer->capacity = toAllocate;
+  while (next < length) {
+    if (next > UINT64_MAX / 2)
+      return length;
 
-  return buffer;
+    next *= 2;
+  }
+
+  return next;
 }
 
-Buffer* BufferCreateCopy(Buffer* buffer, const uint8* data, uint64 length)
+Buffer* BufferCreateWith(Buffer* buffer, uint64 length, Allocator* allocator)
 {
   if (buffer == NULL)
     buffer = (Buffer*) malloc(sizeof(Buffer));
 
+  if (allocator == NULL)
+    allocator = &AllocatorHeap;
+
   uint64 toAllocate = length < ZQ_BUFFER_DEFAULT_CAPACITY ? ZQ_BUFFER_DEFAULT_CAPACITY : length;
 
-  buffer->data     = (uint8*) malloc(toAllocate);
-  buffer->length   = length;
-  buffer->capacity = toAllocate;
+  buffer->data      = (uint8*) allocator->allocate(allocator, toAllocate);
+  buffer->length    = length;
+  buffer->capacity  = toAllocate;
+  buffer->allocator = allocator;
+
+  if (buffer->data == NULL)
+    BufferOutOfMemory(toAllocate);
+
+  return buffer;
+}
+
+Buffer* BufferCreate(Buffer* buffer, uint64 length)
+{
+  return BufferCreateWith(buffer, length, &AllocatorHeap);
+}
+
+Buffer* BufferCreateCopy(Buffer* buffer, const uint8* data, uint64 length)
+{
+  buffer = BufferCreateWith(buffer, length, &AllocatorHeap);
 
   memcpy(buffer->data, data, length);
 
@@ -61,14 +94,9 @@ Buffer* BufferCreateCopy(Buffer* buffer, const uint8* data, uint64 length)
 
 Buffer* BufferClone(Buffer* buffer, const Buffer* other)
 {
-  if (buffer == NULL)
-    buffer = (Buffer*) malloc(sizeof(Buffer));
-
-  uint64 toAllocate = other->capacity;
+  buffer = BufferCreateWith(buffer, other->capacity, other->allocator);
 
-  buffer->data     = (uint8*) malloc(toAllocate);
-  buffer->length   = other->length;
-  buffer->capacity = toAllocate;
+  buffer->length = other->length;
 
   memcpy(buffer->data, other->data, other->length);
 
@@ -80,32 +108,92 @@ void BufferDestroy(Buffer* buffer)
   if (buffer == NULL)
     return;
 
-  while (buffer->length--)
-    buffer->data[buffer->length] = 0;
+  /* File mappings are read-only and hold nothing that needs wiping. */
+  if (buffer->allocator != &AllocatorMapping) {
+    while (buffer->length--)
+      buffer->data[buffer->length] = 0;
+  }
 
-  free(buffer->data);
+  buffer->allocator->release(buffer->allocator, buffer->data, buffer->capacity);
   free(buffer);
 }
 
+Buffer* BufferReserve(Buffer* buffer, uint64 capacity)
+{
+  DEBUG_ASSERT(buffer != NULL);
+
+  if (capacity <= buffer->capacity)
+    return buffer;
+
+  uint8* data = (uint8*) buffer->allocator->reallocate(buffer->allocator, buffer->data, buffer->capacity, capacity);
+
+  if (data == NULL)
+    BufferOutOfMemory(capacity);
+
+  buffer->data     = data;
+  buffer->capacity = capacity;
+
+  return buffer;
+}
+
 Buffer* BufferResize(Buffer* buffer, uint64 length)
 {
   if (buffer == NULL)
     return BufferCreate(buffer, length);
 
-  if (length <= buffer->capacity) {
-    buffer->length = length;
-    return buffer;
-  }
+  if (length > buffer->capacity)
+    BufferReserve(buffer, BufferGrowth(buffer->capacity, length));
 
-  uint64 toAllocate = length < ZQ_BUFFER_DEFAULT_CAPACITY ? ZQ_BUFFER_DEFAULT_CAPACITY : length;
+  buffer->length = length;
+
+  return buffer;
+}
 
-  buffer->data     = (uint8*) realloc(buffer->data, toAllocate);
-  buffer->length   = length;
-  buffer->capacity = toAllocate;
+Buffer* BufferMap(Buffer* buffer, FILE* stream)
+{
+  DEBUG_ASSERT(stream != NULL);
+
+  uint64 length = BufferSizeHint(stream);
+
+  if (length == 0)
+    return NULL;
+
+  /* mmap() offsets must be page-aligned; map from the page holding the current position. */
+  off_t position = ftello(stream);
+  off_t delta    = position % sysconf(_SC_PAGESIZE);
+  void* base     = mmap(NULL, length + delta, PROT_READ, MAP_PRIVATE, fileno(stream), position - delta);
+
+  if (base == MAP_FAILED)
+    return NULL;
+
+  madvise(base, length + delta, MADV_SEQUENTIAL);
+
+  if (buffer == NULL)
+    buffer = (Buffer*) malloc(sizeof(Buffer));
+
+  buffer->data      = (uint8*) base + delta;
+  buffer->length    = length;
+  buffer->capacity  = length;
+  buffer->allocator = &AllocatorMapping;
 
   return buffer;
 }
 
+uint64 BufferSizeHint(FILE* stream)
+{
+  struct stat status;
+
+  if (fstat(fileno(stream), &status) != 0 || !S_ISREG(status.st_mode))
+    return 0;
+
+  off_t position = ftello(stream);
+
+  if (position < 0 || position >= status.st_size)
+    return 0;
+
+  return (uint64) (status.st_size - position);
+}
+
 void BufferDebugPrint(const Buffer* buffer)
 {
   DEBUG_ASSERT(buffer != NULL);
@@ -127,28 +215,29 @@ void BufferDebugPrint(const Buffer* buffer)
 
 uint64 BufferPrintBase16(Buffer* buffer, FILE* stream)
 {
-  for (uint64 i = 0; i < buffer->length; i++) {
-    fprintf(stream, "%02x", buffer->data[i]);
+  Sink* sink = SinkCreate(NULL, stream, 0, SINK_NEWLINE_LF);
+
+  /* Encode straight into the sink's block, one block at a time. */
+  for (uint64 i = 0; i < buffer->length; i += ZQ_SINK_BLOCK_SIZE / 2) {
+    uint64 count = buffer->length - i < ZQ_SINK_BLOCK_SIZE / 2 ? buffer->length - i : ZQ_SINK_BLOCK_SIZE / 2;
+    char*  text  = SinkReserve(sink, 2 * count);
+
+    SinkCommit(sink, base16_encode(text, buffer->data + i, count));
   }
 
-  fflush(stream);
+  SinkDestroy(sink);
 
   return buffer->length * 2;
 }
 
 uint64 BufferPrintBase64(Buffer* buffer, FILE* stream)
 {
-  char*  encoded = malloc(2 * buffer->length); /* malloc(4 * ((buffer->length + 2) / 3)); */
+  Sink*  sink    = SinkCreate(NULL, stream, 76, SINK_NEWLINE_LF);
+  char*  encoded = malloc(4 * ((buffer->length + 2) / 3) + 1);
   uint64 length  = base64_encode(encoded, (char*) buffer->data, buffer->length);
 
-  for (int i = 0; i < length; i++) {
-    fprintf(stream, "%c", encoded[i]);
-
-    if ((i + 1) % 76 == 0)
-      fprintf(stream, "\n");
-  }
-
-  fflush(stream);
+  SinkWriteWrapped(sink, encoded, length);
+  SinkDestroy(sink);
 
   free(encoded);
 
@@ -160,20 +249,25 @@ uint64 BufferReadBase256(Buffer* buffer, FILE* stream)
   DEBUG_ASSERT(buffer != NULL);
   DEBUG_ASSERT(stream != NULL);
 
-  uint8* data = malloc(ZQ_MAX_BUFFER_SIZE);
+  uint64 hint = BufferSizeHint(stream);
+
+  /* Size a regular file's buffer once; the extra byte lets the final (empty) read proceed without growing. */
+  if (hint > 0)
+    BufferReserve(buffer, hint + 1);
 
   uint64 count = 0;
   uint64 total = 0;
 
-  while ((count = fread(data, 1, ZQ_MAX_BUFFER_SIZE, stream)) > 0) {
-    BufferResize(buffer, count + total);
-
-    memcpy(buffer->data + total, data, count);
+  do {
+    if (buffer->capacity - total < ZQ_BUFFER_READ_SIZE && (hint == 0 || total > hint))
+      BufferReserve(buffer, BufferGrowth(buffer->capacity, total + ZQ_BUFFER_READ_SIZE));
 
+    /* Read straight into the buffer; there is no intermediate copy. */
+    count = fread(buffer->data + total, 1, buffer->capacity - total, stream);
     total += count;
-  }
+  } while (count > 0);
 
-  free(data);
+  buffer->length = total;
 
   return total;
 }
@@ -183,41 +277,33 @@ uint64 BufferReadBase16(Buffer* buffer, FILE* stream)
   DEBUG_ASSERT(buffer != NULL);
   DEBUG_ASSERT(stream != NULL);
 
-  uint8* data = malloc(ZQ_MAX_BUFFER_SIZE);
+  char*          data = malloc(ZQ_BUFFER_READ_SIZE);
+  base16_decoder decoder;
 
   uint64 count = 0;
   uint64 total = 0;
 
-  while ((count = fread(data, 1, ZQ_MAX_BUFFER_SIZE, stream)) > 0) {
-    BufferResize(buffer, count + total);
-
-    for (int i = 0; i < count; i += 2) {
-      uint8 byte = 0;
-
-      if (data[i] >= '0' && data[i] <= '9')
-        byte = data[i] - '0';
-      else if (data[i] >= 'a' && data[i] <= 'f')
-        byte = data[i] - 'a' + 10;
-      else if (data[i] >= 'A' && data[i] <= 'F')
-        byte = data[i] - 'A' + 10;
-      else
-        continue;
-
-      byte <<= 4;
-
-      if (data[i + 1] >= '0' && data[i + 1] <= '9')
-        byte |= data[i + 1] - '0';
-      else if (data[i + 1] >= 'a' && data[i + 1] <= 'f')
-        byte |= data[i + 1] - 'a' + 10;
-      else if (data[i + 1] >= 'A' && data[i + 1] <= 'F')
-        byte |= data[i + 1] - 'A' + 10;
-      else
-        continue;
-
-      buffer->data[total++] = byte;
+  base16_decoder_init(&decoder);
+
+  while ((count = fread(data, 1, ZQ_BUFFER_READ_SIZE, stream)) > 0) {
+    BufferResize(buffer, total + count / 2 + 1);
+
+    /* Pairs and comments split across reads are carried in the decoder. */
+    uint64 decoded = base16_decoder_update(&decoder, buffer->data + total, data, count);
+
+    if (decoded == BASE16_INVALID) {
+      fprintf(stderr, "ERROR: Invalid base16 input!\n");
+      exit(EXIT_FAILURE);
     }
+
+    total += decoded;
   }
 
+  if (!base16_decoder_final(&decoder))
+    fprintf(stderr, "WARNING: Ignoring trailing half-byte in base16 input!\n");
+
+  buffer->length = total;
+
   free(data);
 
   return total;
@@ -228,33 +314,38 @@ uint64 BufferReadBase64(Buffer* buffer, FILE* stream)
   DEBUG_ASSERT(buffer != NULL);
   DEBUG_ASSERT(stream != NULL);
 
-  Buffer* readBuffer = BufferCreate(NULL, ZQ_MAX_BUFFER_SIZE);
+  char*          data = malloc(ZQ_BUFFER_READ_SIZE);
+  base64_decoder decoder;
 
-  char* data = malloc(ZQ_MAX_BUFFER_SIZE);
+  uint64 count    = 0;
+  uint64 total    = 0;
+  uint64 consumed = 0;
 
-  uint64 count = 0;
-  uint64 total = 0;
+  base64_decoder_init(&decoder);
 
-  while ((count = fread(data, 1, ZQ_MAX_BUFFER_SIZE, stream)) > 0) {
-    BufferResize(readBuffer, count + total);
-    memcpy(readBuffer->data + total, data, count);
-    memset(data, 0, ZQ_MAX_BUFFER_SIZE);
-    total += count;
-  }
+  while ((count = fread(data, 1, ZQ_BUFFER_READ_SIZE, stream)) > 0) {
+    BufferResize(buffer, total + count / 4 * 3 + 3);
+
+    /* Quanta and comments split across reads are carried in the decoder. */
+    uint64 decoded = base64_decoder_update(&decoder, buffer->data + total, data, count);
 
-  uint8* sanitized        = malloc(total);
-  uint64 sanitized_length = base64_sanitize(sanitized, readBuffer->data, total);
+    if (decoded == BASE64_INVALID) {
+      fprintf(stderr, "ERROR: Invalid base64 input!\n");
+      exit(EXIT_FAILURE);
+    }
 
-  fprintf(stderr, "\n\n");
-  fprintf(stderr, "sanitized: %s\n", sanitized);
-  fprintf(stderr, "sanitized_length: %lu\n", sanitized_length);
+    total += decoded;
+    consumed += count;
+  }
 
-  buffer->length = base64_decode(buffer->data, sanitized, sanitized_length);
+  if (!base64_decoder_final(&decoder)) {
+    fprintf(stderr, "ERROR: Truncated base64 input!\n");
+    exit(EXIT_FAILURE);
+  }
 
-  BufferDebugPrint(buffer);
+  buffer->length = total;
 
-  free(sanitized);
   free(data);
 
-  return total;
-}
\ No newline at end of file
+  return consumed;
+}
@@ -24,12 +24,16 @@
 #ifndef _ZIGMATIQ_BUFFER_H_
 #define _ZIGMATIQ_BUFFER_H_
 
-#include "buffer.h"
+#include <stdio.h>
 
+#include "allocator.h"
 #include "typedef.h"
 
 #define ZQ_BUFFER_DEFAULT_CAPACITY (1024 * 1024) /* 1MB */
 
+/* Minimum free space requested from the stream on each read. */
+#define ZQ_BUFFER_READ_SIZE (64 * 1024) /* 64KB */
+
 /* Unified "binary-string" object for manipulation.
  * The buffer object is a simple wrapper around a uint8 array.
  */
@@ -42,6 +46,9 @@ typedef struct Buffer {
 
   /* The capacity of the data array. */
   uint64 capacity;
+
+  /* Where the data array comes from. */
+  Allocator* allocator;
 } Buffer; /* Buffer */
 
 /* Initialize a buffer object.
@@ -53,6 +60,16 @@ typedef struct Buffer {
  */
 Buffer* BufferCreate(Buffer* buffer, uint64 length);
 
+/* Initialize a buffer object backed by a specific allocator.
+ * Will always allocate at least ZQ_BUFFER_DEFAULT_CAPACITY bytes.
+ *   @param buffer The buffer object.
+ *   @param length The requested length.
+ *   @param allocator The allocator, or NULL for the heap.
+ *   @return The buffer object.
+ *   @note If buffer is NULL, a new buffer object will be allocated.
+ */
+Buffer* BufferCreateWith(Buffer* buffer, uint64 length, Allocator* allocator);
+
 /* Create a new buffer from a uint8 array.
  *   @param buffer The buffer object.
  *   @param data The data array.
@@ -75,13 +92,36 @@ Buffer* BufferClone(Buffer* buffer, const Buffer* other);
  */
 void BufferDestroy(Buffer* buffer);
 
-/* Resize a buffer object.
+/* Resize a buffer object. The capacity grows geometrically, so appending n bytes piecemeal costs O(log n)
+ * reallocations rather than one per call.
  *   @param buffer The buffer object.
  *   @param length The new length.
  *   @return The buffer object.
  */
 Buffer* BufferResize(Buffer* buffer, uint64 length);
 
+/* Ensure a buffer can hold `capacity` bytes without reallocating. The length is unchanged.
+ *   @param buffer The buffer object.
+ *   @param capacity The minimum capacity.
+ *   @return The buffer object.
+ */
+Buffer* BufferReserve(Buffer* buffer, uint64 capacity);
+
+/* Map the remainder of a regular file read-only instead of copying it onto the heap. The mapping shares the
+ * page cache, so no private copy of the file is made. The returned buffer must not be written to or resized.
+ *   @param buffer The buffer object.
+ *   @param stream The stream to map, from its current position to the end of the file.
+ *   @return The buffer object, or NULL if the stream is not a non-empty regular file or cannot be mapped.
+ *   @note If buffer is NULL, a new buffer object will be allocated.
+ */
+Buffer* BufferMap(Buffer* buffer, FILE* stream);
+
+/* Estimate how many bytes remain to be read from a stream.
+ *   @param stream The stream.
+ *   @return The bytes between the current position and the end of a regular file, or 0 if unknown.
+ */
+uint64 BufferSizeHint(FILE* stream);
+
 void BufferDebugPrint(const Buffer* buffer);
 
 /* Print a buffer to a stream in base16.
@@ -0,0 +1,394 @@
+/*
+ * ZIGMA, Copyright (C) 2024 Chase Zehl O'Byrne
+ *   <mail: zehl@live.com> http://zehlchen.com/
+ *
+ * This file is part of ZIGMA.
+ *
+ * ZIGMA is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ZIGMA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ZIGMA; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+
+#include "common.h"
+
+#include "base16.h"
+#include "base64.h"
+#include "check.h"
+#include "stream.h"
+#include "zigma.h"
+
+/* Lengths of a digest in each text encoding. */
+#define CHECK_BASE16_LENGTH (2 * ZIGMA_CHECKSUM_SIZE)
+#define CHECK_BASE64_LENGTH (4 * ((ZIGMA_CHECKSUM_SIZE + 2) / 3))
+
+/* A unit of work for the pool: one entry of a list. */
+typedef struct CheckTask {
+  CheckList*  list;
+  CheckEntry* entry;
+} CheckTask;
+
+/* Append an entry and return it. */
+static CheckEntry* CheckListAppend(CheckList* list, const char* path)
+{
+  if (list->count == list->capacity) {
+    list->capacity = list->capacity == 0 ? 64 : 2 * list->capacity;
+    list->entries  = (CheckEntry*) realloc(list->entries, list->capacity * sizeof(CheckEntry));
+
+    DEBUG_ASSERT(list->entries != NULL);
+  }
+
+  CheckEntry* entry = &list->entries[list->count++];
+
+  memset(entry, 0, sizeof(CheckEntry));
+
+  entry->path         = strdup(path);
+  entry->expectedSize = -1;
+
+  return entry;
+}
+
+/* Remove a trailing newline (and carriage return) from a line read by getline(). */
+static void CheckTrimLine(char* line, ssize_t* length)
+{
+  while (*length > 0 && (line[*length - 1] == '\n' || line[*length - 1] == '\r'))
+    line[--*length] = '\0';
+}
+
+CheckList* CheckListCreate(CheckList* list, uint32 format)
+{
+  if (list == NULL)
+    list = (CheckList*) malloc(sizeof(CheckList));
+
+  DEBUG_ASSERT(list != NULL);
+
+  list->entries   = NULL;
+  list->count     = 0;
+  list->capacity  = 0;
+  list->format    = format;
+  list->malformed = 0;
+
+  pthread_mutex_init(&list->lock, NULL);
+  pthread_cond_init(&list->finished, NULL);
+
+  return list;
+}
+
+void CheckListAdd(CheckList* list, const char* path)
+{
+  DEBUG_ASSERT(list != NULL);
+  DEBUG_ASSERT(path != NULL);
+
+  struct stat info;
+
+  if (strcmp(path, "-") == 0 || stat(path, &info) != 0 || !S_ISDIR(info.st_mode)) {
+    CheckListAppend(list, path);
+    return;
+  }
+
+  /* Sorting keeps the report in the same order from run to run, whatever order the filesystem lists. */
+  struct dirent** names;
+  int             count = scandir(path, &names, NULL, alphasort);
+
+  if (count < 0) {
+    CheckListAppend(list, path)->error = errno;
+    return;
+  }
+
+  uint64 base = strlen(path);
+
+  while (base > 1 && path[base - 1] == '/')
+    base--;
+
+  for (int i = 0; i < count; i++) {
+    const char* name = names[i]->d_name;
+
+    if (strcmp(name, ".") != 0 && strcmp(name, "..") != 0) {
+      char* child = (char*) malloc(base + strlen(name) + 2);
+
+      sprintf(child, "%.*s/%s", (int) base, path, name);
+
+      /* Descend into real directories only, so symbolic links cannot make the walk loop. Links to files are
+       * hashed; sockets, devices and pipes are skipped.
+       */
+      if (lstat(child, &info) == 0) {
+        if (S_ISDIR(info.st_mode))
+          CheckListAdd(list, child);
+        else if (S_ISREG(info.st_mode) || (S_ISLNK(info.st_mode) && stat(child, &info) == 0 && S_ISREG(info.st_mode)))
+          CheckListAppend(list, child);
+      }
+
+      free(child);
+    }
+
+    free(names[i]);
+  }
+
+  free(names);
+}
+
+void CheckListAddFrom(CheckList* list, FILE* stream)
+{
+  DEBUG_ASSERT(list != NULL);
+  DEBUG_ASSERT(stream != NULL);
+
+  char*   line     = NULL;
+  size_t  capacity = 0;
+  ssize_t length;
+
+  while ((length = getline(&line, &capacity, stream)) >= 0) {
+    CheckTrimLine(line, &length);
+
+    if (length > 0)
+      CheckListAdd(list, line);
+  }
+
+  free(line);
+}
+
+void CheckListAddManifest(CheckList* list, FILE* stream)
+{
+  DEBUG_ASSERT(list != NULL);
+  DEBUG_ASSERT(stream != NULL);
+
+  char*   line     = NULL;
+  size_t  capacity = 0;
+  ssize_t length;
+
+  while ((length = getline(&line, &capacity, stream)) >= 0) {
+    CheckTrimLine(line, &length);
+
+    if (length == 0 || line[0] == '#')
+      continue;
+
+    /* DIGEST, then two spaces (or a space and '*', as other tools write), then the path. */
+    char* separator = strchr(line, ' ');
+
+    if (separator == NULL || separator == line || (separator[1] != ' ' && separator[1] != '*') ||
+        separator[2] == '\0') {
+      list->malformed++;
+      continue;
+    }
+
+    char* path   = separator + 2;
+    char* suffix = strrchr(path, '(');
+    int64 size   = -1;
+
+    /* An optional " (SIZE)" suffix; anything else in parentheses is part of the path. */
+    if (suffix != NULL && suffix > path && suffix[-1] == ' ' && line[length - 1] == ')') {
+      char* end;
+
+      size = (int64) strtoull(suffix + 1, &end, 10);
+
+      if (end == suffix + 1 || end != line + length - 1)
+        size = -1;
+      else
+        suffix[-1] = '\0';
+    }
+
+    *separator = '\0';
+
+    CheckEntry* entry = CheckListAppend(list, path);
+
+    entry->expected     = strdup(line);
+    entry->expectedSize = size;
+  }
+
+  free(line);
+}
+
+/* Hash one file; runs on a pool worker. */
+static void CheckHash(void* argument)
+{
+  CheckTask*  task  = (CheckTask*) argument;
+  CheckEntry* entry = task->entry;
+
+  if (entry->error == 0) {
+    FILE* stream = strcmp(entry->path, "-") == 0 ? stdin : fopen(entry->path, "r");
+
+    if (stream == NULL) {
+      entry->error = errno;
+    }
+    else {
+      struct stat info;
+
+      if (fstat(fileno(stream), &info) == 0 && S_ISDIR(info.st_mode)) {
+        entry->error = EISDIR;
+      }
+      else {
+        ZigmaContext  context;
+        StreamReader* reader = StreamReaderCreate(NULL, stream, task->list->format);
+        uint8*        block  = (uint8*) malloc(ZQ_STREAM_BLOCK_SIZE);
+        const uint8*  source;
+        uint64        count;
+
+        ZigmaHashInit(&context);
+
+        /* Memory use is one block whatever the file size; mapped files are hashed straight from the page cache. */
+        while ((count = StreamReaderAcquire(reader, &source, block, ZQ_STREAM_BLOCK_SIZE)) > 0) {
+          ZigmaHashUpdate(&context, source, count);
+          entry->size += count;
+        }
+
+        ZigmaHashFinal(&context, entry->digest, ZIGMA_CHECKSUM_SIZE);
+
+        StreamReaderDestroy(reader);
+
+        free(block);
+      }
+
+      if (stream != stdin)
+        fclose(stream);
+    }
+  }
+
+  pthread_mutex_lock(&task->list->lock);
+
+  entry->done = 1;
+
+  pthread_cond_broadcast(&task->list->finished);
+  pthread_mutex_unlock(&task->list->lock);
+}
+
+/* Write the result line for a finished entry.
+ *   @return 1 if the entry counts as a failure, otherwise 0.
+ */
+static int CheckReport(CheckEntry* entry, Sink* sink, uint32 digestFormat)
+{
+  uint64 pathLength = strlen(entry->path);
+  char*  line       = (char*) malloc(CHECK_BASE16_LENGTH + pathLength + 64);
+  char   digest[CHECK_BASE16_LENGTH + 1];
+  int    failed = 0;
+  int    length;
+
+  if (entry->expected != NULL) {
+    int matches = 0;
+
+    /* The manifest's digest length tells which encoding it was written in. */
+    if (entry->error == 0 && strlen(entry->expected) == CHECK_BASE16_LENGTH) {
+      base16_encode(digest, entry->digest, ZIGMA_CHECKSUM_SIZE);
+      matches = strncasecmp(digest, entry->expected, CHECK_BASE16_LENGTH) == 0;
+    }
+    else if (entry->error == 0 && strlen(entry->expected) == CHECK_BASE64_LENGTH) {
+      base64_encode(digest, (const char*) entry->digest, ZIGMA_CHECKSUM_SIZE);
+      matches = strncmp(digest, entry->expected, CHECK_BASE64_LENGTH) == 0;
+    }
+
+    if (entry->expectedSize >= 0 && (uint64) entry->expectedSize != entry->size)
+      matches = 0;
+
+    failed = !matches;
+    length = sprintf(line, "%s: %s\n", entry->path,
+                     matches ? "OK" : (entry->error != 0 ? "FAILED open or read" : "FAILED"));
+  }
+  else if (entry->error != 0) {
+    fprintf(stderr, "WARNING: %s: %s!\n", entry->path, strerror(entry->error));
+
+    failed = 1;
+    length = 0;
+  }
+  else {
+    uint64 digestLength = digestFormat == 64 ? base64_encode(digest, (const char*) entry->digest, ZIGMA_CHECKSUM_SIZE)
+                                             : base16_encode(digest, entry->digest, ZIGMA_CHECKSUM_SIZE);
+
+    length = sprintf(line, "%.*s  %s (%" PRIu64 ")\n", (int) digestLength, digest, entry->path, entry->size);
+  }
+
+  SinkWrite(sink, line, length);
+
+  free(line);
+
+  return failed;
+}
+
+uint64 CheckListRun(CheckList* list, Pool* pool, Sink* sink, uint32 digestFormat)
+{
+  DEBUG_ASSERT(list != NULL);
+  DEBUG_ASSERT(pool != NULL);
+  DEBUG_ASSERT(sink != NULL);
+
+  CheckTask* tasks     = (CheckTask*) malloc((list->count + 1) * sizeof(CheckTask));
+  uint64     window    = (uint64) pool->count * ZQ_CHECK_WINDOW_PER_WORKER;
+  uint64     submitted = 0;
+  uint64     failures  = 0;
+  uint64     verified  = 0;
+
+  for (uint64 i = 0; i < list->count; i++) {
+    CheckEntry* entry = &list->entries[i];
+
+    /* Keep a bounded number of files in flight ahead of the one being reported. */
+    for (; submitted < list->count && submitted < i + window; submitted++) {
+      tasks[submitted].list  = list;
+      tasks[submitted].entry = &list->entries[submitted];
+
+      PoolSubmit(pool, CheckHash, &tasks[submitted]);
+    }
+
+    pthread_mutex_lock(&list->lock);
+
+    if (!entry->done) {
+      /* Let finished lines out while waiting on a slow file. */
+      pthread_mutex_unlock(&list->lock);
+      SinkFlush(sink);
+      pthread_mutex_lock(&list->lock);
+
+      while (!entry->done)
+        pthread_cond_wait(&list->finished, &list->lock);
+    }
+
+    pthread_mutex_unlock(&list->lock);
+
+    failures += CheckReport(entry, sink, digestFormat);
+    verified += entry->expected != NULL;
+  }
+
+  PoolWait(pool);
+
+  SinkFlush(sink);
+
+  if (list->malformed > 0)
+    fprintf(stderr, "WARNING: %" PRIu64 " line(s) of the manifest are improperly formatted!\n", list->malformed);
+
+  if (verified > 0 && failures > 0)
+    fprintf(stderr, "WARNING: %" PRIu64 " of %" PRIu64 " computed checksums did NOT match!\n", failures, verified);
+
+  free(tasks);
+
+  return failures;
+}
+
+void CheckListDestroy(CheckList* list)
+{
+  if (list == NULL)
+    return;
+
+  for (uint64 i = 0; i < list->count; i++) {
+    free(list->entries[i].path);
+    free(list->entries[i].expected);
+  }
+
+  pthread_mutex_destroy(&list->lock);
+  pthread_cond_destroy(&list->finished);
+
+  free(list->entries);
+  free(list);
+}
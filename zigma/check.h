@@ -0,0 +1,120 @@
+/*
+ * ZIGMA, Copyright (C) 2024 Chase Zehl O'Byrne
+ *   <mail: zehl@live.com> http://zehlchen.com/
+ *
+ * This file is part of ZIGMA.
+ *
+ * ZIGMA is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ZIGMA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ZIGMA; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#pragma once
+#ifndef _ZIGMATIQ_CHECK_H_
+#define _ZIGMATIQ_CHECK_H_
+
+#include <pthread.h>
+#include <stdio.h>
+
+#include "common.h"
+
+#include "pool.h"
+#include "sink.h"
+
+/* Number of files hashed ahead of the one being reported, per worker. */
+#define ZQ_CHECK_WINDOW_PER_WORKER 4
+
+/* A file to be hashed and, in verify mode, the digest it is expected to have. */
+typedef struct CheckEntry {
+  /* The path of the file, or "-" for stdin. */
+  char* path;
+
+  /* Verify mode: the digest text from the manifest, or NULL. */
+  char* expected;
+
+  /* Verify mode: the size from the manifest, or -1 if it was not recorded. */
+  int64 expectedSize;
+
+  /* The computed digest and the number of bytes hashed. */
+  uint8  digest[ZIGMA_CHECKSUM_SIZE];
+  uint64 size;
+
+  /* errno if the file could not be opened or read, otherwise 0. */
+  int error;
+
+  /* Set by the worker once the entry has been hashed. */
+  int done;
+} CheckEntry;
+
+/* An ordered list of files to hash. Results are reported in this order whatever order they finish in.
+ */
+typedef struct CheckList {
+  CheckEntry* entries;
+  uint64      count;
+  uint64      capacity;
+
+  /* The base encoding of the files' contents (16, 64, 256). */
+  uint32 format;
+
+  /* Number of manifest lines that could not be parsed. */
+  uint64 malformed;
+
+  /* Signals the reporting thread when an entry is done. */
+  pthread_mutex_t lock;
+  pthread_cond_t  finished;
+} CheckList;
+
+/* Initialize an empty list.
+ *   @param list The list object, or NULL to allocate one.
+ *   @param format The base encoding of the files' contents.
+ *   @return The list object.
+ */
+CheckList* CheckListCreate(CheckList* list, uint32 format);
+
+/* Add a file, or every regular file below a directory (in name order). Paths that cannot be examined are added
+ * anyway so the error is reported in sequence.
+ *   @param list The list object.
+ *   @param path The file or directory.
+ */
+void CheckListAdd(CheckList* list, const char* path);
+
+/* Add every path named in a file list, one per line.
+ *   @param list The list object.
+ *   @param stream The file list.
+ */
+void CheckListAddFrom(CheckList* list, FILE* stream);
+
+/* Add the entries of a digest manifest, as written by `check`: a digest, two spaces, and a path, optionally
+ * followed by " (SIZE)". Blank lines and lines starting with '#' are skipped.
+ *   @param list The list object.
+ *   @param stream The manifest.
+ */
+void CheckListAddManifest(CheckList* list, FILE* stream);
+
+/* Hash every entry on the pool and write one line per entry to the sink, in list order. Without a manifest a
+ * line is "DIGEST  PATH (SIZE)"; in verify mode it is "PATH: OK" or "PATH: FAILED".
+ *   @param list The list object.
+ *   @param pool The workers to hash on.
+ *   @param sink The destination of the report.
+ *   @param digestFormat The base encoding of digests (16 or 64).
+ *   @return The number of entries that could not be read or did not match.
+ */
+uint64 CheckListRun(CheckList* list, Pool* pool, Sink* sink, uint32 digestFormat);
+
+/* Release a list and its entries.
+ *   @param list The list object.
+ */
+void CheckListDestroy(CheckList* list);
+
+#endif /* _ZIGMATIQ_CHECK_H_ */
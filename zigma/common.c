@@ -20,10 +20,16 @@
  *
  */
 
+#ifdef __linux__
+#define _GNU_SOURCE /* F_SETPIPE_SZ */
+#endif
+
 #include <errno.h>
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #ifdef __linux__
@@ -42,6 +48,38 @@ void Nullify(void* ptr, uint64 size)
     *_ptr++ = 0;
 }
 
+void PackUint32(uint8* data, uint32 value)
+{
+  for (int i = 0; i < 4; i++)
+    data[i] = (uint8) (value >> (8 * i));
+}
+
+void PackUint64(uint8* data, uint64 value)
+{
+  for (int i = 0; i < 8; i++)
+    data[i] = (uint8) (value >> (8 * i));
+}
+
+uint32 UnpackUint32(const uint8* data)
+{
+  uint32 value = 0;
+
+  for (int i = 3; i >= 0; i--)
+    value = (value << 8) | data[i];
+
+  return value;
+}
+
+uint64 UnpackUint64(const uint8* data)
+{
+  uint64 value = 0;
+
+  for (int i = 7; i >= 0; i--)
+    value = (value << 8) | data[i];
+
+  return value;
+}
+
 uint32 uint32_min(uint32 a, uint32 b)
 {
   return (a < b) ? a : b;
@@ -127,6 +165,28 @@ void PrintHex(Buffer* buffer)
   fprintf(stderr, "\n");
 }
 
+uint64 PipeEnlarge(int descriptor)
+{
+  struct stat info;
+
+  if (fstat(descriptor, &info) != 0 || !S_ISFIFO(info.st_mode))
+    return 0;
+
+#ifdef F_SETPIPE_SZ
+  /* Unprivileged processes are capped at /proc/sys/fs/pipe-max-size; settle for the largest size allowed. */
+  for (int size = ZQ_PIPE_SIZE; size > 4096; size /= 2) {
+    if (fcntl(descriptor, F_SETPIPE_SZ, size) >= 0)
+      break;
+  }
+
+  int size = fcntl(descriptor, F_GETPIPE_SZ);
+
+  return size > 0 ? (uint64) size : 0;
+#else
+  return 0;
+#endif
+}
+
 FILE* OpenFile(const char* filename, const char* mode)
 {
   FILE* file = fopen(filename, mode);
@@ -58,6 +58,18 @@ unsigned long CaptureKey(uint8* buffer, const uint8* prompt);
 
 FILE* OpenFile(const char* filename, const char* mode);
 
+/* The capacity asked of pipes by PipeEnlarge(). */
+#ifndef ZQ_PIPE_SIZE
+#define ZQ_PIPE_SIZE (1024 * 1024) /* 1MB */
+#endif
+
+/* Grow the kernel buffer of a pipe to ZQ_PIPE_SIZE (or as close as the system allows), so the other end is stalled
+ * less often and each read or write moves more at once.
+ *   @param descriptor The descriptor to grow.
+ *   @return The capacity of the pipe, or 0 if the descriptor is not a pipe.
+ */
+uint64 PipeEnlarge(int descriptor);
+
 /* Define the length in bytes of the checksum. */
 #ifndef ZIGMA_CHECKSUM_SIZE
 #define ZIGMA_CHECKSUM_SIZE 36 /* 288 bits */
@@ -91,4 +103,18 @@ FILE* OpenFile(const char* filename, const char* mode);
  *   @param size The size of the memory location.
  */
 void Nullify(void* ptr, uint64 size);
+
+/* Store an integer in little-endian byte order, independent of the host.
+ *   @param data The destination (4 or 8 bytes).
+ *   @param value The value to store.
+ */
+void PackUint32(uint8* data, uint32 value);
+void PackUint64(uint8* data, uint64 value);
+
+/* Load an integer stored in little-endian byte order.
+ *   @param data The source (4 or 8 bytes).
+ *   @return The value.
+ */
+uint32 UnpackUint32(const uint8* data);
+uint64 UnpackUint64(const uint8* data);
 #endif /* _ZIGMATIQ_COMMON_H_ */
\ No newline at end of file
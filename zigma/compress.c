@@ -0,0 +1,191 @@
+/*
+ * ZIGMA, Copyright (C) 2024 Chase Zehl O'Byrne
+ *   <mail: zehl@live.com> http://zehlchen.com/
+ *
+ * This file is part of ZIGMA.
+ *
+ * ZIGMA is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ZIGMA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ZIGMA; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+
+#include "buffer.h"
+#include "compress.h"
+#include "lz.h"
+#include "stream.h"
+#include "zigma.h"
+
+/* Take back the output written so far, where possible, and exit with an error. */
+static void CompressCorrupt(StreamWriter* writer, const char* reason)
+{
+  SinkDiscard(writer->sink);
+
+  fprintf(stderr, "ERROR: Corrupt compressed stream (or wrong key): %s!\n", reason);
+  exit(EXIT_FAILURE);
+}
+
+/* Cipher `length` bytes in place and record the time. */
+static void CompressCipher(ZigmaContext* context, StreamDirection direction, StreamWriter* writer, uint8* data,
+                           uint64 length)
+{
+  uint64 start = StatsStart(writer->stats);
+
+  if (direction == STREAM_ENCODE)
+    ZigmaEncodeBlock(context, data, data, length);
+  else
+    ZigmaDecodeBlock(context, data, data, length);
+
+  StatsAdd(writer->stats, STATS_CIPHER, start, length);
+}
+
+uint64 CompressEncode(ZigmaContext* context, StreamReader* reader, StreamWriter* writer, ZigmaContext* tag)
+{
+  DEBUG_ASSERT(context != NULL);
+  DEBUG_ASSERT(reader != NULL);
+  DEBUG_ASSERT(writer != NULL);
+
+  Buffer* block   = BufferCreate(NULL, ZQ_COMPRESS_BLOCK_SIZE);
+  Buffer* packed  = BufferCreate(NULL, ZQ_COMPRESS_BLOCK_SIZE);
+  uint8   field[4];
+  uint32  skip    = 0;
+  uint32  backoff = 1;
+  uint64  total   = 0;
+
+  while ((block->length = StreamReaderReadFull(reader, block->data, ZQ_COMPRESS_BLOCK_SIZE)) > 0) {
+    if (tag != NULL)
+      ZigmaHashUpdate(tag, block->data, block->length);
+
+    uint64 start = StatsStart(writer->stats);
+
+    /* Only a saving of at least 1/32 is worth the decompression. */
+    packed->length = 0;
+
+    if (skip > 0)
+      skip--;
+    else if ((packed->length = LzCompress(packed->data, block->length - (block->length >> 5), block->data,
+                                          block->length)) > 0)
+      backoff = 1;
+    else {
+      skip    = backoff;
+      backoff = backoff < ZQ_COMPRESS_MAX_BACKOFF ? backoff * 2 : ZQ_COMPRESS_MAX_BACKOFF;
+    }
+
+    Buffer* payload = packed->length > 0 ? packed : block;
+
+    StatsAdd(writer->stats, STATS_COMPRESS, start, block->length);
+
+    PackUint32(field, (uint32) payload->length | (payload == block ? ZQ_COMPRESS_STORED : 0));
+
+    CompressCipher(context, STREAM_ENCODE, writer, field, 4);
+    CompressCipher(context, STREAM_ENCODE, writer, payload->data, payload->length);
+
+    StreamWriterWrite(writer, field, 4);
+    StreamWriterWrite(writer, payload->data, payload->length);
+
+    total += block->length;
+  }
+
+  PackUint32(field, 0);
+  CompressCipher(context, STREAM_ENCODE, writer, field, 4);
+  StreamWriterWrite(writer, field, 4);
+
+  if (tag != NULL)
+    StreamTagFinish(tag, STREAM_ENCODE, reader, writer);
+
+  /* BufferDestroy() only wipes `length` bytes; both blocks held plaintext. */
+  block->length  = block->capacity;
+  packed->length = packed->capacity;
+
+  BufferDestroy(block);
+  BufferDestroy(packed);
+
+  return total;
+}
+
+uint64 CompressDecode(ZigmaContext* context, StreamReader* reader, StreamWriter* writer, ZigmaContext* tag)
+{
+  DEBUG_ASSERT(context != NULL);
+  DEBUG_ASSERT(reader != NULL);
+  DEBUG_ASSERT(writer != NULL);
+
+  Buffer* block  = BufferCreate(NULL, ZQ_COMPRESS_BLOCK_SIZE);
+  Buffer* packed = BufferCreate(NULL, ZQ_COMPRESS_BLOCK_SIZE);
+  uint8   field[4];
+  uint64  total  = 0;
+
+  if (tag != NULL)
+    StreamReaderHoldBack(reader, ZQ_STREAM_TAG_SIZE);
+
+  while (1) {
+    if (StreamReaderReadFull(reader, field, 4) != 4)
+      CompressCorrupt(writer, "missing end marker");
+
+    CompressCipher(context, STREAM_DECODE, writer, field, 4);
+
+    uint32 header = UnpackUint32(field);
+
+    if (header == 0)
+      break;
+
+    packed->length = header & ~ZQ_COMPRESS_STORED;
+
+    if (packed->length == 0 || packed->length > ZQ_COMPRESS_BLOCK_SIZE)
+      CompressCorrupt(writer, "invalid frame length");
+
+    if (StreamReaderReadFull(reader, packed->data, packed->length) != packed->length)
+      CompressCorrupt(writer, "truncated frame");
+
+    CompressCipher(context, STREAM_DECODE, writer, packed->data, packed->length);
+
+    Buffer* plain = packed;
+    uint64  start = StatsStart(writer->stats);
+
+    if ((header & ZQ_COMPRESS_STORED) == 0) {
+      if (!LzDecompress(block->data, ZQ_COMPRESS_BLOCK_SIZE, packed->data, packed->length, &block->length))
+        CompressCorrupt(writer, "malformed compressed block");
+
+      plain = block;
+    }
+
+    StatsAdd(writer->stats, STATS_COMPRESS, start, plain->length);
+
+    if (tag != NULL)
+      ZigmaHashUpdate(tag, plain->data, plain->length);
+
+    StreamWriterWrite(writer, plain->data, plain->length);
+
+    total += plain->length;
+  }
+
+  /* Reaching the end of the input also makes the held-back tag available. */
+  if (StreamReaderRead(reader, packed->data, ZQ_COMPRESS_BLOCK_SIZE) != 0)
+    CompressCorrupt(writer, "data after the end marker");
+
+  if (tag != NULL)
+    StreamTagFinish(tag, STREAM_DECODE, reader, writer);
+
+  block->length  = block->capacity;
+  packed->length = packed->capacity;
+
+  BufferDestroy(block);
+  BufferDestroy(packed);
+
+  return total;
+}
@@ -0,0 +1,68 @@
+/*
+ * ZIGMA, Copyright (C) 2024 Chase Zehl O'Byrne
+ *   <mail: zehl@live.com> http://zehlchen.com/
+ *
+ * This file is part of ZIGMA.
+ *
+ * ZIGMA is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ZIGMA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ZIGMA; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#pragma once
+#ifndef _ZIGMATIQ_COMPRESS_H_
+#define _ZIGMATIQ_COMPRESS_H_
+
+#include "common.h"
+
+#include "lz.h"
+#include "stream.h"
+#include "zigma.h"
+
+/* A compressed stream is the plaintext cut into blocks of ZQ_COMPRESS_BLOCK_SIZE bytes, each compressed with
+ * LzCompress() or stored as is when that does not save anything, and run through one cipher stream:
+ *
+ *   frames:  header (4) | payload, ..., 0 (4)
+ *
+ * The header holds the payload length, with ZQ_COMPRESS_STORED set for a stored block. Headers are ciphered along
+ * with the payloads, so nothing about the plaintext is visible but the total length.
+ */
+#define ZQ_COMPRESS_BLOCK_SIZE ZQ_LZ_BLOCK_MAX
+#define ZQ_COMPRESS_STORED     (1U << 31)
+
+/* After a block fails to compress, this many following blocks are stored without trying, doubling with each further
+ * failure up to ZQ_COMPRESS_MAX_BACKOFF, so incompressible input costs next to nothing.
+ */
+#define ZQ_COMPRESS_MAX_BACKOFF 16
+
+/* Compress and encode the input.
+ *   @param context The cipher context.
+ *   @param reader The source of the plaintext.
+ *   @param writer The destination of the compressed stream.
+ *   @param tag A keyed hash context for the integrity tag, as for `StreamCipher()`, or NULL for none.
+ *   @return The number of plaintext bytes encoded.
+ */
+uint64 CompressEncode(ZigmaContext* context, StreamReader* reader, StreamWriter* writer, ZigmaContext* tag);
+
+/* Decode and decompress a compressed stream. A malformed frame, which is also what a wrong key usually produces, is
+ * an error.
+ *   @param context The cipher context.
+ *   @param reader The source of the compressed stream.
+ *   @param writer The destination of the plaintext.
+ *   @param tag A keyed hash context for the integrity tag, as for `StreamCipher()`, or NULL for none.
+ *   @return The number of plaintext bytes decoded.
+ */
+uint64 CompressDecode(ZigmaContext* context, StreamReader* reader, StreamWriter* writer, ZigmaContext* tag);
+
+#endif /* _ZIGMATIQ_COMPRESS_H_ */
@@ -0,0 +1,333 @@
+/*
+ * ZIGMA, Copyright (C) 2024 Chase Zehl O'Byrne
+ *   <mail: zehl@live.com> http://zehlchen.com/
+ *
+ * This file is part of ZIGMA.
+ *
+ * ZIGMA is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ZIGMA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ZIGMA; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+
+#include "buffer.h"
+#include "container.h"
+#include "pool.h"
+#include "stream.h"
+#include "zigma.h"
+
+/* One set of chunks handed to the pool at a time. Two batches alternate so the next one can be read while the
+ * workers are busy with the current one.
+ */
+typedef struct ContainerBatch {
+  ContainerChunk* chunks;
+
+  /* Number of chunk slots. */
+  uint32 width;
+
+  /* Number of slots filled by the last read. */
+  uint32 count;
+} ContainerBatch;
+
+static void ContainerCorrupt(const char* reason)
+{
+  fprintf(stderr, "ERROR: Corrupt container: %s!\n", reason);
+  exit(EXIT_FAILURE);
+}
+
+/* Pool task: derive the chunk's context and cipher its data in place. */
+static void ContainerProcessChunk(void* argument)
+{
+  ContainerChunk* chunk = (ContainerChunk*) argument;
+  ZigmaContext    context;
+
+  ZigmaDerive(&context, chunk->master, chunk->index);
+
+  uint64 start = StatsStart(chunk->stats);
+
+  if (chunk->direction == STREAM_ENCODE)
+    ZigmaEncodeBuffer(&context, chunk->buffer);
+  else
+    ZigmaDecodeBuffer(&context, chunk->buffer);
+
+  StatsAdd(chunk->stats, STATS_CIPHER, start, chunk->buffer->length);
+
+  Nullify(&context, sizeof(ZigmaContext));
+}
+
+static ContainerBatch* ContainerBatchCreate(const ZigmaContext* master, StreamDirection direction, uint32 width,
+                                            uint32 chunkSize, Stats* stats)
+{
+  ContainerBatch* batch = (ContainerBatch*) malloc(sizeof(ContainerBatch));
+
+  DEBUG_ASSERT(batch != NULL);
+
+  batch->chunks = (ContainerChunk*) malloc(width * sizeof(ContainerChunk));
+  batch->width  = width;
+  batch->count  = 0;
+
+  for (uint32 i = 0; i < width; i++) {
+    batch->chunks[i].master    = master;
+    batch->chunks[i].direction = direction;
+    batch->chunks[i].index     = 0;
+    batch->chunks[i].buffer    = BufferCreate(NULL, chunkSize);
+    batch->chunks[i].stats     = stats;
+  }
+
+  return batch;
+}
+
+static void ContainerBatchDestroy(ContainerBatch* batch)
+{
+  for (uint32 i = 0; i < batch->width; i++) {
+    /* Wipe the whole allocation, not just the last chunk's length. */
+    batch->chunks[i].buffer->length = batch->chunks[i].buffer->capacity;
+    BufferDestroy(batch->chunks[i].buffer);
+  }
+
+  free(batch->chunks);
+  free(batch);
+}
+
+static void ContainerBatchSubmit(ContainerBatch* batch, Pool* pool)
+{
+  for (uint32 i = 0; i < batch->count; i++)
+    PoolSubmit(pool, ContainerProcessChunk, &batch->chunks[i]);
+}
+
+/* Record a chunk offset in the index. */
+static void ContainerIndexAppend(Buffer* index, uint64 offset)
+{
+  uint64 length = index->length;
+
+  BufferResize(index, length + 8);
+  PackUint64(index->data + length, offset);
+}
+
+/* Fill a batch with plaintext chunks. Returns non-zero once the end of the input has been reached. */
+static int ContainerFillPlaintext(ContainerBatch* batch, StreamReader* reader, uint64* next, uint32 chunkSize)
+{
+  batch->count = 0;
+
+  while (batch->count < batch->width) {
+    ContainerChunk* chunk = &batch->chunks[batch->count];
+
+    chunk->buffer->length = StreamReaderReadFull(reader, chunk->buffer->data, chunkSize);
+
+    if (chunk->buffer->length == 0)
+      return 1;
+
+    chunk->index = (*next)++;
+    batch->count++;
+
+    if (chunk->buffer->length < chunkSize)
+      return 1;
+  }
+
+  return 0;
+}
+
+/* Fill a batch with framed ciphertext chunks. Returns non-zero once the end marker has been read. */
+static int ContainerFillCiphertext(ContainerBatch* batch, StreamReader* reader, uint64* next, uint32 chunkSize)
+{
+  uint8 frame[4];
+
+  batch->count = 0;
+
+  while (batch->count < batch->width) {
+    ContainerChunk* chunk = &batch->chunks[batch->count];
+
+    if (StreamReaderReadFull(reader, frame, sizeof(frame)) != sizeof(frame))
+      ContainerCorrupt("missing end marker");
+
+    uint32 length = UnpackUint32(frame);
+
+    if (length == 0)
+      return 1;
+
+    if (length > chunkSize)
+      ContainerCorrupt("chunk larger than the declared chunk size");
+
+    chunk->buffer->length = StreamReaderReadFull(reader, chunk->buffer->data, length);
+
+    if (chunk->buffer->length != length)
+      ContainerCorrupt("truncated chunk");
+
+    chunk->index = (*next)++;
+    batch->count++;
+  }
+
+  return 0;
+}
+
+uint64 ContainerEncode(const ZigmaContext* master, StreamReader* reader, StreamWriter* writer, uint32 chunkSize,
+                       Pool* pool)
+{
+  DEBUG_ASSERT(master != NULL);
+  DEBUG_ASSERT(reader != NULL);
+  DEBUG_ASSERT(writer != NULL);
+  DEBUG_ASSERT(pool != NULL);
+  DEBUG_ASSERT(chunkSize > 0 && chunkSize <= ZQ_CONTAINER_MAX_CHUNK_SIZE);
+
+  uint8 header[ZQ_CONTAINER_HEADER_SIZE] = {0};
+  uint8 field[8];
+
+  memcpy(header, ZQ_CONTAINER_MAGIC, 4);
+  header[4] = ZQ_CONTAINER_VERSION;
+  PackUint32(header + 8, chunkSize);
+
+  StreamWriterWrite(writer, header, sizeof(header));
+
+  ContainerBatch* batches[2] = {ContainerBatchCreate(master, STREAM_ENCODE, pool->count, chunkSize, writer->stats),
+                                ContainerBatchCreate(master, STREAM_ENCODE, pool->count, chunkSize, writer->stats)};
+
+  Buffer* index   = BufferCreate(NULL, 0);
+  uint64  offset  = ZQ_CONTAINER_HEADER_SIZE;
+  uint64  next    = 0;
+  uint64  total   = 0;
+  int     current = 0;
+  int     done    = ContainerFillPlaintext(batches[current], reader, &next, chunkSize);
+
+  while (batches[current]->count > 0) {
+    ContainerBatch* batch = batches[current];
+
+    ContainerBatchSubmit(batch, pool);
+
+    /* Read ahead while the workers run. */
+    batches[!current]->count = 0;
+
+    if (!done)
+      done = ContainerFillPlaintext(batches[!current], reader, &next, chunkSize);
+
+    PoolWait(pool);
+
+    for (uint32 i = 0; i < batch->count; i++) {
+      Buffer* data = batch->chunks[i].buffer;
+
+      ContainerIndexAppend(index, offset);
+
+      PackUint32(field, (uint32) data->length);
+      StreamWriterWrite(writer, field, 4);
+      StreamWriterWrite(writer, data->data, data->length);
+
+      offset += 4 + data->length;
+      total += data->length;
+    }
+
+    current = !current;
+  }
+
+  /* End marker, then the index. */
+  PackUint32(field, 0);
+  StreamWriterWrite(writer, field, 4);
+
+  uint64 indexOffset = offset + 4;
+
+  PackUint64(field, next);
+  StreamWriterWrite(writer, field, 8);
+  StreamWriterWrite(writer, index->data, index->length);
+  PackUint64(field, indexOffset);
+  StreamWriterWrite(writer, field, 8);
+  StreamWriterWrite(writer, (const uint8*) ZQ_CONTAINER_INDEX_MAGIC, 4);
+
+  BufferDestroy(index);
+  ContainerBatchDestroy(batches[0]);
+  ContainerBatchDestroy(batches[1]);
+
+  return total;
+}
+
+uint64 ContainerDecode(const ZigmaContext* master, StreamReader* reader, StreamWriter* writer, Pool* pool)
+{
+  DEBUG_ASSERT(master != NULL);
+  DEBUG_ASSERT(reader != NULL);
+  DEBUG_ASSERT(writer != NULL);
+  DEBUG_ASSERT(pool != NULL);
+
+  uint8 header[ZQ_CONTAINER_HEADER_SIZE];
+  uint8 field[8];
+
+  if (StreamReaderReadFull(reader, header, sizeof(header)) != sizeof(header) ||
+      memcmp(header, ZQ_CONTAINER_MAGIC, 4) != 0)
+    ContainerCorrupt("not a chunked container");
+
+  if (header[4] != ZQ_CONTAINER_VERSION)
+    ContainerCorrupt("unsupported version");
+
+  uint32 chunkSize = UnpackUint32(header + 8);
+
+  if (chunkSize == 0 || chunkSize > ZQ_CONTAINER_MAX_CHUNK_SIZE)
+    ContainerCorrupt("invalid chunk size");
+
+  ContainerBatch* batches[2] = {ContainerBatchCreate(master, STREAM_DECODE, pool->count, chunkSize, writer->stats),
+                                ContainerBatchCreate(master, STREAM_DECODE, pool->count, chunkSize, writer->stats)};
+
+  Buffer* index   = BufferCreate(NULL, 0);
+  uint64  offset  = ZQ_CONTAINER_HEADER_SIZE;
+  uint64  next    = 0;
+  uint64  total   = 0;
+  int     current = 0;
+  int     done    = ContainerFillCiphertext(batches[current], reader, &next, chunkSize);
+
+  while (batches[current]->count > 0) {
+    ContainerBatch* batch = batches[current];
+
+    ContainerBatchSubmit(batch, pool);
+
+    batches[!current]->count = 0;
+
+    if (!done)
+      done = ContainerFillCiphertext(batches[!current], reader, &next, chunkSize);
+
+    PoolWait(pool);
+
+    for (uint32 i = 0; i < batch->count; i++) {
+      Buffer* data = batch->chunks[i].buffer;
+
+      ContainerIndexAppend(index, offset);
+      StreamWriterWrite(writer, data->data, data->length);
+
+      offset += 4 + data->length;
+      total += data->length;
+    }
+
+    current = !current;
+  }
+
+  /* Cross-check the stored index against the chunks that were actually read. */
+  if (StreamReaderReadFull(reader, field, 8) != 8 || UnpackUint64(field) != next)
+    ContainerCorrupt("chunk count does not match the index");
+
+  for (uint64 i = 0; i < next; i++) {
+    if (StreamReaderReadFull(reader, field, 8) != 8 || UnpackUint64(field) != UnpackUint64(index->data + 8 * i))
+      ContainerCorrupt("chunk offset does not match the index");
+  }
+
+  if (StreamReaderReadFull(reader, field, 8) != 8 || UnpackUint64(field) != offset + 4)
+    ContainerCorrupt("index offset mismatch");
+
+  if (StreamReaderReadFull(reader, field, 4) != 4 || memcmp(field, ZQ_CONTAINER_INDEX_MAGIC, 4) != 0)
+    ContainerCorrupt("missing index trailer");
+
+  BufferDestroy(index);
+  ContainerBatchDestroy(batches[0]);
+  ContainerBatchDestroy(batches[1]);
+
+  return total;
+}
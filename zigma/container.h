@@ -0,0 +1,95 @@
+/*
+ * ZIGMA, Copyright (C) 2024 Chase Zehl O'Byrne
+ *   <mail: zehl@live.com> http://zehlchen.com/
+ *
+ * This file is part of ZIGMA.
+ *
+ * ZIGMA is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ZIGMA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ZIGMA; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#pragma once
+#ifndef _ZIGMATIQ_CONTAINER_H_
+#define _ZIGMATIQ_CONTAINER_H_
+
+#include "common.h"
+
+#include "buffer.h"
+#include "pool.h"
+#include "stats.h"
+#include "stream.h"
+#include "zigma.h"
+
+/* Chunked container layout (all integers little-endian):
+ *
+ *   header   "ZQCK" | version (1) | reserved (3) | chunk size (4)
+ *   chunk    length (4) | ciphertext (length)       ... repeated, length <= chunk size
+ *   end      length 0 (4)
+ *   index    chunk count (8) | offset of each chunk's length field (8 each) | index offset (8) | "ZQIX"
+ *
+ * Every chunk is ciphered with its own context, derived from the master key schedule and the chunk number
+ * through `ZigmaDerive()`, so chunks can be encoded and decoded independently on separate cores.
+ */
+#define ZQ_CONTAINER_MAGIC       "ZQCK"
+#define ZQ_CONTAINER_INDEX_MAGIC "ZQIX"
+#define ZQ_CONTAINER_VERSION     1
+#define ZQ_CONTAINER_HEADER_SIZE 12
+
+#ifndef ZQ_CONTAINER_DEFAULT_CHUNK_SIZE
+#define ZQ_CONTAINER_DEFAULT_CHUNK_SIZE (1024 * 1024) /* 1MB */
+#endif
+
+#define ZQ_CONTAINER_MAX_CHUNK_SIZE (256 * 1024 * 1024) /* 256MB */
+
+/* A chunk in flight between the reader, a worker, and the writer. */
+typedef struct ContainerChunk {
+  /* The master context that per-chunk contexts are derived from. */
+  const ZigmaContext* master;
+
+  /* Whether the chunk is being encoded or decoded. */
+  StreamDirection direction;
+
+  /* The chunk number within the container. */
+  uint64 index;
+
+  /* The chunk data, ciphered in place. */
+  Buffer* buffer;
+
+  /* Where the cipher's time is recorded, or NULL. */
+  Stats* stats;
+} ContainerChunk;
+
+/* Split the input into chunks, encode them on the pool, and write a chunked container.
+ *   @param master The keyed master context.
+ *   @param reader The plaintext source.
+ *   @param writer The container destination.
+ *   @param chunkSize The plaintext size of each chunk (the last one may be shorter).
+ *   @param pool The workers to encode on.
+ *   @return The number of plaintext bytes encoded.
+ */
+uint64 ContainerEncode(const ZigmaContext* master, StreamReader* reader, StreamWriter* writer, uint32 chunkSize,
+                       Pool* pool);
+
+/* Read a chunked container, decode its chunks on the pool, and write the plaintext in order. Exits with an error
+ * if the container is malformed or its index does not match the chunks.
+ *   @param master The keyed master context.
+ *   @param reader The container source.
+ *   @param writer The plaintext destination.
+ *   @param pool The workers to decode on.
+ *   @return The number of plaintext bytes decoded.
+ */
+uint64 ContainerDecode(const ZigmaContext* master, StreamReader* reader, StreamWriter* writer, Pool* pool);
+
+#endif /* _ZIGMATIQ_CONTAINER_H_ */
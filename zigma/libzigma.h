@@ -0,0 +1,147 @@
+/*
+ * ZIGMA, Copyright (C) 2024 Chase Zehl O'Byrne
+ *   <mail: zehl@live.com> http://zehlchen.com/
+ *
+ * This file is part of ZIGMA.
+ *
+ * ZIGMA is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ZIGMA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ZIGMA; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#pragma once
+#ifndef _ZIGMATIQ_LIBZIGMA_H_
+#define _ZIGMATIQ_LIBZIGMA_H_
+
+/* libzigma: the ZIGMA cipher and hash for use in-process.
+ *
+ * A session is keyed once and then fed data in chunks of any size; splitting the input differently never changes
+ * the output. Sessions share no state, so separate sessions may be used from separate threads. To cipher many
+ * independent records under one key, schedule the key once and start each record from a copy:
+ *
+ *   ZigmaSession* keyed  = ZigmaSessionCreate(ZIGMA_SESSION_ENCODE, key, keyLength);
+ *   ZigmaSession* record = ZigmaSessionClone(keyed);
+ *
+ *   for (each record) {
+ *     ZigmaSessionReset(record, keyed);
+ *     ZigmaSessionUpdate(record, output, input, length);
+ *   }
+ *
+ * Files written by `zigma encode mode=seekable` can be read from any offset without decoding what comes before it:
+ *
+ *   ZigmaSeekable* file = ZigmaSeekableOpen(descriptor, key, keyLength);
+ *   int64_t        got  = ZigmaSeekableRead(file, offset, buffer, sizeof(buffer));
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* The length in bytes of a full digest. */
+#define ZIGMA_SESSION_DIGEST_SIZE 36
+
+typedef enum ZigmaSessionMode {
+  ZIGMA_SESSION_ENCODE = 0,
+  ZIGMA_SESSION_DECODE,
+  ZIGMA_SESSION_HASH
+} ZigmaSessionMode;
+
+typedef struct ZigmaSession  ZigmaSession;
+typedef struct ZigmaSeekable ZigmaSeekable;
+
+/* The library version, e.g. "2.0.1:42".
+ *   @return The version string.
+ */
+const char* ZigmaLibraryVersion(void);
+
+/* Create a session.
+ *   @param mode Whether the session encodes, decodes or hashes.
+ *   @param key The key; ignored (and may be NULL) for ZIGMA_SESSION_HASH.
+ *   @param length The length of the key, at least 1 for the cipher modes.
+ *   @return The session, or NULL if the arguments are invalid or memory is exhausted.
+ */
+ZigmaSession* ZigmaSessionCreate(ZigmaSessionMode mode, const void* key, size_t length);
+
+/* Copy a session, including its position in the stream. Cheaper than creating one from the key again.
+ *   @param session The session to copy.
+ *   @return The copy, or NULL if memory is exhausted.
+ */
+ZigmaSession* ZigmaSessionClone(const ZigmaSession* session);
+
+/* Return a session to the state of another, typically a freshly keyed session kept as a template.
+ *   @param session The session to overwrite.
+ *   @param origin The session to copy from.
+ */
+void ZigmaSessionReset(ZigmaSession* session, const ZigmaSession* origin);
+
+/* Process the next `length` bytes of the stream.
+ *   @param session The session.
+ *   @param output Receives `length` ciphered bytes; may equal `input`. May be NULL in hash mode.
+ *   @param input The data.
+ *   @param length The length of the data.
+ */
+void ZigmaSessionUpdate(ZigmaSession* session, void* output, const void* input, size_t length);
+
+/* Finish the stream. In hash mode this writes the digest of everything processed; in the cipher modes a digest
+ * of the keyed state is written if `digest` is not NULL. The session must be reset before it is used again.
+ *   @param session The session.
+ *   @param digest Receives `length` digest bytes, or NULL.
+ *   @param length The length of the digest, at most ZIGMA_SESSION_DIGEST_SIZE.
+ *   @return 0 on success, or -1 if the session has already been finished or `length` is too large.
+ */
+int ZigmaSessionFinal(ZigmaSession* session, void* digest, size_t length);
+
+/* Wipe and release a session.
+ *   @param session The session, or NULL.
+ */
+void ZigmaSessionDestroy(ZigmaSession* session);
+
+/* Open a seekable file for random access. The header and index are validated and the first checkpoint is
+ * decrypted, so a wrong key is reported here.
+ *   @param descriptor An open, regular file; it is read with pread() and never closed by the library.
+ *   @param key The key the file was encoded with.
+ *   @param length The length of the key, at least 1.
+ *   @return The handle, or NULL if the file is not a valid seekable file, the key is wrong, or memory is exhausted.
+ */
+ZigmaSeekable* ZigmaSeekableOpen(int descriptor, const void* key, size_t length);
+
+/* The length of the plaintext.
+ *   @param file The seekable file.
+ *   @return The length in bytes.
+ */
+uint64_t ZigmaSeekableLength(const ZigmaSeekable* file);
+
+/* Decode plaintext from any offset, restarting from the nearest checkpoint at or before it. Consecutive reads carry
+ * on without going back to a checkpoint.
+ *   @param file The seekable file.
+ *   @param offset The plaintext offset to read from.
+ *   @param data Receives the plaintext.
+ *   @param length The number of bytes wanted.
+ *   @return The number of bytes stored, short only at the end of the plaintext, or -1 if the file cannot be read.
+ */
+int64_t ZigmaSeekableRead(ZigmaSeekable* file, uint64_t offset, void* data, size_t length);
+
+/* Wipe and release a seekable file. The descriptor is left open.
+ *   @param file The seekable file, or NULL.
+ */
+void ZigmaSeekableClose(ZigmaSeekable* file);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _ZIGMATIQ_LIBZIGMA_H_ */
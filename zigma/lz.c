@@ -0,0 +1,242 @@
+/*
+ * ZIGMA, Copyright (C) 2024 Chase Zehl O'Byrne
+ *   <mail: zehl@live.com> http://zehlchen.com/
+ *
+ * This file is part of ZIGMA.
+ *
+ * ZIGMA is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ZIGMA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ZIGMA; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+
+#include "lz.h"
+
+/* Matches end this far before the end of the block, so the last sequence always has literals. */
+#define ZQ_LZ_LAST_LITERALS 5
+
+/* No match starts this close to the end of the block. */
+#define ZQ_LZ_MATCH_LIMIT 12
+
+/* Misses before the search step grows by one; a power of two. */
+#define ZQ_LZ_SKIP_TRIGGER 32
+
+static inline uint32 LzLoad32(const uint8* data)
+{
+  uint32 value;
+
+  memcpy(&value, data, 4);
+
+  return value;
+}
+
+static inline uint32 LzHash(uint32 sequence)
+{
+  return (sequence * 2654435761U) >> (32 - ZQ_LZ_HASH_BITS);
+}
+
+/* Store a count that did not fit in its token nibble. */
+static inline uint8* LzPutCount(uint8* output, uint64 count)
+{
+  for (; count >= 255; count -= 255)
+    *output++ = 255;
+
+  *output++ = (uint8) count;
+
+  return output;
+}
+
+/* Emit the literals [anchor, end) and, unless `match` is 0, a match of `match` bytes at `offset`. */
+static uint8* LzPutSequence(uint8* output, const uint8* limit, const uint8* anchor, const uint8* end, uint16 offset,
+                            uint64 match)
+{
+  uint64 literals = (uint64) (end - anchor);
+
+  /* Token, both extended counts at their longest, the literals and the offset. */
+  if ((uint64) (limit - output) < 1 + literals / 255 + 1 + literals + 2 + match / 255 + 1)
+    return NULL;
+
+  uint8* token = output++;
+
+  *token = (uint8) ((literals < 15 ? literals : 15) << 4);
+
+  if (literals >= 15)
+    output = LzPutCount(output, literals - 15);
+
+  memcpy(output, anchor, literals);
+  output += literals;
+
+  if (match == 0)
+    return output;
+
+  output[0] = (uint8) offset;
+  output[1] = (uint8) (offset >> 8);
+  output += 2;
+
+  match -= ZQ_LZ_MIN_MATCH;
+  *token |= (uint8) (match < 15 ? match : 15);
+
+  if (match >= 15)
+    output = LzPutCount(output, match - 15);
+
+  return output;
+}
+
+uint64 LzCompress(uint8* output, uint64 capacity, const uint8* input, uint64 length)
+{
+  DEBUG_ASSERT(output != NULL);
+  DEBUG_ASSERT(input != NULL);
+  DEBUG_ASSERT(length <= ZQ_LZ_BLOCK_MAX);
+
+  const uint8* anchor = input;
+  const uint8* end    = input + length;
+  uint8*       cursor = output;
+  uint8*       limit  = output + capacity;
+
+  if (length > ZQ_LZ_MATCH_LIMIT) {
+    uint16       table[1 << ZQ_LZ_HASH_BITS];
+    const uint8* position   = input + 1;
+    const uint8* matchEnd   = end - ZQ_LZ_LAST_LITERALS;
+    const uint8* matchLimit = end - ZQ_LZ_MATCH_LIMIT;
+    uint32       misses     = 0;
+
+    /* Position 0 doubles as "empty"; a stale entry only costs a failed comparison. */
+    memset(table, 0, sizeof(table));
+
+    while (position < matchLimit) {
+      uint32       sequence  = LzLoad32(position);
+      uint32       hash      = LzHash(sequence);
+      const uint8* reference = input + table[hash];
+
+      table[hash] = (uint16) (position - input);
+
+      if (reference >= position || LzLoad32(reference) != sequence) {
+        position += 1 + misses++ / ZQ_LZ_SKIP_TRIGGER;
+        continue;
+      }
+
+      misses = 0;
+
+      /* Extend the match backwards over literals that repeat too, then forwards. */
+      while (position > anchor && reference > input && position[-1] == reference[-1]) {
+        position--;
+        reference--;
+      }
+
+      uint64 match = ZQ_LZ_MIN_MATCH;
+
+      while (position + match < matchEnd && position[match] == reference[match])
+        match++;
+
+      cursor = LzPutSequence(cursor, limit, anchor, position, (uint16) (position - reference), match);
+
+      if (cursor == NULL)
+        return 0;
+
+      position += match;
+      anchor = position;
+
+      /* Seed the table inside the match, which helps with runs of short repeats. */
+      if (position < matchLimit)
+        table[LzHash(LzLoad32(position - 2))] = (uint16) (position - 2 - input);
+    }
+  }
+
+  cursor = LzPutSequence(cursor, limit, anchor, end, 0, 0);
+
+  return cursor != NULL ? (uint64) (cursor - output) : 0;
+}
+
+/* Read a count that did not fit in its token nibble. */
+static inline int LzGetCount(const uint8** input, const uint8* end, uint64* count)
+{
+  uint8 byte;
+
+  do {
+    if (*input >= end)
+      return 0;
+
+    byte = *(*input)++;
+    *count += byte;
+  } while (byte == 255);
+
+  return 1;
+}
+
+int LzDecompress(uint8* output, uint64 capacity, const uint8* input, uint64 length, uint64* produced)
+{
+  DEBUG_ASSERT(output != NULL);
+  DEBUG_ASSERT(input != NULL);
+  DEBUG_ASSERT(produced != NULL);
+
+  const uint8* end    = input + length;
+  uint8*       cursor = output;
+  uint8*       limit  = output + capacity;
+
+  while (input < end) {
+    uint8  token    = *input++;
+    uint64 literals = token >> 4;
+
+    if (literals == 15 && !LzGetCount(&input, end, &literals))
+      return 0;
+
+    if (literals > (uint64) (end - input) || literals > (uint64) (limit - cursor))
+      return 0;
+
+    memcpy(cursor, input, literals);
+    cursor += literals;
+    input += literals;
+
+    /* The last sequence has no match. */
+    if (input == end)
+      break;
+
+    if (end - input < 2)
+      return 0;
+
+    uint64 offset = input[0] | (uint64) input[1] << 8;
+    uint64 match  = token & 15;
+
+    input += 2;
+
+    if (match == 15 && !LzGetCount(&input, end, &match))
+      return 0;
+
+    match += ZQ_LZ_MIN_MATCH;
+
+    if (offset == 0 || offset > (uint64) (cursor - output) || match > (uint64) (limit - cursor))
+      return 0;
+
+    const uint8* reference = cursor - offset;
+
+    /* An offset shorter than the match repeats the bytes it is still producing, so those are copied one by one. */
+    if (offset >= match) {
+      memcpy(cursor, reference, match);
+      cursor += match;
+    }
+    else {
+      while (match-- > 0)
+        *cursor++ = *reference++;
+    }
+  }
+
+  *produced = (uint64) (cursor - output);
+
+  return 1;
+}
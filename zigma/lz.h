@@ -0,0 +1,65 @@
+/*
+ * ZIGMA, Copyright (C) 2024 Chase Zehl O'Byrne
+ *   <mail: zehl@live.com> http://zehlchen.com/
+ *
+ * This file is part of ZIGMA.
+ *
+ * ZIGMA is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ZIGMA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ZIGMA; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#pragma once
+#ifndef _ZIGMATIQ_LZ_H_
+#define _ZIGMATIQ_LZ_H_
+
+#include "common.h"
+
+/* A small LZ77 block codec in the style of LZ4: a sequence is a token (literal count and match length, 4 bits each),
+ * the literals, a 16-bit little-endian offset and the match. Counts of 15 or more continue in bytes of 255 and a
+ * remainder. The last sequence has literals only.
+ */
+
+/* The largest block LzCompress() accepts; offsets and the hash table hold 16-bit positions. */
+#define ZQ_LZ_BLOCK_MAX (64 * 1024) /* 64KB */
+
+/* Shortest match worth a sequence. */
+#define ZQ_LZ_MIN_MATCH 4
+
+/* Size of the match finder's hash table, as a power of two. */
+#ifndef ZQ_LZ_HASH_BITS
+#define ZQ_LZ_HASH_BITS 12
+#endif
+
+/* Compress a block, giving up as soon as the result would not fit in `capacity`. Runs of input without matches are
+ * skipped over in growing steps, so incompressible data costs little before it is given up on.
+ *   @param output The destination array.
+ *   @param capacity The size of the destination array; pass less than `length` to require a saving.
+ *   @param input The block, at most ZQ_LZ_BLOCK_MAX bytes.
+ *   @param length The length of the block.
+ *   @return The compressed length, or 0 if it would not fit.
+ */
+uint64 LzCompress(uint8* output, uint64 capacity, const uint8* input, uint64 length);
+
+/* Decompress a block, checking every length and offset against both arrays.
+ *   @param output The destination array.
+ *   @param capacity The size of the destination array.
+ *   @param input The compressed block.
+ *   @param length The length of the compressed block.
+ *   @param produced Receives the decompressed length.
+ *   @return 1 on success, 0 if the block is malformed or does not fit.
+ */
+int LzDecompress(uint8* output, uint64 capacity, const uint8* input, uint64 length, uint64* produced);
+
+#endif /* _ZIGMATIQ_LZ_H_ */
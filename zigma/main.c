@@ -21,18 +21,42 @@
  */
 
 #include <errno.h>
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "common.h"
 
+#include "archive.h"
+#include "base16.h"
 #include "base64.h"
 #include "buffer.h"
+#include "check.h"
+#include "compress.h"
+#include "container.h"
+#include "pool.h"
 #include "registry.h"
+#include "seekable.h"
+#include "serve.h"
+#include "sink.h"
+#include "stats.h"
+#include "stream.h"
 #include "zigma.h"
 
-typedef enum OperationType { OP_UNKNOWN = 0, OP_ENCODE, OP_DECODE, OP_CHECK, OP_HELP, OP_VERSION } OperationType;
+typedef enum OperationType {
+  OP_UNKNOWN = 0,
+  OP_ENCODE,
+  OP_DECODE,
+  OP_CHECK,
+  OP_SERVE,
+  OP_SCHEDULE,
+  OP_ARCHIVE,
+  OP_HELP,
+  OP_VERSION
+} OperationType;
 typedef void (*OperationFunction)(RegistryNode** registry);
 
 OperationFunction DetermineOperation(const char* input);
@@ -48,14 +72,23 @@ struct Command {
 void HandleEncode(RegistryNode** registry);
 void HandleDecode(RegistryNode** registry);
 void HandleCheck(RegistryNode** registry);
+void HandleServe(RegistryNode** registry);
+void HandleSchedule(RegistryNode** registry);
+void HandleArchive(RegistryNode** registry);
 void HandleHelp(RegistryNode** registry);
 void HandleVersion(RegistryNode** registry);
 
 void PrintVersion();
 
-struct Command commands[] = {{"encode", OP_ENCODE, &HandleEncode},    {"decode", OP_DECODE, &HandleDecode},
-                             {"check", OP_CHECK, &HandleCheck},       {"help", OP_HELP, &HandleHelp},
-                             {"version", OP_VERSION, &HandleVersion}, {NULL, OP_UNKNOWN, NULL}};
+struct Command commands[] = {{"encode", OP_ENCODE, &HandleEncode},       {"decode", OP_DECODE, &HandleDecode},
+                             {"check", OP_CHECK, &HandleCheck},          {"serve", OP_SERVE, &HandleServe},
+                             {"schedule", OP_SCHEDULE, &HandleSchedule}, {"archive", OP_ARCHIVE, &HandleArchive},
+                             {"help", OP_HELP, &HandleHelp},             {"version", OP_VERSION, &HandleVersion},
+                             {NULL, OP_UNKNOWN, NULL}};
+
+/* The arguments after the operation. Bare operands (no '=') are not options; `check` reads them from here. */
+static char** operands     = NULL;
+static int    operandCount = 0;
 
 int main(int argc, char* argv[])
 {
@@ -78,6 +111,16 @@ int main(int argc, char* argv[])
     RegistryUpdate(&registry, "out.fmt", "64");  /* 64 = base64 */
     RegistryUpdate(&registry, "key", "");        /* NULL = stdin */
     RegistryUpdate(&registry, "key.fmt", "256"); /* 256 = binary */
+    RegistryUpdate(&registry, "mode", "stream"); /* stream = single context */
+    RegistryUpdate(&registry, "chunk.size", "1048576");
+    RegistryUpdate(&registry, "jobs", "0");      /* 0 = one per processor */
+    RegistryUpdate(&registry, "out.wrap", "76"); /* 0 = no line breaks */
+    RegistryUpdate(&registry, "out.eol", "lf");
+    RegistryUpdate(&registry, "io", "sync");      /* sync = blocking read() and write() */
+    RegistryUpdate(&registry, "stats", "");       /* NULL = none */
+    RegistryUpdate(&registry, "tag", "off");      /* off = no integrity tag */
+    RegistryUpdate(&registry, "compress", "off"); /* off = no compression */
+    RegistryUpdate(&registry, "simd", "auto");    /* auto = widest kernel the processor supports */
   }
   else if (op == HandleDecode) {
     RegistryUpdate(&registry, "in", "");         /* NULL = stdin */
@@ -86,16 +129,53 @@ int main(int argc, char* argv[])
     RegistryUpdate(&registry, "out.fmt", "256"); /* 256 = binary */
     RegistryUpdate(&registry, "key", "");        /* NULL = stdin */
     RegistryUpdate(&registry, "key.fmt", "256"); /* 256 = binary */
+    RegistryUpdate(&registry, "mode", "stream"); /* stream = single context */
+    RegistryUpdate(&registry, "chunk.size", "1048576");
+    RegistryUpdate(&registry, "jobs", "0");      /* 0 = one per processor */
+    RegistryUpdate(&registry, "out.wrap", "76"); /* 0 = no line breaks */
+    RegistryUpdate(&registry, "out.eol", "lf");
+    RegistryUpdate(&registry, "io", "sync");      /* sync = blocking read() and write() */
+    RegistryUpdate(&registry, "stats", "");       /* NULL = none */
+    RegistryUpdate(&registry, "tag", "off");      /* off = no integrity tag */
+    RegistryUpdate(&registry, "compress", "off"); /* off = no compression */
+    RegistryUpdate(&registry, "range", "");       /* NULL = everything */
+    RegistryUpdate(&registry, "simd", "auto");    /* auto = widest kernel the processor supports */
   }
   else if (op == HandleCheck) {
     RegistryUpdate(&registry, "in", "");        /* NULL = stdin */
     RegistryUpdate(&registry, "in.fmt", "256"); /* 256 = binary */
     RegistryUpdate(&registry, "out", "");       /* NULL = stdout */
     RegistryUpdate(&registry, "out.fmt", "16"); /* 16 = base16 */
+    RegistryUpdate(&registry, "list", "");      /* NULL = none */
+    RegistryUpdate(&registry, "verify", "");    /* NULL = compute */
+    RegistryUpdate(&registry, "jobs", "0");     /* 0 = one per processor */
+  }
+  else if (op == HandleServe) {
+    RegistryUpdate(&registry, "socket", ZQ_SERVE_DEFAULT_SOCKET);
+    RegistryUpdate(&registry, "key", "");        /* NULL = keys are loaded by clients */
+    RegistryUpdate(&registry, "key.fmt", "256"); /* 256 = binary, ctx = scheduled */
+    RegistryUpdate(&registry, "jobs", "0");      /* 0 = one per processor */
+  }
+  else if (op == HandleSchedule) {
+    RegistryUpdate(&registry, "key", "");        /* NULL = stdin */
+    RegistryUpdate(&registry, "key.fmt", "256"); /* 256 = binary */
+    RegistryUpdate(&registry, "out", "");        /* NULL = stdout */
+  }
+  else if (op == HandleArchive) {
+    RegistryUpdate(&registry, "in", "");           /* directory to archive, or the archive */
+    RegistryUpdate(&registry, "out", "");          /* the archive, or NULL = stdout */
+    RegistryUpdate(&registry, "key", "");          /* NULL = stdin */
+    RegistryUpdate(&registry, "key.fmt", "256");   /* 256 = binary */
+    RegistryUpdate(&registry, "action", "create"); /* create, list or extract */
+    RegistryUpdate(&registry, "member", "");       /* NULL = every member */
+    RegistryUpdate(&registry, "jobs", "0");        /* 0 = one per processor */
   }
 
   ParseRegistry(&registry, argc, argv);
 
+  operands     = argv + 2;
+  operandCount = argc - 2;
+
   if (op != NULL) {
     op(&registry);
   }
@@ -128,11 +208,16 @@ OperationFunction DetermineOperation(const char* input)
 void ParseRegistry(RegistryNode** registry, int argc, char* argv[])
 {
   for (int i = 2; i < argc; i++) {
+    /* Bare operands are left on the command line for the operation. */
+    if (strchr(argv[i], '=') == NULL)
+      continue;
+
     char* dupl    = strndup(argv[i], ZQ_REGISTRY_KEY_MAX);
     char* delimit = strchr(dupl, '=');
     char* key     = dupl;
     char* value   = "";
 
+    /* strndup() may have cut the '=' off a long argument; the key is then kept whole, with no value. */
     if (delimit != NULL) {
       *delimit = '\0';
       value    = delimit + 1;
@@ -145,6 +230,145 @@ void ParseRegistry(RegistryNode** registry, int argc, char* argv[])
   }
 }
 
+/* Move a reader and writer onto io_uring, or keep blocking I/O where it is unavailable.
+ *   @param reader The input of the operation.
+ *   @param writer The output of the operation.
+ */
+static void UseUring(StreamReader* reader, StreamWriter* writer)
+{
+  if (!StreamReaderUseUring(reader) || !SinkUseUring(writer->sink))
+    fprintf(stderr, "WARNING: io_uring is unavailable; using blocking I/O!\n");
+}
+
+/* Enlarge whichever of the input and output are pipes, and splice output into a pipe rather than copying it.
+ *   @param reader The input of the operation.
+ *   @param writer The output of the operation.
+ */
+static void UsePipes(StreamReader* reader, StreamWriter* writer)
+{
+  StreamReaderUsePipe(reader);
+  SinkUsePipe(writer->sink);
+}
+
+/* Force the base64 and base16 kernels named by the `simd` operand, e.g. to rule one out when comparing output. A
+ * kernel only one codec has (avx512) leaves the other on its default.
+ *   @param option The simd operand; "auto" keeps the kernels picked from the processor features.
+ */
+static void SelectKernels(RegistryNode* option)
+{
+  if (strcmp(option->value, "auto") == 0)
+    return;
+
+  int base64 = base64_select_kernel(option->value);
+  int base16 = base16_select_kernel(option->value);
+
+  if (!base64 && !base16) {
+    fprintf(stderr, "ERROR: Unknown or unsupported SIMD kernel '%s'!\n", option->value);
+    exit(EXIT_FAILURE);
+  }
+}
+
+/* Start collecting statistics if the `stats` operand asks for them.
+ *   @param option The stats operand; empty for none.
+ *   @param format Receives the report format.
+ *   @return The statistics object, or NULL if none were asked for.
+ */
+static Stats* CreateStats(RegistryNode* option, StatsFormat* format)
+{
+  if (*option->value == 0)
+    return NULL;
+
+  if (strcmp(option->value, "text") == 0) {
+    *format = STATS_TEXT;
+  }
+  else if (strcmp(option->value, "json") == 0) {
+    *format = STATS_JSON;
+  }
+  else {
+    fprintf(stderr, "ERROR: Invalid statistics format '%s'!\n", option->value);
+    exit(EXIT_FAILURE);
+  }
+
+  return StatsCreate(NULL);
+}
+
+/* Build the cipher context named by the `key` and `key.fmt` operands and describe it on stderr. A key file or a
+ * captured passphrase is run through the key schedule; a scheduled key file (key.fmt=ctx) is only copied.
+ *   @param key The key operand; empty to capture a passphrase.
+ *   @param keyFormat The key format operand.
+ *   @param confirm Whether a captured passphrase must be entered twice.
+ *   @param stats Where the time spent scheduling the key is recorded, or NULL.
+ *   @return The keyed context.
+ */
+static ZigmaContext* LoadKey(RegistryNode* key, RegistryNode* keyFormat, int confirm, Stats* stats)
+{
+  Buffer*       passwordBuffer = BufferCreateWith(NULL, ZQ_SCHEDULE_SIZE, &AllocatorSecure);
+  ZigmaContext* cipher;
+
+  if (*key->value != 0) {
+    FILE* keyFile = OpenFile(key->value, "r");
+
+    BufferReadBase256(passwordBuffer, keyFile);
+    fclose(keyFile);
+  }
+  else if (strcmp(keyFormat->value, "ctx") == 0) {
+    fprintf(stderr, "ERROR: A scheduled key must be read from a file!\n");
+    exit(EXIT_FAILURE);
+  }
+  else {
+    passwordBuffer->length = CaptureKey(passwordBuffer->data, "Enter password: ");
+
+    if (confirm) {
+      Buffer* passwordRetryBuffer = BufferCreateWith(NULL, ZQ_MAX_KEY_SIZE, &AllocatorSecure);
+
+      passwordRetryBuffer->length = CaptureKey(passwordRetryBuffer->data, "Re-enter password: ");
+
+      if (passwordBuffer->length != passwordRetryBuffer->length ||
+          memcmp(passwordBuffer->data, passwordRetryBuffer->data, passwordBuffer->length) != 0) {
+        fprintf(stderr, "ERROR: Passwords do not match!\n");
+        exit(EXIT_FAILURE);
+      }
+
+      BufferDestroy(passwordRetryBuffer);
+    }
+  }
+
+  if (strcmp(keyFormat->value, "ctx") == 0) {
+    uint64 start = StatsStart(stats);
+
+    cipher = ZigmaImport(NULL, passwordBuffer->data, passwordBuffer->length);
+
+    StatsAdd(stats, STATS_SCHEDULE, start, passwordBuffer->length);
+
+    if (cipher == NULL) {
+      fprintf(stderr, "ERROR: Key file '%s' is not a valid scheduled key!\n", key->value);
+      exit(EXIT_FAILURE);
+    }
+
+    fprintf(stderr, "    key (fmt: ctx) = %s -> scheduled\n\n", key->value);
+  }
+  else {
+    if (passwordBuffer->length > ZQ_MAX_KEY_SIZE) {
+      fprintf(stderr, "ERROR: Key file '%s' is too large!\n", key->value);
+      exit(EXIT_FAILURE);
+    }
+
+    fprintf(stderr, "    key (fmt: %3s) = %s -> %" PRIu64 "/%d (%f%%) bytes\n\n", keyFormat->value,
+            *key->value != 0 ? key->value : "<PASSPHRASE>", passwordBuffer->length, ZQ_MAX_KEY_SIZE,
+            (float) passwordBuffer->length / (float) ZQ_MAX_KEY_SIZE * 100.0f);
+
+    uint64 start = StatsStart(stats);
+
+    cipher = ZigmaCreate(NULL, passwordBuffer->data, passwordBuffer->length);
+
+    StatsAdd(stats, STATS_SCHEDULE, start, passwordBuffer->length);
+  }
+
+  BufferDestroy(passwordBuffer);
+
+  return cipher;
+}
+
 void HandleEncode(RegistryNode** registry)
 {
   RegistryNode* input        = RegistrySearch(registry, "in");
@@ -153,6 +377,16 @@ void HandleEncode(RegistryNode** registry)
   RegistryNode* outputFormat = RegistrySearch(registry, "out.fmt");
   RegistryNode* key          = RegistrySearch(registry, "key");
   RegistryNode* keyFormat    = RegistrySearch(registry, "key.fmt");
+  RegistryNode* mode         = RegistrySearch(registry, "mode");
+  RegistryNode* chunkSize    = RegistrySearch(registry, "chunk.size");
+  RegistryNode* jobs         = RegistrySearch(registry, "jobs");
+  RegistryNode* outputWrap   = RegistrySearch(registry, "out.wrap");
+  RegistryNode* outputEol    = RegistrySearch(registry, "out.eol");
+  RegistryNode* io           = RegistrySearch(registry, "io");
+  RegistryNode* statsOption  = RegistrySearch(registry, "stats");
+  RegistryNode* tagOption    = RegistrySearch(registry, "tag");
+  RegistryNode* compression  = RegistrySearch(registry, "compress");
+  RegistryNode* simd         = RegistrySearch(registry, "simd");
 
   uint32 inputBaseFormat  = strtoul(inputFormat->value, NULL, 10);
   uint32 outputBaseFormat = strtoul(outputFormat->value, NULL, 10);
@@ -167,79 +401,131 @@ void HandleEncode(RegistryNode** registry)
     fprintf(stderr, "ERROR: Invalid output format '%s'!\n", outputFormat->value);
     exit(EXIT_FAILURE);
   }
-  if (!IS_VALID_FORMAT(keyBaseFormat)) {
+  if (!IS_VALID_FORMAT(keyBaseFormat) && strcmp(keyFormat->value, "ctx") != 0) {
     fprintf(stderr, "ERROR: Invalid key format '%s'!\n", keyFormat->value);
     exit(EXIT_FAILURE);
   }
 #undef IS_VALID_FORMAT
 
-  FILE* inputFile  = *input->value != 0 ? OpenFile(input->value, "r") : stdin;
-  FILE* outputFile = *output->value != 0 ? OpenFile(output->value, "w") : stdout;
+  int    chunked        = strcmp(mode->value, "chunked") == 0;
+  int    pipelined      = strcmp(mode->value, "pipeline") == 0;
+  int    seekable       = strcmp(mode->value, "seekable") == 0;
+  uint64 chunkByteCount = strtoull(chunkSize->value, NULL, 10);
+  uint32 jobCount       = strtoul(jobs->value, NULL, 10);
+  int    tagged         = strcmp(tagOption->value, "on") == 0;
+  int    compressed     = strcmp(compression->value, "on") == 0;
 
-  Buffer* passwordBuffer = BufferCreate(NULL, ZQ_MAX_KEY_SIZE);
+  if (!chunked && !pipelined && !seekable && strcmp(mode->value, "stream") != 0) {
+    fprintf(stderr, "ERROR: Invalid mode '%s'!\n", mode->value);
+    exit(EXIT_FAILURE);
+  }
+  if (strcmp(io->value, "sync") != 0 && strcmp(io->value, "uring") != 0 && strcmp(io->value, "pipe") != 0) {
+    fprintf(stderr, "ERROR: Invalid I/O backend '%s'!\n", io->value);
+    exit(EXIT_FAILURE);
+  }
+  if (!tagged && strcmp(tagOption->value, "off") != 0) {
+    fprintf(stderr, "ERROR: Invalid tag setting '%s'!\n", tagOption->value);
+    exit(EXIT_FAILURE);
+  }
+  if (tagged && (chunked || seekable)) {
+    fprintf(stderr, "ERROR: An integrity tag is only supported in stream and pipeline mode!\n");
+    exit(EXIT_FAILURE);
+  }
+  if (!compressed && strcmp(compression->value, "off") != 0) {
+    fprintf(stderr, "ERROR: Invalid compress setting '%s'!\n", compression->value);
+    exit(EXIT_FAILURE);
+  }
+  if (compressed && (chunked || pipelined || seekable)) {
+    fprintf(stderr, "ERROR: Compression is only supported in stream mode!\n");
+    exit(EXIT_FAILURE);
+  }
 
-  if (*key->value != 0) {
-    FILE* keyFile = OpenFile(key->value, "r");
+  SelectKernels(simd);
 
-    BufferReadBase256(passwordBuffer, keyFile);
+  StatsFormat statsFormat;
+  Stats*      stats = CreateStats(statsOption, &statsFormat);
 
-    if (passwordBuffer->length > ZQ_MAX_KEY_SIZE) {
-      fprintf(stderr, "ERROR: Key file '%s' is too large!\n", key->value);
-      exit(EXIT_FAILURE);
-    }
+  if (chunkByteCount == 0 || chunkByteCount > ZQ_CONTAINER_MAX_CHUNK_SIZE) {
+    fprintf(stderr, "ERROR: Invalid chunk size '%s'!\n", chunkSize->value);
+    exit(EXIT_FAILURE);
   }
-  else {
-    Buffer* passwordRetryBuffer = BufferCreate(NULL, ZQ_MAX_KEY_SIZE);
 
-    passwordBuffer->length      = CaptureKey(passwordBuffer->data, "Enter password: ");
-    passwordRetryBuffer->length = CaptureKey(passwordRetryBuffer->data, "Re-enter password: ");
+  uint32      lineWidth = strtoul(outputWrap->value, NULL, 10);
+  SinkNewline newline;
 
-    if (passwordBuffer->length != passwordRetryBuffer->length ||
-        memcmp(passwordBuffer->data, passwordRetryBuffer->data, passwordBuffer->length) != 0) {
-      fprintf(stderr, "ERROR: Passwords do not match!\n");
-      exit(EXIT_FAILURE);
-    }
-
-    BufferDestroy(passwordRetryBuffer);
+  if (lineWidth > ZQ_SINK_MAX_WIDTH) {
+    fprintf(stderr, "ERROR: Invalid line width '%s'!\n", outputWrap->value);
+    exit(EXIT_FAILURE);
+  }
+  if (!SinkParseNewline(outputEol->value, &newline)) {
+    fprintf(stderr, "ERROR: Invalid line ending '%s'!\n", outputEol->value);
+    exit(EXIT_FAILURE);
   }
 
-  fprintf(stderr, "   mode            = ENCODING\n");
+  FILE* inputFile  = *input->value != 0 ? OpenFile(input->value, "r") : stdin;
+  FILE* outputFile = *output->value != 0 ? OpenFile(output->value, "w") : stdout;
+
+  fprintf(stderr, "   mode            = ENCODING%s\n",
+          chunked ? " (CHUNKED)" : pipelined ? " (PIPELINED)" : seekable ? " (SEEKABLE)" : "");
   fprintf(stderr, "  input (fmt: %3d) = %s\n", inputBaseFormat, *input->value != 0 ? input->value : "<STDIN>");
   fprintf(stderr, " output (fmt: %3d) = %s\n", outputBaseFormat, *output->value != 0 ? output->value : "<STDOUT>");
-  fprintf(stderr, "    key (fmt: %3d) = %s -> %d/%d (%f%%) bytes\n\n", keyBaseFormat,
-          *key->value != 0 ? key->value : "<PASSPHRASE>", passwordBuffer->length, ZQ_MAX_KEY_SIZE,
-          (float) passwordBuffer->length / (float) ZQ_MAX_KEY_SIZE * 100.0f);
 
-  ZigmaContext* cipher = ZigmaCreate(NULL, passwordBuffer->data, passwordBuffer->length);
+  ZigmaContext* cipher = LoadKey(key, keyFormat, 1, stats);
 
-  BufferDestroy(passwordBuffer);
+  StreamReader* reader = StreamReaderCreate(NULL, inputFile, inputBaseFormat);
+  StreamWriter* writer = StreamWriterCreate(NULL, outputFile, outputBaseFormat, lineWidth, newline);
 
-  Buffer* outputBuffer = BufferCreate(NULL, 0);
+  if (strcmp(io->value, "uring") == 0)
+    UseUring(reader, writer);
+  else if (strcmp(io->value, "pipe") == 0)
+    UsePipes(reader, writer);
+
+  reader->stats       = stats;
+  writer->stats       = stats;
+  writer->sink->stats = stats;
+
+  /* The tag is a keyed hash of the plaintext under a context derived from the key, computed alongside the cipher. */
+  ZigmaContext  tagContext;
+  ZigmaContext* tag = tagged ? ZigmaDerive(&tagContext, cipher, ZQ_STREAM_TAG_DOMAIN) : NULL;
 
   uint64 total;
 
-  if (inputBaseFormat == 16)
-    total = BufferReadBase16(outputBuffer, inputFile);
-  else if (inputBaseFormat == 64)
-    total = BufferReadBase64(outputBuffer, inputFile);
-  else
-    total = BufferReadBase256(outputBuffer, inputFile);
+  if (tag != NULL)
+    StreamTagStart(STREAM_ENCODE, reader, writer);
+
+  if (chunked) {
+    Pool* pool = PoolCreate(jobCount);
 
-  ZigmaEncodeBuffer(cipher, outputBuffer);
+    total = ContainerEncode(cipher, reader, writer, (uint32) chunkByteCount, pool);
 
-  if (outputBaseFormat == 256) {
-    fwrite(outputBuffer->data, 1, total, outputFile);
+    PoolDestroy(pool);
   }
-  else if (outputBaseFormat == 64) {
-    BufferPrintBase64(outputBuffer, outputFile);
+  else if (pipelined) {
+    total = StreamPipeline(cipher, STREAM_ENCODE, reader, writer, tag);
   }
-  else if (outputBaseFormat == 16) {
-    BufferPrintBase16(outputBuffer, outputFile);
+  else if (seekable) {
+    total = SeekableEncode(cipher, reader, writer, (uint32) chunkByteCount);
   }
+  else if (compressed) {
+    total = CompressEncode(cipher, reader, writer, tag);
+  }
+  else {
+    total = StreamCipher(cipher, STREAM_ENCODE, reader, writer, tag);
+  }
+
+  StreamWriterDestroy(writer);
+  StreamReaderDestroy(reader);
 
-  BufferDestroy(outputBuffer);
+  Nullify(&tagContext, sizeof(ZigmaContext));
+  Nullify(cipher, sizeof(ZigmaContext));
+  free(cipher);
 
-  fprintf(stderr, "!COMPLETE! ENCODED %d BYTES!\n", total);
+  fprintf(stderr, "!COMPLETE! ENCODED %" PRIu64 " BYTES!\n", total);
+
+  if (stats != NULL) {
+    StatsReport(stats, stderr, statsFormat, "encode");
+    StatsDestroy(stats);
+  }
 }
 
 void HandleDecode(RegistryNode** registry)
@@ -250,6 +536,17 @@ void HandleDecode(RegistryNode** registry)
   RegistryNode* outputFormat = RegistrySearch(registry, "out.fmt");
   RegistryNode* key          = RegistrySearch(registry, "key");
   RegistryNode* keyFormat    = RegistrySearch(registry, "key.fmt");
+  RegistryNode* mode         = RegistrySearch(registry, "mode");
+  RegistryNode* chunkSize    = RegistrySearch(registry, "chunk.size");
+  RegistryNode* jobs         = RegistrySearch(registry, "jobs");
+  RegistryNode* outputWrap   = RegistrySearch(registry, "out.wrap");
+  RegistryNode* outputEol    = RegistrySearch(registry, "out.eol");
+  RegistryNode* io           = RegistrySearch(registry, "io");
+  RegistryNode* statsOption  = RegistrySearch(registry, "stats");
+  RegistryNode* tagOption    = RegistrySearch(registry, "tag");
+  RegistryNode* compression  = RegistrySearch(registry, "compress");
+  RegistryNode* range        = RegistrySearch(registry, "range");
+  RegistryNode* simd         = RegistrySearch(registry, "simd");
 
   uint32 inputBaseFormat  = strtoul(inputFormat->value, NULL, 10);
   uint32 outputBaseFormat = strtoul(outputFormat->value, NULL, 10);
@@ -264,116 +561,446 @@ void HandleDecode(RegistryNode** registry)
     fprintf(stderr, "ERROR: Invalid output format '%s'!\n", outputFormat->value);
     exit(EXIT_FAILURE);
   }
-  if (!IS_VALID_FORMAT(keyBaseFormat)) {
+  if (!IS_VALID_FORMAT(keyBaseFormat) && strcmp(keyFormat->value, "ctx") != 0) {
     fprintf(stderr, "ERROR: Invalid key format '%s'!\n", keyFormat->value);
     exit(EXIT_FAILURE);
   }
 #undef IS_VALID_FORMAT
 
-  FILE* inputFile  = *input->value != 0 ? OpenFile(input->value, "r") : stdin;
-  FILE* outputFile = *output->value != 0 ? OpenFile(output->value, "w") : stdout;
+  int    chunked        = strcmp(mode->value, "chunked") == 0;
+  int    pipelined      = strcmp(mode->value, "pipeline") == 0;
+  int    seekable       = strcmp(mode->value, "seekable") == 0;
+  uint64 chunkByteCount = strtoull(chunkSize->value, NULL, 10);
+  uint32 jobCount       = strtoul(jobs->value, NULL, 10);
+  int    tagged         = strcmp(tagOption->value, "on") == 0;
+  int    compressed     = strcmp(compression->value, "on") == 0;
+
+  if (!chunked && !pipelined && !seekable && strcmp(mode->value, "stream") != 0) {
+    fprintf(stderr, "ERROR: Invalid mode '%s'!\n", mode->value);
+    exit(EXIT_FAILURE);
+  }
+  if (strcmp(io->value, "sync") != 0 && strcmp(io->value, "uring") != 0 && strcmp(io->value, "pipe") != 0) {
+    fprintf(stderr, "ERROR: Invalid I/O backend '%s'!\n", io->value);
+    exit(EXIT_FAILURE);
+  }
+  if (!tagged && strcmp(tagOption->value, "off") != 0) {
+    fprintf(stderr, "ERROR: Invalid tag setting '%s'!\n", tagOption->value);
+    exit(EXIT_FAILURE);
+  }
+  if (tagged && (chunked || seekable)) {
+    fprintf(stderr, "ERROR: An integrity tag is only supported in stream and pipeline mode!\n");
+    exit(EXIT_FAILURE);
+  }
+  if (!compressed && strcmp(compression->value, "off") != 0) {
+    fprintf(stderr, "ERROR: Invalid compress setting '%s'!\n", compression->value);
+    exit(EXIT_FAILURE);
+  }
+  if (compressed && (chunked || pipelined || seekable)) {
+    fprintf(stderr, "ERROR: Compression is only supported in stream mode!\n");
+    exit(EXIT_FAILURE);
+  }
 
-  Buffer* passwordBuffer = BufferCreate(NULL, ZQ_MAX_KEY_SIZE);
+  SelectKernels(simd);
 
-  if (*key->value != 0) {
-    FILE* keyFile = OpenFile(key->value, "r");
+  StatsFormat statsFormat;
+  Stats*      stats = CreateStats(statsOption, &statsFormat);
 
-    BufferReadBase256(passwordBuffer, keyFile);
+  if (chunkByteCount == 0 || chunkByteCount > ZQ_CONTAINER_MAX_CHUNK_SIZE) {
+    fprintf(stderr, "ERROR: Invalid chunk size '%s'!\n", chunkSize->value);
+    exit(EXIT_FAILURE);
+  }
 
-    if (passwordBuffer->length > ZQ_MAX_KEY_SIZE) {
-      fprintf(stderr, "ERROR: Key file '%s' is too large!\n", key->value);
+  uint64 rangeOffset = 0;
+  uint64 rangeLength = 0;
+
+  /* A range is read from a seekable file in place. */
+  if (*range->value != 0) {
+    char* separator;
+
+    rangeOffset = strtoull(range->value, &separator, 10);
+
+    if (*separator != ':' || separator == range->value || *(separator + 1) == 0) {
+      fprintf(stderr, "ERROR: Invalid range '%s'; expected OFFSET:LEN!\n", range->value);
+      exit(EXIT_FAILURE);
+    }
+
+    rangeLength = strtoull(separator + 1, NULL, 10);
+
+    if (chunked || pipelined) {
+      fprintf(stderr, "ERROR: A range can only be decoded from a seekable file (mode=seekable)!\n");
+      exit(EXIT_FAILURE);
+    }
+    if (inputBaseFormat != 256 || *input->value == 0) {
+      fprintf(stderr, "ERROR: A range needs a binary input file (in=FILE in.fmt=256)!\n");
       exit(EXIT_FAILURE);
     }
+
+    seekable = 1;
   }
-  else {
-    passwordBuffer->length = CaptureKey(passwordBuffer->data, "Enter password: ");
+
+  uint32      lineWidth = strtoul(outputWrap->value, NULL, 10);
+  SinkNewline newline;
+
+  if (lineWidth > ZQ_SINK_MAX_WIDTH) {
+    fprintf(stderr, "ERROR: Invalid line width '%s'!\n", outputWrap->value);
+    exit(EXIT_FAILURE);
+  }
+  if (!SinkParseNewline(outputEol->value, &newline)) {
+    fprintf(stderr, "ERROR: Invalid line ending '%s'!\n", outputEol->value);
+    exit(EXIT_FAILURE);
   }
 
-  fprintf(stderr, "   mode            = DECODING\n");
+  FILE* inputFile  = *input->value != 0 ? OpenFile(input->value, "r") : stdin;
+  FILE* outputFile = *output->value != 0 ? OpenFile(output->value, "w") : stdout;
+
+  fprintf(stderr, "   mode            = DECODING%s\n",
+          chunked ? " (CHUNKED)" : pipelined ? " (PIPELINED)" : seekable ? " (SEEKABLE)" : "");
   fprintf(stderr, "  input (fmt: %3d) = %s\n", inputBaseFormat, *input->value != 0 ? input->value : "<STDIN>");
   fprintf(stderr, " output (fmt: %3d) = %s\n", outputBaseFormat, *output->value != 0 ? output->value : "<STDOUT>");
-  fprintf(stderr, "    key (fmt: %3d) = %s -> %d/%d (%f%%) bytes\n\n", keyBaseFormat,
-          *key->value != 0 ? key->value : "<PASSPHRASE>", passwordBuffer->length, ZQ_MAX_KEY_SIZE,
-          (float) passwordBuffer->length / (float) ZQ_MAX_KEY_SIZE * 100.0f);
 
-  ZigmaContext* cipher = ZigmaCreate(NULL, passwordBuffer->data, passwordBuffer->length);
+  ZigmaContext* cipher = LoadKey(key, keyFormat, 0, stats);
 
-  BufferDestroy(passwordBuffer);
+  if (*range->value != 0) {
+    Seekable* file = SeekableOpen(NULL, fileno(inputFile), cipher);
 
-  Buffer* outputBuffer = BufferCreate(NULL, 0);
+    if (file == NULL || file->error != NULL) {
+      fprintf(stderr, "ERROR: Unable to open seekable file: %s!\n", file ? file->error : "out of memory");
+      exit(EXIT_FAILURE);
+    }
 
-  uint64 total;
+    /* A range that runs past the end would silently produce less than was asked for. */
+    if (rangeOffset > file->length || rangeLength > file->length - rangeOffset) {
+      fprintf(stderr, "ERROR: Range %" PRIu64 ":%" PRIu64 " is past the end of the plaintext (%" PRIu64 " bytes)!\n",
+              rangeOffset, rangeLength, file->length);
+      exit(EXIT_FAILURE);
+    }
 
-  if (inputBaseFormat == 16)
-    total = BufferReadBase16(outputBuffer, inputFile);
-  else if (inputBaseFormat == 64)
-    total = BufferReadBase64(outputBuffer, inputFile);
-  else
-    total = BufferReadBase256(outputBuffer, inputFile);
+    StreamWriter* writer = StreamWriterCreate(NULL, outputFile, outputBaseFormat, lineWidth, newline);
+
+    writer->stats       = stats;
+    writer->sink->stats = stats;
+
+    uint64 total = SeekableDecodeRange(file, rangeOffset, rangeLength, writer);
+
+    StreamWriterDestroy(writer);
+    SeekableDestroy(file);
+
+    Nullify(cipher, sizeof(ZigmaContext));
+    free(cipher);
+
+    fprintf(stderr, "!COMPLETE! DECODED %" PRIu64 " BYTES AT OFFSET %" PRIu64 "!\n", total, rangeOffset);
+
+    if (stats != NULL) {
+      StatsReport(stats, stderr, statsFormat, "decode");
+      StatsDestroy(stats);
+    }
+
+    return;
+  }
+
+  StreamReader* reader = StreamReaderCreate(NULL, inputFile, inputBaseFormat);
+  StreamWriter* writer = StreamWriterCreate(NULL, outputFile, outputBaseFormat, lineWidth, newline);
+
+  if (strcmp(io->value, "uring") == 0)
+    UseUring(reader, writer);
+  else if (strcmp(io->value, "pipe") == 0)
+    UsePipes(reader, writer);
+
+  reader->stats       = stats;
+  writer->stats       = stats;
+  writer->sink->stats = stats;
+
+  /* The tag is a keyed hash of the plaintext under a context derived from the key, computed alongside the cipher. */
+  ZigmaContext  tagContext;
+  ZigmaContext* tag = tagged ? ZigmaDerive(&tagContext, cipher, ZQ_STREAM_TAG_DOMAIN) : NULL;
+
+  uint64 total = 0;
+
+  /* Tagged and untagged streams are told apart by the tag header. A compressed stream without one fails on its
+   * first frame header instead.
+   */
+  if (tag != NULL)
+    StreamTagStart(STREAM_DECODE, reader, writer);
+  else if (!chunked && !seekable && !compressed)
+    total = StreamTagRefuse(cipher, reader, writer);
+
+  if (chunked) {
+    Pool* pool = PoolCreate(jobCount);
 
-  ZigmaDecodeBuffer(cipher, outputBuffer);
+    total = ContainerDecode(cipher, reader, writer, pool);
 
-  if (outputBaseFormat == 256) {
-    fwrite(outputBuffer->data, 1, total, outputFile);
+    PoolDestroy(pool);
   }
-  else if (outputBaseFormat == 64) {
-    BufferPrintBase64(outputBuffer, outputFile);
+  else if (pipelined) {
+    total += StreamPipeline(cipher, STREAM_DECODE, reader, writer, tag);
   }
-  else if (outputBaseFormat == 16) {
-    BufferPrintBase16(outputBuffer, outputFile);
+  else if (seekable) {
+    total = SeekableDecode(cipher, reader, writer);
   }
+  else if (compressed) {
+    total = CompressDecode(cipher, reader, writer, tag);
+  }
+  else {
+    total += StreamCipher(cipher, STREAM_DECODE, reader, writer, tag);
+  }
+
+  StreamWriterDestroy(writer);
+  StreamReaderDestroy(reader);
 
-  BufferDestroy(outputBuffer);
+  Nullify(&tagContext, sizeof(ZigmaContext));
+  Nullify(cipher, sizeof(ZigmaContext));
+  free(cipher);
 
-  fprintf(stderr, "!COMPLETE! DECODED %d BYTES!\n", total);
+  fprintf(stderr, "!COMPLETE! DECODED %" PRIu64 " BYTES!\n", total);
+
+  if (stats != NULL) {
+    StatsReport(stats, stderr, statsFormat, "decode");
+    StatsDestroy(stats);
+  }
 }
 
+/* Hash `in=`, the bare operands and the paths in `list=` (or only stdin if none are given) on a pool of `jobs=`
+ * workers and print one digest line per file; with `verify=`, re-hash the files named in that manifest instead
+ * and report each as OK or FAILED. Exits non-zero if any file could not be read or did not match.
+ */
 void HandleCheck(RegistryNode** registry)
 {
   RegistryNode* input        = RegistrySearch(registry, "in");
   RegistryNode* inputFormat  = RegistrySearch(registry, "in.fmt");
   RegistryNode* output       = RegistrySearch(registry, "out");
   RegistryNode* outputFormat = RegistrySearch(registry, "out.fmt");
+  RegistryNode* fileList     = RegistrySearch(registry, "list");
+  RegistryNode* manifest     = RegistrySearch(registry, "verify");
+  RegistryNode* jobs         = RegistrySearch(registry, "jobs");
 
   uint32 inputBaseFormat  = strtoul(inputFormat->value, NULL, 10);
   uint32 outputBaseFormat = strtoul(outputFormat->value, NULL, 10);
+  uint32 jobCount         = strtoul(jobs->value, NULL, 10);
 
 #define IS_VALID_FORMAT(x) ((x) == 16 || (x) == 64 || (x) == 256)
-  if (!IS_VALID_FORMAT(inputBaseFormat) || !IS_VALID_FORMAT(outputBaseFormat)) {
+  if (!IS_VALID_FORMAT(inputBaseFormat) || (outputBaseFormat != 16 && outputBaseFormat != 64)) {
     fprintf(stderr, "ERROR: Invalid format!\n");
     exit(EXIT_FAILURE);
   }
 #undef IS_VALID_FORMAT
 
-  FILE* inputFile = *input->value != 0 ? OpenFile(input->value, "r") : stdin;
+  CheckList* list = CheckListCreate(NULL, inputBaseFormat);
+
+  if (*manifest->value != 0) {
+    FILE* manifestFile = strcmp(manifest->value, "-") != 0 ? OpenFile(manifest->value, "r") : stdin;
 
-  ZigmaContext* cipher       = ZigmaCreate(NULL, NULL, 0);
-  Buffer*       outputBuffer = BufferCreate(NULL, 0);
-  uint64        total        = BufferReadBase256(outputBuffer, inputFile);
+    CheckListAddManifest(list, manifestFile);
 
-  ZigmaEncodeBuffer(cipher, outputBuffer);
+    if (manifestFile != stdin)
+      fclose(manifestFile);
+  }
+  else {
+    if (*input->value != 0)
+      CheckListAdd(list, input->value);
+
+    /* Bare operands (no '=') name further files and directories, in command line order, exactly as given. */
+    for (int i = 0; i < operandCount; i++) {
+      if (strchr(operands[i], '=') == NULL)
+        CheckListAdd(list, operands[i]);
+    }
 
-  Buffer* checksumBuffer = BufferCreate(NULL, ZIGMA_CHECKSUM_SIZE);
+    if (*fileList->value != 0) {
+      FILE* listFile = strcmp(fileList->value, "-") != 0 ? OpenFile(fileList->value, "r") : stdin;
 
-  ZigmaHashFinal(cipher, checksumBuffer->data, ZIGMA_CHECKSUM_SIZE);
+      CheckListAddFrom(list, listFile);
 
-  if (outputBaseFormat == 16) {
-    for (int i = 0; i < ZIGMA_CHECKSUM_SIZE; i++) {
-      fprintf(stdout, "%02x", checksumBuffer->data[i]);
+      if (listFile != stdin)
+        fclose(listFile);
     }
+
+    if (list->count == 0)
+      CheckListAdd(list, "-");
+  }
+
+  FILE* outputFile = *output->value != 0 ? OpenFile(output->value, "w") : stdout;
+  Sink* sink       = SinkCreate(NULL, outputFile, 0, SINK_NEWLINE_LF);
+  Pool* pool       = PoolCreate(jobCount);
+
+  uint64 failures = CheckListRun(list, pool, sink, outputBaseFormat);
+
+  PoolDestroy(pool);
+  SinkDestroy(sink);
+  CheckListDestroy(list);
+
+  if (failures > 0)
+    exit(EXIT_FAILURE);
+}
+
+void HandleServe(RegistryNode** registry)
+{
+  RegistryNode* socketPath = RegistrySearch(registry, "socket");
+  RegistryNode* key        = RegistrySearch(registry, "key");
+  RegistryNode* keyFormat  = RegistrySearch(registry, "key.fmt");
+  RegistryNode* jobs       = RegistrySearch(registry, "jobs");
+
+  uint32 jobCount = strtoul(jobs->value, NULL, 10);
+
+  if (*socketPath->value == 0) {
+    fprintf(stderr, "ERROR: Invalid socket path!\n");
+    exit(EXIT_FAILURE);
+  }
+
+  Server* server = ServerCreate(socketPath->value, jobCount);
+
+  fprintf(stderr, "   mode            = SERVING\n");
+  fprintf(stderr, " socket            = %s\n", socketPath->value);
+  fprintf(stderr, "   jobs            = %u\n", server->pool->count);
+
+  if (*key->value != 0)
+    ServerAddContext(server, LoadKey(key, keyFormat, 0, NULL));
+  else
+    fprintf(stderr, "    key            = <NONE>\n\n");
+
+  ServerRun(server);
+
+  char statistics[256];
+
+  ServerStatistics(server, statistics, sizeof(statistics));
+  ServerDestroy(server);
+
+  fprintf(stderr, "!COMPLETE! %s", statistics);
+}
+
+void HandleSchedule(RegistryNode** registry)
+{
+  RegistryNode* key       = RegistrySearch(registry, "key");
+  RegistryNode* keyFormat = RegistrySearch(registry, "key.fmt");
+  RegistryNode* output    = RegistrySearch(registry, "out");
+
+  FILE* outputFile = *output->value != 0 ? OpenFile(output->value, "w") : stdout;
+
+  if (isatty(fileno(outputFile))) {
+    fprintf(stderr, "ERROR: Refusing to write a scheduled key to a terminal!\n");
+    exit(EXIT_FAILURE);
   }
-  else if (outputBaseFormat == 64) {
-    char*  encoded = malloc(4 * ((checksumBuffer->length + 2) / 3));
-    uint64 length  = base64_encode(encoded, (char*) checksumBuffer->data, ZIGMA_CHECKSUM_SIZE);
 
-    for (int i = 0; i < length; i++) {
-      fprintf(stdout, "%c", encoded[i]);
+  /* The snapshot is as sensitive as the key itself. */
+  if (*output->value != 0)
+    fchmod(fileno(outputFile), S_IRUSR | S_IWUSR);
+
+  fprintf(stderr, "   mode            = SCHEDULING\n");
+  fprintf(stderr, " output            = %s\n", *output->value != 0 ? output->value : "<STDOUT>");
+
+  ZigmaContext* cipher = LoadKey(key, keyFormat, 1, NULL);
+  uint8         snapshot[ZQ_SCHEDULE_SIZE];
+
+  ZigmaExport(cipher, snapshot);
+
+  if (fwrite(snapshot, 1, ZQ_SCHEDULE_SIZE, outputFile) != ZQ_SCHEDULE_SIZE || fflush(outputFile) != 0) {
+    fprintf(stderr, "ERROR: Unable to write the scheduled key: %s!\n", strerror(errno));
+    exit(EXIT_FAILURE);
+  }
+
+  Nullify(snapshot, sizeof(snapshot));
+  Nullify(cipher, sizeof(ZigmaContext));
+  free(cipher);
+
+  if (outputFile != stdout)
+    fclose(outputFile);
+
+  fprintf(stderr, "!COMPLETE! SCHEDULED %d BYTES!\n", ZQ_SCHEDULE_SIZE);
+}
+
+void HandleArchive(RegistryNode** registry)
+{
+  RegistryNode* input     = RegistrySearch(registry, "in");
+  RegistryNode* output    = RegistrySearch(registry, "out");
+  RegistryNode* key       = RegistrySearch(registry, "key");
+  RegistryNode* keyFormat = RegistrySearch(registry, "key.fmt");
+  RegistryNode* action    = RegistrySearch(registry, "action");
+  RegistryNode* member    = RegistrySearch(registry, "member");
+  RegistryNode* jobs      = RegistrySearch(registry, "jobs");
+
+  uint32 jobCount = strtoul(jobs->value, NULL, 10);
+  int    creating = strcmp(action->value, "create") == 0;
+  int    listing  = strcmp(action->value, "list") == 0;
+
+  if (!creating && !listing && strcmp(action->value, "extract") != 0) {
+    fprintf(stderr, "ERROR: Invalid archive action '%s'!\n", action->value);
+    exit(EXIT_FAILURE);
+  }
+  if (*input->value == 0) {
+    fprintf(stderr, "ERROR: No %s given (in=%s)!\n", creating ? "directory" : "archive", creating ? "DIR" : "FILE");
+    exit(EXIT_FAILURE);
+  }
+  if (creating && *output->value == 0) {
+    fprintf(stderr, "ERROR: An archive must be written to a file (out=FILE)!\n");
+    exit(EXIT_FAILURE);
+  }
+  if (!creating && !listing && *member->value == 0 && *output->value == 0) {
+    fprintf(stderr, "ERROR: Extracting every member needs a directory (out=DIR)!\n");
+    exit(EXIT_FAILURE);
+  }
+
+  fprintf(stderr, "   mode            = %s\n", creating ? "ARCHIVING" : listing ? "LISTING" : "EXTRACTING");
+  fprintf(stderr, "  input            = %s\n", input->value);
+  fprintf(stderr, " output            = %s\n", *output->value != 0 ? output->value : "<STDOUT>");
+
+  if (creating) {
+    FILE*         outputFile = OpenFile(output->value, "w");
+    ZigmaContext* cipher     = LoadKey(key, keyFormat, 1, NULL);
+    Pool*         pool       = PoolCreate(jobCount);
+    uint64        count;
+
+    uint64 total = ArchiveCreate(cipher, input->value, outputFile, pool, &count);
+
+    PoolDestroy(pool);
+    fclose(outputFile);
+
+    Nullify(cipher, sizeof(ZigmaContext));
+    free(cipher);
+
+    fprintf(stderr, "!COMPLETE! ARCHIVED %" PRIu64 " BYTES IN %" PRIu64 " MEMBERS!\n", total, count);
+    return;
+  }
+
+  /* Only the index is decoded up front; a member is read only when it is extracted. */
+  FILE*          inputFile = OpenFile(input->value, "r");
+  ZigmaContext*  cipher    = LoadKey(key, keyFormat, 0, NULL);
+  Archive*       archive   = ArchiveOpen(NULL, inputFile, cipher);
+  ArchiveMember* selected  = NULL;
+
+  if (*member->value != 0 && (selected = ArchiveFind(archive, member->value)) == NULL) {
+    fprintf(stderr, "ERROR: No member '%s' in the archive!\n", member->value);
+    exit(EXIT_FAILURE);
+  }
+
+  if (listing || selected != NULL) {
+    FILE* outputFile = *output->value != 0 ? OpenFile(output->value, "w") : stdout;
+
+    if (listing) {
+      ArchiveList(archive, selected, outputFile);
+
+      fprintf(stderr, "!COMPLETE! LISTED %" PRIu64 " MEMBERS!\n", selected != NULL ? 1 : archive->count);
+    }
+    else {
+      StreamWriter* writer = StreamWriterCreate(NULL, outputFile, 256, 0, SINK_NEWLINE_LF);
+      uint64        total  = ArchiveExtract(archive, selected, writer);
+
+      StreamWriterDestroy(writer);
+
+      fprintf(stderr, "!COMPLETE! EXTRACTED %" PRIu64 " BYTES!\n", total);
     }
 
-    free(encoded);
+    if (outputFile != stdout)
+      fclose(outputFile);
   }
+  else {
+    uint64 total = ArchiveExtractAll(archive, output->value);
+
+    fprintf(stderr, "!COMPLETE! EXTRACTED %" PRIu64 " BYTES IN %" PRIu64 " MEMBERS!\n", total, archive->count);
+  }
+
+  ArchiveDestroy(archive);
+  fclose(inputFile);
 
-  fprintf(stdout, "  %s (%d)\n", *input->value != 0 ? input->value : "-", total);
+  Nullify(cipher, sizeof(ZigmaContext));
+  free(cipher);
 }
 
 void HandleHelp(RegistryNode** registry)
@@ -381,16 +1008,43 @@ void HandleHelp(RegistryNode** registry)
   fprintf(stderr, "Usage: zigma OPERATION [OPERAND...]\n");
   fprintf(stderr, "\n");
   fprintf(stderr, "OPERATION must be one one of the following:\n");
-  fprintf(stderr, "  encode, decode, check, help, version\n");
+  fprintf(stderr, "  encode, decode, check, serve, schedule, archive, help, version\n");
   fprintf(stderr, "\n");
   fprintf(stderr, "OPERAND must be in the form of <KEY[.SUBKEY]>[=VALUE]\n");
   fprintf(stderr, "  KEY must be one of the following:\n");
   fprintf(stderr, "    in=FILE    read from FILE instead, or omit for:  <STDIN>\n");
   fprintf(stderr, "    out=FILE   write to FILE instead, or omit for:   <STDOUT>\n");
   fprintf(stderr, "    key=FILE   use FILE as master key, or omit for:  <CAPTURE>\n");
+  fprintf(stderr, "    mode=MODE  stream (default), pipeline to overlap I/O with the cipher, chunked\n");
+  fprintf(stderr, "               for a multi-core container, or seekable for random access\n");
+  fprintf(stderr, "    range=OFFSET:LEN decode: only LEN bytes from OFFSET of a seekable file\n");
+  fprintf(stderr, "    io=IO      sync (default), uring for asynchronous reads and writes through io_uring,\n");
+  fprintf(stderr, "               or pipe to enlarge pipes and vmsplice() output into them\n");
+  fprintf(stderr, "    tag=on     append an integrity tag when encoding and verify it when decoding (stream\n");
+  fprintf(stderr, "               and pipeline mode; default off); tagged input must be decoded with tag=on.\n");
+  fprintf(stderr, "               Output is written before the tag is checked: on a mismatch an output file\n");
+  fprintf(stderr, "               is truncated, but output already sent down a pipe cannot be recalled\n");
+  fprintf(stderr, "    compress=on compress the plaintext before encoding and decompress it after decoding\n");
+  fprintf(stderr, "               (stream mode; default off)\n");
+  fprintf(stderr, "    simd=NAME  base64/base16 kernel: auto (default), scalar, ssse3, avx2 or avx512\n");
+  fprintf(stderr, "    stats=FMT  report the time and throughput of each stage on <STDERR>, as text or json\n");
+  fprintf(stderr, "    jobs=N     worker threads for chunked mode and check, or omit for one per CPU\n");
+  fprintf(stderr, "    list=FILE  check: also hash every path listed in FILE, one per line\n");
+  fprintf(stderr, "    verify=FILE check: re-hash the files in a digest manifest and report mismatches\n");
+  fprintf(stderr, "    action=ACT archive: create (default) from the directory in=DIR, or list or extract\n");
+  fprintf(stderr, "               the archive in=FILE\n");
+  fprintf(stderr, "    member=PATH archive: list or extract only this member (extract writes it to out=FILE;\n");
+  fprintf(stderr, "               without a member, every file is extracted below out=DIR)\n");
+  fprintf(stderr, "    socket=PATH serve: the Unix socket to listen on (default %s)\n", ZQ_SERVE_DEFAULT_SOCKET);
+  fprintf(stderr, "  Any other OPERAND without '=' names a further file or directory to check.\n");
   fprintf(stderr, "\n");
   fprintf(stderr, "  SUBKEY must be one of the following:\n");
   fprintf(stderr, "    .fmt=BASE   the base encoding of the data (16, 64, 256)\n");
+  fprintf(stderr, "                or ctx for a key file written by schedule (key.fmt)\n");
+  fprintf(stderr, "    .size=BYTES the chunk size for chunked mode, or the checkpoint interval for seekable\n");
+  fprintf(stderr, "                mode (chunk.size, default 1048576)\n");
+  fprintf(stderr, "    .wrap=N     base64 characters per output line (out.wrap, default 76, 0 = none)\n");
+  fprintf(stderr, "    .eol=EOL    the output line ending, lf (default) or crlf (out.eol)\n");
   fprintf(stderr, "\n");
 }
 
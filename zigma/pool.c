@@ -0,0 +1,169 @@
+/*
+ * ZIGMA, Copyright (C) 2024 Chase Zehl O'Byrne
+ *   <mail: zehl@live.com> http://zehlchen.com/
+ *
+ * This file is part of ZIGMA.
+ *
+ * ZIGMA is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ZIGMA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ZIGMA; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "common.h"
+
+#include "pool.h"
+
+/* Worker loop: pop jobs until the pool is stopped and the queue is drained. */
+static void* PoolWorker(void* argument)
+{
+  Pool* pool = (Pool*) argument;
+
+  pthread_mutex_lock(&pool->lock);
+
+  while (1) {
+    while (pool->head == NULL && !pool->stopping)
+      pthread_cond_wait(&pool->available, &pool->lock);
+
+    if (pool->head == NULL)
+      break;
+
+    PoolJob* job = pool->head;
+
+    pool->head = job->next;
+
+    if (pool->head == NULL)
+      pool->tail = NULL;
+
+    pthread_mutex_unlock(&pool->lock);
+
+    job->task(job->argument);
+    free(job);
+
+    pthread_mutex_lock(&pool->lock);
+
+    if (--pool->outstanding == 0)
+      pthread_cond_broadcast(&pool->idle);
+  }
+
+  pthread_mutex_unlock(&pool->lock);
+
+  return NULL;
+}
+
+uint32 PoolDefaultWorkers(void)
+{
+  long count = sysconf(_SC_NPROCESSORS_ONLN);
+
+  return count > 0 ? (uint32) count : 1;
+}
+
+Pool* PoolCreate(uint32 count)
+{
+  Pool* pool = (Pool*) malloc(sizeof(Pool));
+
+  DEBUG_ASSERT(pool != NULL);
+
+  if (count == 0)
+    count = PoolDefaultWorkers();
+
+  pool->threads     = (pthread_t*) malloc(count * sizeof(pthread_t));
+  pool->count       = 0;
+  pool->head        = NULL;
+  pool->tail        = NULL;
+  pool->outstanding = 0;
+  pool->stopping    = 0;
+
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->available, NULL);
+  pthread_cond_init(&pool->idle, NULL);
+
+  for (uint32 i = 0; i < count; i++) {
+    int error = pthread_create(&pool->threads[i], NULL, PoolWorker, pool);
+
+    if (error != 0) {
+      fprintf(stderr, "ERROR: pthread_create(): %s!\n", strerror(error));
+      exit(EXIT_FAILURE);
+    }
+
+    pool->count++;
+  }
+
+  return pool;
+}
+
+void PoolSubmit(Pool* pool, PoolTask task, void* argument)
+{
+  DEBUG_ASSERT(pool != NULL);
+  DEBUG_ASSERT(task != NULL);
+
+  PoolJob* job = (PoolJob*) malloc(sizeof(PoolJob));
+
+  DEBUG_ASSERT(job != NULL);
+
+  job->task     = task;
+  job->argument = argument;
+  job->next     = NULL;
+
+  pthread_mutex_lock(&pool->lock);
+
+  if (pool->tail == NULL)
+    pool->head = job;
+  else
+    pool->tail->next = job;
+
+  pool->tail = job;
+  pool->outstanding++;
+
+  pthread_cond_signal(&pool->available);
+  pthread_mutex_unlock(&pool->lock);
+}
+
+void PoolWait(Pool* pool)
+{
+  DEBUG_ASSERT(pool != NULL);
+
+  pthread_mutex_lock(&pool->lock);
+
+  while (pool->outstanding > 0)
+    pthread_cond_wait(&pool->idle, &pool->lock);
+
+  pthread_mutex_unlock(&pool->lock);
+}
+
+void PoolDestroy(Pool* pool)
+{
+  if (pool == NULL)
+    return;
+
+  pthread_mutex_lock(&pool->lock);
+  pool->stopping = 1;
+  pthread_cond_broadcast(&pool->available);
+  pthread_mutex_unlock(&pool->lock);
+
+  for (uint32 i = 0; i < pool->count; i++)
+    pthread_join(pool->threads[i], NULL);
+
+  pthread_cond_destroy(&pool->idle);
+  pthread_cond_destroy(&pool->available);
+  pthread_mutex_destroy(&pool->lock);
+
+  free(pool->threads);
+  free(pool);
+}
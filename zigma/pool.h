@@ -0,0 +1,91 @@
+/*
+ * ZIGMA, Copyright (C) 2024 Chase Zehl O'Byrne
+ *   <mail: zehl@live.com> http://zehlchen.com/
+ *
+ * This file is part of ZIGMA.
+ *
+ * ZIGMA is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ZIGMA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ZIGMA; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#pragma once
+#ifndef _ZIGMATIQ_POOL_H_
+#define _ZIGMATIQ_POOL_H_
+
+#include <pthread.h>
+
+#include "common.h"
+
+typedef void (*PoolTask)(void* argument);
+
+/* A queued unit of work. */
+typedef struct PoolJob {
+  PoolTask task;
+  void*    argument;
+
+  struct PoolJob* next;
+} PoolJob;
+
+/* Fixed-size pool of worker threads consuming a FIFO job queue.
+ */
+typedef struct Pool {
+  /* The worker threads. */
+  pthread_t* threads;
+  uint32     count;
+
+  /* Pending jobs, oldest first. */
+  PoolJob* head;
+  PoolJob* tail;
+
+  /* Number of jobs queued or running. */
+  uint64 outstanding;
+
+  /* Set when the pool is being torn down. */
+  int stopping;
+
+  pthread_mutex_t lock;
+  pthread_cond_t  available;
+  pthread_cond_t  idle;
+} Pool;
+
+/* The number of workers to use when none is requested: one per online processor.
+ *   @return The number of online processors, at least 1.
+ */
+uint32 PoolDefaultWorkers(void);
+
+/* Start a worker pool.
+ *   @param count The number of workers, or 0 for PoolDefaultWorkers().
+ *   @return The pool object.
+ */
+Pool* PoolCreate(uint32 count);
+
+/* Queue a job. Jobs are started in submission order but may complete in any order.
+ *   @param pool The pool object.
+ *   @param task The function to run.
+ *   @param argument The argument passed to `task`.
+ */
+void PoolSubmit(Pool* pool, PoolTask task, void* argument);
+
+/* Block until every submitted job has completed.
+ *   @param pool The pool object.
+ */
+void PoolWait(Pool* pool);
+
+/* Finish outstanding jobs, stop the workers, and release the pool.
+ *   @param pool The pool object.
+ */
+void PoolDestroy(Pool* pool);
+
+#endif /* _ZIGMATIQ_POOL_H_ */
@@ -0,0 +1,132 @@
+/*
+ * ZIGMA, Copyright (C) 2024 Chase Zehl O'Byrne
+ *   <mail: zehl@live.com> http://zehlchen.com/
+ *
+ * This file is part of ZIGMA.
+ *
+ * ZIGMA is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ZIGMA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ZIGMA; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <sched.h>
+#include <stdlib.h>
+
+#include "common.h"
+
+#include "ring.h"
+
+_Static_assert((ZQ_RING_CAPACITY & (ZQ_RING_CAPACITY - 1)) == 0, "ring capacity must be a power of two");
+
+/* Whether the producer at `position` has a free slot, or the consumer at `position` has an item. */
+static int RingReady(Ring* ring, int producer, uint64 position)
+{
+  if (producer)
+    return position - atomic_load(&ring->tail) < ZQ_RING_CAPACITY;
+
+  return atomic_load(&ring->head) != position;
+}
+
+/* Wait until the ring is ready for this side. The sleeper count is raised before the last check, and the other side
+ * publishes before it reads the count, so one of the two always sees the other and no wake-up is lost.
+ */
+static void RingWait(Ring* ring, int producer, uint64 position)
+{
+  for (int spin = 0; spin < ZQ_RING_SPIN; spin++) {
+    if (RingReady(ring, producer, position))
+      return;
+
+    sched_yield();
+  }
+
+  pthread_mutex_lock(&ring->lock);
+  atomic_fetch_add(&ring->sleepers, 1);
+
+  while (!RingReady(ring, producer, position))
+    pthread_cond_wait(&ring->changed, &ring->lock);
+
+  atomic_fetch_sub(&ring->sleepers, 1);
+  pthread_mutex_unlock(&ring->lock);
+}
+
+/* Wake the other side if it is asleep. */
+static void RingNotify(Ring* ring)
+{
+  if (atomic_load(&ring->sleepers) == 0)
+    return;
+
+  pthread_mutex_lock(&ring->lock);
+  pthread_cond_broadcast(&ring->changed);
+  pthread_mutex_unlock(&ring->lock);
+}
+
+Ring* RingCreate(Ring* ring)
+{
+  if (ring == NULL)
+    ring = (Ring*) malloc(sizeof(Ring));
+
+  DEBUG_ASSERT(ring != NULL);
+
+  atomic_init(&ring->head, 0);
+  atomic_init(&ring->tail, 0);
+  atomic_init(&ring->sleepers, 0);
+
+  pthread_mutex_init(&ring->lock, NULL);
+  pthread_cond_init(&ring->changed, NULL);
+
+  return ring;
+}
+
+void RingPush(Ring* ring, void* item)
+{
+  DEBUG_ASSERT(ring != NULL);
+
+  uint64 head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+
+  RingWait(ring, 1, head);
+
+  ring->slots[head & (ZQ_RING_CAPACITY - 1)] = item;
+
+  atomic_store(&ring->head, head + 1);
+
+  RingNotify(ring);
+}
+
+void* RingPop(Ring* ring)
+{
+  DEBUG_ASSERT(ring != NULL);
+
+  uint64 tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+
+  RingWait(ring, 0, tail);
+
+  void* item = ring->slots[tail & (ZQ_RING_CAPACITY - 1)];
+
+  atomic_store(&ring->tail, tail + 1);
+
+  RingNotify(ring);
+
+  return item;
+}
+
+void RingDestroy(Ring* ring)
+{
+  if (ring == NULL)
+    return;
+
+  pthread_mutex_destroy(&ring->lock);
+  pthread_cond_destroy(&ring->changed);
+
+  free(ring);
+}
@@ -0,0 +1,80 @@
+/*
+ * ZIGMA, Copyright (C) 2024 Chase Zehl O'Byrne
+ *   <mail: zehl@live.com> http://zehlchen.com/
+ *
+ * This file is part of ZIGMA.
+ *
+ * ZIGMA is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ZIGMA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ZIGMA; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#pragma once
+#ifndef _ZIGMATIQ_RING_H_
+#define _ZIGMATIQ_RING_H_
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "common.h"
+
+/* Number of slots in a ring; a power of two. */
+#ifndef ZQ_RING_CAPACITY
+#define ZQ_RING_CAPACITY 8
+#endif
+
+/* Number of times a blocked side re-checks the ring before going to sleep. */
+#define ZQ_RING_SPIN 64
+
+/* Bounded single-producer/single-consumer queue of pointers. Pushing and popping are lock-free; a side that has to
+ * wait (ring full or empty) spins briefly and then sleeps, and the other side only takes the lock to wake it.
+ */
+typedef struct Ring {
+  /* Slots published so far, and slots consumed so far; both only grow. */
+  _Atomic uint64 head;
+  _Atomic uint64 tail;
+
+  void* slots[ZQ_RING_CAPACITY];
+
+  /* Number of threads asleep waiting on the ring. */
+  _Atomic uint32 sleepers;
+
+  pthread_mutex_t lock;
+  pthread_cond_t  changed;
+} Ring;
+
+/* Initialize an empty ring.
+ *   @param ring The ring object, or NULL to allocate one.
+ *   @return The ring object.
+ */
+Ring* RingCreate(Ring* ring);
+
+/* Append an item, waiting while the ring is full. Only one thread may push.
+ *   @param ring The ring object.
+ *   @param item The item.
+ */
+void RingPush(Ring* ring, void* item);
+
+/* Remove the oldest item, waiting while the ring is empty. Only one thread may pop.
+ *   @param ring The ring object.
+ *   @return The item.
+ */
+void* RingPop(Ring* ring);
+
+/* Release a ring. Items still queued are not freed.
+ *   @param ring The ring object.
+ */
+void RingDestroy(Ring* ring);
+
+#endif /* _ZIGMATIQ_RING_H_ */
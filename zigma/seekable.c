@@ -0,0 +1,555 @@
+/*
+ * ZIGMA, Copyright (C) 2024 Chase Zehl O'Byrne
+ *   <mail: zehl@live.com> http://zehlchen.com/
+ *
+ * This file is part of ZIGMA.
+ *
+ * ZIGMA is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ZIGMA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ZIGMA; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "common.h"
+
+#include "buffer.h"
+#include "libzigma.h"
+#include "seekable.h"
+#include "stream.h"
+#include "zigma.h"
+
+static void SeekableCorrupt(const char* reason)
+{
+  fprintf(stderr, "ERROR: Corrupt seekable file: %s!\n", reason);
+  exit(EXIT_FAILURE);
+}
+
+/* Encrypt or decrypt the checkpoint of frame `number` in place. */
+static void SeekableCipherCheckpoint(const ZigmaContext* master, uint64 number, uint8* data, StreamDirection direction)
+{
+  ZigmaContext context;
+
+  ZigmaDerive(&context, master, ZQ_SEEKABLE_DOMAIN | number);
+
+  if (direction == STREAM_ENCODE)
+    ZigmaEncodeBlock(&context, data, data, ZQ_SCHEDULE_SIZE);
+  else
+    ZigmaDecodeBlock(&context, data, data, ZQ_SCHEDULE_SIZE);
+
+  Nullify(&context, sizeof(ZigmaContext));
+}
+
+uint64 SeekableEncode(const ZigmaContext* master, StreamReader* reader, StreamWriter* writer, uint32 interval)
+{
+  DEBUG_ASSERT(master != NULL);
+  DEBUG_ASSERT(reader != NULL);
+  DEBUG_ASSERT(writer != NULL);
+  DEBUG_ASSERT(interval > 0 && interval <= ZQ_SEEKABLE_MAX_INTERVAL);
+
+  uint8        header[ZQ_SEEKABLE_HEADER_SIZE] = {0};
+  uint8        field[8];
+  ZigmaContext context;
+
+  memcpy(header, ZQ_SEEKABLE_MAGIC, 4);
+  header[4] = ZQ_SEEKABLE_VERSION;
+  PackUint32(header + 8, interval);
+
+  StreamWriterWrite(writer, header, sizeof(header));
+
+  memcpy(&context, master, sizeof(ZigmaContext));
+
+  Buffer* frame  = BufferCreate(NULL, interval);
+  Buffer* index  = BufferCreate(NULL, 0);
+  uint64  offset = ZQ_SEEKABLE_HEADER_SIZE;
+  uint64  count  = 0;
+  uint64  total  = 0;
+
+  while ((frame->length = StreamReaderReadFull(reader, frame->data, interval)) > 0) {
+    uint64 at = index->length;
+
+    /* The checkpoint is the context before the frame's first byte. */
+    BufferResize(index, at + ZQ_SCHEDULE_SIZE);
+    ZigmaExport(&context, index->data + at);
+    SeekableCipherCheckpoint(master, count, index->data + at, STREAM_ENCODE);
+
+    uint64 start = StatsStart(writer->stats);
+
+    ZigmaEncodeBlock(&context, frame->data, frame->data, frame->length);
+
+    StatsAdd(writer->stats, STATS_CIPHER, start, frame->length);
+
+    PackUint32(field, (uint32) frame->length);
+    StreamWriterWrite(writer, field, 4);
+    StreamWriterWrite(writer, frame->data, frame->length);
+
+    offset += 4 + frame->length;
+    total += frame->length;
+    count++;
+
+    if (frame->length < interval)
+      break;
+  }
+
+  /* End marker, then the index. */
+  PackUint32(field, 0);
+  StreamWriterWrite(writer, field, 4);
+
+  uint64 indexOffset = offset + 4;
+
+  PackUint64(field, count);
+  StreamWriterWrite(writer, field, 8);
+  StreamWriterWrite(writer, index->data, index->length);
+  PackUint64(field, total);
+  StreamWriterWrite(writer, field, 8);
+  PackUint64(field, indexOffset);
+  StreamWriterWrite(writer, field, 8);
+  StreamWriterWrite(writer, (const uint8*) ZQ_SEEKABLE_INDEX_MAGIC, 4);
+
+  /* BufferDestroy() only wipes `length` bytes; the frame held plaintext. */
+  frame->length = frame->capacity;
+
+  BufferDestroy(frame);
+  BufferDestroy(index);
+
+  Nullify(&context, sizeof(ZigmaContext));
+
+  return total;
+}
+
+uint64 SeekableDecode(const ZigmaContext* master, StreamReader* reader, StreamWriter* writer)
+{
+  DEBUG_ASSERT(master != NULL);
+  DEBUG_ASSERT(reader != NULL);
+  DEBUG_ASSERT(writer != NULL);
+
+  uint8        header[ZQ_SEEKABLE_HEADER_SIZE];
+  uint8        field[8];
+  uint8        checkpoint[ZQ_SCHEDULE_SIZE];
+  uint8        digests[2][ZIGMA_CHECKSUM_SIZE];
+  ZigmaContext context, expected, stored;
+
+  if (StreamReaderReadFull(reader, header, sizeof(header)) != sizeof(header) ||
+      memcmp(header, ZQ_SEEKABLE_MAGIC, 4) != 0)
+    SeekableCorrupt("not a seekable file");
+
+  if (header[4] != ZQ_SEEKABLE_VERSION)
+    SeekableCorrupt("unsupported version");
+
+  uint32 interval = UnpackUint32(header + 8);
+
+  if (interval == 0 || interval > ZQ_SEEKABLE_MAX_INTERVAL)
+    SeekableCorrupt("invalid checkpoint interval");
+
+  memcpy(&context, master, sizeof(ZigmaContext));
+
+  /* The checkpoints this stream should have are hashed as they go by, to be compared with the index at the end. */
+  ZigmaHashInit(&expected);
+
+  Buffer* block  = BufferCreate(NULL, ZQ_STREAM_BLOCK_SIZE);
+  uint64  offset = ZQ_SEEKABLE_HEADER_SIZE;
+  uint64  count  = 0;
+  uint64  total  = 0;
+  uint32  length = interval;
+
+  while (1) {
+    if (StreamReaderReadFull(reader, field, 4) != 4)
+      SeekableCorrupt("missing end marker");
+
+    uint32 previous = length;
+
+    if ((length = UnpackUint32(field)) == 0)
+      break;
+
+    if (length > interval || previous < interval)
+      SeekableCorrupt("frame does not match the checkpoint interval");
+
+    ZigmaExport(&context, checkpoint);
+    ZigmaHashUpdate(&expected, checkpoint, ZQ_SCHEDULE_SIZE);
+
+    for (uint64 remaining = length; remaining > 0;) {
+      block->length = remaining < ZQ_STREAM_BLOCK_SIZE ? remaining : ZQ_STREAM_BLOCK_SIZE;
+
+      if (StreamReaderReadFull(reader, block->data, block->length) != block->length)
+        SeekableCorrupt("truncated frame");
+
+      uint64 start = StatsStart(writer->stats);
+
+      ZigmaDecodeBlock(&context, block->data, block->data, block->length);
+
+      StatsAdd(writer->stats, STATS_CIPHER, start, block->length);
+
+      StreamWriterWrite(writer, block->data, block->length);
+
+      remaining -= block->length;
+    }
+
+    offset += 4 + length;
+    total += length;
+    count++;
+  }
+
+  if (StreamReaderReadFull(reader, field, 8) != 8 || UnpackUint64(field) != count)
+    SeekableCorrupt("checkpoint count does not match the frames");
+
+  ZigmaHashInit(&stored);
+
+  for (uint64 i = 0; i < count; i++) {
+    if (StreamReaderReadFull(reader, checkpoint, ZQ_SCHEDULE_SIZE) != ZQ_SCHEDULE_SIZE)
+      SeekableCorrupt("truncated index");
+
+    SeekableCipherCheckpoint(master, i, checkpoint, STREAM_DECODE);
+    ZigmaHashUpdate(&stored, checkpoint, ZQ_SCHEDULE_SIZE);
+  }
+
+  ZigmaHashFinal(&expected, digests[0], ZIGMA_CHECKSUM_SIZE);
+  ZigmaHashFinal(&stored, digests[1], ZIGMA_CHECKSUM_SIZE);
+
+  /* With a wrong key the checkpoints decrypt to noise, so this is where it shows. */
+  if (memcmp(digests[0], digests[1], ZIGMA_CHECKSUM_SIZE) != 0)
+    SeekableCorrupt("checkpoints do not match the stream (wrong key?)");
+
+  if (StreamReaderReadFull(reader, field, 8) != 8 || UnpackUint64(field) != total)
+    SeekableCorrupt("length does not match the frames");
+
+  if (StreamReaderReadFull(reader, field, 8) != 8 || UnpackUint64(field) != offset + 4)
+    SeekableCorrupt("index offset mismatch");
+
+  if (StreamReaderReadFull(reader, field, 4) != 4 || memcmp(field, ZQ_SEEKABLE_INDEX_MAGIC, 4) != 0)
+    SeekableCorrupt("missing index trailer");
+
+  block->length = block->capacity;
+  BufferDestroy(block);
+
+  Nullify(checkpoint, sizeof(checkpoint));
+  Nullify(&context, sizeof(ZigmaContext));
+  Nullify(&expected, sizeof(ZigmaContext));
+  Nullify(&stored, sizeof(ZigmaContext));
+
+  return total;
+}
+
+/* Record why random access failed.
+ *   @return 0, for the caller to pass on.
+ */
+static int SeekableFail(Seekable* seekable, const char* reason)
+{
+  seekable->error = reason;
+
+  return 0;
+}
+
+/* Read exactly `length` bytes at `offset` of the file.
+ *   @return 1 on success, 0 on failure (see `error`).
+ */
+static int SeekablePread(Seekable* seekable, uint8* data, uint64 length, uint64 offset)
+{
+  while (length > 0) {
+    ssize_t count = pread(seekable->descriptor, data, length, (off_t) offset);
+
+    if (count < 0 && errno == EINTR)
+      continue;
+
+    if (count < 0)
+      return SeekableFail(seekable, "read error");
+
+    if (count == 0)
+      return SeekableFail(seekable, "truncated file");
+
+    data += count;
+    length -= count;
+    offset += count;
+  }
+
+  return 1;
+}
+
+/* Position the context at the start of frame `number`.
+ *   @return 1 on success, 0 on failure (see `error`).
+ */
+static int SeekableRestore(Seekable* seekable, uint64 number)
+{
+  uint8 checkpoint[ZQ_SCHEDULE_SIZE];
+  int   restored;
+
+  if (!SeekablePread(seekable, checkpoint, ZQ_SCHEDULE_SIZE, seekable->checkpoints + number * ZQ_SCHEDULE_SIZE))
+    return 0;
+
+  SeekableCipherCheckpoint(seekable->master, number, checkpoint, STREAM_DECODE);
+
+  restored = ZigmaImport(&seekable->context, checkpoint, ZQ_SCHEDULE_SIZE) != NULL;
+
+  Nullify(checkpoint, sizeof(checkpoint));
+
+  if (!restored) {
+    seekable->position = UINT64_MAX;
+    return SeekableFail(seekable, "unable to decrypt a checkpoint (wrong key or corrupt file)");
+  }
+
+  seekable->position = number * seekable->interval;
+
+  return 1;
+}
+
+/* Decode the next `length` bytes of plaintext from the context's position, crossing frames as needed.
+ *   @return 1 on success, 0 on failure (see `error`).
+ */
+static int SeekableAdvance(Seekable* seekable, uint8* data, uint64 length)
+{
+  while (length > 0) {
+    uint64 frame  = seekable->position / seekable->interval;
+    uint64 within = seekable->position % seekable->interval;
+    uint64 count  = seekable->interval - within;
+
+    if (count > length)
+      count = length;
+
+    if (!SeekablePread(seekable, data, count,
+                       ZQ_SEEKABLE_HEADER_SIZE + frame * (4 + seekable->interval) + 4 + within)) {
+      seekable->position = UINT64_MAX;
+      return 0;
+    }
+
+    ZigmaDecodeBlock(&seekable->context, data, data, count);
+
+    seekable->position += count;
+
+    data += count;
+    length -= count;
+  }
+
+  return 1;
+}
+
+Seekable* SeekableOpen(Seekable* seekable, int descriptor, const ZigmaContext* master)
+{
+  DEBUG_ASSERT(master != NULL);
+
+  if (seekable == NULL)
+    seekable = (Seekable*) malloc(sizeof(Seekable));
+
+  if (seekable == NULL)
+    return NULL;
+
+  struct stat info;
+  uint8       header[ZQ_SEEKABLE_HEADER_SIZE];
+  uint8       trailer[ZQ_SEEKABLE_TRAILER_SIZE];
+  uint8       field[8];
+
+  seekable->descriptor = descriptor;
+  seekable->master     = master;
+  seekable->length     = 0;
+  seekable->position   = UINT64_MAX;
+  seekable->scratch    = NULL;
+  seekable->error      = NULL;
+
+  if (fstat(seekable->descriptor, &info) != 0 || !S_ISREG(info.st_mode)) {
+    SeekableFail(seekable, "random access needs a regular file");
+    return seekable;
+  }
+
+  uint64 size = (uint64) info.st_size;
+
+  if (size < ZQ_SEEKABLE_HEADER_SIZE + 4 + 8 + ZQ_SEEKABLE_TRAILER_SIZE) {
+    SeekableFail(seekable, "too short");
+    return seekable;
+  }
+
+  if (!SeekablePread(seekable, header, sizeof(header), 0) ||
+      !SeekablePread(seekable, trailer, sizeof(trailer), size - ZQ_SEEKABLE_TRAILER_SIZE))
+    return seekable;
+
+  if (memcmp(header, ZQ_SEEKABLE_MAGIC, 4) != 0 || memcmp(trailer + 16, ZQ_SEEKABLE_INDEX_MAGIC, 4) != 0) {
+    SeekableFail(seekable, "not a seekable file");
+    return seekable;
+  }
+
+  if (header[4] != ZQ_SEEKABLE_VERSION) {
+    SeekableFail(seekable, "unsupported version");
+    return seekable;
+  }
+
+  seekable->interval = UnpackUint32(header + 8);
+  seekable->length   = UnpackUint64(trailer);
+
+  uint64 indexOffset = UnpackUint64(trailer + 8);
+
+  if (seekable->interval == 0 || seekable->interval > ZQ_SEEKABLE_MAX_INTERVAL || indexOffset > size - 8 ||
+      seekable->length > size) {
+    SeekableFail(seekable, "invalid header");
+    return seekable;
+  }
+
+  if (!SeekablePread(seekable, field, 8, indexOffset))
+    return seekable;
+
+  seekable->count       = UnpackUint64(field);
+  seekable->checkpoints = indexOffset + 8;
+
+  /* Every frame but the last is full, and the index follows the end marker directly. */
+  uint64 frames = (seekable->length + seekable->interval - 1) / seekable->interval;
+
+  if (seekable->count != frames ||
+      indexOffset != ZQ_SEEKABLE_HEADER_SIZE + 4 * frames + seekable->length + 4 ||
+      size != seekable->checkpoints + frames * ZQ_SCHEDULE_SIZE + ZQ_SEEKABLE_TRAILER_SIZE) {
+    SeekableFail(seekable, "index does not match the file");
+    return seekable;
+  }
+
+  seekable->scratch = (uint8*) malloc(ZQ_STREAM_BLOCK_SIZE);
+
+  if (seekable->scratch == NULL) {
+    SeekableFail(seekable, "out of memory");
+    return seekable;
+  }
+
+  /* Decrypting the first checkpoint checks the key before any plaintext is produced. */
+  if (seekable->count > 0)
+    SeekableRestore(seekable, 0);
+
+  return seekable;
+}
+
+int64 SeekableRead(Seekable* seekable, uint64 offset, uint8* data, uint64 length)
+{
+  DEBUG_ASSERT(seekable != NULL);
+  DEBUG_ASSERT(data != NULL || length == 0);
+
+  if (offset >= seekable->length)
+    return 0;
+
+  if (length > seekable->length - offset)
+    length = seekable->length - offset;
+
+  /* Go back to a checkpoint unless the context is already between the nearest one and the offset. */
+  if (seekable->position > offset || offset - seekable->position > offset % seekable->interval) {
+    if (!SeekableRestore(seekable, offset / seekable->interval))
+      return -1;
+  }
+
+  /* Move forward to the offset, discarding the plaintext. */
+  while (seekable->position < offset) {
+    uint64 count = offset - seekable->position;
+
+    if (!SeekableAdvance(seekable, seekable->scratch, count < ZQ_STREAM_BLOCK_SIZE ? count : ZQ_STREAM_BLOCK_SIZE))
+      return -1;
+  }
+
+  if (!SeekableAdvance(seekable, data, length))
+    return -1;
+
+  return (int64) length;
+}
+
+uint64 SeekableDecodeRange(Seekable* seekable, uint64 offset, uint64 length, StreamWriter* writer)
+{
+  DEBUG_ASSERT(seekable != NULL);
+  DEBUG_ASSERT(writer != NULL);
+
+  uint8* block = (uint8*) malloc(ZQ_STREAM_BLOCK_SIZE);
+  uint64 total = 0;
+  int64  count;
+
+  while (total < length) {
+    uint64 wanted = length - total < ZQ_STREAM_BLOCK_SIZE ? length - total : ZQ_STREAM_BLOCK_SIZE;
+
+    if ((count = SeekableRead(seekable, offset + total, block, wanted)) < 0)
+      SeekableCorrupt(seekable->error);
+
+    if (count == 0)
+      break;
+
+    StreamWriterWrite(writer, block, count);
+
+    total += count;
+  }
+
+  Nullify(block, ZQ_STREAM_BLOCK_SIZE);
+  free(block);
+
+  return total;
+}
+
+void SeekableDestroy(Seekable* seekable)
+{
+  if (seekable == NULL)
+    return;
+
+  Nullify(&seekable->context, sizeof(ZigmaContext));
+
+  if (seekable->scratch != NULL) {
+    Nullify(seekable->scratch, ZQ_STREAM_BLOCK_SIZE);
+    free(seekable->scratch);
+  }
+
+  free(seekable);
+}
+
+struct ZigmaSeekable {
+  ZigmaContext master;
+  Seekable*    seekable;
+};
+
+ZigmaSeekable* ZigmaSeekableOpen(int descriptor, const void* key, size_t length)
+{
+  if (key == NULL || length == 0)
+    return NULL;
+
+  ZigmaSeekable* file = (ZigmaSeekable*) malloc(sizeof(ZigmaSeekable));
+
+  if (file == NULL)
+    return NULL;
+
+  ZigmaCreate(&file->master, (const char*) key, length);
+
+  file->seekable = SeekableOpen(NULL, descriptor, &file->master);
+
+  if (file->seekable == NULL || file->seekable->error != NULL) {
+    ZigmaSeekableClose(file);
+    return NULL;
+  }
+
+  return file;
+}
+
+uint64_t ZigmaSeekableLength(const ZigmaSeekable* file)
+{
+  DEBUG_ASSERT(file != NULL);
+
+  return file->seekable->length;
+}
+
+int64_t ZigmaSeekableRead(ZigmaSeekable* file, uint64_t offset, void* data, size_t length)
+{
+  DEBUG_ASSERT(file != NULL);
+
+  return SeekableRead(file->seekable, offset, (uint8*) data, length);
+}
+
+void ZigmaSeekableClose(ZigmaSeekable* file)
+{
+  if (file == NULL)
+    return;
+
+  SeekableDestroy(file->seekable);
+
+  Nullify(&file->master, sizeof(ZigmaContext));
+  free(file);
+}
@@ -0,0 +1,135 @@
+/*
+ * ZIGMA, Copyright (C) 2024 Chase Zehl O'Byrne
+ *   <mail: zehl@live.com> http://zehlchen.com/
+ *
+ * This file is part of ZIGMA.
+ *
+ * ZIGMA is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ZIGMA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ZIGMA; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#pragma once
+#ifndef _ZIGMATIQ_SEEKABLE_H_
+#define _ZIGMATIQ_SEEKABLE_H_
+
+#include <stdio.h>
+
+#include "common.h"
+
+#include "stream.h"
+#include "zigma.h"
+
+/* A seekable file is a single cipher stream cut into frames of `interval` plaintext bytes, followed by an index of
+ * checkpoints: the context at the start of every frame, serialized as a scheduled key and encrypted with a context
+ * derived from the master key. Reading from any offset restarts from the checkpoint before it.
+ *
+ *   header:  "ZQSK" | version | reserved (3) | interval (4)
+ *   frames:  length (4) | ciphertext, ..., 0 (4)
+ *   index:   count (8) | checkpoints (count * ZQ_SCHEDULE_SIZE) | length (8) | index offset (8) | "ZQSX"
+ *
+ * The ciphertext in the frames is exactly the `mode=stream` ciphertext of the same plaintext.
+ */
+#define ZQ_SEEKABLE_MAGIC        "ZQSK"
+#define ZQ_SEEKABLE_INDEX_MAGIC  "ZQSX"
+#define ZQ_SEEKABLE_VERSION      1
+#define ZQ_SEEKABLE_HEADER_SIZE  12
+#define ZQ_SEEKABLE_TRAILER_SIZE 20
+
+/* The largest checkpoint interval; a frame is held in memory while it is encoded. */
+#define ZQ_SEEKABLE_MAX_INTERVAL (256 * 1024 * 1024) /* 256MB */
+
+/* Checkpoint contexts are derived with indices in their own range, apart from those of container chunks. */
+#define ZQ_SEEKABLE_DOMAIN (1ULL << 63)
+
+/* Random access to a seekable file. Consecutive reads carry on from where the last one ended without going back to
+ * a checkpoint.
+ */
+typedef struct Seekable {
+  /* The file, read with pread(). */
+  int descriptor;
+
+  /* The master key the checkpoints are encrypted under. */
+  const ZigmaContext* master;
+
+  /* Plaintext bytes per frame, plaintext length, and number of checkpoints. */
+  uint32 interval;
+  uint64 length;
+  uint64 count;
+
+  /* File offset of the first checkpoint. */
+  uint64 checkpoints;
+
+  /* The context positioned at plaintext offset `position`. */
+  ZigmaContext context;
+  uint64       position;
+
+  /* Ciphertext read from the file, and plaintext decoded only to move forward. */
+  uint8* scratch;
+
+  /* Why opening or the last read failed, or NULL. Random access never exits the process. */
+  const char* error;
+} Seekable;
+
+/* Encode the input as a seekable file.
+ *   @param master The keyed context; it is not modified.
+ *   @param reader The source of the plaintext.
+ *   @param writer The destination of the seekable file.
+ *   @param interval Plaintext bytes between checkpoints.
+ *   @return The number of plaintext bytes encoded.
+ */
+uint64 SeekableEncode(const ZigmaContext* master, StreamReader* reader, StreamWriter* writer, uint32 interval);
+
+/* Decode a whole seekable file front to back, checking every checkpoint in the index against the stream.
+ *   @param master The keyed context; it is not modified.
+ *   @param reader The source of the seekable file.
+ *   @param writer The destination of the plaintext.
+ *   @return The number of plaintext bytes decoded.
+ */
+uint64 SeekableDecode(const ZigmaContext* master, StreamReader* reader, StreamWriter* writer);
+
+/* Open a seekable file for random access. The header and index are validated, and the first checkpoint is
+ * decrypted, so a wrong key is reported here.
+ *   @param seekable The object to initialize, or NULL to allocate one.
+ *   @param descriptor A binary, regular file; it is read with pread() and not closed.
+ *   @param master The keyed context; it must outlive the object.
+ *   @return The object, with `error` set if the file cannot be used, or NULL if it cannot be allocated.
+ */
+Seekable* SeekableOpen(Seekable* seekable, int descriptor, const ZigmaContext* master);
+
+/* Decode plaintext from any offset, restarting from the nearest checkpoint at or before it. The cost is at most one
+ * interval of cipher work plus the bytes read, however far into the file `offset` is.
+ *   @param seekable The seekable file.
+ *   @param offset The plaintext offset to read from.
+ *   @param data The destination array.
+ *   @param length The number of bytes wanted.
+ *   @return The number of bytes stored, short only at the end of the plaintext, or -1 on failure (see `error`).
+ */
+int64 SeekableRead(Seekable* seekable, uint64 offset, uint8* data, uint64 length);
+
+/* Decode a range of plaintext to a writer, block by block. Exits with an error if the file cannot be read.
+ *   @param seekable The seekable file.
+ *   @param offset The plaintext offset of the range.
+ *   @param length The length of the range; it is cut short at the end of the plaintext.
+ *   @param writer The destination of the plaintext.
+ *   @return The number of bytes written.
+ */
+uint64 SeekableDecodeRange(Seekable* seekable, uint64 offset, uint64 length, StreamWriter* writer);
+
+/* Release a seekable file. The stream itself is not closed.
+ *   @param seekable The seekable file.
+ */
+void SeekableDestroy(Seekable* seekable);
+
+#endif /* _ZIGMATIQ_SEEKABLE_H_ */
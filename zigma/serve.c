@@ -0,0 +1,816 @@
+/*
+ * ZIGMA, Copyright (C) 2024 Chase Zehl O'Byrne
+ *   <mail: zehl@live.com> http://zehlchen.com/
+ *
+ * This file is part of ZIGMA.
+ *
+ * ZIGMA is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ZIGMA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ZIGMA; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "common.h"
+
+#include "serve.h"
+
+#define ZQ_SERVE_EVENTS 64
+
+/* A client connection. Requests are read into `input`; responses are queued in `output` until the socket takes
+ * them. At most one request per connection is with the workers at a time, which keeps responses in order.
+ */
+typedef struct ServeConnection {
+  int descriptor;
+
+  uint8* input;
+  uint64 inputLength;
+  uint64 inputCapacity;
+
+  uint8* output;
+  uint64 outputLength;
+  uint64 outputOffset;
+  uint64 outputCapacity;
+
+  /* Whether a request is with the workers. */
+  int busy;
+
+  /* The events the connection is registered for. */
+  uint32 interest;
+
+  /* Set once the peer has stopped sending; queued responses are still delivered. */
+  int finished;
+
+  /* Set once the socket is closed; the connection is freed when its request (if any) comes back. */
+  int closed;
+
+  struct ServeConnection* next;
+} ServeConnection;
+
+/* A request handed to the workers. */
+typedef struct ServeJob {
+  Server*          server;
+  ServeConnection* connection;
+
+  uint8               operation;
+  const ZigmaContext* key;
+
+  /* The payload, ciphered in place; for hash and key requests the response is built separately. */
+  uint8* payload;
+  uint64 length;
+
+  /* The response payload and status. */
+  uint8* response;
+  uint64 responseLength;
+  uint8  status;
+
+  /* A newly scheduled key, for 'K' requests. */
+  ZigmaContext* scheduled;
+
+  /* When the request was dispatched, in nanoseconds. */
+  uint64 started;
+
+  struct ServeJob* next;
+} ServeJob;
+
+static uint64 ServeNow(void)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return (uint64) now.tv_sec * 1000000000ull + (uint64) now.tv_nsec;
+}
+
+static void ServeFatal(const char* call)
+{
+  fprintf(stderr, "ERROR: %s(): %s!\n", call, strerror(errno));
+  exit(EXIT_FAILURE);
+}
+
+/* Make room for `extra` more bytes in a growable array. */
+static void ServeReserve(uint8** data, uint64* capacity, uint64 length, uint64 extra)
+{
+  if (length + extra <= *capacity)
+    return;
+
+  uint64 target = *capacity == 0 ? 4096 : *capacity;
+
+  while (target < length + extra)
+    target *= 2;
+
+  *data     = (uint8*) realloc(*data, target);
+  *capacity = target;
+
+  if (*data == NULL) {
+    fprintf(stderr, "ERROR: Unable to allocate %" PRIu64 " bytes!\n", target);
+    exit(EXIT_FAILURE);
+  }
+}
+
+/* Runs on a worker: wipe what the request leaves behind and hand the job back to the event loop. */
+static void ServeFinish(ServeJob* job)
+{
+  if (job->payload != NULL) {
+    Nullify(job->payload, job->length);
+    free(job->payload);
+
+    job->payload = NULL;
+  }
+
+  pthread_mutex_lock(&job->server->lock);
+
+  job->next             = job->server->finished;
+  job->server->finished = job;
+
+  pthread_mutex_unlock(&job->server->lock);
+
+  /* Wake the event loop. */
+  uint64 one = 1;
+
+  if (write(job->server->wakeup, &one, sizeof(one)) < 0 && errno != EAGAIN)
+    ServeFatal("write");
+}
+
+/* Runs on a worker: cipher a list of encode and decode requests together, each message in its own lane. */
+static void ServeExecuteBatch(void* argument)
+{
+  ServeJob*    job = (ServeJob*) argument;
+  ZigmaContext contexts[ZQ_SERVE_BATCH_JOBS];
+  ZigmaLane    lanes[2][ZQ_SERVE_BATCH_JOBS];
+  uint64       count[2] = {0, 0};
+  uint64       used     = 0;
+
+  for (ServeJob* item = job; item != NULL; item = item->next) {
+    ZigmaLane* lane = &lanes[item->operation == 'D'][count[item->operation == 'D']++];
+
+    /* Every message starts from the key's scheduled state; the shared context is never touched. */
+    memcpy(&contexts[used], item->key, sizeof(ZigmaContext));
+
+    lane->context = &contexts[used++];
+    lane->output  = item->payload;
+    lane->input   = item->payload;
+    lane->length  = item->length;
+  }
+
+  ZigmaEncodeBatch(lanes[0], count[0]);
+  ZigmaDecodeBatch(lanes[1], count[1]);
+
+  Nullify(contexts, used * sizeof(ZigmaContext));
+
+  /* ServeFinish() reuses `next` for the finished list. */
+  while (job != NULL) {
+    ServeJob* next = job->next;
+
+    job->response       = job->payload;
+    job->responseLength = job->length;
+    job->payload        = NULL;
+
+    ServeFinish(job);
+
+    job = next;
+  }
+}
+
+/* Runs on a worker: hash or schedule one request. */
+static void ServeExecute(void* argument)
+{
+  ServeJob*    job = (ServeJob*) argument;
+  ZigmaContext context;
+
+  switch (job->operation) {
+  case 'H':
+    ZigmaHashInit(&context);
+    ZigmaHashUpdate(&context, job->payload, job->length);
+
+    job->response       = (uint8*) malloc(ZIGMA_CHECKSUM_SIZE);
+    job->responseLength = ZIGMA_CHECKSUM_SIZE;
+
+    ZigmaHashFinal(&context, job->response, ZIGMA_CHECKSUM_SIZE);
+    break;
+
+  case 'K':
+    job->scheduled = ZigmaCreate(NULL, (const char*) job->payload, job->length);
+    break;
+  }
+
+  Nullify(&context, sizeof(ZigmaContext));
+
+  ServeFinish(job);
+}
+
+/* Hand the pending encode and decode jobs to the workers, spread evenly over them and at most ZQ_SERVE_BATCH_JOBS
+ * to a batch.
+ */
+static void ServeSubmit(Server* server)
+{
+  uint64 size = (server->pendingCount + server->pool->count - 1) / server->pool->count;
+
+  if (size > ZQ_SERVE_BATCH_JOBS)
+    size = ZQ_SERVE_BATCH_JOBS;
+
+  while (server->pending != NULL) {
+    ServeJob* batch = server->pending;
+    ServeJob* last  = batch;
+
+    for (uint64 i = 1; i < size && last->next != NULL; i++)
+      last = last->next;
+
+    server->pending = last->next;
+    last->next      = NULL;
+
+    PoolSubmit(server->pool, ServeExecuteBatch, batch);
+  }
+
+  server->pendingCount = 0;
+}
+
+static void ServeClose(Server* server, ServeConnection* connection)
+{
+  if (connection->descriptor >= 0) {
+    epoll_ctl(server->events, EPOLL_CTL_DEL, connection->descriptor, NULL);
+    close(connection->descriptor);
+
+    connection->descriptor = -1;
+    connection->closed     = 1;
+
+    server->connections--;
+  }
+
+  /* Events for the connection may still be pending in this round of the loop; free it afterwards. */
+  if (!connection->busy) {
+    connection->next = server->released;
+    server->released = connection;
+  }
+}
+
+/* Free the connections closed during the last round of events. */
+static void ServeRelease(Server* server)
+{
+  while (server->released != NULL) {
+    ServeConnection* connection = server->released;
+
+    server->released = connection->next;
+
+    Nullify(connection->input, connection->inputCapacity);
+    Nullify(connection->output, connection->outputCapacity);
+
+    free(connection->input);
+    free(connection->output);
+    free(connection);
+  }
+}
+
+/* Send as much of the queued output as the socket will take. */
+static void ServeFlush(Server* server, ServeConnection* connection)
+{
+  while (connection->outputOffset < connection->outputLength) {
+    ssize_t count = send(connection->descriptor, connection->output + connection->outputOffset,
+                         connection->outputLength - connection->outputOffset, MSG_NOSIGNAL);
+
+    if (count < 0) {
+      if (errno == EINTR)
+        continue;
+
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        break;
+
+      ServeClose(server, connection);
+      return;
+    }
+
+    connection->outputOffset += count;
+  }
+
+  if (connection->outputOffset == connection->outputLength)
+    connection->outputOffset = connection->outputLength = 0;
+}
+
+/* Whether to read more from the client. Only one request per connection runs at a time, so nothing is read while
+ * one does, nor past the end of the next request: whatever a pipelining client sends beyond that waits in the
+ * socket, and the kernel pushes back on the client instead of the server buffering it.
+ */
+static int ServeReading(const ServeConnection* connection)
+{
+  if (connection->finished || connection->busy)
+    return 0;
+
+  if (connection->inputLength < ZQ_SERVE_HEADER_SIZE)
+    return 1;
+
+  /* An oversized request is refused from its header alone. */
+  uint64 length = UnpackUint32(connection->input + 8);
+
+  return length <= ZQ_SERVE_MAX_MESSAGE && connection->inputLength < ZQ_SERVE_HEADER_SIZE + length;
+}
+
+/* Register for the events the connection now needs, or close it once a finished peer has been fully answered. */
+static void ServeUpdate(Server* server, ServeConnection* connection)
+{
+  if (connection->closed)
+    return;
+
+  if (connection->finished && !connection->busy && connection->outputLength == 0) {
+    ServeClose(server, connection);
+    return;
+  }
+
+  uint32 interest = (ServeReading(connection) ? EPOLLIN : 0) | (connection->outputLength > 0 ? EPOLLOUT : 0);
+
+  if (interest != connection->interest) {
+    struct epoll_event event = {.events = interest, .data.ptr = connection};
+
+    epoll_ctl(server->events, EPOLL_CTL_MOD, connection->descriptor, &event);
+
+    connection->interest = interest;
+  }
+}
+
+/* Queue a response frame. */
+static void ServeRespond(ServeConnection* connection, uint8 status, const uint8* payload, uint64 length)
+{
+  uint8 header[ZQ_SERVE_RESPONSE_SIZE] = {status};
+
+  PackUint32(header + 4, (uint32) length);
+
+  ServeReserve(&connection->output, &connection->outputCapacity, connection->outputLength,
+               ZQ_SERVE_RESPONSE_SIZE + length);
+
+  memcpy(connection->output + connection->outputLength, header, ZQ_SERVE_RESPONSE_SIZE);
+  memcpy(connection->output + connection->outputLength + ZQ_SERVE_RESPONSE_SIZE, payload, length);
+
+  connection->outputLength += ZQ_SERVE_RESPONSE_SIZE + length;
+}
+
+/* Start the next complete request on a connection, unless one is already running. Requests that need no worker
+ * (statistics and malformed requests) are answered immediately.
+ */
+static void ServeDispatch(Server* server, ServeConnection* connection)
+{
+  while (!connection->busy && !connection->closed && connection->inputLength >= ZQ_SERVE_HEADER_SIZE) {
+    uint8  operation = connection->input[0];
+    uint32 keyId     = UnpackUint32(connection->input + 4);
+    uint64 length    = UnpackUint32(connection->input + 8);
+
+    if (length > ZQ_SERVE_MAX_MESSAGE) {
+      /* The stream cannot be resynchronized; answer, then hang up. */
+      ServeRespond(connection, SERVE_ERROR_LENGTH, NULL, 0);
+
+      Nullify(connection->input, connection->inputLength);
+
+      connection->inputLength = 0;
+      connection->finished    = 1;
+      return;
+    }
+
+    if (connection->inputLength < ZQ_SERVE_HEADER_SIZE + length)
+      return;
+
+    uint8* payload = connection->input + ZQ_SERVE_HEADER_SIZE;
+    int    status  = SERVE_OK;
+
+    if (operation != 'E' && operation != 'D' && operation != 'H' && operation != 'K' && operation != 'S')
+      status = SERVE_ERROR_OPERATION;
+    else if ((operation == 'E' || operation == 'D') && keyId >= server->keyCount)
+      status = SERVE_ERROR_KEY;
+    else if (operation == 'K' && (length == 0 || length > ZQ_MAX_KEY_SIZE))
+      status = SERVE_ERROR_LENGTH;
+
+    if (status != SERVE_OK || operation == 'S') {
+      char   text[256];
+      uint64 textLength = status == SERVE_OK ? ServerStatistics(server, text, sizeof(text)) : 0;
+
+      ServeRespond(connection, status, (const uint8*) text, textLength);
+    }
+    else {
+      ServeJob* job = (ServeJob*) calloc(1, sizeof(ServeJob));
+
+      job->server     = server;
+      job->connection = connection;
+      job->operation  = operation;
+      job->key        = operation == 'E' || operation == 'D' ? server->keys[keyId] : NULL;
+      job->length     = length;
+      job->payload    = (uint8*) malloc(length + 1);
+      job->started    = ServeNow();
+
+      memcpy(job->payload, payload, length);
+
+      connection->busy = 1;
+
+      if (operation == 'E' || operation == 'D') {
+        job->next       = server->pending;
+        server->pending = job;
+
+        server->pendingCount++;
+      }
+      else {
+        PoolSubmit(server->pool, ServeExecute, job);
+      }
+    }
+
+    /* Drop the request from the input, wiping what it leaves behind. */
+    uint64 consumed = ZQ_SERVE_HEADER_SIZE + length;
+
+    memmove(connection->input, connection->input + consumed, connection->inputLength - consumed);
+    Nullify(connection->input + connection->inputLength - consumed, consumed);
+
+    connection->inputLength -= consumed;
+  }
+}
+
+/* Return finished jobs to their connections. */
+static void ServeComplete(Server* server)
+{
+  uint64 count;
+
+  if (read(server->wakeup, &count, sizeof(count)) < 0 && errno != EAGAIN)
+    ServeFatal("read");
+
+  pthread_mutex_lock(&server->lock);
+
+  ServeJob* job    = server->finished;
+  server->finished = NULL;
+
+  pthread_mutex_unlock(&server->lock);
+
+  /* The list is newest first; completions on different connections may be handled in any order. */
+  while (job != NULL) {
+    ServeJob*        next       = job->next;
+    ServeConnection* connection = job->connection;
+
+    if (job->operation == 'K') {
+      uint8 id[4];
+
+      if (server->keyCount < ZQ_SERVE_MAX_KEYS) {
+        PackUint32(id, server->keyCount);
+
+        server->keys[server->keyCount++] = job->scheduled;
+
+        job->response       = (uint8*) malloc(sizeof(id));
+        job->responseLength = sizeof(id);
+
+        memcpy(job->response, id, sizeof(id));
+      }
+      else {
+        Nullify(job->scheduled, sizeof(ZigmaContext));
+        free(job->scheduled);
+
+        job->status = SERVE_ERROR_KEY;
+      }
+    }
+
+    server->latencies[server->requests % ZQ_SERVE_LATENCY_SAMPLES] = ServeNow() - job->started;
+    server->requests++;
+    server->bytes += job->responseLength;
+
+    connection->busy = 0;
+
+    if (connection->closed) {
+      ServeClose(server, connection);
+    }
+    else {
+      ServeRespond(connection, job->status, job->response, job->responseLength);
+      ServeDispatch(server, connection);
+      ServeFlush(server, connection);
+      ServeUpdate(server, connection);
+    }
+
+    if (job->response != NULL) {
+      Nullify(job->response, job->responseLength);
+      free(job->response);
+    }
+
+    free(job);
+
+    job = next;
+  }
+}
+
+/* Read what the client has sent, up to the end of its next request, and start that request. */
+static void ServeReceive(Server* server, ServeConnection* connection)
+{
+  while (ServeReading(connection)) {
+    ServeReserve(&connection->input, &connection->inputCapacity, connection->inputLength, 64 * 1024);
+
+    ssize_t count = recv(connection->descriptor, connection->input + connection->inputLength,
+                         connection->inputCapacity - connection->inputLength, 0);
+
+    if (count > 0) {
+      connection->inputLength += count;
+      continue;
+    }
+
+    if (count < 0 && errno == EINTR)
+      continue;
+
+    if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+      break;
+
+    if (count < 0) {
+      ServeClose(server, connection);
+      return;
+    }
+
+    /* End of stream: requests already received are still answered (the peer may have only shut down writing). */
+    connection->finished = 1;
+    break;
+  }
+
+  ServeDispatch(server, connection);
+  ServeFlush(server, connection);
+  ServeUpdate(server, connection);
+}
+
+static void ServeAccept(Server* server)
+{
+  for (;;) {
+    int descriptor = accept4(server->listener, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+    if (descriptor < 0) {
+      if (errno == EINTR || errno == ECONNABORTED)
+        continue;
+
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        return;
+
+      ServeFatal("accept4");
+    }
+
+    ServeConnection* connection = (ServeConnection*) calloc(1, sizeof(ServeConnection));
+
+    connection->descriptor = descriptor;
+    connection->interest   = EPOLLIN;
+
+    struct epoll_event event = {.events = EPOLLIN, .data.ptr = connection};
+
+    if (epoll_ctl(server->events, EPOLL_CTL_ADD, descriptor, &event) < 0)
+      ServeFatal("epoll_ctl");
+
+    server->connections++;
+  }
+}
+
+Server* ServerCreate(const char* path, uint32 workers)
+{
+  DEBUG_ASSERT(path != NULL);
+
+  struct sockaddr_un address = {.sun_family = AF_UNIX};
+
+  if (strlen(path) >= sizeof(address.sun_path)) {
+    fprintf(stderr, "ERROR: Socket path '%s' is too long!\n", path);
+    exit(EXIT_FAILURE);
+  }
+
+  strcpy(address.sun_path, path);
+
+  Server* server = (Server*) calloc(1, sizeof(Server));
+
+  server->path      = strdup(path);
+  server->latencies = (uint64*) calloc(ZQ_SERVE_LATENCY_SAMPLES, sizeof(uint64));
+
+  pthread_mutex_init(&server->lock, NULL);
+
+  /* Refuse to take over a socket someone is still serving; a stale one is replaced. */
+  server->listener = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+  if (server->listener < 0)
+    ServeFatal("socket");
+
+  int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+  if (connect(probe, (struct sockaddr*) &address, sizeof(address)) == 0) {
+    fprintf(stderr, "ERROR: '%s' is already being served!\n", path);
+    exit(EXIT_FAILURE);
+  }
+
+  close(probe);
+  unlink(path);
+
+  /* Keys are reachable through the socket; only the owner may connect. */
+  mode_t mask = umask(0077);
+
+  if (bind(server->listener, (struct sockaddr*) &address, sizeof(address)) < 0)
+    ServeFatal("bind");
+
+  umask(mask);
+
+  if (listen(server->listener, SOMAXCONN) < 0)
+    ServeFatal("listen");
+
+  /* Signals are taken through the event loop; block them before the workers start so they inherit the mask. */
+  sigset_t signals;
+
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &signals, NULL);
+
+  server->signals = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+  server->wakeup  = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  server->events  = epoll_create1(EPOLL_CLOEXEC);
+
+  if (server->signals < 0 || server->wakeup < 0 || server->events < 0)
+    ServeFatal("epoll_create1");
+
+  /* The three internal descriptors are told apart from connections by their (non-pointer) tags. */
+  struct epoll_event event = {.events = EPOLLIN};
+
+  event.data.u64 = 0;
+  epoll_ctl(server->events, EPOLL_CTL_ADD, server->listener, &event);
+  event.data.u64 = 1;
+  epoll_ctl(server->events, EPOLL_CTL_ADD, server->wakeup, &event);
+  event.data.u64 = 2;
+  epoll_ctl(server->events, EPOLL_CTL_ADD, server->signals, &event);
+
+  server->pool = PoolCreate(workers);
+
+  return server;
+}
+
+int64 ServerAddKey(Server* server, const uint8* key, uint64 length)
+{
+  DEBUG_ASSERT(server != NULL);
+  DEBUG_ASSERT(key != NULL);
+
+  if (server->keyCount == ZQ_SERVE_MAX_KEYS)
+    return -1;
+
+  return ServerAddContext(server, ZigmaCreate(NULL, (const char*) key, length));
+}
+
+int64 ServerAddContext(Server* server, ZigmaContext* context)
+{
+  DEBUG_ASSERT(server != NULL);
+  DEBUG_ASSERT(context != NULL);
+
+  if (server->keyCount == ZQ_SERVE_MAX_KEYS) {
+    Nullify(context, sizeof(ZigmaContext));
+    free(context);
+    return -1;
+  }
+
+  server->keys[server->keyCount] = context;
+
+  return server->keyCount++;
+}
+
+void ServerRun(Server* server)
+{
+  DEBUG_ASSERT(server != NULL);
+
+  struct epoll_event events[ZQ_SERVE_EVENTS];
+
+  for (;;) {
+    int count = epoll_wait(server->events, events, ZQ_SERVE_EVENTS, -1);
+
+    if (count < 0) {
+      if (errno == EINTR)
+        continue;
+
+      ServeFatal("epoll_wait");
+    }
+
+    for (int i = 0; i < count; i++) {
+      if (events[i].data.u64 == 0) {
+        ServeAccept(server);
+      }
+      else if (events[i].data.u64 == 1) {
+        ServeComplete(server);
+      }
+      else if (events[i].data.u64 == 2) {
+        ServeSubmit(server);
+        return;
+      }
+      else {
+        ServeConnection* connection = (ServeConnection*) events[i].data.ptr;
+
+        /* A connection may have been closed by an earlier event in this batch. */
+        if (connection->closed)
+          continue;
+
+        if (events[i].events & EPOLLOUT) {
+          ServeFlush(server, connection);
+          ServeUpdate(server, connection);
+        }
+
+        /* A connection that is not being read from still reports a hang-up; nothing can be delivered to it. */
+        int readable = (connection->interest & EPOLLIN) && (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR));
+
+        if (!connection->closed && readable)
+          ServeReceive(server, connection);
+        else if (!connection->closed && (events[i].events & (EPOLLHUP | EPOLLERR)))
+          ServeClose(server, connection);
+      }
+    }
+
+    ServeSubmit(server);
+    ServeRelease(server);
+  }
+}
+
+static int ServeCompareLatency(const void* a, const void* b)
+{
+  uint64 x = *(const uint64*) a;
+  uint64 y = *(const uint64*) b;
+
+  return x < y ? -1 : x > y;
+}
+
+uint64 ServerStatistics(Server* server, char* text, uint64 size)
+{
+  DEBUG_ASSERT(server != NULL);
+
+  uint64  count  = server->requests < ZQ_SERVE_LATENCY_SAMPLES ? server->requests : ZQ_SERVE_LATENCY_SAMPLES;
+  uint64* sorted = (uint64*) malloc((count + 1) * sizeof(uint64));
+  double  p50 = 0, p99 = 0, max = 0;
+
+  if (count > 0) {
+    memcpy(sorted, server->latencies, count * sizeof(uint64));
+    qsort(sorted, count, sizeof(uint64), ServeCompareLatency);
+
+    p50 = sorted[(count - 1) * 50 / 100] / 1000.0;
+    p99 = sorted[(count - 1) * 99 / 100] / 1000.0;
+    max = sorted[count - 1] / 1000.0;
+  }
+
+  free(sorted);
+
+  int length = snprintf(text, size,
+                        "requests=%" PRIu64 " bytes=%" PRIu64 " keys=%u connections=%" PRIu64
+                        " p50_us=%.1f p99_us=%.1f max_us=%.1f\n",
+                        server->requests, server->bytes, server->keyCount, server->connections, p50, p99, max);
+
+  return length < 0 ? 0 : ((uint64) length < size ? (uint64) length : size - 1);
+}
+
+void ServerDestroy(Server* server)
+{
+  if (server == NULL)
+    return;
+
+  /* Let running jobs finish, then discard what they produced; their connections are going away. */
+  PoolDestroy(server->pool);
+  ServeRelease(server);
+
+  while (server->finished != NULL) {
+    ServeJob* job = server->finished;
+
+    server->finished = job->next;
+
+    if (job->response != NULL)
+      Nullify(job->response, job->responseLength);
+
+    if (job->scheduled != NULL)
+      Nullify(job->scheduled, sizeof(ZigmaContext));
+
+    free(job->response);
+    free(job->scheduled);
+    free(job);
+  }
+
+  for (uint32 i = 0; i < server->keyCount; i++) {
+    Nullify(server->keys[i], sizeof(ZigmaContext));
+    free(server->keys[i]);
+  }
+
+  close(server->listener);
+  close(server->events);
+  close(server->wakeup);
+  close(server->signals);
+
+  unlink(server->path);
+
+  pthread_mutex_destroy(&server->lock);
+
+  free(server->latencies);
+  free(server->path);
+  free(server);
+}
@@ -0,0 +1,154 @@
+/*
+ * ZIGMA, Copyright (C) 2024 Chase Zehl O'Byrne
+ *   <mail: zehl@live.com> http://zehlchen.com/
+ *
+ * This file is part of ZIGMA.
+ *
+ * ZIGMA is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ZIGMA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ZIGMA; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#pragma once
+#ifndef _ZIGMATIQ_SERVE_H_
+#define _ZIGMATIQ_SERVE_H_
+
+#include <pthread.h>
+
+#include "common.h"
+
+#include "pool.h"
+#include "zigma.h"
+
+/* `zigma serve` protocol over a Unix stream socket (all integers little-endian):
+ *
+ *   request   operation (1) | reserved (3) | key id (4) | length (4) | payload (length)
+ *   response  status (1)    | reserved (3) | length (4) | payload (length)
+ *
+ *   'E' encode   payload is plaintext; the response is the ciphertext under key `key id`
+ *   'D' decode   payload is ciphertext; the response is the plaintext
+ *   'H' hash     payload is data (the key id is ignored); the response is its ZIGMA_CHECKSUM_SIZE-byte digest
+ *   'K' key      payload is a key of 1 to ZQ_MAX_KEY_SIZE bytes; it is scheduled once and the response is its new
+ *                key id (4)
+ *   'S' stats    no payload; the response is a line of text with request counts and latency percentiles
+ *
+ * Every message is ciphered from a copy of the key's pre-scheduled context, so messages are independent of each
+ * other and of the order they arrive in. Requests on one connection are answered in order; connections are served
+ * concurrently. A client may send requests back to back, but the server takes them off the socket one at a time.
+ */
+#define ZQ_SERVE_HEADER_SIZE   12
+#define ZQ_SERVE_RESPONSE_SIZE 8
+
+#define ZQ_SERVE_DEFAULT_SOCKET "zigma.sock"
+
+/* The largest payload accepted in one request. */
+#ifndef ZQ_SERVE_MAX_MESSAGE
+#define ZQ_SERVE_MAX_MESSAGE (16 * 1024 * 1024) /* 16MB */
+#endif
+
+/* The number of keys a server can hold. */
+#define ZQ_SERVE_MAX_KEYS 4096
+
+/* The most encode and decode requests ciphered together by one worker with `ZigmaEncodeBatch()`. */
+#define ZQ_SERVE_BATCH_JOBS 64
+
+/* Latency percentiles are computed over this many of the most recent requests. */
+#define ZQ_SERVE_LATENCY_SAMPLES 65536
+
+typedef enum ServeStatus {
+  SERVE_OK = 0,
+  SERVE_ERROR_OPERATION, /* unknown operation */
+  SERVE_ERROR_KEY,       /* unknown key id, or the key table is full */
+  SERVE_ERROR_LENGTH     /* payload too large (or a key longer than ZQ_MAX_KEY_SIZE), or missing where required */
+} ServeStatus;
+
+struct ServeJob;
+struct ServeConnection;
+
+/* A Unix socket server that keeps keys scheduled and ciphers messages on a worker pool.
+ */
+typedef struct Server {
+  /* The socket path, listening socket, event loop, and the descriptors that wake it. */
+  char* path;
+  int   listener;
+  int   events;
+  int   wakeup;
+  int   signals;
+
+  /* The workers messages are ciphered on. */
+  Pool* pool;
+
+  /* Pre-scheduled contexts, indexed by key id. Only the event loop adds keys; contexts are never modified. */
+  ZigmaContext* keys[ZQ_SERVE_MAX_KEYS];
+  uint32        keyCount;
+
+  /* Encode and decode jobs dispatched during this turn of the event loop; they go to the workers in batches. */
+  struct ServeJob* pending;
+  uint64           pendingCount;
+
+  /* Jobs finished by the workers, waiting for the event loop. */
+  struct ServeJob* finished;
+  pthread_mutex_t  lock;
+
+  /* Service times in nanoseconds of the most recent requests (a ring). */
+  uint64* latencies;
+  uint64  requests;
+  uint64  bytes;
+
+  /* Number of open connections, and those closed but not yet freed. */
+  uint64                  connections;
+  struct ServeConnection* released;
+} Server;
+
+/* Bind the socket and start the workers. Exits with an error if the socket is already being served.
+ *   @param path The socket path.
+ *   @param workers The number of workers, or 0 for one per processor.
+ *   @return The server object.
+ */
+Server* ServerCreate(const char* path, uint32 workers);
+
+/* Schedule a key and keep it for the life of the server.
+ *   @param server The server object.
+ *   @param key The key.
+ *   @param length The length of the key.
+ *   @return The key id, or -1 if the key table is full.
+ */
+int64 ServerAddKey(Server* server, const uint8* key, uint64 length);
+
+/* Keep an already scheduled context for the life of the server, e.g. one loaded with `ZigmaImport()`.
+ *   @param server The server object.
+ *   @param context The keyed context; the server takes ownership of it.
+ *   @return The key id, or -1 if the key table is full (the context is then released).
+ */
+int64 ServerAddContext(Server* server, ZigmaContext* context);
+
+/* Serve requests until SIGINT or SIGTERM.
+ *   @param server The server object.
+ */
+void ServerRun(Server* server);
+
+/* Describe the requests served so far: count, bytes, and p50/p99/max service latency.
+ *   @param server The server object.
+ *   @param text The destination.
+ *   @param size The size of the destination.
+ *   @return The length of the description.
+ */
+uint64 ServerStatistics(Server* server, char* text, uint64 size);
+
+/* Stop the workers, wipe the keys, remove the socket, and release the server.
+ *   @param server The server object.
+ */
+void ServerDestroy(Server* server);
+
+#endif /* _ZIGMATIQ_SERVE_H_ */
@@ -0,0 +1,134 @@
+/*
+ * ZIGMA, Copyright (C) 2024 Chase Zehl O'Byrne
+ *   <mail: zehl@live.com> http://zehlchen.com/
+ *
+ * This file is part of ZIGMA.
+ *
+ * ZIGMA is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ZIGMA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ZIGMA; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+
+#include "libzigma.h"
+#include "zigma.h"
+
+_Static_assert(ZIGMA_SESSION_DIGEST_SIZE == ZIGMA_CHECKSUM_SIZE, "digest sizes disagree");
+
+struct ZigmaSession {
+  ZigmaContext     context;
+  ZigmaSessionMode mode;
+
+  /* Set by ZigmaSessionFinal(); cleared by ZigmaSessionReset(). */
+  int finished;
+};
+
+const char* ZigmaLibraryVersion(void)
+{
+  return ZIGMATIQ_VERSION_STRING;
+}
+
+ZigmaSession* ZigmaSessionCreate(ZigmaSessionMode mode, const void* key, size_t length)
+{
+  if (mode != ZIGMA_SESSION_HASH && (key == NULL || length == 0))
+    return NULL;
+
+  if (mode != ZIGMA_SESSION_ENCODE && mode != ZIGMA_SESSION_DECODE && mode != ZIGMA_SESSION_HASH)
+    return NULL;
+
+  ZigmaSession* session = (ZigmaSession*) malloc(sizeof(ZigmaSession));
+
+  if (session == NULL)
+    return NULL;
+
+  session->mode     = mode;
+  session->finished = 0;
+
+  if (mode == ZIGMA_SESSION_HASH)
+    ZigmaHashInit(&session->context);
+  else
+    ZigmaCreate(&session->context, (const char*) key, length);
+
+  return session;
+}
+
+ZigmaSession* ZigmaSessionClone(const ZigmaSession* session)
+{
+  DEBUG_ASSERT(session != NULL);
+
+  ZigmaSession* clone = (ZigmaSession*) malloc(sizeof(ZigmaSession));
+
+  if (clone != NULL)
+    memcpy(clone, session, sizeof(ZigmaSession));
+
+  return clone;
+}
+
+void ZigmaSessionReset(ZigmaSession* session, const ZigmaSession* origin)
+{
+  DEBUG_ASSERT(session != NULL);
+  DEBUG_ASSERT(origin != NULL);
+
+  if (session != origin)
+    memcpy(session, origin, sizeof(ZigmaSession));
+}
+
+void ZigmaSessionUpdate(ZigmaSession* session, void* output, const void* input, size_t length)
+{
+  DEBUG_ASSERT(session != NULL);
+  DEBUG_ASSERT(input != NULL || length == 0);
+
+  if (session->mode == ZIGMA_SESSION_DECODE) {
+    ZigmaDecodeBlock(&session->context, (uint8*) output, (const uint8*) input, length);
+    return;
+  }
+
+  if (output != NULL) {
+    ZigmaEncodeBlock(&session->context, (uint8*) output, (const uint8*) input, length);
+    return;
+  }
+
+  DEBUG_ASSERT(session->mode == ZIGMA_SESSION_HASH);
+
+  ZigmaHashUpdate(&session->context, (const uint8*) input, length);
+}
+
+int ZigmaSessionFinal(ZigmaSession* session, void* digest, size_t length)
+{
+  DEBUG_ASSERT(session != NULL);
+
+  if (session->finished || length > ZIGMA_SESSION_DIGEST_SIZE)
+    return -1;
+
+  session->finished = 1;
+
+  if (digest != NULL)
+    ZigmaHashFinal(&session->context, (uint8*) digest, (uint32) length);
+
+  return 0;
+}
+
+void ZigmaSessionDestroy(ZigmaSession* session)
+{
+  if (session == NULL)
+    return;
+
+  Nullify(session, sizeof(ZigmaSession));
+
+  free(session);
+}
@@ -0,0 +1,531 @@
+/*
+ * ZIGMA, Copyright (C) 2024 Chase Zehl O'Byrne
+ *   <mail: zehl@live.com> http://zehlchen.com/
+ *
+ * This file is part of ZIGMA.
+ *
+ * ZIGMA is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ZIGMA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ZIGMA; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef __linux__
+#define _GNU_SOURCE /* vmsplice() */
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "common.h"
+
+#include "sink.h"
+
+/* Write every byte described by `vector`, resuming after partial writes and interruptions. */
+static void SinkIssue(Sink* sink, struct iovec* vector, int count)
+{
+  uint64 start    = StatsStart(sink->stats);
+  uint64 produced = sink->produced;
+
+  while (count > 0) {
+    ssize_t written = writev(sink->descriptor, vector, count);
+
+    if (written < 0) {
+      if (errno == EINTR)
+        continue;
+
+      fprintf(stderr, "ERROR: write(): %s!\n", strerror(errno));
+      exit(EXIT_FAILURE);
+    }
+
+    sink->produced += written;
+
+    /* Drop the entries written in full and advance into the first one that was not. */
+    while (count > 0 && (size_t) written >= vector->iov_len) {
+      written -= vector->iov_len;
+      vector++;
+      count--;
+    }
+
+    if (count > 0) {
+      vector->iov_base = (char*) vector->iov_base + written;
+      vector->iov_len -= written;
+    }
+  }
+
+  StatsAdd(sink->stats, STATS_WRITE, start, sink->produced - produced);
+}
+
+#ifdef SPLICE_F_GIFT
+/* Whether the next block of the splice ring may be staged into. The pipe holds at most `capacity` bytes of spliced
+ * pages, so once that much more has been spliced behind a block, the reader has taken all of it out of the pipe.
+ */
+static int SinkRingReady(const Sink* sink)
+{
+  return sink->spliceTotal >= sink->ringFree[(sink->ringIndex + 1) % sink->ringCount];
+}
+
+/* Hand the staged block to the pipe and stage into the next block of the ring. */
+static void SinkSplice(Sink* sink)
+{
+  struct iovec vector = {sink->block, sink->length};
+  uint64       start  = StatsStart(sink->stats);
+
+  /* No SPLICE_F_GIFT: the pages are staged into again once the pipe has let go of them. */
+  while (vector.iov_len > 0) {
+    ssize_t written = vmsplice(sink->descriptor, &vector, 1, 0);
+
+    if (written < 0) {
+      if (errno == EINTR)
+        continue;
+
+      fprintf(stderr, "ERROR: vmsplice(): %s!\n", strerror(errno));
+      exit(EXIT_FAILURE);
+    }
+
+    sink->produced += written;
+    sink->spliceTotal += written;
+
+    vector.iov_base = (char*) vector.iov_base + written;
+    vector.iov_len -= written;
+  }
+
+  sink->ringFree[sink->ringIndex] = sink->spliceTotal + sink->capacity;
+  sink->ringIndex                 = (sink->ringIndex + 1) % sink->ringCount;
+
+  StatsAdd(sink->stats, STATS_WRITE, start, sink->length);
+
+  sink->block  = sink->ring + (uint64) sink->ringIndex * ZQ_SINK_BLOCK_SIZE;
+  sink->length = 0;
+}
+#endif
+
+/* Wait for one asynchronous write and release its block. A short write is finished synchronously. */
+static void SinkReap(Sink* sink)
+{
+  uint64 tag;
+  uint64 start  = StatsStart(sink->stats);
+  int32  result = UringComplete(sink->uring, &tag);
+
+  if (result < 0) {
+    fprintf(stderr, "ERROR: write(): %s!\n", strerror(-result));
+    exit(EXIT_FAILURE);
+  }
+
+  sink->produced += result;
+
+  for (uint64 done = result; done < sink->pending[tag];) {
+    ssize_t written = sink->offsets[tag] >= 0 ?
+                          pwrite(sink->descriptor, sink->blocks[tag] + done, sink->pending[tag] - done,
+                                 sink->offsets[tag] + done) :
+                          write(sink->descriptor, sink->blocks[tag] + done, sink->pending[tag] - done);
+
+    if (written < 0 && errno != EINTR) {
+      fprintf(stderr, "ERROR: write(): %s!\n", strerror(errno));
+      exit(EXIT_FAILURE);
+    }
+
+    if (written > 0) {
+      done += written;
+      sink->produced += written;
+    }
+  }
+
+  StatsAdd(sink->stats, STATS_WRITE, start, sink->pending[tag]);
+
+  sink->pending[tag] = 0;
+}
+
+/* Submit the staged block and move on to the next free one. */
+static void SinkSubmit(Sink* sink)
+{
+  uint32 index = sink->current;
+
+  /* Without offsets, a second write could overtake the first. */
+  if (sink->offset < 0) {
+    while (sink->uring->inflight > 0)
+      SinkReap(sink);
+  }
+
+  sink->pending[index] = sink->length;
+  sink->offsets[index] = sink->offset;
+
+  uint64 start = StatsStart(sink->stats);
+
+  UringPrepare(sink->uring, 1, sink->descriptor, index, sink->block, sink->length, sink->offset, index);
+  UringSubmit(sink->uring);
+
+  /* The bytes are counted when the write completes. */
+  StatsAdd(sink->stats, STATS_WRITE, start, 0);
+
+  if (sink->offset >= 0)
+    sink->offset += sink->length;
+
+  sink->current = (index + 1) % ZQ_SINK_URING_DEPTH;
+
+  while (sink->pending[sink->current] > 0)
+    SinkReap(sink);
+
+  sink->block  = sink->blocks[sink->current];
+  sink->length = 0;
+}
+
+int SinkParseNewline(const char* name, SinkNewline* newline)
+{
+  DEBUG_ASSERT(name != NULL);
+  DEBUG_ASSERT(newline != NULL);
+
+  if (strcmp(name, "lf") == 0)
+    *newline = SINK_NEWLINE_LF;
+  else if (strcmp(name, "crlf") == 0)
+    *newline = SINK_NEWLINE_CRLF;
+  else
+    return 0;
+
+  return 1;
+}
+
+Sink* SinkCreate(Sink* sink, FILE* stream, uint32 width, SinkNewline newline)
+{
+  DEBUG_ASSERT(stream != NULL);
+  DEBUG_ASSERT(width <= ZQ_SINK_MAX_WIDTH);
+
+  if (sink == NULL)
+    sink = (Sink*) malloc(sizeof(Sink));
+
+  DEBUG_ASSERT(sink != NULL);
+
+  fflush(stream);
+
+  sink->descriptor = fileno(stream);
+  sink->block      = (char*) aligned_alloc(ZQ_SINK_ALIGNMENT, ZQ_SINK_BLOCK_SIZE);
+  sink->length     = 0;
+  sink->width      = width;
+  sink->column     = 0;
+  sink->produced   = 0;
+  sink->stats      = NULL;
+  sink->spliced    = 0;
+  sink->ring       = NULL;
+  sink->ringFree   = NULL;
+  sink->uring      = NULL;
+  sink->current    = 0;
+  sink->offset     = -1;
+  sink->origin     = -1;
+
+  if (sink->block == NULL) {
+    fprintf(stderr, "ERROR: Unable to allocate output block!\n");
+    exit(EXIT_FAILURE);
+  }
+
+  struct stat info;
+
+  /* Appended output starts at the end of the file, wherever the file position is. */
+  if (fstat(sink->descriptor, &info) == 0 && S_ISREG(info.st_mode)) {
+    sink->origin = (fcntl(sink->descriptor, F_GETFL) & O_APPEND) ? (int64) info.st_size :
+                                                                   (int64) lseek(sink->descriptor, 0, SEEK_CUR);
+  }
+
+  if (newline == SINK_NEWLINE_CRLF) {
+    sink->newline[0]    = '\r';
+    sink->newline[1]    = '\n';
+    sink->newlineLength = 2;
+  }
+  else {
+    sink->newline[0]    = '\n';
+    sink->newlineLength = 1;
+  }
+
+  return sink;
+}
+
+int SinkUsePipe(Sink* sink)
+{
+  DEBUG_ASSERT(sink != NULL);
+
+#ifdef SPLICE_F_GIFT
+  if (sink->spliced)
+    return 1;
+
+  uint64 capacity = sink->uring == NULL ? PipeEnlarge(sink->descriptor) : 0;
+
+  if (capacity == 0)
+    return 0;
+
+  /* Enough blocks that a full pipe never holds the one being staged into, with one to spare for short flushes. */
+  uint32 count = (uint32) ((capacity + ZQ_SINK_BLOCK_SIZE - 1) / ZQ_SINK_BLOCK_SIZE) + 2;
+  void*  ring  = mmap(NULL, (uint64) count * ZQ_SINK_BLOCK_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+                      -1, 0);
+
+  sink->ringFree = (uint64*) calloc(count, sizeof(uint64));
+
+  if (ring == MAP_FAILED || sink->ringFree == NULL) {
+    fprintf(stderr, "ERROR: Unable to allocate output block!\n");
+    exit(EXIT_FAILURE);
+  }
+
+  SinkFlush(sink);
+  free(sink->block);
+
+  sink->ring        = (char*) ring;
+  sink->ringCount   = count;
+  sink->ringIndex   = 0;
+  sink->capacity    = capacity;
+  sink->spliceTotal = 0;
+  sink->block       = sink->ring;
+  sink->spliced     = 1;
+
+  return 1;
+#else
+  return 0;
+#endif
+}
+
+int SinkUseUring(Sink* sink)
+{
+  DEBUG_ASSERT(sink != NULL);
+
+  if (sink->uring != NULL)
+    return 1;
+
+  if (sink->spliced)
+    return 0;
+
+  Uring* uring = UringCreate(ZQ_SINK_URING_DEPTH);
+
+  if (uring == NULL)
+    return 0;
+
+  SinkFlush(sink);
+
+  struct stat  info;
+  struct iovec buffers[ZQ_SINK_URING_DEPTH];
+
+  /* Appending descriptors ignore offsets, so they are treated like pipes. */
+  if (fstat(sink->descriptor, &info) == 0 && S_ISREG(info.st_mode) && !(fcntl(sink->descriptor, F_GETFL) & O_APPEND))
+    sink->offset = lseek(sink->descriptor, 0, SEEK_CUR);
+
+  for (int i = 0; i < ZQ_SINK_URING_DEPTH; i++) {
+    sink->blocks[i]  = i == 0 ? sink->block : (char*) aligned_alloc(ZQ_SINK_ALIGNMENT, ZQ_SINK_BLOCK_SIZE);
+    sink->pending[i] = 0;
+
+    if (sink->blocks[i] == NULL) {
+      fprintf(stderr, "ERROR: Unable to allocate output block!\n");
+      exit(EXIT_FAILURE);
+    }
+
+    buffers[i].iov_base = sink->blocks[i];
+    buffers[i].iov_len  = ZQ_SINK_BLOCK_SIZE;
+  }
+
+  UringRegister(uring, buffers, ZQ_SINK_URING_DEPTH);
+
+  sink->uring   = uring;
+  sink->current = 0;
+
+  return 1;
+}
+
+void SinkWrite(Sink* sink, const void* data, uint64 length)
+{
+  DEBUG_ASSERT(sink != NULL);
+  DEBUG_ASSERT(data != NULL || length == 0);
+
+  if (length <= ZQ_SINK_BLOCK_SIZE - sink->length) {
+    memcpy(sink->block + sink->length, data, length);
+    sink->length += length;
+    return;
+  }
+
+  if (length < ZQ_SINK_BLOCK_SIZE) {
+    SinkFlush(sink);
+
+    memcpy(sink->block, data, length);
+    sink->length = length;
+    return;
+  }
+
+  /* Asynchronous and spliced writes only ever come from the staging blocks. */
+  if (sink->uring != NULL || sink->spliced) {
+    for (uint64 count; length > 0; data = (const char*) data + count, length -= count) {
+      count = length < ZQ_SINK_BLOCK_SIZE ? length : ZQ_SINK_BLOCK_SIZE;
+
+      memcpy(SinkReserve(sink, count), data, count);
+      SinkCommit(sink, count);
+    }
+
+    return;
+  }
+
+  /* Too big to stage: send what is staged and the caller's data together. */
+  struct iovec vector[2] = {
+    {sink->block,  sink->length},
+    {(void*) data, length      },
+  };
+
+  SinkIssue(sink, vector, 2);
+
+  sink->length = 0;
+}
+
+void SinkWriteWrapped(Sink* sink, const char* text, uint64 length)
+{
+  DEBUG_ASSERT(sink != NULL);
+
+  if (sink->width == 0) {
+    SinkWrite(sink, text, length);
+    return;
+  }
+
+  while (length > 0) {
+    uint64 span = sink->width - sink->column;
+
+    if (span > length)
+      span = length;
+
+    /* A line and its terminator always fit in an empty block. */
+    if (ZQ_SINK_BLOCK_SIZE - sink->length < span + sink->newlineLength)
+      SinkFlush(sink);
+
+    memcpy(sink->block + sink->length, text, span);
+
+    sink->length += span;
+    sink->column += span;
+    text += span;
+    length -= span;
+
+    if (sink->column == sink->width) {
+      memcpy(sink->block + sink->length, sink->newline, sink->newlineLength);
+
+      sink->length += sink->newlineLength;
+      sink->column = 0;
+    }
+  }
+}
+
+char* SinkReserve(Sink* sink, uint64 length)
+{
+  DEBUG_ASSERT(sink != NULL);
+  DEBUG_ASSERT(length <= ZQ_SINK_BLOCK_SIZE);
+
+  if (ZQ_SINK_BLOCK_SIZE - sink->length < length)
+    SinkFlush(sink);
+
+  return sink->block + sink->length;
+}
+
+void SinkCommit(Sink* sink, uint64 length)
+{
+  DEBUG_ASSERT(sink != NULL);
+  DEBUG_ASSERT(sink->length + length <= ZQ_SINK_BLOCK_SIZE);
+
+  sink->length += length;
+}
+
+void SinkFlush(Sink* sink)
+{
+  DEBUG_ASSERT(sink != NULL);
+
+  if (sink->length == 0)
+    return;
+
+  if (sink->uring != NULL) {
+    SinkSubmit(sink);
+    return;
+  }
+
+#ifdef SPLICE_F_GIFT
+  /* While the next block of the ring may still be in the pipe, copy the staged one and keep staging into it. */
+  if (sink->spliced && sink->length >= ZQ_SINK_SPLICE_MINIMUM && SinkRingReady(sink)) {
+    SinkSplice(sink);
+    return;
+  }
+#endif
+
+  struct iovec vector = {sink->block, sink->length};
+
+  SinkIssue(sink, &vector, 1);
+
+  sink->length = 0;
+}
+
+int SinkDiscard(Sink* sink)
+{
+  DEBUG_ASSERT(sink != NULL);
+
+  sink->length = 0;
+  sink->column = 0;
+
+  /* Writes still in flight would land after the truncation. */
+  if (sink->uring != NULL) {
+    while (sink->uring->inflight > 0)
+      SinkReap(sink);
+  }
+
+  if (sink->origin < 0 || ftruncate(sink->descriptor, sink->origin) != 0)
+    return 0;
+
+  lseek(sink->descriptor, sink->origin, SEEK_SET);
+
+  if (sink->offset >= 0)
+    sink->offset = sink->origin;
+
+  return 1;
+}
+
+void SinkDestroy(Sink* sink)
+{
+  if (sink == NULL)
+    return;
+
+  SinkFlush(sink);
+
+  if (sink->uring != NULL) {
+    while (sink->uring->inflight > 0)
+      SinkReap(sink);
+
+    /* Writes at explicit offsets leave the file position alone; move it past the output. */
+    if (sink->offset >= 0)
+      lseek(sink->descriptor, sink->offset, SEEK_SET);
+
+    UringDestroy(sink->uring);
+
+    /* Decoded plaintext passes through the blocks. */
+    for (int i = 0; i < ZQ_SINK_URING_DEPTH; i++) {
+      Nullify(sink->blocks[i], ZQ_SINK_BLOCK_SIZE);
+      free(sink->blocks[i]);
+    }
+
+    free(sink);
+    return;
+  }
+
+  /* Decoded plaintext passes through the block. The other blocks of a splice ring may still be in the pipe. */
+  Nullify(sink->block, ZQ_SINK_BLOCK_SIZE);
+
+  if (sink->spliced) {
+    munmap(sink->ring, (uint64) sink->ringCount * ZQ_SINK_BLOCK_SIZE);
+    free(sink->ringFree);
+  }
+  else {
+    free(sink->block);
+  }
+
+  free(sink);
+}
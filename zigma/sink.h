@@ -0,0 +1,194 @@
+/*
+ * ZIGMA, Copyright (C) 2024 Chase Zehl O'Byrne
+ *   <mail: zehl@live.com> http://zehlchen.com/
+ *
+ * This file is part of ZIGMA.
+ *
+ * ZIGMA is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ZIGMA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ZIGMA; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#pragma once
+#ifndef _ZIGMATIQ_SINK_H_
+#define _ZIGMATIQ_SINK_H_
+
+#include <stdio.h>
+
+#include "common.h"
+
+#include "stats.h"
+#include "uring.h"
+
+/* Size of the staging block; output reaches the descriptor in writes of about this size. */
+#ifndef ZQ_SINK_BLOCK_SIZE
+#define ZQ_SINK_BLOCK_SIZE (256 * 1024) /* 256KB */
+#endif
+
+/* Alignment of the staging block. */
+#define ZQ_SINK_ALIGNMENT 4096
+
+/* Number of staging blocks rotated through when writes are asynchronous (SinkUseUring()). */
+#ifndef ZQ_SINK_URING_DEPTH
+#define ZQ_SINK_URING_DEPTH 4
+#endif
+
+/* Blocks flushed with at least this much in them are handed to a pipe with vmsplice() (SinkUsePipe()); smaller
+ * flushes are copied with write() and the block is kept.
+ */
+#define ZQ_SINK_SPLICE_MINIMUM (64 * 1024) /* 64KB */
+
+/* The longest output line accepted by SinkCreate(). */
+#define ZQ_SINK_MAX_WIDTH 4096
+
+typedef enum SinkNewline { SINK_NEWLINE_LF = 0, SINK_NEWLINE_CRLF } SinkNewline;
+
+/* Buffered output to a file descriptor (file, terminal or pipe) that bypasses stdio. Text can be wrapped into lines
+ * as it is staged, so line breaks cost a copy rather than a call each.
+ */
+typedef struct Sink {
+  /* The descriptor written to. */
+  int descriptor;
+
+  /* Staged output not yet written. */
+  char*  block;
+  uint64 length;
+
+  /* Characters per line for wrapped text, or 0 to disable wrapping. */
+  uint32 width;
+
+  /* The line terminator. */
+  char   newline[2];
+  uint32 newlineLength;
+
+  /* Characters on the current (unterminated) line. */
+  uint32 column;
+
+  /* Number of bytes written to the descriptor. */
+  uint64 produced;
+
+  /* Where the time spent writing is recorded, or NULL. */
+  Stats* stats;
+
+  /* Whether large flushes are given to a pipe with vmsplice() (SinkUsePipe()); the block is then one of `ring`. */
+  int spliced;
+
+  /* The mapped blocks staged into and spliced in turn, the one in use, and for each the value `spliceTotal` must
+   * reach before it is staged into again: by then the pipe, which holds at most `capacity` bytes, has let go of it.
+   */
+  char*   ring;
+  uint32  ringCount;
+  uint32  ringIndex;
+  uint64* ringFree;
+  uint64  spliceTotal;
+  uint64  capacity;
+
+  /* Asynchronous writes (SinkUseUring()), or NULL for blocking writes. */
+  Uring* uring;
+
+  /* The staging blocks used in turn while earlier ones are written, with the length and offset of each write. */
+  char*  blocks[ZQ_SINK_URING_DEPTH];
+  uint64 pending[ZQ_SINK_URING_DEPTH];
+  int64  offsets[ZQ_SINK_URING_DEPTH];
+  uint32 current;
+
+  /* The file offset of the next write, or -1 where the descriptor has none (only one write is then in flight). */
+  int64 offset;
+
+  /* The length of a regular file when the sink was created, or -1 for other descriptors (SinkDiscard()). */
+  int64 origin;
+} Sink;
+
+/* Parse a line terminator name ("lf" or "crlf").
+ *   @param name The name.
+ *   @param newline Receives the terminator.
+ *   @return 1 on success, 0 if the name is unknown.
+ */
+int SinkParseNewline(const char* name, SinkNewline* newline);
+
+/* Initialize a sink on the descriptor behind `stream`. Anything already buffered in `stream` is flushed first;
+ * afterwards the stream should not be written to until the sink is destroyed.
+ *   @param sink The sink object.
+ *   @param stream The stream to write to.
+ *   @param width Characters per line for SinkWriteWrapped(), or 0 for no wrapping.
+ *   @param newline The line terminator.
+ *   @return The sink object.
+ */
+Sink* SinkCreate(Sink* sink, FILE* stream, uint32 width, SinkNewline newline);
+
+/* Switch the sink to asynchronous writes through io_uring: a full block is submitted and staging continues in the
+ * next one while the kernel writes it. Regular files keep up to ZQ_SINK_URING_DEPTH writes in flight at explicit
+ * offsets; pipes and other streams keep one. Anything already staged is written out first.
+ *   @param sink The sink object.
+ *   @return 1 on success, 0 if io_uring is unavailable (the sink keeps blocking writes).
+ */
+int SinkUseUring(Sink* sink);
+
+/* If the descriptor is a pipe, enlarge it and hand large flushes to the kernel with vmsplice() instead of copying
+ * them with write(). Staging rotates through a ring of blocks a little larger than the pipe, and a block is only
+ * staged into again once enough has been spliced after it to fill the pipe; until then flushes are copied. The
+ * pages are referenced rather than copied, so a reader that moves them on with splice() instead of reading them
+ * could see them overwritten. Anything already staged is written first.
+ *   @param sink The sink object.
+ *   @return 1 if the descriptor is a pipe and splicing is on, 0 otherwise (the sink is unchanged).
+ */
+int SinkUsePipe(Sink* sink);
+
+/* Write bytes verbatim. Writes larger than the staging block skip the copy and go out with a single writev().
+ *   @param sink The sink object.
+ *   @param data The data array.
+ *   @param length The length of the data array.
+ */
+void SinkWrite(Sink* sink, const void* data, uint64 length);
+
+/* Write text, ending a line after every `width` characters. A partial line is continued by the next call.
+ *   @param sink The sink object.
+ *   @param text The text.
+ *   @param length The length of the text.
+ */
+void SinkWriteWrapped(Sink* sink, const char* text, uint64 length);
+
+/* Obtain room for `length` bytes at the end of the staging block, flushing first if needed, so a producer can
+ * encode straight into the block instead of into a buffer of its own. Follow with SinkCommit().
+ *   @param sink The sink object.
+ *   @param length The number of bytes wanted, at most ZQ_SINK_BLOCK_SIZE.
+ *   @return Where to put the bytes.
+ */
+char* SinkReserve(Sink* sink, uint64 length);
+
+/* Stage bytes placed by the caller after SinkReserve().
+ *   @param sink The sink object.
+ *   @param length The number of bytes actually placed, no more than were reserved.
+ */
+void SinkCommit(Sink* sink, uint64 length);
+
+/* Write out everything staged so far. With asynchronous writes the staged block is only submitted.
+ *   @param sink The sink object.
+ */
+void SinkFlush(Sink* sink);
+
+/* Take back the output written so far, e.g. plaintext that failed verification. Anything staged is dropped and a
+ * regular file is truncated to its length when the sink was created. Output already sent to a pipe, socket or
+ * terminal cannot be recalled.
+ *   @param sink The sink object.
+ *   @return 1 if the output was taken back, 0 if it had already left.
+ */
+int SinkDiscard(Sink* sink);
+
+/* Flush and release the sink. The descriptor is left open.
+ *   @param sink The sink object.
+ */
+void SinkDestroy(Sink* sink);
+
+#endif /* _ZIGMATIQ_SINK_H_ */
@@ -0,0 +1,121 @@
+/*
+ * ZIGMA, Copyright (C) 2024 Chase Zehl O'Byrne
+ *   <mail: zehl@live.com> http://zehlchen.com/
+ *
+ * This file is part of ZIGMA.
+ *
+ * ZIGMA is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ZIGMA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ZIGMA; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <time.h>
+
+#include "common.h"
+
+#include "stats.h"
+
+static const char* StatsStageNames[STATS_STAGES] = {"read", "decode", "schedule", "compress", "cipher", "encode", "write"};
+
+Stats* StatsCreate(Stats* stats)
+{
+  if (stats == NULL)
+    stats = (Stats*) malloc(sizeof(Stats));
+
+  DEBUG_ASSERT(stats != NULL);
+
+  for (int i = 0; i < STATS_STAGES; i++) {
+    atomic_init(&stats->nanoseconds[i], 0);
+    atomic_init(&stats->bytes[i], 0);
+  }
+
+  stats->start = StatsClock();
+
+  return stats;
+}
+
+uint64 StatsClock(void)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return (uint64) now.tv_sec * 1000000000 + (uint64) now.tv_nsec;
+}
+
+uint64 StatsStart(const Stats* stats)
+{
+  return stats != NULL ? StatsClock() : 0;
+}
+
+void StatsAdd(Stats* stats, StatsStage stage, uint64 start, uint64 bytes)
+{
+  if (stats == NULL)
+    return;
+
+  atomic_fetch_add_explicit(&stats->nanoseconds[stage], StatsClock() - start, memory_order_relaxed);
+  atomic_fetch_add_explicit(&stats->bytes[stage], bytes, memory_order_relaxed);
+}
+
+void StatsReport(const Stats* stats, FILE* stream, StatsFormat format, const char* operation)
+{
+  DEBUG_ASSERT(stats != NULL);
+
+  struct rusage usage;
+  double        wall   = (double) (StatsClock() - stats->start) / 1e9;
+  uint64        input  = atomic_load(&stats->bytes[STATS_READ]);
+  uint64        output = atomic_load(&stats->bytes[STATS_WRITE]);
+
+  /* ru_maxrss is in kilobytes on Linux. */
+  getrusage(RUSAGE_SELF, &usage);
+
+  if (format == STATS_JSON) {
+    fprintf(stream, "{\"operation\":\"%s\",\"seconds\":%.6f,\"bytes_in\":%" PRIu64 ",\"bytes_out\":%" PRIu64
+                    ",\"peak_rss_kb\":%ld,\"stages\":{",
+            operation, wall, input, output, usage.ru_maxrss);
+  }
+  else {
+    fprintf(stream, "  %-10s %12s %14s %10s\n", "stage", "seconds", "bytes", "MB/s");
+  }
+
+  for (int i = 0; i < STATS_STAGES; i++) {
+    double seconds = (double) atomic_load(&stats->nanoseconds[i]) / 1e9;
+    uint64 bytes   = atomic_load(&stats->bytes[i]);
+    double rate    = seconds > 0 ? (double) bytes / seconds / 1e6 : 0;
+
+    if (format == STATS_JSON)
+      fprintf(stream, "%s\"%s\":{\"seconds\":%.6f,\"bytes\":%" PRIu64 ",\"mbps\":%.1f}", i > 0 ? "," : "",
+              StatsStageNames[i], seconds, bytes, rate);
+    else
+      fprintf(stream, "  %-10s %12.6f %14" PRIu64 " %10.1f\n", StatsStageNames[i], seconds, bytes, rate);
+  }
+
+  if (format == STATS_JSON) {
+    fprintf(stream, "}}\n");
+  }
+  else {
+    fprintf(stream, "  %-10s %12.6f %14" PRIu64 " %10.1f (in)\n", "total", wall, input,
+            wall > 0 ? (double) input / wall / 1e6 : 0);
+    fprintf(stream, "  %-10s %12s %14" PRIu64 " (out)\n", "", "", output);
+    fprintf(stream, "  peak RSS   %ld KB\n", usage.ru_maxrss);
+  }
+}
+
+void StatsDestroy(Stats* stats)
+{
+  free(stats);
+}
@@ -0,0 +1,97 @@
+/*
+ * ZIGMA, Copyright (C) 2024 Chase Zehl O'Byrne
+ *   <mail: zehl@live.com> http://zehlchen.com/
+ *
+ * This file is part of ZIGMA.
+ *
+ * ZIGMA is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ZIGMA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ZIGMA; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#pragma once
+#ifndef _ZIGMATIQ_STATS_H_
+#define _ZIGMATIQ_STATS_H_
+
+#include <stdatomic.h>
+#include <stdio.h>
+
+#include "common.h"
+
+/* The stages an operation's time is divided into. */
+typedef enum StatsStage {
+  STATS_READ = 0, /* Reading the input (read(), io_uring waits, or a mapping). */
+  STATS_DECODE,   /* Decoding base16 or base64 input. */
+  STATS_SCHEDULE, /* Loading and scheduling the key. */
+  STATS_COMPRESS, /* Compressing or decompressing the plaintext. */
+  STATS_CIPHER,   /* The cipher itself. */
+  STATS_ENCODE,   /* Encoding base16 or base64 output. */
+  STATS_WRITE,    /* Writing the output. */
+  STATS_STAGES
+} StatsStage;
+
+typedef enum StatsFormat { STATS_TEXT = 0, STATS_JSON } StatsFormat;
+
+/* Per-stage timings of one operation. Stages may be timed from several threads at once (pipeline and chunked
+ * modes), so their times are summed over threads and can add up to more than the wall time.
+ */
+typedef struct Stats {
+  /* Time spent in each stage, in nanoseconds, and the bytes each stage took in. */
+  _Atomic uint64 nanoseconds[STATS_STAGES];
+  _Atomic uint64 bytes[STATS_STAGES];
+
+  /* When the operation started, in nanoseconds. */
+  uint64 start;
+} Stats;
+
+/* Initialize a set of statistics and start the wall clock.
+ *   @param stats The statistics object.
+ *   @return The statistics object.
+ */
+Stats* StatsCreate(Stats* stats);
+
+/* Read the monotonic clock.
+ *   @return The time in nanoseconds.
+ */
+uint64 StatsClock(void);
+
+/* Start timing a stage.
+ *   @param stats The statistics object, or NULL when nothing is recorded.
+ *   @return The time to pass to StatsAdd(), or 0 if `stats` is NULL (the clock is not read).
+ */
+uint64 StatsStart(const Stats* stats);
+
+/* Add the time since `start` and a number of bytes to a stage.
+ *   @param stats The statistics object, or NULL when nothing is recorded.
+ *   @param stage The stage.
+ *   @param start The value returned by StatsStart().
+ *   @param bytes The number of bytes the stage took in.
+ */
+void StatsAdd(Stats* stats, StatsStage stage, uint64 start, uint64 bytes);
+
+/* Print the statistics along with the wall time and peak resident memory of the process. The bytes read and written
+ * are the operation's input and output.
+ *   @param stats The statistics object.
+ *   @param stream The stream to print to.
+ *   @param format Human-readable text or a single line of JSON.
+ *   @param operation The name of the operation.
+ */
+void StatsReport(const Stats* stats, FILE* stream, StatsFormat format, const char* operation);
+
+/* Release a statistics object.
+ *   @param stats The statistics object.
+ */
+void StatsDestroy(Stats* stats);
+
+#endif /* _ZIGMATIQ_STATS_H_ */
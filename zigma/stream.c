@@ -0,0 +1,909 @@
+/*
+ * ZIGMA, Copyright (C) 2024 Chase Zehl O'Byrne
+ *   <mail: zehl@live.com> http://zehlchen.com/
+ *
+ * This file is part of ZIGMA.
+ *
+ * ZIGMA is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ZIGMA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ZIGMA; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "common.h"
+
+#include "base16.h"
+#include "base64.h"
+#include "buffer.h"
+#include "stream.h"
+#include "zigma.h"
+
+/* Queue the read that fills buffer `index` of the read-ahead. */
+static void StreamAheadPrepare(StreamReader* reader, uint32 index)
+{
+  reader->aheadLength[index] = -1;
+
+  UringPrepare(reader->uring, 0, fileno(reader->stream), 0, reader->ahead + (uint64) index * ZQ_STREAM_BLOCK_SIZE,
+               ZQ_STREAM_BLOCK_SIZE, reader->aheadPosition, index);
+
+  if (reader->aheadPosition >= 0)
+    reader->aheadPosition += ZQ_STREAM_BLOCK_SIZE;
+}
+
+/* Wait for one read of the read-ahead to complete. */
+static void StreamAheadReap(StreamReader* reader)
+{
+  uint64 tag;
+  int32  result = UringComplete(reader->uring, &tag);
+
+  if (result < 0) {
+    fprintf(stderr, "ERROR: read(): %s!\n", strerror(-result));
+    exit(EXIT_FAILURE);
+  }
+
+  reader->aheadLength[tag] = result;
+}
+
+/* Copy out of the read-ahead buffers in order, queueing the next read as each one is used up. */
+static uint64 StreamAheadRead(StreamReader* reader, uint8* data, uint64 capacity)
+{
+  uint32 index = reader->aheadIndex;
+
+  while (reader->aheadLength[index] < 0)
+    StreamAheadReap(reader);
+
+  uint64 length = reader->aheadLength[index];
+  uint64 count  = length - reader->aheadOffset;
+
+  /* The end of the stream; nothing more is queued. */
+  if (length == 0)
+    return 0;
+
+  if (count > capacity)
+    count = capacity;
+
+  memcpy(data, reader->ahead + (uint64) index * ZQ_STREAM_BLOCK_SIZE + reader->aheadOffset, count);
+
+  reader->aheadOffset += count;
+
+  if (reader->aheadOffset < length)
+    return count;
+
+  reader->aheadOffset = 0;
+  reader->aheadIndex  = (index + 1) % reader->aheadDepth;
+
+  if (reader->aheadBase < 0) {
+    StreamAheadPrepare(reader, index);
+  }
+  else {
+    reader->aheadBase += length;
+
+    /* A short read leaves a gap before the reads queued behind it; queue them again from where it ended. */
+    if (length < ZQ_STREAM_BLOCK_SIZE) {
+      while (reader->uring->inflight > 0)
+        StreamAheadReap(reader);
+
+      reader->aheadPosition = reader->aheadBase;
+
+      for (uint32 i = 1; i <= reader->aheadDepth; i++)
+        StreamAheadPrepare(reader, (index + i) % reader->aheadDepth);
+    }
+    else {
+      StreamAheadPrepare(reader, index);
+    }
+  }
+
+  UringSubmit(reader->uring);
+
+  return count;
+}
+
+/* Read whatever is available from the underlying descriptor (up to `capacity` bytes). Unlike fread(), this
+ * returns after a partial read, which keeps latency low when the input is a pipe.
+ */
+static uint64 StreamReadRaw(StreamReader* reader, uint8* data, uint64 capacity)
+{
+  ssize_t count;
+  uint64  start = StatsStart(reader->stats);
+
+  if (reader->uring != NULL) {
+    count = StreamAheadRead(reader, data, capacity);
+
+    StatsAdd(reader->stats, STATS_READ, start, count);
+
+    return count;
+  }
+
+  do {
+    count = read(fileno(reader->stream), data, capacity);
+  } while (count < 0 && errno == EINTR);
+
+  if (count < 0) {
+    fprintf(stderr, "ERROR: read(): %s!\n", strerror(errno));
+    exit(EXIT_FAILURE);
+  }
+
+  StatsAdd(reader->stats, STATS_READ, start, count);
+
+  return (uint64) count;
+}
+
+StreamReader* StreamReaderCreate(StreamReader* reader, FILE* stream, uint32 format)
+{
+  DEBUG_ASSERT(stream != NULL);
+
+  if (reader == NULL)
+    reader = (StreamReader*) malloc(sizeof(StreamReader));
+
+  DEBUG_ASSERT(reader != NULL);
+
+  reader->stream     = stream;
+  reader->format     = format;
+  reader->scratch    = NULL;
+  reader->pending    = NULL;
+  reader->mapping    = NULL;
+  reader->released   = 0;
+  reader->offset     = 0;
+  reader->consumed   = 0;
+  reader->stats      = NULL;
+  reader->holdback   = 0;
+  reader->heldLength = 0;
+  reader->uring      = NULL;
+  reader->ahead      = NULL;
+
+  base16_decoder_init(&reader->base16);
+  base64_decoder_init(&reader->base64);
+
+  /* Text is read a scratch buffer at a time; the decoded form of a full scratch buffer always fits `pending`. */
+  if (format != 256) {
+    reader->scratch = (uint8*) malloc(ZQ_STREAM_TEXT_SIZE);
+    reader->pending = BufferCreate(NULL, ZQ_STREAM_TEXT_SIZE);
+
+    reader->pending->length = 0;
+  }
+
+  /* Binary regular files are mapped rather than read; pipes and terminals fall back to read(). */
+  if (format == 256)
+    reader->mapping = BufferMap(NULL, stream);
+
+  return reader;
+}
+
+int StreamReaderUsePipe(StreamReader* reader)
+{
+  DEBUG_ASSERT(reader != NULL);
+
+  return PipeEnlarge(fileno(reader->stream)) > 0;
+}
+
+int StreamReaderUseUring(StreamReader* reader)
+{
+  DEBUG_ASSERT(reader != NULL);
+
+  /* Mapped input is never read. */
+  if (reader->mapping != NULL || reader->uring != NULL)
+    return 1;
+
+  Uring* uring = UringCreate(ZQ_STREAM_URING_DEPTH);
+
+  if (uring == NULL)
+    return 0;
+
+  struct stat info;
+  int         descriptor = fileno(reader->stream);
+
+  reader->aheadDepth    = 1;
+  reader->aheadIndex    = 0;
+  reader->aheadOffset   = 0;
+  reader->aheadPosition = -1;
+
+  /* Reads at explicit offsets can be queued several deep; a pipe gives its bytes to whichever read comes first. */
+  if (fstat(descriptor, &info) == 0 && S_ISREG(info.st_mode) &&
+      (reader->aheadPosition = lseek(descriptor, 0, SEEK_CUR)) >= 0)
+    reader->aheadDepth = ZQ_STREAM_URING_DEPTH;
+
+  reader->aheadBase = reader->aheadPosition;
+  reader->ahead     = (uint8*) malloc((uint64) reader->aheadDepth * ZQ_STREAM_BLOCK_SIZE);
+  reader->uring     = uring;
+
+  if (reader->ahead == NULL) {
+    fprintf(stderr, "ERROR: Unable to allocate read-ahead buffers!\n");
+    exit(EXIT_FAILURE);
+  }
+
+  struct iovec buffer = {reader->ahead, (uint64) reader->aheadDepth * ZQ_STREAM_BLOCK_SIZE};
+
+  UringRegister(uring, &buffer, 1);
+
+  for (uint32 i = 0; i < reader->aheadDepth; i++)
+    StreamAheadPrepare(reader, i);
+
+  UringSubmit(uring);
+
+  return 1;
+}
+
+/* Read up to `limit` characters of text and decode them into `data`, which must hold the decoded form of `limit`
+ * characters plus a carried partial quantum. Keeps reading until something has been decoded, so output can flow.
+ */
+static uint64 StreamDecodeText(StreamReader* reader, uint8* data, uint64 limit)
+{
+  uint64 total = 0;
+
+  while (total == 0) {
+    uint64 count = StreamReadRaw(reader, reader->scratch, limit);
+
+    if (count == 0) {
+      if (reader->format == 64 && !base64_decoder_final(&reader->base64)) {
+        fprintf(stderr, "ERROR: Truncated base64 input!\n");
+        exit(EXIT_FAILURE);
+      }
+
+      break;
+    }
+
+    reader->consumed += count;
+
+    uint64 start = StatsStart(reader->stats);
+
+    if (reader->format == 16) {
+      total = base16_decoder_update(&reader->base16, data, (const char*) reader->scratch, count);
+
+      if (total == BASE16_INVALID) {
+        fprintf(stderr, "ERROR: Invalid base16 input!\n");
+        exit(EXIT_FAILURE);
+      }
+    }
+    else {
+      total = base64_decoder_update(&reader->base64, data, (const char*) reader->scratch, count);
+
+      if (total == BASE64_INVALID) {
+        fprintf(stderr, "ERROR: Invalid base64 input!\n");
+        exit(EXIT_FAILURE);
+      }
+    }
+
+    StatsAdd(reader->stats, STATS_DECODE, start, count);
+  }
+
+  return total;
+}
+
+/* StreamReaderRead() without the trailer being held back. */
+static uint64 StreamReadDecoded(StreamReader* reader, uint8* data, uint64 capacity)
+{
+  if (reader->mapping != NULL) {
+    const uint8* source;
+    uint64       count = StreamReaderAcquire(reader, &source, data, capacity);
+
+    memcpy(data, source, count);
+
+    return count;
+  }
+
+  if (reader->format == 256) {
+    uint64 count = StreamReadRaw(reader, data, capacity);
+
+    reader->consumed += count;
+
+    return count;
+  }
+
+  /* Leftovers from a small read are handed out first. */
+  if (reader->offset < reader->pending->length) {
+    uint64 count = reader->pending->length - reader->offset;
+
+    if (count > capacity)
+      count = capacity;
+
+    memcpy(data, reader->pending->data + reader->offset, count);
+
+    reader->offset += count;
+
+    return count;
+  }
+
+  /* Read no more text than can be decoded straight into `data`; tiny reads go through `pending` instead. */
+  uint64 limit = reader->format == 16 ? 2 * capacity : (capacity / 3) * 4;
+
+  if (limit > ZQ_STREAM_TEXT_SIZE)
+    limit = ZQ_STREAM_TEXT_SIZE;
+
+  if (limit < ZQ_STREAM_TEXT_MINIMUM) {
+    reader->pending->length = StreamDecodeText(reader, reader->pending->data, ZQ_STREAM_TEXT_SIZE);
+    reader->offset          = 0;
+
+    return reader->pending->length > 0 ? StreamReadDecoded(reader, data, capacity) : 0;
+  }
+
+  return StreamDecodeText(reader, data, reader->format == 16 ? limit : limit - 4);
+}
+
+uint64 StreamReaderRead(StreamReader* reader, uint8* data, uint64 capacity)
+{
+  DEBUG_ASSERT(reader != NULL);
+  DEBUG_ASSERT(data != NULL);
+
+  /* A mapping simply ends early (see StreamReaderAcquire()). */
+  if (reader->holdback == 0 || reader->mapping != NULL)
+    return StreamReadDecoded(reader, data, capacity);
+
+  /* A read no larger than the trailer cannot hold it back in `data`, so it is gathered in `held` instead. */
+  if (reader->heldLength <= reader->holdback && capacity <= reader->holdback) {
+    while (reader->heldLength <= reader->holdback) {
+      uint64 count = StreamReadDecoded(reader, reader->held + reader->heldLength,
+                                       sizeof(reader->held) - reader->heldLength);
+
+      if (count == 0)
+        return 0;
+
+      reader->heldLength += (uint32) count;
+    }
+  }
+
+  /* Bytes held beyond the trailer go out first. */
+  if (reader->heldLength > reader->holdback) {
+    uint64 count = reader->heldLength - reader->holdback < capacity ? reader->heldLength - reader->holdback : capacity;
+
+    memcpy(data, reader->held, count);
+    memmove(reader->held, reader->held + count, reader->heldLength - count);
+    reader->heldLength -= (uint32) count;
+
+    return count;
+  }
+
+  /* The held bytes go first; whatever then falls in the last `holdback` bytes is held again. */
+  while (1) {
+    uint64 held = reader->heldLength;
+
+    memcpy(data, reader->held, held);
+
+    uint64 count = StreamReadDecoded(reader, data + held, capacity - held);
+    uint64 total = held + count;
+
+    if (count == 0)
+      return 0;
+
+    if (total > reader->holdback) {
+      memcpy(reader->held, data + total - reader->holdback, reader->holdback);
+      reader->heldLength = reader->holdback;
+
+      return total - reader->holdback;
+    }
+
+    memcpy(reader->held, data, total);
+    reader->heldLength = total;
+  }
+}
+
+void StreamReaderHoldBack(StreamReader* reader, uint32 length)
+{
+  DEBUG_ASSERT(reader != NULL);
+  DEBUG_ASSERT(length <= ZQ_STREAM_HOLDBACK_MAX);
+
+  reader->holdback = length;
+}
+
+uint32 StreamReaderTrailer(StreamReader* reader, uint8* data)
+{
+  DEBUG_ASSERT(reader != NULL);
+  DEBUG_ASSERT(data != NULL);
+
+  if (reader->mapping != NULL) {
+    uint32 length = reader->mapping->length < reader->holdback ? (uint32) reader->mapping->length : reader->holdback;
+
+    memcpy(data, reader->mapping->data + reader->mapping->length - length, length);
+
+    return length;
+  }
+
+  uint32 length = reader->heldLength < reader->holdback ? reader->heldLength : reader->holdback;
+
+  memcpy(data, reader->held + reader->heldLength - length, length);
+
+  return length;
+}
+
+uint64 StreamReaderAcquire(StreamReader* reader, const uint8** data, uint8* scratch, uint64 capacity)
+{
+  DEBUG_ASSERT(reader != NULL);
+  DEBUG_ASSERT(data != NULL);
+
+  if (reader->mapping == NULL) {
+    *data = scratch;
+
+    return StreamReaderRead(reader, scratch, capacity);
+  }
+
+  uint64 end   = reader->mapping->length > reader->holdback ? reader->mapping->length - reader->holdback : 0;
+  uint64 count = end > reader->offset ? end - reader->offset : 0;
+  uint64 start = StatsStart(reader->stats);
+
+  if (count > capacity)
+    count = capacity;
+
+  *data = reader->mapping->data + reader->offset;
+
+  /* Drop pages already consumed so resident memory stays bounded on very large files. */
+  if (reader->offset - reader->released >= ZQ_STREAM_RELEASE_SIZE) {
+    uint64    page  = (uint64) sysconf(_SC_PAGESIZE);
+    uintptr_t start = ((uintptr_t) (reader->mapping->data + reader->released) + page - 1) & ~(page - 1);
+    uintptr_t end   = (uintptr_t) (reader->mapping->data + reader->offset) & ~(page - 1);
+
+    if (end > start)
+      madvise((void*) start, end - start, MADV_DONTNEED);
+
+    reader->released = reader->offset;
+  }
+
+  reader->offset += count;
+  reader->consumed += count;
+
+  StatsAdd(reader->stats, STATS_READ, start, count);
+
+  return count;
+}
+
+uint64 StreamReaderReadFull(StreamReader* reader, uint8* data, uint64 length)
+{
+  uint64 total = 0;
+  uint64 count;
+
+  while (total < length && (count = StreamReaderRead(reader, data + total, length - total)) > 0)
+    total += count;
+
+  return total;
+}
+
+void StreamReaderDestroy(StreamReader* reader)
+{
+  if (reader == NULL)
+    return;
+
+  if (reader->format == 16 && !base16_decoder_final(&reader->base16))
+    fprintf(stderr, "WARNING: Ignoring trailing half-byte in base16 input!\n");
+
+  /* BufferDestroy() only wipes `length` bytes; the decoded text may be plaintext. */
+  if (reader->pending != NULL)
+    reader->pending->length = reader->pending->capacity;
+
+  BufferDestroy(reader->pending);
+  BufferDestroy(reader->mapping);
+
+  if (reader->uring != NULL) {
+    while (reader->uring->inflight > 0)
+      StreamAheadReap(reader);
+
+    UringDestroy(reader->uring);
+
+    Nullify(reader->ahead, (uint64) reader->aheadDepth * ZQ_STREAM_BLOCK_SIZE);
+    free(reader->ahead);
+  }
+
+  free(reader->scratch);
+  free(reader);
+}
+
+StreamWriter* StreamWriterCreate(StreamWriter* writer, FILE* stream, uint32 format, uint32 width, SinkNewline newline)
+{
+  DEBUG_ASSERT(stream != NULL);
+
+  if (writer == NULL)
+    writer = (StreamWriter*) malloc(sizeof(StreamWriter));
+
+  DEBUG_ASSERT(writer != NULL);
+
+  writer->sink        = SinkCreate(NULL, stream, format == 64 ? width : 0, newline);
+  writer->format      = format;
+  writer->carryLength = 0;
+  writer->scratch     = NULL;
+  writer->produced    = 0;
+  writer->stats       = NULL;
+
+  /* Only wrapped base64 is staged here; large enough for a tile, the carried triple and a terminator. */
+  if (format == 64 && width > 0)
+    writer->scratch = (char*) malloc(2 * ZQ_STREAM_TILE_SIZE + 8);
+
+  return writer;
+}
+
+/* Encode and write the given binary chunk, which may be larger than one block. For base64, `length` must be a
+ * multiple of three unless this is the final chunk.
+ */
+static void StreamWriteChunk(StreamWriter* writer, const uint8* data, uint64 length)
+{
+  /* Text is encoded one tile at a time; base64 tiles stay on triple boundaries. */
+  const uint64 slice = ZQ_STREAM_TILE_SIZE - ZQ_STREAM_TILE_SIZE % 3;
+
+  if (writer->format == 256) {
+    SinkWrite(writer->sink, data, length);
+    writer->produced += length;
+    return;
+  }
+
+  while (length > 0) {
+    uint64 count = length < slice ? length : slice;
+    uint64 encoded;
+    uint64 start;
+
+    /* Unwrapped text is encoded straight into the sink's block; only line wrapping needs a staging copy. Reserving
+     * space may write out the block, so the clock starts after it.
+     */
+    if (writer->format == 16) {
+      char* target = SinkReserve(writer->sink, 2 * count);
+
+      start   = StatsStart(writer->stats);
+      encoded = base16_encode(target, data, count);
+
+      SinkCommit(writer->sink, encoded);
+    }
+    else if (writer->sink->width == 0) {
+      char* target = SinkReserve(writer->sink, 4 * ((count + 2) / 3) + 1);
+
+      start   = StatsStart(writer->stats);
+      encoded = base64_encode(target, (const char*) data, count);
+
+      SinkCommit(writer->sink, encoded);
+    }
+    else {
+      start   = StatsStart(writer->stats);
+      encoded = base64_encode(writer->scratch, (const char*) data, count);
+
+      SinkWriteWrapped(writer->sink, writer->scratch, encoded);
+    }
+
+    StatsAdd(writer->stats, STATS_ENCODE, start, count);
+
+    writer->produced += encoded;
+
+    data += count;
+    length -= count;
+  }
+}
+
+void StreamWriterWrite(StreamWriter* writer, const uint8* data, uint64 length)
+{
+  DEBUG_ASSERT(writer != NULL);
+
+  if (writer->format != 64) {
+    StreamWriteChunk(writer, data, length);
+    return;
+  }
+
+  /* Base64 works on whole triples; complete the carried triple first. */
+  while (writer->carryLength > 0 && writer->carryLength < 3 && length > 0) {
+    writer->carry[writer->carryLength++] = *data++;
+    length--;
+  }
+
+  if (writer->carryLength == 3) {
+    StreamWriteChunk(writer, writer->carry, 3);
+    writer->carryLength = 0;
+  }
+
+  uint64 whole = length - length % 3;
+
+  StreamWriteChunk(writer, data, whole);
+
+  for (uint64 i = whole; i < length; i++)
+    writer->carry[writer->carryLength++] = data[i];
+}
+
+void StreamWriterFlush(StreamWriter* writer)
+{
+  DEBUG_ASSERT(writer != NULL);
+
+  SinkFlush(writer->sink);
+}
+
+void StreamWriterDestroy(StreamWriter* writer)
+{
+  if (writer == NULL)
+    return;
+
+  if (writer->carryLength > 0)
+    StreamWriteChunk(writer, writer->carry, writer->carryLength);
+
+  SinkDestroy(writer->sink);
+
+  Nullify(writer->carry, sizeof(writer->carry));
+
+  free(writer->scratch);
+  free(writer);
+}
+
+/* Fill in the header that starts tagged output. */
+static void StreamTagHeader(uint8* header)
+{
+  memset(header, 0, ZQ_STREAM_TAG_HEADER_SIZE);
+  memcpy(header, ZQ_STREAM_TAG_MAGIC, 4);
+
+  header[4] = ZQ_STREAM_TAG_VERSION;
+}
+
+void StreamTagStart(StreamDirection direction, StreamReader* reader, StreamWriter* writer)
+{
+  DEBUG_ASSERT(reader != NULL);
+  DEBUG_ASSERT(writer != NULL);
+
+  uint8 expected[ZQ_STREAM_TAG_HEADER_SIZE];
+  uint8 header[ZQ_STREAM_TAG_HEADER_SIZE];
+
+  StreamTagHeader(expected);
+
+  if (direction == STREAM_ENCODE) {
+    StreamWriterWrite(writer, expected, sizeof(expected));
+    return;
+  }
+
+  if (StreamReaderReadFull(reader, header, sizeof(header)) != sizeof(header) ||
+      memcmp(header, expected, sizeof(header)) != 0) {
+    fprintf(stderr, "ERROR: The input has no integrity tag; it was encoded without tag=on!\n");
+    exit(EXIT_FAILURE);
+  }
+}
+
+uint64 StreamTagRefuse(ZigmaContext* context, StreamReader* reader, StreamWriter* writer)
+{
+  DEBUG_ASSERT(context != NULL);
+  DEBUG_ASSERT(reader != NULL);
+  DEBUG_ASSERT(writer != NULL);
+
+  uint8  expected[ZQ_STREAM_TAG_HEADER_SIZE];
+  uint8  header[ZQ_STREAM_TAG_HEADER_SIZE];
+  uint64 length = StreamReaderReadFull(reader, header, sizeof(header));
+
+  StreamTagHeader(expected);
+
+  if (length == sizeof(header) && memcmp(header, expected, sizeof(header)) == 0) {
+    fprintf(stderr, "ERROR: The input carries an integrity tag; decode it with tag=on!\n");
+    exit(EXIT_FAILURE);
+  }
+
+  uint64 start = StatsStart(writer->stats);
+
+  ZigmaDecodeBlock(context, header, header, length);
+
+  StatsAdd(writer->stats, STATS_CIPHER, start, length);
+  StreamWriterWrite(writer, header, length);
+
+  Nullify(header, sizeof(header));
+
+  return length;
+}
+
+void StreamTagFinish(ZigmaContext* tag, StreamDirection direction, StreamReader* reader, StreamWriter* writer)
+{
+  uint8 digest[ZQ_STREAM_TAG_SIZE];
+  uint8 stored[ZQ_STREAM_HOLDBACK_MAX];
+
+  ZigmaHashFinal(tag, digest, ZQ_STREAM_TAG_SIZE);
+
+  if (direction == STREAM_ENCODE) {
+    StreamWriterWrite(writer, digest, ZQ_STREAM_TAG_SIZE);
+  }
+  else if (StreamReaderTrailer(reader, stored) != ZQ_STREAM_TAG_SIZE ||
+           memcmp(stored, digest, ZQ_STREAM_TAG_SIZE) != 0) {
+    /* The plaintext has been written as it was decoded; take back what can be. */
+    if (SinkDiscard(writer->sink))
+      fprintf(stderr, "ERROR: Integrity tag mismatch; wrong key or corrupted input! The output was truncated.\n");
+    else
+      fprintf(stderr, "ERROR: Integrity tag mismatch; wrong key or corrupted input! Discard the output.\n");
+
+    exit(EXIT_FAILURE);
+  }
+
+  Nullify(digest, sizeof(digest));
+  Nullify(stored, sizeof(stored));
+}
+
+uint64 StreamCipher(ZigmaContext* context, StreamDirection direction, StreamReader* reader, StreamWriter* writer,
+                    ZigmaContext* tag)
+{
+  DEBUG_ASSERT(context != NULL);
+  DEBUG_ASSERT(reader != NULL);
+  DEBUG_ASSERT(writer != NULL);
+
+  Buffer*      block = BufferCreate(NULL, ZQ_STREAM_BLOCK_SIZE);
+  const uint8* source;
+  uint64       total = 0;
+
+  if (tag != NULL && direction == STREAM_DECODE)
+    StreamReaderHoldBack(reader, ZQ_STREAM_TAG_SIZE);
+
+  /* Mapped input is ciphered straight from the mapping, saving a copy. */
+  while ((block->length = StreamReaderAcquire(reader, &source, block->data, ZQ_STREAM_BLOCK_SIZE)) > 0) {
+    for (uint64 offset = 0; offset < block->length; offset += ZQ_STREAM_TILE_SIZE) {
+      uint64 count = block->length - offset < ZQ_STREAM_TILE_SIZE ? block->length - offset : ZQ_STREAM_TILE_SIZE;
+
+      /* Binary output needs no encoding, so the cipher writes it into the sink's block directly. */
+      int    direct = writer->format == 256;
+      uint8* target = direct ? (uint8*) SinkReserve(writer->sink, count) : block->data + offset;
+      uint64 start  = StatsStart(writer->stats);
+
+      /* The tag covers the plaintext: before the cipher when encoding (it may work in place), after when decoding. */
+      if (tag != NULL && direction == STREAM_ENCODE)
+        ZigmaHashUpdate(tag, source + offset, count);
+
+      if (direction == STREAM_ENCODE)
+        ZigmaEncodeBlock(context, target, source + offset, count);
+      else
+        ZigmaDecodeBlock(context, target, source + offset, count);
+
+      if (tag != NULL && direction == STREAM_DECODE)
+        ZigmaHashUpdate(tag, target, count);
+
+      StatsAdd(writer->stats, STATS_CIPHER, start, count);
+
+      if (direct) {
+        SinkCommit(writer->sink, count);
+        writer->produced += count;
+      }
+      else {
+        StreamWriterWrite(writer, target, count);
+      }
+    }
+
+    /* A short read means the input is arriving slowly (a pipe or terminal); pass on what we have. */
+    if (block->length < ZQ_STREAM_BLOCK_SIZE)
+      StreamWriterFlush(writer);
+
+    total += block->length;
+  }
+
+  if (tag != NULL)
+    StreamTagFinish(tag, direction, reader, writer);
+
+  /* BufferDestroy() only wipes `length` bytes; make sure the whole block is cleared. */
+  block->length = block->capacity;
+  BufferDestroy(block);
+
+  return total;
+}
+
+/* State shared by the stages of `StreamPipeline()`. */
+typedef struct StreamStages {
+  StreamReader* reader;
+  StreamWriter* writer;
+
+  /* Empty blocks for the reader, read blocks for the cipher, and ciphered blocks for the writer. */
+  Ring* empty;
+  Ring* read;
+  Ring* ciphered;
+
+  /* Bytes written by the writer stage. */
+  uint64 total;
+} StreamStages;
+
+/* The reader stage. A block with zero length marks the end of the input. */
+static void* StreamPipelineRead(void* argument)
+{
+  StreamStages* stages = (StreamStages*) argument;
+  Buffer*       block;
+
+  do {
+    block         = (Buffer*) RingPop(stages->empty);
+    block->length = StreamReaderRead(stages->reader, block->data, ZQ_STREAM_BLOCK_SIZE);
+
+    RingPush(stages->read, block);
+  } while (block->length > 0);
+
+  return NULL;
+}
+
+/* The writer stage; hands every block back to the reader once it is written. */
+static void* StreamPipelineWrite(void* argument)
+{
+  StreamStages* stages = (StreamStages*) argument;
+  Buffer*       block;
+
+  while ((block = (Buffer*) RingPop(stages->ciphered))->length > 0) {
+    StreamWriterWrite(stages->writer, block->data, block->length);
+
+    /* As in StreamCipher(): a short block means slow input, so pass on what we have. */
+    if (block->length < ZQ_STREAM_BLOCK_SIZE)
+      StreamWriterFlush(stages->writer);
+
+    stages->total += block->length;
+
+    RingPush(stages->empty, block);
+  }
+
+  return NULL;
+}
+
+uint64 StreamPipeline(ZigmaContext* context, StreamDirection direction, StreamReader* reader, StreamWriter* writer,
+                      ZigmaContext* tag)
+{
+  DEBUG_ASSERT(context != NULL);
+  DEBUG_ASSERT(reader != NULL);
+  DEBUG_ASSERT(writer != NULL);
+
+  StreamStages stages;
+  Buffer*      blocks[ZQ_RING_CAPACITY];
+  pthread_t    readThread, writeThread;
+
+  stages.reader = reader;
+  stages.writer = writer;
+  stages.total  = 0;
+
+  if (tag != NULL && direction == STREAM_DECODE)
+    StreamReaderHoldBack(reader, ZQ_STREAM_TAG_SIZE);
+
+  stages.empty    = RingCreate(NULL);
+  stages.read     = RingCreate(NULL);
+  stages.ciphered = RingCreate(NULL);
+
+  /* Every block fits in any one ring, so no stage can wait on a ring that is full of blocks it cannot reach. */
+  for (int i = 0; i < ZQ_RING_CAPACITY; i++) {
+    blocks[i] = BufferCreate(NULL, ZQ_STREAM_BLOCK_SIZE);
+    RingPush(stages.empty, blocks[i]);
+  }
+
+  if (pthread_create(&readThread, NULL, StreamPipelineRead, &stages) != 0 ||
+      pthread_create(&writeThread, NULL, StreamPipelineWrite, &stages) != 0) {
+    fprintf(stderr, "ERROR: Unable to start the pipeline threads!\n");
+    exit(EXIT_FAILURE);
+  }
+
+  /* The cipher stage runs on the calling thread. */
+  Buffer* block;
+
+  while ((block = (Buffer*) RingPop(stages.read))->length > 0) {
+    uint64 start = StatsStart(writer->stats);
+
+    if (tag != NULL && direction == STREAM_ENCODE)
+      ZigmaHashUpdate(tag, block->data, block->length);
+
+    if (direction == STREAM_ENCODE)
+      ZigmaEncodeBlock(context, block->data, block->data, block->length);
+    else
+      ZigmaDecodeBlock(context, block->data, block->data, block->length);
+
+    if (tag != NULL && direction == STREAM_DECODE)
+      ZigmaHashUpdate(tag, block->data, block->length);
+
+    StatsAdd(writer->stats, STATS_CIPHER, start, block->length);
+
+    RingPush(stages.ciphered, block);
+  }
+
+  RingPush(stages.ciphered, block);
+
+  pthread_join(readThread, NULL);
+  pthread_join(writeThread, NULL);
+
+  if (tag != NULL)
+    StreamTagFinish(tag, direction, reader, writer);
+
+  /* BufferDestroy() only wipes `length` bytes; make sure every block is cleared. */
+  for (int i = 0; i < ZQ_RING_CAPACITY; i++) {
+    blocks[i]->length = blocks[i]->capacity;
+    BufferDestroy(blocks[i]);
+  }
+
+  RingDestroy(stages.empty);
+  RingDestroy(stages.read);
+  RingDestroy(stages.ciphered);
+
+  return stages.total;
+}
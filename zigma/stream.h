@@ -0,0 +1,317 @@
+/*
+ * ZIGMA, Copyright (C) 2024 Chase Zehl O'Byrne
+ *   <mail: zehl@live.com> http://zehlchen.com/
+ *
+ * This file is part of ZIGMA.
+ *
+ * ZIGMA is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ZIGMA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ZIGMA; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#pragma once
+#ifndef _ZIGMATIQ_STREAM_H_
+#define _ZIGMATIQ_STREAM_H_
+
+#include "common.h"
+
+#include "base16.h"
+#include "base64.h"
+#include "buffer.h"
+#include "ring.h"
+#include "sink.h"
+#include "stats.h"
+#include "zigma.h"
+
+/* The amount of plaintext moved through the cipher per iteration. */
+#ifndef ZQ_STREAM_BLOCK_SIZE
+#define ZQ_STREAM_BLOCK_SIZE (64 * 1024) /* 64KB */
+#endif
+
+/* The piece of a block that is ciphered and then encoded back-to-back, so it is still in L1 when it is encoded. */
+#ifndef ZQ_STREAM_TILE_SIZE
+#define ZQ_STREAM_TILE_SIZE (16 * 1024) /* 16KB */
+#endif
+
+/* Number of ZQ_STREAM_BLOCK_SIZE reads kept in flight ahead of the reader (StreamReaderUseUring()). */
+#ifndef ZQ_STREAM_URING_DEPTH
+#define ZQ_STREAM_URING_DEPTH 4
+#endif
+
+/* Characters of base16 or base64 text read per iteration. */
+#define ZQ_STREAM_TEXT_SIZE (2 * ZQ_STREAM_BLOCK_SIZE)
+
+/* Reads that could take fewer characters than this are decoded into the reader's own buffer first. */
+#define ZQ_STREAM_TEXT_MINIMUM 64
+
+/* How much of a mapped input is consumed between hints to the kernel that the pages can be dropped. */
+#define ZQ_STREAM_RELEASE_SIZE (8 * 1024 * 1024) /* 8MB */
+
+/* The longest trailer StreamReaderHoldBack() can keep back. */
+#define ZQ_STREAM_HOLDBACK_MAX 64
+
+/* Length of the integrity tag appended by StreamCipher() and StreamPipeline(). */
+#define ZQ_STREAM_TAG_SIZE 32
+
+/* Tag contexts are derived with an index in their own range, apart from container chunks and checkpoints. */
+#define ZQ_STREAM_TAG_DOMAIN (1ULL << 62)
+
+/* Tagged output starts with this header, so that decoding can tell it from a stream without a tag:
+ *   magic "ZQTG" (4) | version (1) | reserved (3)
+ */
+#define ZQ_STREAM_TAG_MAGIC       "ZQTG"
+#define ZQ_STREAM_TAG_VERSION     1
+#define ZQ_STREAM_TAG_HEADER_SIZE 8
+
+/* Default number of base64 characters per output line. */
+#define ZQ_BASE64_LINE_LENGTH 76
+
+typedef enum StreamDirection { STREAM_ENCODE = 0, STREAM_DECODE } StreamDirection;
+
+/* Incremental reader that yields decoded (binary) blocks from a stream in any supported base.
+ */
+typedef struct StreamReader {
+  /* The stream to read from. */
+  FILE* stream;
+
+  /* The base encoding of the stream (16, 64, 256). */
+  uint32 format;
+
+  /* Decoder state carried between reads of a text stream. */
+  base16_decoder base16;
+  base64_decoder base64;
+
+  /* Raw text read from the stream, awaiting conversion. */
+  uint8* scratch;
+
+  /* Decoded text not yet handed out, for reads too small to decode into directly. */
+  Buffer* pending;
+
+  /* Read-only mapping of a base256 regular file, read without copying. */
+  Buffer* mapping;
+
+  /* Mapped bytes already handed back to the kernel. */
+  uint64 released;
+
+  /* Read position within `pending` or `mapping`. */
+  uint64 offset;
+
+  /* Number of raw bytes consumed from the stream. */
+  uint64 consumed;
+
+  /* Where the time spent reading and decoding is recorded, or NULL. */
+  Stats* stats;
+
+  /* Bytes kept back from the end of the stream (StreamReaderHoldBack()), and the last bytes read so far; reads no
+   * larger than the trailer are served from here too.
+   */
+  uint32 holdback;
+  uint8  held[2 * ZQ_STREAM_HOLDBACK_MAX];
+  uint32 heldLength;
+
+  /* Read-ahead through io_uring (StreamReaderUseUring()), or NULL for blocking reads. */
+  Uring* uring;
+
+  /* One ZQ_STREAM_BLOCK_SIZE buffer per read, with the bytes each holds (-1 while its read is in flight). */
+  uint8* ahead;
+  int32  aheadLength[ZQ_STREAM_URING_DEPTH];
+  uint32 aheadDepth;
+
+  /* The buffer being consumed and the read position within it. */
+  uint32 aheadIndex;
+  uint64 aheadOffset;
+
+  /* File offsets of the buffer being consumed and of the next read, or -1 where the stream has none. */
+  int64 aheadBase;
+  int64 aheadPosition;
+} StreamReader;
+
+/* Incremental writer that encodes binary blocks to a stream in any supported base.
+ */
+typedef struct StreamWriter {
+  /* The destination of the encoded output. */
+  Sink* sink;
+
+  /* The base encoding of the stream (16, 64, 256). */
+  uint32 format;
+
+  /* Bytes of an incomplete base64 triple carried to the next write. */
+  uint8  carry[3];
+  uint32 carryLength;
+
+  /* Encoded text of one tile, before it is wrapped into the sink. */
+  char* scratch;
+
+  /* Number of characters written to the stream. */
+  uint64 produced;
+
+  /* Where the time spent encoding (and, by StreamCipher() and friends, ciphering) is recorded, or NULL. */
+  Stats* stats;
+} StreamWriter;
+
+/* Initialize a stream reader.
+ *   @param reader The reader object.
+ *   @param stream The stream to read from.
+ *   @param format The base encoding of the stream.
+ *   @return The reader object.
+ */
+StreamReader* StreamReaderCreate(StreamReader* reader, FILE* stream, uint32 format);
+
+/* Switch the reader to asynchronous read-ahead through io_uring. Regular files keep ZQ_STREAM_URING_DEPTH reads in
+ * flight at explicit offsets; pipes and terminals keep one, so it is ready by the time the cipher wants it. Mapped
+ * input is never read and needs nothing. Must be called before the first read.
+ *   @param reader The reader object.
+ *   @return 1 on success, 0 if io_uring is unavailable (the reader keeps blocking reads).
+ */
+int StreamReaderUseUring(StreamReader* reader);
+
+/* If the input is a pipe, enlarge it so the writer at the other end can run further ahead of the reader.
+ *   @param reader The reader object.
+ *   @return 1 if the input is a pipe, 0 otherwise.
+ */
+int StreamReaderUsePipe(StreamReader* reader);
+
+/* Keep the last `length` decoded bytes of the stream out of every read, e.g. a trailer that follows the data. They
+ * are available from StreamReaderTrailer() once the reads have reached the end. Must be called before the first read.
+ *   @param reader The reader object.
+ *   @param length The length of the trailer, at most ZQ_STREAM_HOLDBACK_MAX.
+ */
+void StreamReaderHoldBack(StreamReader* reader, uint32 length);
+
+/* Obtain the bytes kept back by StreamReaderHoldBack() after the last read.
+ *   @param reader The reader object.
+ *   @param data Receives the trailer.
+ *   @return The length of the trailer, short if the whole stream was shorter.
+ */
+uint32 StreamReaderTrailer(StreamReader* reader, uint8* data);
+
+/* Read up to `capacity` decoded bytes. Returns as soon as any data is available, so pipes are not stalled.
+ *   @param reader The reader object.
+ *   @param data The destination array.
+ *   @param capacity The size of the destination array.
+ *   @return The number of bytes stored, or 0 at the end of the stream.
+ */
+uint64 StreamReaderRead(StreamReader* reader, uint8* data, uint64 capacity);
+
+/* Obtain up to `capacity` decoded bytes without copying them when possible. For a mapped file `*data` points
+ * straight into the mapping; otherwise the bytes are read into `scratch` and `*data` points there. The data
+ * stays valid until the next call.
+ *   @param reader The reader object.
+ *   @param data Receives a pointer to the bytes.
+ *   @param scratch Storage used when the input is not mapped.
+ *   @param capacity The maximum number of bytes wanted (and the size of `scratch`).
+ *   @return The number of bytes available, or 0 at the end of the stream.
+ */
+uint64 StreamReaderAcquire(StreamReader* reader, const uint8** data, uint8* scratch, uint64 capacity);
+
+/* Read exactly `length` decoded bytes, stopping short only at the end of the stream.
+ *   @param reader The reader object.
+ *   @param data The destination array.
+ *   @param length The number of bytes wanted.
+ *   @return The number of bytes stored.
+ */
+uint64 StreamReaderReadFull(StreamReader* reader, uint8* data, uint64 length);
+
+/* Release the resources held by a stream reader.
+ *   @param reader The reader object.
+ */
+void StreamReaderDestroy(StreamReader* reader);
+
+/* Initialize a stream writer. Output is staged in a Sink and reaches the stream in large writes.
+ *   @param writer The writer object.
+ *   @param stream The stream to write to.
+ *   @param format The base encoding of the stream.
+ *   @param width Characters per base64 line, or 0 for a single line. Other formats are never wrapped.
+ *   @param newline The line terminator for base64 output.
+ *   @return The writer object.
+ */
+StreamWriter* StreamWriterCreate(StreamWriter* writer, FILE* stream, uint32 format, uint32 width, SinkNewline newline);
+
+/* Encode and write a block of binary data.
+ *   @param writer The writer object.
+ *   @param data The data array.
+ *   @param length The length of the data array.
+ */
+void StreamWriterWrite(StreamWriter* writer, const uint8* data, uint64 length);
+
+/* Write out the staged output, e.g. before waiting on slow input.
+ *   @param writer The writer object.
+ */
+void StreamWriterFlush(StreamWriter* writer);
+
+/* Flush any carried bytes (with base64 padding) and release the writer's resources.
+ *   @param writer The writer object.
+ */
+void StreamWriterDestroy(StreamWriter* writer);
+
+/* Move the input stream through the cipher block by block, writing each block before reading the next one.
+ * Memory use is bounded by ZQ_STREAM_BLOCK_SIZE regardless of the input length. Within a block, each tile goes
+ * through the cipher and the output codec back-to-back; binary output is ciphered straight into the sink.
+ *
+ * With a `tag` context, each tile of plaintext is also hashed while it is in cache. Encoding appends the
+ * ZQ_STREAM_TAG_SIZE byte tag after the ciphertext; decoding holds the tag back from the input and exits with an
+ * error if it does not match, which is what a wrong key or corrupted input looks like. Decoded plaintext is written
+ * before the tag is checked, so on a mismatch a regular output file is truncated (SinkDiscard()) before exiting.
+ *   @param context The cipher context.
+ *   @param direction Whether to encode or decode.
+ *   @param reader The source of the data.
+ *   @param writer The destination of the data.
+ *   @param tag A keyed hash context for the integrity tag (see ZQ_STREAM_TAG_DOMAIN), or NULL for none.
+ *   @return The number of bytes moved through the cipher.
+ */
+uint64 StreamCipher(ZigmaContext* context, StreamDirection direction, StreamReader* reader, StreamWriter* writer,
+                    ZigmaContext* tag);
+
+/* Start an integrity tag: write the ZQ_STREAM_TAG_MAGIC header when encoding, or read and check it when decoding,
+ * exiting with an error if the input was encoded without a tag.
+ *   @param direction Whether the header is written or checked.
+ *   @param reader The source of the data.
+ *   @param writer The destination of the data.
+ */
+void StreamTagStart(StreamDirection direction, StreamReader* reader, StreamWriter* writer);
+
+/* Decoding without a tag: exit with an error if the input starts with the ZQ_STREAM_TAG_MAGIC header, rather than
+ * deciphering the header and the tag as if they were ciphertext. Otherwise the bytes read to find out are decoded and
+ * written, and decoding carries on with the same context.
+ *   @param context The cipher context.
+ *   @param reader The source of the data.
+ *   @param writer The destination of the data.
+ *   @return The number of bytes decoded.
+ */
+uint64 StreamTagRefuse(ZigmaContext* context, StreamReader* reader, StreamWriter* writer);
+
+/* Finish an integrity tag: append it to the output when encoding, or check it against the trailer held back from the
+ * input when decoding, exiting with an error on a mismatch after truncating a regular output file (SinkDiscard()). The
+ * reader must have reached the end of the input.
+ *   @param tag The keyed hash context, with all of the plaintext added.
+ *   @param direction Whether the tag is written or checked.
+ *   @param reader The source of the data.
+ *   @param writer The destination of the data.
+ */
+void StreamTagFinish(ZigmaContext* tag, StreamDirection direction, StreamReader* reader, StreamWriter* writer);
+
+/* Like `StreamCipher()`, but reading and input decoding, the cipher, and output encoding and writing each run on their
+ * own thread. Blocks are handed from stage to stage through bounded rings, so a slow stage holds back the others
+ * instead of growing a queue; memory use is ZQ_RING_CAPACITY blocks. The output is identical to `StreamCipher()`.
+ *   @param context The cipher context.
+ *   @param direction Whether to encode or decode.
+ *   @param reader The source of the data.
+ *   @param writer The destination of the data.
+ *   @param tag A keyed hash context for the integrity tag, as for `StreamCipher()`, or NULL for none.
+ *   @return The number of bytes moved through the cipher.
+ */
+uint64 StreamPipeline(ZigmaContext* context, StreamDirection direction, StreamReader* reader, StreamWriter* writer,
+                      ZigmaContext* tag);
+
+#endif /* _ZIGMATIQ_STREAM_H_ */
@@ -0,0 +1,248 @@
+/*
+ * ZIGMA, Copyright (C) 2024 Chase Zehl O'Byrne
+ *   <mail: zehl@live.com> http://zehlchen.com/
+ *
+ * This file is part of ZIGMA.
+ *
+ * ZIGMA is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ZIGMA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ZIGMA; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "common.h"
+
+#include "uring.h"
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define ZQ_URING 1
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#endif
+
+#ifdef ZQ_URING
+
+static int UringSetup(uint32 entries, struct io_uring_params* params)
+{
+  return (int) syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int UringEnter(int descriptor, uint32 submit, uint32 wait, uint32 flags)
+{
+  return (int) syscall(__NR_io_uring_enter, descriptor, submit, wait, flags, NULL, 0);
+}
+
+Uring* UringCreate(uint32 depth)
+{
+  struct io_uring_params params;
+
+  memset(&params, 0, sizeof(params));
+
+  int descriptor = UringSetup(depth, &params);
+
+  /* ENOSYS on old kernels, EPERM where io_uring is disabled by policy or a seccomp filter. */
+  if (descriptor < 0)
+    return NULL;
+
+  Uring* uring = (Uring*) calloc(1, sizeof(Uring));
+
+  DEBUG_ASSERT(uring != NULL);
+
+  uring->descriptor = descriptor;
+
+  /* The submission and completion rings share one mapping on every kernel new enough to matter here. */
+  uint64 sqSize = params.sq_off.array + params.sq_entries * sizeof(uint32);
+  uint64 cqSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+
+  uring->ringsSize   = sqSize > cqSize ? sqSize : cqSize;
+  uring->entriesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+
+  if (!(params.features & IORING_FEAT_SINGLE_MMAP)) {
+    close(descriptor);
+    free(uring);
+    return NULL;
+  }
+
+  uring->rings   = mmap(NULL, uring->ringsSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, descriptor,
+                        IORING_OFF_SQ_RING);
+  uring->entries = mmap(NULL, uring->entriesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, descriptor,
+                        IORING_OFF_SQES);
+
+  if (uring->rings == MAP_FAILED || uring->entries == MAP_FAILED) {
+    if (uring->rings != MAP_FAILED)
+      munmap(uring->rings, uring->ringsSize);
+    if (uring->entries != MAP_FAILED)
+      munmap(uring->entries, uring->entriesSize);
+
+    close(descriptor);
+    free(uring);
+    return NULL;
+  }
+
+  uint8* rings = (uint8*) uring->rings;
+
+  uring->sqHead    = (uint32*) (rings + params.sq_off.head);
+  uring->sqTail    = (uint32*) (rings + params.sq_off.tail);
+  uring->sqMask    = (uint32*) (rings + params.sq_off.ring_mask);
+  uring->sqArray   = (uint32*) (rings + params.sq_off.array);
+  uring->cqHead    = (uint32*) (rings + params.cq_off.head);
+  uring->cqTail    = (uint32*) (rings + params.cq_off.tail);
+  uring->cqMask    = (uint32*) (rings + params.cq_off.ring_mask);
+  uring->cqEntries = rings + params.cq_off.cqes;
+
+  return uring;
+}
+
+void UringRegister(Uring* uring, const struct iovec* buffers, uint32 count)
+{
+  DEBUG_ASSERT(uring != NULL);
+
+  uring->registered =
+      syscall(__NR_io_uring_register, uring->descriptor, IORING_REGISTER_BUFFERS, buffers, count) == 0;
+}
+
+void UringPrepare(Uring* uring, int write, int descriptor, uint32 index, void* data, uint32 length, int64 offset,
+                  uint64 tag)
+{
+  DEBUG_ASSERT(uring != NULL);
+
+  uint32               tail  = *uring->sqTail + uring->prepared;
+  uint32               slot  = tail & *uring->sqMask;
+  struct io_uring_sqe* entry = (struct io_uring_sqe*) uring->entries + slot;
+
+  memset(entry, 0, sizeof(*entry));
+
+  if (uring->registered)
+    entry->opcode = write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+  else
+    entry->opcode = write ? IORING_OP_WRITE : IORING_OP_READ;
+
+  entry->fd        = descriptor;
+  entry->addr      = (uint64) (uintptr_t) data;
+  entry->len       = length;
+  entry->off       = (uint64) offset;
+  entry->buf_index = (uint16) index;
+  entry->user_data = tag;
+
+  uring->sqArray[slot] = slot;
+  uring->prepared++;
+}
+
+void UringSubmit(Uring* uring)
+{
+  DEBUG_ASSERT(uring != NULL);
+
+  if (uring->prepared == 0)
+    return;
+
+  /* Publish the entries before the kernel can see the new tail. */
+  __atomic_store_n(uring->sqTail, *uring->sqTail + uring->prepared, __ATOMIC_RELEASE);
+
+  uint32 count = uring->prepared;
+
+  while (count > 0) {
+    int submitted = UringEnter(uring->descriptor, count, 0, 0);
+
+    if (submitted < 0) {
+      if (errno == EINTR || errno == EAGAIN)
+        continue;
+
+      fprintf(stderr, "ERROR: io_uring_enter(): %s!\n", strerror(errno));
+      exit(EXIT_FAILURE);
+    }
+
+    count -= submitted;
+  }
+
+  uring->inflight += uring->prepared;
+  uring->prepared = 0;
+}
+
+int32 UringComplete(Uring* uring, uint64* tag)
+{
+  DEBUG_ASSERT(uring != NULL);
+  DEBUG_ASSERT(uring->inflight > 0);
+
+  uint32 head = *uring->cqHead;
+
+  while (head == __atomic_load_n(uring->cqTail, __ATOMIC_ACQUIRE)) {
+    if (UringEnter(uring->descriptor, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR) {
+      fprintf(stderr, "ERROR: io_uring_enter(): %s!\n", strerror(errno));
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  struct io_uring_cqe* completion = (struct io_uring_cqe*) uring->cqEntries + (head & *uring->cqMask);
+  int32                result     = completion->res;
+
+  if (tag != NULL)
+    *tag = completion->user_data;
+
+  __atomic_store_n(uring->cqHead, head + 1, __ATOMIC_RELEASE);
+
+  uring->inflight--;
+
+  return result;
+}
+
+void UringDestroy(Uring* uring)
+{
+  if (uring == NULL)
+    return;
+
+  DEBUG_ASSERT(uring->inflight == 0);
+
+  munmap(uring->entries, uring->entriesSize);
+  munmap(uring->rings, uring->ringsSize);
+  close(uring->descriptor);
+
+  free(uring);
+}
+
+#else /* !ZQ_URING */
+
+Uring* UringCreate(uint32 depth)
+{
+  return NULL;
+}
+
+void UringRegister(Uring* uring, const struct iovec* buffers, uint32 count)
+{
+}
+
+void UringPrepare(Uring* uring, int write, int descriptor, uint32 index, void* data, uint32 length, int64 offset,
+                  uint64 tag)
+{
+}
+
+void UringSubmit(Uring* uring)
+{
+}
+
+int32 UringComplete(Uring* uring, uint64* tag)
+{
+  return -ENOSYS;
+}
+
+void UringDestroy(Uring* uring)
+{
+}
+
+#endif /* ZQ_URING */
@@ -0,0 +1,109 @@
+/*
+ * ZIGMA, Copyright (C) 2024 Chase Zehl O'Byrne
+ *   <mail: zehl@live.com> http://zehlchen.com/
+ *
+ * This file is part of ZIGMA.
+ *
+ * ZIGMA is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ZIGMA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ZIGMA; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#pragma once
+#ifndef _ZIGMATIQ_URING_H_
+#define _ZIGMATIQ_URING_H_
+
+#include <sys/uio.h>
+
+#include "common.h"
+
+/* Minimal io_uring submission/completion interface on the raw system calls (no liburing). Every request carries a
+ * 64-bit tag that comes back with its completion. Where io_uring is not available UringCreate() returns NULL and
+ * callers keep their blocking path.
+ */
+typedef struct Uring {
+  /* The ring descriptor and the shared ring mapping. */
+  int    descriptor;
+  void*  rings;
+  uint64 ringsSize;
+
+  /* The submission queue entries. */
+  void*  entries;
+  uint64 entriesSize;
+
+  /* Submission queue indices and index array. */
+  uint32* sqHead;
+  uint32* sqTail;
+  uint32* sqMask;
+  uint32* sqArray;
+
+  /* Completion queue indices and entries. */
+  uint32* cqHead;
+  uint32* cqTail;
+  uint32* cqMask;
+  void*   cqEntries;
+
+  /* Requests prepared but not yet submitted, and requests submitted but not yet completed. */
+  uint32 prepared;
+  uint32 inflight;
+
+  /* Whether buffers were registered, so requests can use the fixed-buffer opcodes. */
+  int registered;
+} Uring;
+
+/* Set up a ring.
+ *   @param depth The number of requests that may be in flight.
+ *   @return The ring, or NULL if io_uring is unavailable (old kernel, disabled, or not Linux).
+ */
+Uring* UringCreate(uint32 depth);
+
+/* Register buffers with the kernel so reads and writes into them skip the per-request page pinning. Failure (for
+ * instance a low RLIMIT_MEMLOCK) is not an error; requests then use the ordinary opcodes.
+ *   @param uring The ring.
+ *   @param buffers The buffers; a request names one by its index.
+ *   @param count The number of buffers.
+ */
+void UringRegister(Uring* uring, const struct iovec* buffers, uint32 count);
+
+/* Queue a read into, or a write from, registered buffer `index`.
+ *   @param uring The ring.
+ *   @param write Whether to write rather than read.
+ *   @param descriptor The file descriptor.
+ *   @param index The buffer index passed to UringRegister().
+ *   @param data The address within that buffer.
+ *   @param length The number of bytes.
+ *   @param offset The file offset, or -1 for the current position (pipes, terminals, sockets).
+ *   @param tag Returned with the completion.
+ */
+void UringPrepare(Uring* uring, int write, int descriptor, uint32 index, void* data, uint32 length, int64 offset,
+                  uint64 tag);
+
+/* Hand every prepared request to the kernel.
+ *   @param uring The ring.
+ */
+void UringSubmit(Uring* uring);
+
+/* Wait for the next completion.
+ *   @param uring The ring; at least one request must be in flight.
+ *   @param tag Receives the tag of the completed request.
+ *   @return The result: a byte count, or a negated errno value.
+ */
+int32 UringComplete(Uring* uring, uint64* tag);
+
+/* Release a ring. Requests still in flight must have been completed.
+ *   @param uring The ring, or NULL.
+ */
+void UringDestroy(Uring* uring);
+
+#endif /* _ZIGMATIQ_URING_H_ */
@@ -28,6 +28,71 @@
 
 #include "zigma.h"
 
+/* One step of the cipher on indices held by the caller. The two directions differ only in which of X and Y takes the
+ * input byte and which the result. `decode` is a constant at every call, so each direction gets its own code.
+ */
+static inline __attribute__((always_inline)) uint8 ZigmaStep(uint8* restrict state, uint8* A, uint8* B, uint8* C,
+                                                             uint8* X, uint8* Y, uint8 byte, const int decode)
+{
+  uint8 swaptemp;
+  uint8 result;
+
+  *B += state[(*A)++];
+
+  swaptemp  = state[*Y];
+  state[*Y] = state[*B];
+  state[*B] = state[*X];
+  state[*X] = state[*A];
+  state[*A] = swaptemp;
+
+  *C += state[swaptemp];
+
+  result = byte ^ state[(uint8) (state[*B] + state[*A])] ^ state[state[(uint8) (state[*X] + state[*Y] + state[*C])]];
+
+  *X = decode ? result : byte;
+  *Y = decode ? byte : result;
+
+  return result;
+}
+
+/* The block kernel behind every encode, decode and hash function. The indices stay in locals for the whole block
+ * and are written back once; `state` is restrict-qualified so stores to `output` do not force it to be reloaded.
+ * `output` may equal `input`, or be NULL to only advance the state (hashing).
+ */
+static inline __attribute__((always_inline)) void ZigmaKernel(ZigmaContext* context, uint8* output,
+                                                              const uint8* input, uint64 length, const int decode)
+{
+  uint8* restrict state = context->state;
+  uint8           A     = context->index_A;
+  uint8           B     = context->index_B;
+  uint8           C     = context->index_C;
+  uint8           X     = context->byte_X;
+  uint8           Y     = context->byte_Y;
+  uint64          i     = 0;
+
+  for (; i + ZQ_ZIGMA_UNROLL <= length; i += ZQ_ZIGMA_UNROLL) {
+    for (int k = 0; k < ZQ_ZIGMA_UNROLL; k++) {
+      uint8 result = ZigmaStep(state, &A, &B, &C, &X, &Y, input[i + k], decode);
+
+      if (output != NULL)
+        output[i + k] = result;
+    }
+  }
+
+  for (; i < length; i++) {
+    uint8 result = ZigmaStep(state, &A, &B, &C, &X, &Y, input[i], decode);
+
+    if (output != NULL)
+      output[i] = result;
+  }
+
+  context->index_A = A;
+  context->index_B = B;
+  context->index_C = C;
+  context->byte_X  = X;
+  context->byte_Y  = Y;
+}
+
 ZigmaContext* ZigmaCreate(ZigmaContext* context, const char* key, uint64 length)
 {
   if (context == NULL)
@@ -110,6 +175,114 @@ uint8 ZigmaKeyRandom(ZigmaContext* context, uint32 limit, uint8 const* key, uint
   return u;
 }
 
+ZigmaContext* ZigmaDerive(ZigmaContext* context, const ZigmaContext* master, uint64 index)
+{
+  DEBUG_ASSERT(master != NULL);
+
+  if (context == NULL)
+    context = (ZigmaContext*) malloc(sizeof(ZigmaContext));
+
+  memcpy(context, master, sizeof(ZigmaContext));
+
+  /* Mix the index into the state. */
+  for (int i = 0; i < 8; i++)
+    ZigmaEncodeByte(context, (uint8) (index >> (8 * i)));
+
+  /* Advance the permutation vector so the index affects every position. */
+  for (int i = 255; i >= 0; i--)
+    ZigmaEncodeByte(context, i);
+
+  return context;
+}
+
+/* The checksum stored after a serialized snapshot. */
+static void ZigmaScheduleChecksum(const uint8* data, uint8* checksum)
+{
+  ZigmaContext context;
+
+  ZigmaCreateHash(&context);
+
+  for (int i = 0; i < 8 + ZQ_SCHEDULE_SNAPSHOT_SIZE; i++)
+    ZigmaEncodeByte(&context, data[i]);
+
+  ZigmaHashFinal(&context, checksum, ZQ_SCHEDULE_CHECKSUM_SIZE);
+
+  Nullify(&context, sizeof(ZigmaContext));
+}
+
+uint64 ZigmaExport(const ZigmaContext* context, uint8* data)
+{
+  DEBUG_ASSERT(context != NULL);
+  DEBUG_ASSERT(data != NULL);
+
+  memcpy(data, ZQ_SCHEDULE_MAGIC, 4);
+  data[4] = ZQ_SCHEDULE_VERSION;
+  data[5] = data[6] = data[7] = 0;
+
+  data[8]  = context->index_A;
+  data[9]  = context->index_B;
+  data[10] = context->index_C;
+  data[11] = context->byte_X;
+  data[12] = context->byte_Y;
+
+  memcpy(data + 13, context->state, 256);
+
+  ZigmaScheduleChecksum(data, data + 8 + ZQ_SCHEDULE_SNAPSHOT_SIZE);
+
+  return ZQ_SCHEDULE_SIZE;
+}
+
+ZigmaContext* ZigmaImport(ZigmaContext* context, const uint8* data, uint64 length)
+{
+  DEBUG_ASSERT(data != NULL);
+
+  uint8 checksum[ZQ_SCHEDULE_CHECKSUM_SIZE];
+  uint8 seen[256] = {0};
+
+  if (length != ZQ_SCHEDULE_SIZE || memcmp(data, ZQ_SCHEDULE_MAGIC, 4) != 0 || data[4] != ZQ_SCHEDULE_VERSION)
+    return NULL;
+
+  ZigmaScheduleChecksum(data, checksum);
+
+  if (memcmp(checksum, data + 8 + ZQ_SCHEDULE_SNAPSHOT_SIZE, ZQ_SCHEDULE_CHECKSUM_SIZE) != 0)
+    return NULL;
+
+  /* Every keyed state is a permutation; anything else would not decode what it encodes. */
+  for (int i = 0; i < 256; i++) {
+    if (seen[data[13 + i]]++ != 0)
+      return NULL;
+  }
+
+  if (context == NULL)
+    context = (ZigmaContext*) malloc(sizeof(ZigmaContext));
+
+  context->index_A = data[8];
+  context->index_B = data[9];
+  context->index_C = data[10];
+  context->byte_X  = data[11];
+  context->byte_Y  = data[12];
+
+  memcpy(context->state, data + 13, 256);
+
+  return context;
+}
+
+ZigmaContext* ZigmaHashInit(ZigmaContext* context)
+{
+  if (context == NULL)
+    context = (ZigmaContext*) malloc(sizeof(ZigmaContext));
+
+  return ZigmaCreateHash(context);
+}
+
+void ZigmaHashUpdate(ZigmaContext* context, const uint8* data, uint64 length)
+{
+  DEBUG_ASSERT(context != NULL);
+  DEBUG_ASSERT(data != NULL || length == 0);
+
+  ZigmaKernel(context, NULL, data, length, 0);
+}
+
 void ZigmaHashFinal(ZigmaContext* context, uint8* data, uint32 length)
 {
   /* Advance the permutation vector. */
@@ -124,70 +297,179 @@ void ZigmaHashFinal(ZigmaContext* context, uint8* data, uint32 length)
 
 uint8 ZigmaEncodeByte(ZigmaContext* context, uint8 byte)
 {
-  uint8 swaptemp;
+  uint8 result;
 
-  context->index_B += context->state[context->index_A++];
+  ZigmaKernel(context, &result, &byte, 1, 0);
 
-  swaptemp                         = context->state[context->byte_Y];
-  context->state[context->byte_Y]  = context->state[context->index_B];
-  context->state[context->index_B] = context->state[context->byte_X];
-  context->state[context->byte_X]  = context->state[context->index_A];
-  context->state[context->index_A] = swaptemp;
+  return result;
+}
 
-  context->index_C += context->state[swaptemp];
+uint8 ZigmaDecodeByte(ZigmaContext* context, uint8 byte)
+{
+  uint8 result;
 
-  context->byte_Y = byte ^
-                    context->state[(context->state[context->index_B] + context->state[context->index_A]) & 0xFF] ^
-                    context->state[context->state[(context->state[context->byte_X] + context->state[context->byte_Y] +
-                                                   context->state[context->index_C]) &
-                                                  0xFF]];
+  ZigmaKernel(context, &result, &byte, 1, 1);
+
+  return result;
+}
 
-  context->byte_X = byte;
+void ZigmaEncodeBuffer(ZigmaContext* context, Buffer* buffer)
+{
+  DEBUG_ASSERT(context != NULL);
+  DEBUG_ASSERT(buffer != NULL);
 
-  return context->byte_Y;
+  ZigmaEncodeBlock(context, buffer->data, buffer->data, buffer->length);
 }
 
-uint8 ZigmaDecodeByte(ZigmaContext* context, uint8 byte)
+void ZigmaDecodeBuffer(ZigmaContext* context, Buffer* buffer)
 {
-  uint8 swaptemp;
+  DEBUG_ASSERT(context != NULL);
+  DEBUG_ASSERT(buffer != NULL);
 
-  context->index_B += context->state[context->index_A++];
+  ZigmaDecodeBlock(context, buffer->data, buffer->data, buffer->length);
+}
 
-  swaptemp                         = context->state[context->byte_Y];
-  context->state[context->byte_Y]  = context->state[context->index_B];
-  context->state[context->index_B] = context->state[context->byte_X];
-  context->state[context->byte_X]  = context->state[context->index_A];
-  context->state[context->index_A] = swaptemp;
+void ZigmaEncodeBlock(ZigmaContext* context, uint8* output, const uint8* input, uint64 length)
+{
+  DEBUG_ASSERT(context != NULL);
+  DEBUG_ASSERT(output != NULL || length == 0);
+  DEBUG_ASSERT(input != NULL || length == 0);
 
-  context->index_C += context->state[swaptemp];
+  ZigmaKernel(context, output, input, length, 0);
+}
+
+void ZigmaDecodeBlock(ZigmaContext* context, uint8* output, const uint8* input, uint64 length)
+{
+  DEBUG_ASSERT(context != NULL);
+  DEBUG_ASSERT(output != NULL || length == 0);
+  DEBUG_ASSERT(input != NULL || length == 0);
+
+  ZigmaKernel(context, output, input, length, 1);
+}
+
+/* A lane being worked on by the batch kernel. */
+typedef struct ZigmaSlot {
+  ZigmaContext* context;
+  uint8*        output;
+  const uint8*  input;
+  uint64        remaining;
+} ZigmaSlot;
+
+/* Load the next non-empty lane into `slot`. Returns 0 when no lanes are left. */
+static int ZigmaBatchRefill(ZigmaSlot* slot, ZigmaLane* lanes, uint64 count, uint64* next)
+{
+  while (*next < count) {
+    ZigmaLane* lane = &lanes[(*next)++];
 
-  context->byte_X = byte ^
-                    context->state[(context->state[context->index_B] + context->state[context->index_A]) & 0xFF] ^
-                    context->state[context->state[(context->state[context->byte_X] + context->state[context->byte_Y] +
-                                                   context->state[context->index_C]) &
-                                                  0xFF]];
+    if (lane->length == 0)
+      continue;
 
-  context->byte_Y = byte;
+    slot->context   = lane->context;
+    slot->output    = lane->output;
+    slot->input     = lane->input;
+    slot->remaining = lane->length;
 
-  return context->byte_X;
+    return 1;
+  }
+
+  slot->remaining = 0;
+
+  return 0;
 }
 
-void ZigmaEncodeBuffer(ZigmaContext* context, Buffer* buffer)
+/* The batch counterpart of `ZigmaKernel()`: step every slot `steps` times with its indices held in locals, and write
+ * them back once. Slots with nothing left are skipped unless `full` says all of them are live, which gives the
+ * inner loop a constant trip count the compiler can unroll across the lanes.
+ */
+static inline __attribute__((always_inline)) void ZigmaBatchKernel(ZigmaSlot* slots, uint64 steps, const int full,
+                                                                   const int decode)
 {
-  DEBUG_ASSERT(context != NULL);
-  DEBUG_ASSERT(buffer != NULL);
+  uint8* state[ZQ_ZIGMA_BATCH_WIDTH];
+  uint8  A[ZQ_ZIGMA_BATCH_WIDTH], B[ZQ_ZIGMA_BATCH_WIDTH], C[ZQ_ZIGMA_BATCH_WIDTH];
+  uint8  X[ZQ_ZIGMA_BATCH_WIDTH], Y[ZQ_ZIGMA_BATCH_WIDTH];
+
+  for (uint32 s = 0; s < ZQ_ZIGMA_BATCH_WIDTH; s++) {
+    if (!full && slots[s].remaining == 0)
+      continue;
+
+    state[s] = slots[s].context->state;
+    A[s]     = slots[s].context->index_A;
+    B[s]     = slots[s].context->index_B;
+    C[s]     = slots[s].context->index_C;
+    X[s]     = slots[s].context->byte_X;
+    Y[s]     = slots[s].context->byte_Y;
+  }
+
+  for (uint64 i = 0; i < steps; i++) {
+    for (uint32 s = 0; s < ZQ_ZIGMA_BATCH_WIDTH; s++) {
+      if (!full && slots[s].remaining == 0)
+        continue;
 
-  for (int i = 0; i < buffer->length; i++)
-    buffer->data[i] = ZigmaEncodeByte(context, buffer->data[i]);
+      slots[s].output[i] = ZigmaStep(state[s], &A[s], &B[s], &C[s], &X[s], &Y[s], slots[s].input[i], decode);
+    }
+  }
+
+  for (uint32 s = 0; s < ZQ_ZIGMA_BATCH_WIDTH; s++) {
+    if (!full && slots[s].remaining == 0)
+      continue;
+
+    slots[s].context->index_A = A[s];
+    slots[s].context->index_B = B[s];
+    slots[s].context->index_C = C[s];
+    slots[s].context->byte_X  = X[s];
+    slots[s].context->byte_Y  = Y[s];
+  }
 }
 
-void ZigmaDecodeBuffer(ZigmaContext* context, Buffer* buffer)
+static inline __attribute__((always_inline)) void ZigmaBatch(ZigmaLane* lanes, uint64 count, const int decode)
 {
-  DEBUG_ASSERT(context != NULL);
-  DEBUG_ASSERT(buffer != NULL);
+  ZigmaSlot slots[ZQ_ZIGMA_BATCH_WIDTH];
+  uint32    active = 0;
+  uint64    next   = 0;
+
+  for (uint32 s = 0; s < ZQ_ZIGMA_BATCH_WIDTH; s++)
+    active += ZigmaBatchRefill(&slots[s], lanes, count, &next);
+
+  while (active > 0) {
+    /* Step every live lane until the shortest one runs out. */
+    uint64 steps = UINT64_MAX;
+
+    for (uint32 s = 0; s < ZQ_ZIGMA_BATCH_WIDTH; s++) {
+      if (slots[s].remaining > 0 && slots[s].remaining < steps)
+        steps = slots[s].remaining;
+    }
+
+    if (active == ZQ_ZIGMA_BATCH_WIDTH)
+      ZigmaBatchKernel(slots, steps, 1, decode);
+    else
+      ZigmaBatchKernel(slots, steps, 0, decode);
+
+    for (uint32 s = 0; s < ZQ_ZIGMA_BATCH_WIDTH; s++) {
+      if (slots[s].remaining == 0)
+        continue;
+
+      slots[s].output += steps;
+      slots[s].input += steps;
+      slots[s].remaining -= steps;
+
+      if (slots[s].remaining == 0)
+        active -= 1 - ZigmaBatchRefill(&slots[s], lanes, count, &next);
+    }
+  }
+}
+
+void ZigmaEncodeBatch(ZigmaLane* lanes, uint64 count)
+{
+  DEBUG_ASSERT(lanes != NULL || count == 0);
+
+  ZigmaBatch(lanes, count, 0);
+}
+
+void ZigmaDecodeBatch(ZigmaLane* lanes, uint64 count)
+{
+  DEBUG_ASSERT(lanes != NULL || count == 0);
 
-  for (int i = 0; i < buffer->length; i++)
-    buffer->data[i] = ZigmaDecodeByte(context, buffer->data[i]);
+  ZigmaBatch(lanes, count, 1);
 }
 
 void ZigmaPrint(ZigmaContext* context)
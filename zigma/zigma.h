@@ -39,6 +39,45 @@ typedef struct ZigmaContext {
   uint8 state[256];
 } ZigmaContext;
 
+/* Scheduled key file layout (integers little-endian):
+ *
+ *   "ZQKS" | version (1) | reserved (3) | A, B, C, X, Y (5) | state (256) | checksum (8)
+ *
+ * The snapshot is a context exactly as `ZigmaCreate()` leaves it, so loading a key costs a copy instead of the key
+ * schedule. The checksum is the first 8 bytes of the ZIGMA hash of everything before it.
+ */
+#define ZQ_SCHEDULE_MAGIC         "ZQKS"
+#define ZQ_SCHEDULE_VERSION       1
+#define ZQ_SCHEDULE_SNAPSHOT_SIZE 261
+#define ZQ_SCHEDULE_CHECKSUM_SIZE 8
+#define ZQ_SCHEDULE_SIZE          (8 + ZQ_SCHEDULE_SNAPSHOT_SIZE + ZQ_SCHEDULE_CHECKSUM_SIZE)
+
+/* Number of bytes per iteration of the block kernel's unrolled loop. */
+#ifndef ZQ_ZIGMA_UNROLL
+#define ZQ_ZIGMA_UNROLL 8
+#endif
+
+/* Number of independent contexts advanced together by the batch kernels. */
+#ifndef ZQ_ZIGMA_BATCH_WIDTH
+#define ZQ_ZIGMA_BATCH_WIDTH 8
+#endif
+
+/* One independent message in a batch: its own context plus source and destination arrays.
+ */
+typedef struct ZigmaLane {
+  /* The context of this message; it is advanced exactly as a single-stream call would advance it. */
+  ZigmaContext* context;
+
+  /* The destination array (may equal `input`). */
+  uint8* output;
+
+  /* The source array. */
+  const uint8* input;
+
+  /* The number of bytes in the message. */
+  uint64 length;
+} ZigmaLane;
+
 /* Initialize a ZIGMA context with a key of the given length. This function accepts NULL as the context
  * argument, in which case it allocates a new context. Otherwise, it uses the context provided. If no key
  * is provided, the context is initialized to be used as a hash function.
@@ -68,6 +107,47 @@ ZigmaContext* ZigmaCreateHash(ZigmaContext* context);
  */
 uint8 ZigmaKeyRandom(ZigmaContext* context, uint32 limit, uint8 const* key, uint32 length, uint8* rsum, uint32* keypos);
 
+/* Derive an independent context from a keyed master context and a 64-bit index (e.g. a chunk number). The
+ * index is fed through a copy of the master context and the permutation vector is then advanced, so the
+ * master key schedule is paid once no matter how many contexts are derived from it.
+ *   @param context The context to initialize, or NULL to allocate a new context.
+ *   @param master The keyed context to derive from; it is not modified.
+ *   @param index The index that distinguishes the derived context.
+ *   @return The derived context.
+ */
+ZigmaContext* ZigmaDerive(ZigmaContext* context, const ZigmaContext* master, uint64 index);
+
+/* Serialize a keyed context as a scheduled key file.
+ *   @param context The context to export; it is not modified.
+ *   @param data Receives ZQ_SCHEDULE_SIZE bytes.
+ *   @return The number of bytes written (ZQ_SCHEDULE_SIZE).
+ */
+uint64 ZigmaExport(const ZigmaContext* context, uint8* data);
+
+/* Load a context from a scheduled key file. The header, checksum and permutation vector are all verified before
+ * anything is written to the context.
+ *   @param context The context to initialize, or NULL to allocate a new context.
+ *   @param data The serialized key.
+ *   @param length The length of the serialized key.
+ *   @return The context, or NULL if the data is not a valid scheduled key of this version.
+ */
+ZigmaContext* ZigmaImport(ZigmaContext* context, const uint8* data, uint64 length);
+
+/* Initialize a context as a hash function; the same as `ZigmaCreate(context, NULL, 0)`.
+ *   @param context The context to initialize, or NULL to allocate a new context.
+ *   @return The initialized context.
+ */
+ZigmaContext* ZigmaHashInit(ZigmaContext* context);
+
+/* Feed `length` bytes into a hash context. The state advances exactly as `ZigmaEncodeBlock()` would advance it,
+ * but the ciphertext is never stored, so no output array is needed and the loop keeps the indices in registers.
+ * Splitting the data across calls does not change the digest.
+ *   @param context The context to be used as a hash function.
+ *   @param data The data to hash.
+ *   @param length The number of bytes to hash.
+ */
+void ZigmaHashUpdate(ZigmaContext* context, const uint8* data, uint64 length);
+
 /* Used to terminate a context to generate a hash value based on the permutation vector.
  *   @param context The context to be used as a hash function.
  *   @param data Pointer to location where the hash value will be stored.
@@ -89,18 +169,50 @@ uint8 ZigmaEncodeByte(ZigmaContext* context, uint8 byte);
  */
 uint8 ZigmaDecodeByte(ZigmaContext* context, uint8 byte);
 
-/* Encode a buffer.
+/* Encode a buffer in place.
  *   @param context The context to be used for encoding.
  *   @param buffer The buffer to encode.
  */
 void ZigmaEncodeBuffer(ZigmaContext* context, Buffer* buffer);
 
-/* Decode a buffer.
+/* Decode a buffer in place.
  *   @param context The context to be used for decoding.
  *   @param buffer The buffer to decode.
  */
 void ZigmaDecodeBuffer(ZigmaContext* context, Buffer* buffer);
 
+/* Encode `length` bytes from `input` into `output`. The input is never written, so it may be a read-only
+ * mapping; `output` may equal `input` for in-place operation but must not otherwise overlap it.
+ *   @param context The context to be used for encoding.
+ *   @param output The destination array.
+ *   @param input The source array.
+ *   @param length The number of bytes to encode.
+ */
+void ZigmaEncodeBlock(ZigmaContext* context, uint8* output, const uint8* input, uint64 length);
+
+/* Decode `length` bytes from `input` into `output`. The same aliasing rules as `ZigmaEncodeBlock()` apply.
+ *   @param context The context to be used for decoding.
+ *   @param output The destination array.
+ *   @param input The source array.
+ *   @param length The number of bytes to decode.
+ */
+void ZigmaDecodeBlock(ZigmaContext* context, uint8* output, const uint8* input, uint64 length);
+
+/* Encode many independent messages at once. ZQ_ZIGMA_BATCH_WIDTH lanes are stepped in lockstep in a single loop,
+ * so their dependent state lookups overlap instead of executing back to back; finished lanes are replaced by
+ * the next pending message. Every lane must have its own context, and each lane's output is identical to
+ * `ZigmaEncodeBlock()` on that lane alone.
+ *   @param lanes The messages to encode.
+ *   @param count The number of lanes.
+ */
+void ZigmaEncodeBatch(ZigmaLane* lanes, uint64 count);
+
+/* Decode many independent messages at once; see `ZigmaEncodeBatch()`.
+ *   @param lanes The messages to decode.
+ *   @param count The number of lanes.
+ */
+void ZigmaDecodeBatch(ZigmaLane* lanes, uint64 count);
+
 /* Print the context.
  */
 void ZigmaPrint(ZigmaContext* context);